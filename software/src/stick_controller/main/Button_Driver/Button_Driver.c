@@ -1,8 +1,11 @@
 #include "Button_Driver.h"
+#include "button_input.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "driver/gpio.h" 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 void  ESP32_Button_init(void){
   gpio_reset_pin(Button_PIN1);                        
@@ -12,19 +15,39 @@ void  ESP32_Button_init(void){
 uint8_t Button_GPIO_Get_Level(int GPIO_PIN){                
   return (uint8_t)(gpio_get_level(GPIO_PIN));
 }
-void Timer_Callback(void *arg){                             
-  button_ticks();                                       
+// Runs the state machines on each input event and every TICKS_INTERVAL
+// while a button is busy; sleeps while all are idle
+static bool Buttons_Busy(void);
+static void Button_Task(void *arg){
+  button_input_event_t event;
+  int64_t next_tick_us = esp_timer_get_time();
+  while(1){
+    bool busy = Buttons_Busy();
+    bool got = button_input_receive(&event, busy ? 1 : portMAX_DELAY);
+    int64_t now_us = esp_timer_get_time();
+    if(got && !busy){
+      next_tick_us = now_us;
+    }
+    while(next_tick_us <= now_us){
+      button_ticks();
+      next_tick_us += TICKS_INTERVAL * 1000;
+    }
+  }
 }
 
 
 
 struct Button BUTTON1;                   
+struct Button BUTTON_SLOW, BUTTON_MEDIUM, BUTTON_FAST;
 PressEvent BOOT_KEY_State,PWR_KEY_State;                    
+// Debounced level from button_input (button_id = button_input_id_t), active LOW
 uint8_t Read_Button_GPIO_Level(uint8_t button_id)           
 {
-  if(!button_id)                        
-    return (uint8_t)(gpio_get_level(Button_PIN1));
-  return 0;
+  return button_input_is_pressed((button_input_id_t)button_id) ? 0 : 1;
+}
+static bool Buttons_Busy(void){
+  return BUTTON1.state || BUTTON_SLOW.state || BUTTON_MEDIUM.state || BUTTON_FAST.state ||
+         button_input_pressed_mask() != 0;
 }
 void Button_SINGLE_CLICK_Callback(void* btn){          
   struct Button *user_button = (struct Button *)btn;      
@@ -47,23 +70,23 @@ void Button_LONG_PRESS_START_Callback(void* btn){
 void button_Init(void)
 {
   ESP32_Button_init();   
-  button_init(&BUTTON1, Read_Button_GPIO_Level, 0 , 0);  
+  button_init(&BUTTON1, Read_Button_GPIO_Level, 0 , BUTTON_INPUT_BOOT);  
+  button_init(&BUTTON_SLOW, Read_Button_GPIO_Level, 0 , BUTTON_INPUT_SLOW);  
+  button_init(&BUTTON_MEDIUM, Read_Button_GPIO_Level, 0 , BUTTON_INPUT_MEDIUM);  
+  button_init(&BUTTON_FAST, Read_Button_GPIO_Level, 0 , BUTTON_INPUT_FAST);  
   button_attach(&BUTTON1, SINGLE_CLICK, Button_SINGLE_CLICK_Callback);      
   button_attach(&BUTTON1, DOUBLE_CLICK, Button_DOUBLE_CLICK_Callback);          
   button_attach(&BUTTON1, LONG_PRESS_START, Button_LONG_PRESS_START_Callback); 
 
-  const esp_timer_create_args_t clock_tick_timer_args = 
-  {
-    .callback = &Timer_Callback,                                           
-    .name = "Timer_task",                               
-    .arg = NULL,
-  };
-  esp_timer_handle_t clock_tick_timer = NULL;
-  ESP_ERROR_CHECK(esp_timer_create(&clock_tick_timer_args, &clock_tick_timer));     
-  ESP_ERROR_CHECK(esp_timer_start_periodic(clock_tick_timer, 1000 * 5));  
+  // Speed buttons are configured by speed_buttons_init(), which runs first
+  ESP_ERROR_CHECK(button_input_start());
  
   BOOT_KEY_State = NONE_PRESS;              
   button_start(&BUTTON1);                                                   
+  button_start(&BUTTON_SLOW);                                                   
+  button_start(&BUTTON_MEDIUM);                                                   
+  button_start(&BUTTON_FAST);                                                   
+  xTaskCreatePinnedToCore(Button_Task, "button_task", 2048, NULL, 6, NULL, 0);
 }
 
 
@@ -10,6 +10,8 @@
 #define Button_PIN1   BOOT_KEY_PIN
 
 extern PressEvent BOOT_KEY_State;    
+// Click/long-press state machines of the speed buttons (get_button_event())
+extern struct Button BUTTON_SLOW, BUTTON_MEDIUM, BUTTON_FAST;
 
 void button_Init(void);
 
@@ -97,6 +97,10 @@ speed_level_t speed_buttons_get_level(void) {
     bool fast_pressed = false;
     speed_buttons_get_raw(&slow_pressed, &medium_pressed, &fast_pressed);
 
+    return speed_buttons_level_from(slow_pressed, medium_pressed, fast_pressed);
+}
+
+speed_level_t speed_buttons_level_from(bool slow_pressed, bool medium_pressed, bool fast_pressed) {
     // Priority: FAST > MEDIUM > SLOW
     // If multiple buttons pressed, highest speed wins
     if (fast_pressed) {
@@ -71,6 +71,18 @@ void speed_buttons_get_raw(bool *slow_pressed, bool *medium_pressed, bool *fast_
  */
 speed_level_t speed_buttons_get_level(void);
 
+/**
+ * @brief Speed level for given button states (e.g. debounced ones)
+ * 
+ * Same priority as speed_buttons_get_level(): FAST > MEDIUM > SLOW
+ * 
+ * @param slow_pressed   SLOW button held
+ * @param medium_pressed MEDIUM button held
+ * @param fast_pressed   FAST button held
+ * @return Speed level
+ */
+speed_level_t speed_buttons_level_from(bool slow_pressed, bool medium_pressed, bool fast_pressed);
+
 /**
  * @brief Get speed level as string
  * @param level Speed level
@@ -0,0 +1,255 @@
+/**
+ * @file button_input.c
+ * @brief Interrupt-driven, debounced input for the BOOT and speed buttons
+ */
+
+#include "button_input.h"
+#include "Button_Driver.h"
+#include "Speed_Buttons.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include <stdatomic.h>
+#include <string.h>
+
+static const char *TAG = "button_input";
+
+#define INPUT_QUEUE_LEN     16
+#define INPUT_INTEG_MAX     CONFIG_BUTTON_INTEGRATOR
+
+typedef struct {
+    gpio_num_t gpio;
+    bool stable;                // Debounced: pressed
+    bool settling;              // Interrupt masked, sampler running the integrator
+    uint8_t integ;              // 0 = released ... INPUT_INTEG_MAX = pressed
+} input_pin_t;
+
+static input_pin_t input_pins[BUTTON_INPUT_COUNT] = {
+    [BUTTON_INPUT_BOOT]   = { .gpio = Button_PIN1 },
+    [BUTTON_INPUT_SLOW]   = { .gpio = SPEED_BTN_SLOW_PIN },
+    [BUTTON_INPUT_MEDIUM] = { .gpio = SPEED_BTN_MEDIUM_PIN },
+    [BUTTON_INPUT_FAST]   = { .gpio = SPEED_BTN_FAST_PIN },
+};
+
+static portMUX_TYPE input_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_uint input_mask;
+static QueueHandle_t input_queue = NULL;
+static esp_timer_handle_t input_sampler = NULL;
+static button_input_stats_t input_stats;
+static button_input_hook_t input_hook = NULL;
+static void *input_hook_ctx = NULL;
+
+static inline bool input_read(const input_pin_t *pin) {
+    return gpio_get_level(pin->gpio) == 0;
+}
+
+// New debounced state of one pin: call with input_lock held
+static void IRAM_ATTR input_set_locked(int id, bool pressed, int64_t now_us) {
+    uint32_t mask;
+
+    input_pins[id].stable = pressed;
+    if (pressed) {
+        mask = atomic_fetch_or_explicit(&input_mask, BUTTON_INPUT_BIT(id), memory_order_relaxed) |
+               BUTTON_INPUT_BIT(id);
+    } else {
+        mask = atomic_fetch_and_explicit(&input_mask, ~BUTTON_INPUT_BIT(id), memory_order_relaxed) &
+               ~BUTTON_INPUT_BIT(id);
+    }
+    // Under the lock, so the hook sees every change in order
+    if (input_hook != NULL) {
+        input_hook(mask, now_us, input_hook_ctx);
+    }
+}
+
+// Take an edge: call with input_lock held. Returns true if *event is to be queued.
+static bool IRAM_ATTR input_edge_locked(int id, int64_t now_us, button_input_event_t *event) {
+    input_pin_t *pin = &input_pins[id];
+    bool pressed = input_read(pin);
+
+    input_stats.edges++;
+    gpio_intr_disable(pin->gpio);
+    pin->settling = true;
+    pin->integ = INPUT_INTEG_MAX / 2;
+    // Already running is fine (ESP_ERR_INVALID_STATE)
+    esp_timer_start_periodic(input_sampler, CONFIG_BUTTON_SAMPLE_US);
+
+    if (pressed == pin->stable) {
+        return false;           // Spike already over: the integrator decides
+    }
+    input_set_locked(id, pressed, now_us);
+    event->button = (uint8_t)id;
+    event->pressed = pressed;
+    event->time_us = now_us;
+    return true;
+}
+
+static void IRAM_ATTR input_isr(void *arg) {
+    int id = (int)(intptr_t)arg;
+    int64_t now_us = esp_timer_get_time();
+    button_input_event_t event;
+    BaseType_t woken = pdFALSE;
+
+    portENTER_CRITICAL_ISR(&input_lock);
+    bool publish = input_pins[id].settling ? false : input_edge_locked(id, now_us, &event);
+    portEXIT_CRITICAL_ISR(&input_lock);
+
+    if (publish && xQueueSendFromISR(input_queue, &event, &woken) != pdTRUE) {
+        portENTER_CRITICAL_ISR(&input_lock);
+        input_stats.dropped++;
+        portEXIT_CRITICAL_ISR(&input_lock);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+static void input_queue_event(const button_input_event_t *event) {
+    if (xQueueSend(input_queue, event, 0) != pdTRUE) {
+        portENTER_CRITICAL(&input_lock);
+        input_stats.dropped++;
+        portEXIT_CRITICAL(&input_lock);
+    }
+}
+
+static void input_sample(void *arg) {
+    (void)arg;
+    int64_t now_us = esp_timer_get_time();
+    button_input_event_t events[BUTTON_INPUT_COUNT];
+    int event_count = 0;
+    bool settled[BUTTON_INPUT_COUNT] = { false };
+    bool any_settling = false;
+
+    portENTER_CRITICAL(&input_lock);
+    for (int id = 0; id < BUTTON_INPUT_COUNT; id++) {
+        input_pin_t *pin = &input_pins[id];
+        if (!pin->settling) continue;
+
+        if (input_read(pin)) {
+            if (pin->integ < INPUT_INTEG_MAX) pin->integ++;
+        } else {
+            if (pin->integ > 0) pin->integ--;
+        }
+        if (pin->integ != 0 && pin->integ != INPUT_INTEG_MAX) {
+            any_settling = true;
+            continue;
+        }
+
+        pin->settling = false;
+        settled[id] = true;
+        bool pressed = pin->integ == INPUT_INTEG_MAX;
+        if (pressed != pin->stable) {
+            input_set_locked(id, pressed, now_us);
+            input_stats.corrections++;
+            events[event_count].button = (uint8_t)id;
+            events[event_count].pressed = pressed;
+            events[event_count].time_us = now_us;
+            event_count++;
+        }
+    }
+    if (!any_settling) {
+        esp_timer_stop(input_sampler);
+    }
+    portEXIT_CRITICAL(&input_lock);
+
+    // Queued before the interrupts come back, so each pin's events stay in order
+    for (int i = 0; i < event_count; i++) {
+        input_queue_event(&events[i]);
+    }
+
+    for (int id = 0; id < BUTTON_INPUT_COUNT; id++) {
+        if (!settled[id]) continue;
+
+        gpio_intr_enable(input_pins[id].gpio);
+        // An edge while the interrupt was masked would otherwise be lost
+        button_input_event_t event;
+        portENTER_CRITICAL(&input_lock);
+        bool publish = !input_pins[id].settling && input_read(&input_pins[id]) != input_pins[id].stable &&
+                       input_edge_locked(id, esp_timer_get_time(), &event);
+        portEXIT_CRITICAL(&input_lock);
+        if (publish) {
+            input_queue_event(&event);
+        }
+    }
+}
+
+esp_err_t button_input_start(void) {
+    if (input_queue != NULL) return ESP_ERR_INVALID_STATE;
+
+    input_queue = xQueueCreate(INPUT_QUEUE_LEN, sizeof(button_input_event_t));
+    if (input_queue == NULL) return ESP_ERR_NO_MEM;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = input_sample,
+        .name = "button_input",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &input_sampler);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Sampler create failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Shared with other drivers that may have installed it first
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "GPIO ISR service failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    memset(&input_stats, 0, sizeof(input_stats));
+    uint32_t mask = 0;
+    for (int id = 0; id < BUTTON_INPUT_COUNT; id++) {
+        input_pin_t *pin = &input_pins[id];
+        pin->stable = input_read(pin);
+        pin->integ = pin->stable ? INPUT_INTEG_MAX : 0;
+        if (pin->stable) mask |= BUTTON_INPUT_BIT(id);
+
+        ret = gpio_set_intr_type(pin->gpio, GPIO_INTR_ANYEDGE);
+        if (ret == ESP_OK) ret = gpio_isr_handler_add(pin->gpio, input_isr, (void *)(intptr_t)id);
+        if (ret == ESP_OK) ret = gpio_intr_enable(pin->gpio);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "GPIO%d interrupt failed: %s", pin->gpio, esp_err_to_name(ret));
+            return ret;
+        }
+    }
+    atomic_store(&input_mask, mask);
+
+    ESP_LOGI(TAG, "Edge interrupts on %d buttons, integrator %d x %d us",
+             BUTTON_INPUT_COUNT, INPUT_INTEG_MAX, CONFIG_BUTTON_SAMPLE_US);
+    return ESP_OK;
+}
+
+void button_input_set_hook(button_input_hook_t hook, void *ctx) {
+    portENTER_CRITICAL(&input_lock);
+    input_hook = hook;
+    input_hook_ctx = ctx;
+    portEXIT_CRITICAL(&input_lock);
+}
+
+uint32_t button_input_pressed_mask(void) {
+    return atomic_load_explicit(&input_mask, memory_order_relaxed);
+}
+
+bool button_input_is_pressed(button_input_id_t button) {
+    return (button_input_pressed_mask() & BUTTON_INPUT_BIT(button)) != 0;
+}
+
+bool button_input_receive(button_input_event_t *event, TickType_t wait) {
+    if (event == NULL || input_queue == NULL) return false;
+    if (xQueueReceive(input_queue, event, wait) != pdTRUE) return false;
+
+    int64_t latency = esp_timer_get_time() - event->time_us;
+    portENTER_CRITICAL(&input_lock);
+    input_stats.events++;
+    if (latency > (int64_t)input_stats.latency_max_us) {
+        input_stats.latency_max_us = (uint32_t)latency;
+    }
+    portEXIT_CRITICAL(&input_lock);
+    return true;
+}
+
+void button_input_get_stats(button_input_stats_t *stats) {
+    if (stats == NULL) return;
+
+    portENTER_CRITICAL(&input_lock);
+    *stats = input_stats;
+    portEXIT_CRITICAL(&input_lock);
+}
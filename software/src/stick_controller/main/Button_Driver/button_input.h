@@ -0,0 +1,113 @@
+/**
+ * @file button_input.h
+ * @brief Interrupt-driven, debounced input for the BOOT and speed buttons
+ *
+ * Every button pin raises an interrupt on both edges. Nothing is sampled
+ * while the buttons are idle:
+ * - The first edge from a settled pin is taken at once: the pressed mask
+ *   changes and an event stamped with the interrupt time is queued, so a
+ *   press is seen well under a millisecond after the contact closes.
+ * - The pin interrupt is then masked and a sampler reads the pin every
+ *   CONFIG_BUTTON_SAMPLE_US into a per-pin integrator. The pin is settled
+ *   when the integrator reaches either end; if that end disagrees with the
+ *   state taken on the edge (a spike, or a release during the bounce), a
+ *   correcting event is queued.
+ * - Settled pins get their interrupt back; the sampler stops when no pin
+ *   is settling.
+ *
+ * All pins are active LOW and must already be configured as inputs.
+ */
+
+#ifndef BUTTON_INPUT_H
+#define BUTTON_INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    BUTTON_INPUT_BOOT = 0,
+    BUTTON_INPUT_SLOW,
+    BUTTON_INPUT_MEDIUM,
+    BUTTON_INPUT_FAST,
+    BUTTON_INPUT_COUNT
+} button_input_id_t;
+
+#define BUTTON_INPUT_BIT(id)    (1UL << (id))
+
+typedef struct {
+    uint8_t button;             // button_input_id_t
+    bool pressed;
+    int64_t time_us;            // Edge (or settle) time, esp_timer_get_time()
+} button_input_event_t;
+
+typedef struct {
+    uint32_t edges;             // Edge interrupts taken
+    uint32_t events;            // Events taken by button_input_receive()
+    uint32_t corrections;       // Events that undid the state taken on an edge
+    uint32_t dropped;           // Events lost to a full queue
+    uint32_t latency_max_us;    // Edge to button_input_receive()
+} button_input_stats_t;
+
+/**
+ * @brief Called whenever the debounced mask changes
+ *
+ * Runs inside the driver's critical section, from the edge interrupt or
+ * the sampler timer, so it sees every change in order. Must be short,
+ * ISR-safe and in IRAM.
+ *
+ * @param mask    Buttons held now, BUTTON_INPUT_BIT() per button
+ * @param time_us Time of the change, esp_timer_get_time()
+ * @param ctx     User context given to button_input_set_hook()
+ */
+typedef void (*button_input_hook_t)(uint32_t mask, int64_t time_us, void *ctx);
+
+/**
+ * @brief Attach the edge interrupts and start
+ * @return ESP_OK, or the GPIO / timer / queue error
+ */
+esp_err_t button_input_start(void);
+
+/**
+ * @brief Install the mask change hook (one at a time)
+ * @param hook Hook, or NULL to remove it
+ * @param ctx  Passed to the hook
+ */
+void button_input_set_hook(button_input_hook_t hook, void *ctx);
+
+/**
+ * @brief Debounced buttons held now, BUTTON_INPUT_BIT() per button
+ *
+ * Lock-free; for the control loop.
+ */
+uint32_t button_input_pressed_mask(void);
+
+/**
+ * @brief Whether one button is held (debounced)
+ */
+bool button_input_is_pressed(button_input_id_t button);
+
+/**
+ * @brief Take the next press/release event
+ * @param event Output
+ * @param wait  Ticks to wait for one
+ * @return true if an event was received
+ */
+bool button_input_receive(button_input_event_t *event, TickType_t wait);
+
+/**
+ * @brief Read the counters
+ * @param stats Output
+ */
+void button_input_get_stats(button_input_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BUTTON_INPUT_H
@@ -11,7 +11,7 @@
 
 //According to your need to modify the constants.
 #define TICKS_INTERVAL    5	//ms
-#define DEBOUNCE_TICKS    3	//MAX 7 (0 ~ 7)
+#define DEBOUNCE_TICKS    0	//MAX 7 (0 ~ 7); levels arrive debounced from button_input
 #define SHORT_TICKS       (300 /TICKS_INTERVAL)
 #define LONG_TICKS        (1000 /TICKS_INTERVAL)
 
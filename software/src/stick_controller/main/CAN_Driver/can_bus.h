@@ -0,0 +1,86 @@
+/**
+ * @file can_bus.h
+ * @brief Minimal CAN bus interface with interchangeable backends
+ *
+ * Code above this layer only sees can_frame_t and a can_backend_t, so the
+ * same logic runs on:
+ * - the ESP32-S3 TWAI controller (can_backend_twai)
+ * - Linux SocketCAN, e.g. a vcan interface, when built for the IDF linux
+ *   target (can_backend_socketcan)
+ */
+
+#ifndef CAN_BUS_H
+#define CAN_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAN_BUS_MAX_DLC     8
+
+// One classic CAN frame
+typedef struct {
+    uint32_t id;                // 11- or 29-bit identifier
+    bool extended;              // 29-bit identifier
+    uint8_t dlc;                // Data length (0..8)
+    uint8_t data[CAN_BUS_MAX_DLC];
+} can_frame_t;
+
+// Bus settings; each backend uses the fields that apply to it
+typedef struct {
+    int tx_gpio;                // TWAI TX pin (to transceiver TXD)
+    int rx_gpio;                // TWAI RX pin (from transceiver RXD)
+    uint32_t bitrate;           // 125000, 250000, 500000 or 1000000
+    const char *ifname;         // SocketCAN interface, e.g. "vcan0"
+} can_bus_config_t;
+
+// Backend operations
+typedef struct {
+    const char *name;
+
+    /**
+     * @brief Open the bus
+     * @param config Bus settings
+     * @return ESP_OK on success
+     */
+    esp_err_t (*start)(const can_bus_config_t *config);
+
+    /**
+     * @brief Close the bus
+     */
+    void (*stop)(void);
+
+    /**
+     * @brief Wait for a received frame
+     * @param frame      Output
+     * @param timeout_ms Longest wait
+     * @return ESP_OK, ESP_ERR_TIMEOUT, or another error if the bus failed
+     */
+    esp_err_t (*receive)(can_frame_t *frame, uint32_t timeout_ms);
+
+    /**
+     * @brief Queue a frame for transmission
+     * @param frame      Frame to send
+     * @param timeout_ms Longest wait for space in the TX queue
+     * @return ESP_OK on success
+     */
+    esp_err_t (*transmit)(const can_frame_t *frame, uint32_t timeout_ms);
+} can_backend_t;
+
+#if defined(__linux__)
+extern const can_backend_t can_backend_socketcan;
+#define CAN_BUS_DEFAULT_BACKEND (&can_backend_socketcan)
+#else
+extern const can_backend_t can_backend_twai;
+#define CAN_BUS_DEFAULT_BACKEND (&can_backend_twai)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CAN_BUS_H
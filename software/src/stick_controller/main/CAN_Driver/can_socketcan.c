@@ -0,0 +1,128 @@
+/**
+ * @file can_socketcan.c
+ * @brief CAN backend on Linux SocketCAN, for off-target runs
+ *
+ * Used when the firmware is built for the IDF linux target. Works with
+ * real interfaces and with a virtual one:
+ *   sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+ *   cansend vcan0 00000954#0000138800640190   (STATUS_1 from controller 84)
+ */
+
+#include "can_bus.h"
+
+#if defined(__linux__)
+
+#include "esp_log.h"
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+static const char *TAG = "can_socketcan";
+
+static int can_socket = -1;
+
+static esp_err_t socketcan_start(const can_bus_config_t *config) {
+    struct ifreq ifr;
+    struct sockaddr_can addr;
+
+    if (config == NULL || config->ifname == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Bit rate is a property of the interface (ip link), not of the socket
+    can_socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (can_socket < 0) {
+        ESP_LOGE(TAG, "socket() failed: %s", strerror(errno));
+        return ESP_FAIL;
+    }
+
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, config->ifname, IFNAMSIZ - 1);
+    if (ioctl(can_socket, SIOCGIFINDEX, &ifr) < 0) {
+        ESP_LOGE(TAG, "No interface %s: %s", config->ifname, strerror(errno));
+        close(can_socket);
+        can_socket = -1;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(can_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "bind() failed: %s", strerror(errno));
+        close(can_socket);
+        can_socket = -1;
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "SocketCAN opened on %s", config->ifname);
+    return ESP_OK;
+}
+
+static void socketcan_stop(void) {
+    if (can_socket >= 0) {
+        close(can_socket);
+        can_socket = -1;
+    }
+}
+
+static esp_err_t socketcan_receive(can_frame_t *frame, uint32_t timeout_ms) {
+    struct pollfd pfd = { .fd = can_socket, .events = POLLIN };
+    struct can_frame raw;
+
+    if (can_socket < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int ready = poll(&pfd, 1, (int)timeout_ms);
+    if (ready == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (ready < 0) {
+        return errno == EINTR ? ESP_ERR_TIMEOUT : ESP_FAIL;
+    }
+
+    if (read(can_socket, &raw, sizeof(raw)) != (ssize_t)sizeof(raw)) {
+        return ESP_FAIL;
+    }
+    if (raw.can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)) {
+        return ESP_ERR_TIMEOUT;     // Not a data frame; caller just waits again
+    }
+
+    frame->extended = (raw.can_id & CAN_EFF_FLAG) != 0;
+    frame->id = raw.can_id & (frame->extended ? CAN_EFF_MASK : CAN_SFF_MASK);
+    frame->dlc = raw.can_dlc > CAN_BUS_MAX_DLC ? CAN_BUS_MAX_DLC : raw.can_dlc;
+    memcpy(frame->data, raw.data, frame->dlc);
+    return ESP_OK;
+}
+
+static esp_err_t socketcan_transmit(const can_frame_t *frame, uint32_t timeout_ms) {
+    struct can_frame raw;
+    (void)timeout_ms;
+
+    if (can_socket < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(&raw, 0, sizeof(raw));
+    raw.can_id = frame->id | (frame->extended ? CAN_EFF_FLAG : 0);
+    raw.can_dlc = frame->dlc;
+    memcpy(raw.data, frame->data, frame->dlc);
+    return write(can_socket, &raw, sizeof(raw)) == (ssize_t)sizeof(raw) ? ESP_OK : ESP_FAIL;
+}
+
+const can_backend_t can_backend_socketcan = {
+    .name = "socketcan",
+    .start = socketcan_start,
+    .stop = socketcan_stop,
+    .receive = socketcan_receive,
+    .transmit = socketcan_transmit,
+};
+
+#endif // __linux__
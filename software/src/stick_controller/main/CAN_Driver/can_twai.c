@@ -0,0 +1,113 @@
+/**
+ * @file can_twai.c
+ * @brief CAN backend on the ESP32-S3 TWAI controller
+ *
+ * Needs an external CAN transceiver (e.g. SN65HVD230) between the TWAI
+ * pins and the VESC CAN bus.
+ */
+
+#include "can_bus.h"
+
+#if !defined(__linux__)
+
+#include "driver/twai.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "can_twai";
+
+#define CAN_TWAI_RX_QUEUE_LEN   32      // ~6 status bursts per controller at 50 Hz
+#define CAN_TWAI_TX_QUEUE_LEN   4
+
+static bool twai_bitrate_timing(uint32_t bitrate, twai_timing_config_t *timing) {
+    switch (bitrate) {
+        case 125000:  *timing = (twai_timing_config_t)TWAI_TIMING_CONFIG_125KBITS(); return true;
+        case 250000:  *timing = (twai_timing_config_t)TWAI_TIMING_CONFIG_250KBITS(); return true;
+        case 500000:  *timing = (twai_timing_config_t)TWAI_TIMING_CONFIG_500KBITS(); return true;
+        case 1000000: *timing = (twai_timing_config_t)TWAI_TIMING_CONFIG_1MBITS();   return true;
+        default:      return false;
+    }
+}
+
+static esp_err_t twai_backend_start(const can_bus_config_t *config) {
+    twai_timing_config_t timing;
+    if (config == NULL || !twai_bitrate_timing(config->bitrate, &timing)) {
+        ESP_LOGE(TAG, "Unsupported bitrate");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Normal mode so frames are acknowledged even when the VESC is the only other node
+    twai_general_config_t general = TWAI_GENERAL_CONFIG_DEFAULT(config->tx_gpio, config->rx_gpio,
+                                                                TWAI_MODE_NORMAL);
+    general.rx_queue_len = CAN_TWAI_RX_QUEUE_LEN;
+    general.tx_queue_len = CAN_TWAI_TX_QUEUE_LEN;
+    twai_filter_config_t filter = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+
+    esp_err_t ret = twai_driver_install(&general, &timing, &filter);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "TWAI driver install failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = twai_start();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "TWAI start failed: %s", esp_err_to_name(ret));
+        twai_driver_uninstall();
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "TWAI started on TX:%d RX:%d @ %lu bit/s",
+             config->tx_gpio, config->rx_gpio, (unsigned long)config->bitrate);
+    return ESP_OK;
+}
+
+static void twai_backend_stop(void) {
+    twai_stop();
+    twai_driver_uninstall();
+}
+
+static esp_err_t twai_backend_receive(can_frame_t *frame, uint32_t timeout_ms) {
+    twai_message_t msg;
+
+    esp_err_t ret = twai_receive(&msg, pdMS_TO_TICKS(timeout_ms));
+    if (ret != ESP_OK) {
+        // Quiet bus: recover from bus-off (which ends in STOPPED) so reception resumes
+        twai_status_info_t status;
+        if (ret == ESP_ERR_TIMEOUT && twai_get_status_info(&status) == ESP_OK) {
+            if (status.state == TWAI_STATE_BUS_OFF) {
+                ESP_LOGW(TAG, "Bus off, recovering");
+                twai_initiate_recovery();
+            } else if (status.state == TWAI_STATE_STOPPED) {
+                twai_start();
+            }
+        }
+        return ret;
+    }
+
+    frame->id = msg.identifier;
+    frame->extended = msg.extd;
+    frame->dlc = msg.data_length_code > CAN_BUS_MAX_DLC ? CAN_BUS_MAX_DLC : msg.data_length_code;
+    memcpy(frame->data, msg.data, frame->dlc);
+    return ESP_OK;
+}
+
+static esp_err_t twai_backend_transmit(const can_frame_t *frame, uint32_t timeout_ms) {
+    twai_message_t msg = {
+        .extd = frame->extended,
+        .identifier = frame->id,
+        .data_length_code = frame->dlc,
+    };
+    memcpy(msg.data, frame->data, frame->dlc);
+    return twai_transmit(&msg, pdMS_TO_TICKS(timeout_ms));
+}
+
+const can_backend_t can_backend_twai = {
+    .name = "twai",
+    .start = twai_backend_start,
+    .stop = twai_backend_stop,
+    .receive = twai_backend_receive,
+    .transmit = twai_backend_transmit,
+};
+
+#endif // !__linux__
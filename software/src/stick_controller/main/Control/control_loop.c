@@ -0,0 +1,178 @@
+/**
+ * @file control_loop.c
+ * @brief Fixed-rate control loop on its own core
+ */
+
+#include "control_loop.h"
+#include "driver/gptimer.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char *TAG = "control_loop";
+
+#define LOOP_TIMER_HZ       1000000     // GPTimer resolution: 1 us per count
+#define LOOP_RUN_AVG_SHIFT  4           // Running average weight 1/16
+
+static control_loop_config_t loop_config;
+static control_loop_step_t loop_step = NULL;
+static void *loop_ctx = NULL;
+static TaskHandle_t loop_task_handle = NULL;
+static gptimer_handle_t loop_timer = NULL;
+static volatile int64_t loop_alarm_us = 0;      // Written by the alarm interrupt
+
+// Start-up handshake: the timer is created from the loop task so its
+// interrupt lands on the control core
+static StaticSemaphore_t loop_ready_buf;
+static SemaphoreHandle_t loop_ready = NULL;
+static esp_err_t loop_start_err = ESP_OK;
+
+static portMUX_TYPE loop_lock = portMUX_INITIALIZER_UNLOCKED;
+static control_loop_stats_t loop_stats;
+static uint32_t loop_run_avg_x16 = 0;
+
+static bool IRAM_ATTR loop_on_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata,
+                                    void *user_ctx) {
+    (void)timer;
+    (void)edata;
+    (void)user_ctx;
+    BaseType_t woken = pdFALSE;
+
+    loop_alarm_us = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(loop_task_handle, &woken);
+    return woken == pdTRUE;
+}
+
+static esp_err_t loop_timer_start(void) {
+    const gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = LOOP_TIMER_HZ,
+    };
+    const gptimer_event_callbacks_t callbacks = {
+        .on_alarm = loop_on_alarm,
+    };
+    const gptimer_alarm_config_t alarm_config = {
+        .alarm_count = loop_config.period_us,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+
+    esp_err_t ret = gptimer_new_timer(&timer_config, &loop_timer);
+    if (ret != ESP_OK) return ret;
+
+    ret = gptimer_register_event_callbacks(loop_timer, &callbacks, NULL);
+    if (ret == ESP_OK) ret = gptimer_set_alarm_action(loop_timer, &alarm_config);
+    if (ret == ESP_OK) ret = gptimer_enable(loop_timer);
+    if (ret == ESP_OK) ret = gptimer_start(loop_timer);
+    if (ret != ESP_OK) {
+        gptimer_del_timer(loop_timer);
+        loop_timer = NULL;
+    }
+    return ret;
+}
+
+static void loop_record(int64_t alarm_us, int64_t start_us, int64_t prev_start_us, uint32_t run_us,
+                        uint32_t missed) {
+    uint32_t latency = start_us > alarm_us ? (uint32_t)(start_us - alarm_us) : 0;
+    uint32_t jitter = 0;
+    if (prev_start_us != 0) {
+        int64_t deviation = start_us - prev_start_us - (int64_t)loop_config.period_us * (1 + missed);
+        jitter = (uint32_t)(deviation < 0 ? -deviation : deviation);
+    }
+
+    portENTER_CRITICAL(&loop_lock);
+    loop_stats.steps++;
+    loop_stats.missed += missed;
+    if (run_us > loop_config.budget_us) loop_stats.overruns++;
+    if (latency > loop_stats.latency_max_us) loop_stats.latency_max_us = latency;
+    if (jitter > loop_stats.jitter_max_us) loop_stats.jitter_max_us = jitter;
+    if (run_us > loop_stats.run_max_us) loop_stats.run_max_us = run_us;
+    loop_run_avg_x16 += run_us - (loop_run_avg_x16 >> LOOP_RUN_AVG_SHIFT);
+    loop_stats.run_avg_us = loop_run_avg_x16 >> LOOP_RUN_AVG_SHIFT;
+    portEXIT_CRITICAL(&loop_lock);
+}
+
+static void loop_task(void *arg) {
+    (void)arg;
+    int64_t prev_start_us = 0;
+    bool overrun_logged = false;
+
+    loop_task_handle = xTaskGetCurrentTaskHandle();
+    loop_start_err = loop_timer_start();
+    xSemaphoreGive(loop_ready);
+    if (loop_start_err != ESP_OK) {
+        loop_task_handle = NULL;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (1) {
+        // More than one pending alarm: steps were skipped while this one ran late
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t start_us = esp_timer_get_time();
+        int64_t alarm_us = loop_alarm_us;
+
+        loop_step(start_us, loop_ctx);
+
+        uint32_t run_us = (uint32_t)(esp_timer_get_time() - start_us);
+        uint32_t missed = pending > 1 ? pending - 1 : 0;
+        loop_record(alarm_us, start_us, prev_start_us, run_us, missed);
+        prev_start_us = start_us;
+
+        if (!overrun_logged && (run_us > loop_config.budget_us || missed)) {
+            overrun_logged = true;
+            ESP_LOGW(TAG, "Step took %lu us (budget %lu us), %lu period(s) missed",
+                     (unsigned long)run_us, (unsigned long)loop_config.budget_us, (unsigned long)missed);
+        }
+    }
+}
+
+esp_err_t control_loop_start(const control_loop_config_t *config, control_loop_step_t step, void *ctx) {
+    if (config == NULL || step == NULL || config->period_us == 0 || config->budget_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (loop_task_handle != NULL) return ESP_ERR_INVALID_STATE;
+
+    loop_config = *config;
+    loop_step = step;
+    loop_ctx = ctx;
+    control_loop_reset_stats();
+    if (loop_ready == NULL) {
+        loop_ready = xSemaphoreCreateBinaryStatic(&loop_ready_buf);
+    }
+
+    if (xTaskCreatePinnedToCore(loop_task, "control_loop", config->stack_size, NULL, config->priority,
+                                &loop_task_handle, config->core) != pdPASS) {
+        loop_task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreTake(loop_ready, portMAX_DELAY);
+    if (loop_start_err != ESP_OK) {
+        ESP_LOGE(TAG, "Timer start failed: %s", esp_err_to_name(loop_start_err));
+        return loop_start_err;
+    }
+
+    ESP_LOGI(TAG, "Running every %lu us on core %d, budget %lu us",
+             (unsigned long)config->period_us, config->core, (unsigned long)config->budget_us);
+    return ESP_OK;
+}
+
+void control_loop_get_stats(control_loop_stats_t *stats) {
+    if (stats == NULL) return;
+
+    portENTER_CRITICAL(&loop_lock);
+    *stats = loop_stats;
+    portEXIT_CRITICAL(&loop_lock);
+}
+
+void control_loop_reset_stats(void) {
+    portENTER_CRITICAL(&loop_lock);
+    memset(&loop_stats, 0, sizeof(loop_stats));
+    loop_stats.budget_us = loop_config.budget_us;
+    loop_run_avg_x16 = 0;
+    portEXIT_CRITICAL(&loop_lock);
+}
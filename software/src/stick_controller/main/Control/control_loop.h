@@ -0,0 +1,79 @@
+/**
+ * @file control_loop.h
+ * @brief Fixed-rate control loop on its own core
+ *
+ * A GPTimer alarm wakes a high-priority task pinned to the control core at
+ * a fixed rate, independent of the FreeRTOS tick. The task runs one step
+ * per alarm and measures it:
+ * - latency: alarm interrupt to step start
+ * - jitter: deviation of the step start from the nominal period
+ * - run time against the budget; a step over budget is an overrun
+ * - missed periods: alarms that fired while a step was still running
+ *
+ * The step must not block. Anything slow (UART requests, NVS, display)
+ * belongs in the lower-priority tasks on the other core.
+ */
+
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One control step
+ * @param now_us Start of the step (esp_timer_get_time())
+ * @param ctx    User context given to control_loop_start()
+ */
+typedef void (*control_loop_step_t)(int64_t now_us, void *ctx);
+
+typedef struct {
+    uint32_t period_us;         // Step period
+    uint32_t budget_us;         // Longest allowed step
+    int core;                   // Core the task is pinned to (and the alarm interrupt allocated on)
+    uint32_t priority;          // FreeRTOS priority of the task
+    uint32_t stack_size;        // Task stack in bytes
+} control_loop_config_t;
+
+typedef struct {
+    uint32_t steps;             // Steps run
+    uint32_t overruns;          // Steps that took longer than budget_us
+    uint32_t missed;            // Alarms that found the previous step still running
+    uint32_t latency_max_us;    // Alarm interrupt to step start
+    uint32_t jitter_max_us;     // |start - previous start - period|
+    uint32_t run_avg_us;        // Step run time, running average
+    uint32_t run_max_us;
+    uint32_t budget_us;
+} control_loop_stats_t;
+
+/**
+ * @brief Create the timer and the task and start stepping
+ * @param config Rate, budget and task placement
+ * @param step   Step function
+ * @param ctx    Passed to step
+ * @return ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_INVALID_STATE if already
+ *         running, or the timer/task creation error
+ */
+esp_err_t control_loop_start(const control_loop_config_t *config, control_loop_step_t step, void *ctx);
+
+/**
+ * @brief Get the timing counters
+ * @param stats Output
+ */
+void control_loop_get_stats(control_loop_stats_t *stats);
+
+/**
+ * @brief Clear the maxima and counters (e.g. after start-up effects)
+ */
+void control_loop_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONTROL_LOOP_H
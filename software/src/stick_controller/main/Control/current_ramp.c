@@ -0,0 +1,90 @@
+/**
+ * @file current_ramp.c
+ * @brief Jerk-limited current setpoint ramp
+ */
+
+#include "current_ramp.h"
+#include <math.h>
+
+#define RAMP_SETTLE_A   0.001f      // Closer than this is on target (1 mA, the wire resolution)
+
+void current_ramp_reset(current_ramp_t *ramp, float current) {
+    ramp->current = current;
+    ramp->rate = 0.0f;
+    ramp->target = current;
+}
+
+void current_ramp_set_target(current_ramp_t *ramp, float target, const current_ramp_profile_t *profile) {
+    ramp->target = target;
+    ramp->profile = *profile;
+}
+
+// Fastest slew rate that still eases out onto the target in steps of dt_s.
+// Slowing by dv = jerk * dt_s per step from v = (m + f) * dv, m whole and
+// 0 <= f < 1, covers ((m + 1) * f + m * (m + 1) / 2) * dv * dt_s: solved
+// for v at distance. On this curve every step slows by exactly dv and the
+// last one lands on the target at under dv, so the jerk limit holds to the
+// end. A quarter step of margin keeps float rounding of the setpoint from
+// pushing the ramp above the curve, where it could only catch up late.
+static float ramp_ease_rate(float distance, float jerk, float dt_s) {
+    float dv = jerk * dt_s;
+    float u = distance / (dv * dt_s);           // Distance in steps of dv * dt_s
+    if (u <= 1.0f) {
+        return distance / dt_s;                 // Lands on the next step
+    }
+    u -= 0.25f;
+
+    float m = floorf((sqrtf(8.0f * u + 1.0f) - 1.0f) / 2.0f);
+    float f = (u - m * (m + 1.0f) / 2.0f) / (m + 1.0f);
+    f = f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+    return (m + f) * dv;
+}
+
+float current_ramp_step(current_ramp_t *ramp, float dt_s) {
+    float error = ramp->target - ramp->current;
+    if (fabsf(error) < RAMP_SETTLE_A) {
+        current_ramp_reset(ramp, ramp->target);
+        return ramp->current;
+    }
+    if (dt_s <= 0.0f) {
+        return ramp->current;
+    }
+
+    const current_ramp_profile_t *p = &ramp->profile;
+    float dir = error > 0.0f ? 1.0f : -1.0f;
+    float rate_max = error > 0.0f ? p->rate_up : p->rate_down;
+
+    if (rate_max <= 0.0f && p->jerk <= 0.0f) {
+        // No limits: plain step
+        current_ramp_reset(ramp, ramp->target);
+        return ramp->current;
+    }
+
+    // A new target behind the setpoint: stop moving away at once rather than ease out
+    if (ramp->rate * dir < 0.0f) {
+        ramp->rate = 0.0f;
+    }
+
+    float want = rate_max > 0.0f ? rate_max : INFINITY;
+    if (p->jerk > 0.0f) {
+        float ease = ramp_ease_rate(fabsf(error), p->jerk, dt_s);
+        if (ease < want) want = ease;
+        float dv = p->jerk * dt_s;
+        float change = dir * want - ramp->rate;
+        ramp->rate += change > dv ? dv : (change < -dv ? -dv : change);
+    } else {
+        ramp->rate = dir * want;
+    }
+
+    float next = ramp->current + ramp->rate * dt_s;
+    if ((dir > 0.0f && next >= ramp->target) || (dir < 0.0f && next <= ramp->target)) {
+        current_ramp_reset(ramp, ramp->target);
+    } else {
+        ramp->current = next;
+    }
+    return ramp->current;
+}
+
+bool current_ramp_done(const current_ramp_t *ramp) {
+    return ramp->current == ramp->target && ramp->rate == 0.0f;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file current_ramp.h
+ * @brief Jerk-limited current setpoint ramp
+ *
+ * Moves a current setpoint towards its target in small steps instead of
+ * one jump. The slew rate (A/s) is capped separately for rising and
+ * falling current, and the slew rate itself changes by at most the jerk
+ * limit (A/s^2), so the setpoint follows an S-curve: it eases in, runs at
+ * the rate cap and eases out onto the target without overshoot. A new
+ * target mid-ramp continues from the present setpoint and slew rate; if
+ * the setpoint was moving away from the new target it stops at once.
+ *
+ * Pure arithmetic, no ESP-IDF dependencies: it runs on the host as well.
+ */
+
+#ifndef CURRENT_RAMP_H
+#define CURRENT_RAMP_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float rate_up;              // Max slew towards more current (A/s), 0 = no limit
+    float rate_down;            // Max slew towards less current (A/s), 0 = no limit
+    float jerk;                 // Max change of the slew rate (A/s^2), 0 = no limit
+} current_ramp_profile_t;
+
+typedef struct {
+    float current;              // Setpoint now (A)
+    float rate;                 // Slew rate now (A/s)
+    float target;               // Setpoint being ramped to (A)
+    current_ramp_profile_t profile;
+} current_ramp_t;
+
+/**
+ * @brief Start at rest
+ * @param ramp    Ramp state
+ * @param current Initial setpoint, also the target
+ */
+void current_ramp_reset(current_ramp_t *ramp, float current);
+
+/**
+ * @brief Ramp to a new target
+ * @param ramp    Ramp state
+ * @param target  Setpoint to reach (A)
+ * @param profile Limits for this move (copied)
+ */
+void current_ramp_set_target(current_ramp_t *ramp, float target, const current_ramp_profile_t *profile);
+
+/**
+ * @brief Advance the ramp
+ * @param ramp Ramp state
+ * @param dt_s Time since the previous step (s)
+ * @return The new setpoint
+ */
+float current_ramp_step(current_ramp_t *ramp, float dt_s);
+
+/**
+ * @brief Whether the setpoint has settled on the target
+ */
+bool current_ramp_done(const current_ramp_t *ramp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CURRENT_RAMP_H
@@ -0,0 +1,161 @@
+/**
+ * @file estop.c
+ * @brief Emergency-stop chord fast path
+ */
+
+#include "estop.h"
+#include "button_input.h"
+#include "vesc_io.h"
+#include "vesc_cmd.h"
+#include "vesc_uart.h"
+#include "driver/gptimer.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdatomic.h>
+#include <string.h>
+
+static const char *TAG = "estop";
+
+#define ESTOP_TIMER_HZ  1000000     // GPTimer resolution: 1 us per count
+#define ESTOP_CHORD     (BUTTON_INPUT_BIT(BUTTON_INPUT_SLOW) | BUTTON_INPUT_BIT(BUTTON_INPUT_MEDIUM) | \
+                         BUTTON_INPUT_BIT(BUTTON_INPUT_FAST))
+
+static gptimer_handle_t estop_timer = NULL;
+static uint32_t estop_hold_us = 0;
+static atomic_bool estop_fired;
+
+// Guarded by estop_lock: taken from the button hook and the alarm interrupt
+static portMUX_TYPE estop_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool estop_chord = false;        // All three held
+static bool estop_armed = false;        // Timer running towards the alarm
+static int64_t estop_due_us = 0;        // Chord time + hold time
+static estop_stats_t estop_stats;
+
+// Runs inside button_input's critical section, from its interrupt or sampler
+static void IRAM_ATTR estop_on_buttons(uint32_t mask, int64_t time_us, void *ctx) {
+    (void)ctx;
+    bool chord = (mask & ESTOP_CHORD) == ESTOP_CHORD;
+
+    portENTER_CRITICAL_SAFE(&estop_lock);
+    if (chord != estop_chord) {
+        estop_chord = chord;
+        if (chord) {
+            const gptimer_alarm_config_t alarm_config = {
+                .alarm_count = estop_hold_us,
+            };
+            gptimer_set_raw_count(estop_timer, 0);
+            gptimer_set_alarm_action(estop_timer, &alarm_config);
+            estop_armed = true;
+            estop_due_us = time_us + estop_hold_us;
+            estop_stats.armed++;
+        } else if (estop_armed) {
+            gptimer_set_alarm_action(estop_timer, NULL);
+            estop_armed = false;
+            estop_stats.cancelled++;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&estop_lock);
+}
+
+static bool IRAM_ATTR estop_on_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata,
+                                     void *user_ctx) {
+    (void)timer;
+    (void)edata;
+    (void)user_ctx;
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&estop_lock);
+    // Released just as the alarm came: disarmed, ignore it
+    bool fire = estop_armed;
+    int64_t due_us = estop_due_us;
+    estop_armed = false;
+    if (fire) {
+        uint32_t late = now_us > due_us ? (uint32_t)(now_us - due_us) : 0;
+        estop_stats.fired++;
+        if (late > estop_stats.alarm_late_max_us) estop_stats.alarm_late_max_us = late;
+    }
+    portEXIT_CRITICAL_ISR(&estop_lock);
+
+    if (!fire) return false;
+
+    // Motor commands are held back before the control loop can see the e-stop
+    bool woken = vesc_io_estop_from_isr(due_us);
+    atomic_store(&estop_fired, true);
+    return woken;
+}
+
+esp_err_t estop_start(const int *can_ids, int count, uint32_t hold_ms) {
+    if (can_ids == NULL || count <= 0 || count > VESC_MAX_CONTROLLERS || hold_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (estop_timer != NULL) return ESP_ERR_INVALID_STATE;
+
+    // 0 A to every controller, encoded now so the interrupt only has to point at it
+    uint8_t payloads[VESC_MAX_CONTROLLERS][VESC_MOTOR_COMMAND_MAX_LEN];
+    vesc_io_frame_t frames[VESC_MAX_CONTROLLERS];
+    for (int i = 0; i < count; i++) {
+        frames[i].payload = payloads[i];
+        frames[i].len = vesc_build_motor_command(payloads[i], can_ids[i], COMM_SET_CURRENT, 0.0f);
+    }
+    esp_err_t ret = vesc_io_estop_prepare(frames, count);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "E-stop burst does not fit: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    const gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = ESTOP_TIMER_HZ,
+    };
+    const gptimer_event_callbacks_t callbacks = {
+        .on_alarm = estop_on_alarm,
+    };
+
+    ret = gptimer_new_timer(&timer_config, &estop_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Timer create failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    // Free-running; the alarm is only set while the chord is held
+    ret = gptimer_register_event_callbacks(estop_timer, &callbacks, NULL);
+    if (ret == ESP_OK) ret = gptimer_enable(estop_timer);
+    if (ret == ESP_OK) ret = gptimer_start(estop_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Timer start failed: %s", esp_err_to_name(ret));
+        gptimer_del_timer(estop_timer);
+        estop_timer = NULL;
+        return ret;
+    }
+
+    estop_hold_us = hold_ms * 1000;
+    memset(&estop_stats, 0, sizeof(estop_stats));
+    atomic_store(&estop_fired, false);
+    // Held at start-up: needs a release and a new chord to count
+    estop_chord = (button_input_pressed_mask() & ESTOP_CHORD) == ESTOP_CHORD;
+    button_input_set_hook(estop_on_buttons, NULL);
+
+    ESP_LOGI(TAG, "Chord hold %lu ms, %d controller(s) in the 0 A burst",
+             (unsigned long)hold_ms, count);
+    return ESP_OK;
+}
+
+bool estop_take(void) {
+    return atomic_exchange(&estop_fired, false);
+}
+
+void estop_acknowledge(void) {
+    uint32_t hold = vesc_io_estop_held();
+    if (hold != 0) {
+        vesc_cmd_release_estop(hold);
+    }
+}
+
+void estop_get_stats(estop_stats_t *stats) {
+    if (stats == NULL) return;
+
+    portENTER_CRITICAL(&estop_lock);
+    *stats = estop_stats;
+    portEXIT_CRITICAL(&estop_lock);
+}
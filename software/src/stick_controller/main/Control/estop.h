@@ -0,0 +1,74 @@
+/**
+ * @file estop.h
+ * @brief Emergency-stop chord fast path
+ *
+ * Holding SLOW, MEDIUM and FAST together for CONFIG_ESTOP_HOLD_MS cuts
+ * every motor without going through the control loop:
+ * - the button change that completes the chord (edge interrupt) arms a
+ *   one-shot hardware timer; releasing any of the three disarms it
+ * - the timer interrupt hands the VESC I/O engine its pre-built 0 A burst,
+ *   written ahead of everything queued (see vesc_io_estop_from_isr())
+ * - the control loop picks the e-stop up with estop_take(), sets its own
+ *   setpoint to 0 A and calls estop_acknowledge(); the hold ends when the
+ *   setpoint scheduler's 0 A batch goes out, not before
+ *
+ * The chord is complete when the hold time has run out. The engine's
+ * vesc_io_estop_stats_t times the burst from that moment; estop_stats_t
+ * adds how late the timer interrupt ran.
+ */
+
+#ifndef ESTOP_H
+#define ESTOP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t armed;             // Chords made
+    uint32_t cancelled;         // Chords released before the hold time
+    uint32_t fired;
+    uint32_t alarm_late_max_us; // Worst timer interrupt lateness past the hold time
+} estop_stats_t;
+
+/**
+ * @brief Build the 0 A burst and attach to the buttons
+ *
+ * Call after vesc_io_init() and button_input_start().
+ *
+ * @param can_ids CAN controller IDs (VESC_CAN_LOCAL for the UART VESC)
+ * @param count   Number of controllers
+ * @param hold_ms Chord hold time
+ * @return ESP_OK, or the timer / VESC I/O error
+ */
+esp_err_t estop_start(const int *can_ids, int count, uint32_t hold_ms);
+
+/**
+ * @brief Whether the e-stop fired since the last call
+ */
+bool estop_take(void);
+
+/**
+ * @brief Let motor commands through again, starting with 0 A
+ *
+ * Hands 0 A to vesc_cmd, whose sender lifts the hold with that batch
+ * (vesc_cmd_release_estop()). Call from the control loop once its own
+ * setpoint is 0 A.
+ */
+void estop_acknowledge(void);
+
+/**
+ * @brief Read the counters
+ * @param stats Output
+ */
+void estop_get_stats(estop_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESTOP_H
@@ -0,0 +1,108 @@
+/**
+ * @file prop_guard.c
+ * @brief Prop ventilation / cavitation detector with current cut-back
+ */
+
+#include "prop_guard.h"
+#include <math.h>
+#include <string.h>
+
+// Load coefficient: current per (kERPM)^2
+static float guard_load(float rpm, float current) {
+    float krpm = rpm / 1000.0f;
+    return current / (krpm * krpm);
+}
+
+void prop_guard_init(prop_guard_t *guard, const prop_guard_config_t *config) {
+    memset(guard, 0, sizeof(*guard));
+    guard->config = *config;
+    guard->state = PROP_GUARD_LOADED;
+    guard->scale = 1.0f;
+    guard->load = 1.0f;
+}
+
+float prop_guard_update(prop_guard_t *guard, int64_t time_us, float rpm, float current, bool driving) {
+    const prop_guard_config_t *c = &guard->config;
+    rpm = fabsf(rpm);
+    current = fabsf(current);
+
+    float dt_s = guard->have_prev ? (float)(time_us - guard->prev_us) / 1000000.0f : 0.0f;
+    bool rated = dt_s > 0.0f && dt_s <= c->max_dt_s;
+    float drpm = rated ? (rpm - guard->prev_rpm) / dt_s : 0.0f;
+    float dcurrent = rated ? (current - guard->prev_current) / dt_s : 0.0f;
+    guard->have_prev = true;
+    guard->prev_us = time_us;
+    guard->prev_rpm = rpm;
+    guard->prev_current = current;
+
+    if (!driving) {
+        guard->state = PROP_GUARD_LOADED;
+        guard->scale = 1.0f;
+        guard->prev_low = false;
+        return guard->scale;
+    }
+    if (rpm < c->rpm_min) {
+        // Too slow to tell air from water; a ventilated prop spins down into here
+        guard->prev_low = false;
+        if (guard->state == PROP_GUARD_VENTILATED) {
+            guard->state = PROP_GUARD_RESTORING;
+        }
+    } else {
+        float load = guard_load(rpm, current);
+
+        if (guard->baseline <= 0.0f) {
+            guard->load = 1.0f;
+        } else {
+            guard->load = load / guard->baseline;
+        }
+
+        bool low = guard->baseline > 0.0f && guard->load < c->load_trip;
+        bool runaway = rated && (drpm >= c->rpm_rise || dcurrent <= -c->current_fall);
+        bool steady = rated && fabsf(drpm) < c->steady_rpm && fabsf(dcurrent) < c->steady_current;
+
+        if (low && (runaway || guard->prev_low)) {
+            if (guard->state != PROP_GUARD_VENTILATED) {
+                guard->trips++;
+            }
+            guard->state = PROP_GUARD_VENTILATED;
+            guard->scale = c->cut_scale;
+            guard->clear_for_s = 0.0f;
+        } else if (guard->state == PROP_GUARD_VENTILATED) {
+            if (guard->load >= c->load_clear) {
+                guard->clear_for_s += rated ? dt_s : 0.0f;
+                if (guard->clear_for_s >= c->clear_s) {
+                    guard->state = PROP_GUARD_RESTORING;
+                }
+            } else {
+                guard->clear_for_s = 0.0f;
+            }
+        } else if (guard->state == PROP_GUARD_LOADED && steady && current >= c->current_min &&
+                   (guard->baseline <= 0.0f || guard->load >= c->load_clear)) {
+            // Only loads that look like water go into the baseline
+            if (guard->baseline <= 0.0f) {
+                guard->baseline = load;
+            } else {
+                guard->baseline += c->baseline_weight * (load - guard->baseline);
+            }
+        }
+        guard->prev_low = low;
+    }
+
+    if (guard->state == PROP_GUARD_RESTORING) {
+        guard->scale += c->restore_rate * (rated ? dt_s : 0.0f);
+        if (guard->scale >= 1.0f) {
+            guard->scale = 1.0f;
+            guard->state = PROP_GUARD_LOADED;
+        }
+    }
+    return guard->scale;
+}
+
+const char *prop_guard_state_to_string(prop_guard_state_t state) {
+    switch (state) {
+        case PROP_GUARD_LOADED:     return "LOADED";
+        case PROP_GUARD_VENTILATED: return "VENTILATED";
+        case PROP_GUARD_RESTORING:  return "RESTORING";
+        default:                    return "UNKNOWN";
+    }
+}
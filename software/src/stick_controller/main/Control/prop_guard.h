@@ -0,0 +1,101 @@
+/**
+ * @file prop_guard.h
+ * @brief Prop ventilation / cavitation detector with current cut-back
+ *
+ * A prop in water loads the motor with a torque that grows with the square
+ * of its speed, so motor current / (kERPM)^2 stays near a constant, the load
+ * coefficient. When the prop pulls air it loses that load: RPM runs away
+ * while the current collapses, and the coefficient falls far below its
+ * value in water.
+ *
+ * The guard learns the in-water coefficient from steady samples (neither
+ * RPM nor current changing fast) and judges every telemetry sample:
+ * - load below the trip share of the baseline, and RPM rising or current
+ *   falling fast: ventilating, the setpoint scale drops to the cut share at
+ *   once; a second low sample in a row trips as well, for a runaway that
+ *   has already levelled off
+ * - load back above the clear share for the clear time: the scale climbs
+ *   back to 1 at the restore rate, and drops again if the load goes
+ * - rider off the throttle: back to loaded, scale 1
+ *
+ * Rates are only taken between samples at most max_dt_s apart, so it needs
+ * the active telemetry rate. Nothing trips before a baseline is learnt.
+ *
+ * Pure arithmetic, no ESP-IDF dependencies: it runs on the host as well.
+ */
+
+#ifndef PROP_GUARD_H
+#define PROP_GUARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float load_trip;            // Ventilating below this share of the baseline load
+    float load_clear;           // Load back above this share
+    float rpm_rise;             // eRPM/s rise that marks a runaway
+    float current_fall;         // A/s fall that marks a load loss
+    float rpm_min;              // eRPM below which nothing is judged or learnt
+    float current_min;          // A below which nothing is learnt
+    float steady_rpm;           // Learn only while |eRPM/s| stays under this
+    float steady_current;       // ... and |A/s| under this
+    float baseline_weight;      // Share of a steady sample in the baseline average
+    float cut_scale;            // Setpoint scale while ventilating
+    float restore_rate;         // Scale per second back to 1
+    float clear_s;              // Load back this long before restoring
+    float max_dt_s;             // Samples further apart are not differentiated
+} prop_guard_config_t;
+
+typedef enum {
+    PROP_GUARD_LOADED = 0,
+    PROP_GUARD_VENTILATED,
+    PROP_GUARD_RESTORING,
+} prop_guard_state_t;
+
+typedef struct {
+    prop_guard_config_t config;
+    prop_guard_state_t state;
+    float scale;                // Setpoint scale now (cut_scale ... 1)
+    float baseline;             // Learnt load coefficient, A / (kERPM)^2; 0 = none yet
+    float load;                 // Load of the last sample, share of the baseline
+    bool have_prev;
+    int64_t prev_us;
+    float prev_rpm;
+    float prev_current;
+    bool prev_low;              // Last sample was below the trip share
+    float clear_for_s;          // Time the load has been back
+    uint32_t trips;
+} prop_guard_t;
+
+/**
+ * @brief Start with no baseline
+ * @param guard  Guard state
+ * @param config Limits (copied)
+ */
+void prop_guard_init(prop_guard_t *guard, const prop_guard_config_t *config);
+
+/**
+ * @brief Judge a telemetry sample
+ * @param guard   Guard state
+ * @param time_us Sample time (us, any monotonic clock)
+ * @param rpm     Motor eRPM
+ * @param current Motor current (A)
+ * @param driving The rider is asking for current
+ * @return Setpoint scale to apply (cut_scale ... 1)
+ */
+float prop_guard_update(prop_guard_t *guard, int64_t time_us, float rpm, float current, bool driving);
+
+/**
+ * @brief State name for logs
+ */
+const char *prop_guard_state_to_string(prop_guard_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROP_GUARD_H
@@ -0,0 +1,79 @@
+/**
+ * @file stall_guard.c
+ * @brief Weed / stall detector and reverse-pulse clearing sequence
+ */
+
+#include "stall_guard.h"
+#include <math.h>
+#include <string.h>
+
+void stall_guard_init(stall_guard_t *guard, const stall_guard_config_t *config) {
+    memset(guard, 0, sizeof(*guard));
+    guard->config = *config;
+    if (guard->config.max_clears > STALL_GUARD_MAX_CLEARS) {
+        guard->config.max_clears = STALL_GUARD_MAX_CLEARS;
+    }
+}
+
+// Clearings within the window before time_us
+static uint32_t guard_recent_clears(const stall_guard_t *guard, int64_t time_us) {
+    const stall_guard_config_t *c = &guard->config;
+    uint32_t recent = 0;
+    uint32_t stored = guard->clears < STALL_GUARD_MAX_CLEARS ? guard->clears : STALL_GUARD_MAX_CLEARS;
+
+    for (uint32_t i = 0; i < stored; i++) {
+        if ((float)(time_us - guard->clear_us[i]) / 1000000.0f < c->window_s) {
+            recent++;
+        }
+    }
+    return recent;
+}
+
+stall_guard_action_t stall_guard_update(stall_guard_t *guard, int64_t time_us, float rpm, float current,
+                                        float commanded, float temp_fet, bool driving) {
+    const stall_guard_config_t *c = &guard->config;
+    float threshold = fmaxf(c->current_min, c->current_share * commanded);
+
+    if (!driving || commanded <= 0.0f || current < threshold || fabsf(rpm) >= c->rpm_max) {
+        guard->stalled = false;
+        return STALL_GUARD_NONE;
+    }
+    if (!guard->stalled) {
+        guard->stalled = true;
+        guard->stalled_us = time_us;
+        return STALL_GUARD_NONE;
+    }
+    if ((float)(time_us - guard->stalled_us) / 1000000.0f < c->detect_s) {
+        return STALL_GUARD_NONE;
+    }
+
+    // Confirmed; a new stall starts over
+    guard->stalled = false;
+    bool too_soon = guard->have_clear &&
+                    (float)(time_us - guard->last_clear_us) / 1000000.0f < c->cooldown_s;
+    if (too_soon || temp_fet >= c->temp_max || guard_recent_clears(guard, time_us) >= c->max_clears) {
+        guard->lockouts++;
+        return STALL_GUARD_LOCKOUT;
+    }
+
+    guard->have_clear = true;
+    guard->last_clear_us = time_us;
+    guard->clear_us[guard->clear_next] = time_us;
+    guard->clear_next = (guard->clear_next + 1) % STALL_GUARD_MAX_CLEARS;
+    guard->clears++;
+    return STALL_GUARD_CLEAR;
+}
+
+float stall_guard_pulse(const stall_guard_config_t *config, float elapsed_s, bool *done) {
+    float period = config->gap_s + config->pulse_s;
+
+    *done = elapsed_s >= period * (float)config->pulses + config->gap_s;
+    if (*done || elapsed_s < 0.0f) {
+        return 0.0f;
+    }
+    float n = floorf(elapsed_s / period);
+    if (n >= (float)config->pulses) {
+        return 0.0f;            // Gap after the last pulse
+    }
+    return elapsed_s - n * period < config->gap_s ? 0.0f : -config->pulse_current;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file stall_guard.h
+ * @brief Weed / stall detector and reverse-pulse clearing sequence
+ *
+ * Weed wrapped round the prop stalls it: RPM drops towards zero while the
+ * motor current sits at the commanded value, heating motor and FETs for
+ * nothing. The guard watches the telemetry samples:
+ * - stalled: current at or above current_share of the commanded current
+ *   (and current_min), |eRPM| below rpm_max, for detect_s
+ * - a confirmed stall asks for a clearing sequence: stall_guard_pulse()
+ *   gives the setpoint over time, reverse pulses with 0 A gaps
+ * - rate limits: a stall within cooldown_s of the last clearing, more than
+ *   max_clears clearings within window_s, or FETs at temp_max ask for a
+ *   lockout instead (0 A until the rider lets go), so it cannot keep
+ *   pulsing against weed it does not shift
+ *
+ * Pure arithmetic, no ESP-IDF dependencies: it runs on the host as well.
+ */
+
+#ifndef STALL_GUARD_H
+#define STALL_GUARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STALL_GUARD_MAX_CLEARS  8       // Largest max_clears
+
+typedef struct {
+    float current_share;        // Stalled at or above this share of the commanded current
+    float current_min;          // ... and at least this current (A)
+    float rpm_max;              // ... while |eRPM| stays below this
+    float detect_s;             // ... for this long
+    float temp_max;             // FET temperature (C) at which a stall locks out at once
+    float cooldown_s;           // A stall this soon after a clearing locks out
+    uint32_t max_clears;        // Clearings allowed per window (<= STALL_GUARD_MAX_CLEARS)
+    float window_s;
+    float pulse_current;        // Reverse pulse (A, sent negative)
+    float pulse_s;
+    float gap_s;                // 0 A before each pulse and after the last
+    uint32_t pulses;
+} stall_guard_config_t;
+
+typedef enum {
+    STALL_GUARD_NONE = 0,
+    STALL_GUARD_CLEAR,          // Run the clearing sequence
+    STALL_GUARD_LOCKOUT,        // Hold 0 A until the rider lets go
+} stall_guard_action_t;
+
+typedef struct {
+    stall_guard_config_t config;
+    bool stalled;               // Stall condition seen, not yet confirmed
+    int64_t stalled_us;         // Since
+    bool have_clear;
+    int64_t last_clear_us;
+    int64_t clear_us[STALL_GUARD_MAX_CLEARS];   // Recent clearings, ring
+    uint32_t clear_next;
+    uint32_t clears;
+    uint32_t lockouts;
+} stall_guard_t;
+
+/**
+ * @brief Start with no history
+ * @param guard  Guard state
+ * @param config Limits (copied)
+ */
+void stall_guard_init(stall_guard_t *guard, const stall_guard_config_t *config);
+
+/**
+ * @brief Judge a telemetry sample
+ * @param guard     Guard state
+ * @param time_us   Sample time (us, any monotonic clock)
+ * @param rpm       Motor eRPM
+ * @param current   Motor current (A)
+ * @param commanded Current setpoint (A)
+ * @param temp_fet  FET temperature (C)
+ * @param driving   The rider is asking for current and no clearing is running
+ * @return Action to take, STALL_GUARD_NONE most of the time
+ */
+stall_guard_action_t stall_guard_update(stall_guard_t *guard, int64_t time_us, float rpm, float current,
+                                        float commanded, float temp_fet, bool driving);
+
+/**
+ * @brief Setpoint of the clearing sequence
+ * @param config    Limits
+ * @param elapsed_s Time since the sequence started
+ * @param done      Set once the sequence is over
+ * @return Current to command (A): 0 or -pulse_current
+ */
+float stall_guard_pulse(const stall_guard_config_t *config, float elapsed_s, bool *done);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STALL_GUARD_H
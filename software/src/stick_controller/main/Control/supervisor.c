@@ -0,0 +1,135 @@
+/**
+ * @file supervisor.c
+ * @brief Deadline supervisor for the periodic tasks
+ */
+
+#include "supervisor.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static const char *TAG = "supervisor";
+
+typedef struct {
+    supervisor_stats_t stats;
+    int64_t last_us;            // Last check-in, 0 before the first
+} sup_task_t;
+
+static portMUX_TYPE sup_lock = portMUX_INITIALIZER_UNLOCKED;
+static sup_task_t sup_tasks[SUPERVISOR_MAX_TASKS];
+static int sup_count = 0;
+static esp_timer_handle_t sup_timer = NULL;
+static supervisor_trip_t sup_on_trip = NULL;
+static void *sup_ctx = NULL;
+
+static void sup_check(void *arg) {
+    (void)arg;
+    int64_t now_us = esp_timer_get_time();
+
+    for (int i = 0; i < sup_count; i++) {
+        sup_task_t *task = &sup_tasks[i];
+        bool tripped = false;
+
+        portENTER_CRITICAL(&sup_lock);
+        if (task->last_us != 0 && !task->stats.late &&
+            now_us - task->last_us > (int64_t)task->stats.deadline_us) {
+            task->stats.late = true;
+            task->stats.misses++;
+            tripped = task->stats.critical;
+        }
+        portEXIT_CRITICAL(&sup_lock);
+
+        if (tripped) {
+            ESP_LOGE(TAG, "%s missed its %lu us deadline", task->stats.name,
+                     (unsigned long)task->stats.deadline_us);
+            if (sup_on_trip != NULL) {
+                sup_on_trip(i, sup_ctx);
+            }
+        }
+    }
+}
+
+esp_err_t supervisor_start(uint32_t check_period_us, supervisor_trip_t on_trip, void *ctx) {
+    if (check_period_us == 0) return ESP_ERR_INVALID_ARG;
+    if (sup_timer != NULL) return ESP_ERR_INVALID_STATE;
+
+    sup_on_trip = on_trip;
+    sup_ctx = ctx;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = sup_check,
+        .name = "supervisor",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &sup_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Timer create failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ret = esp_timer_start_periodic(sup_timer, check_period_us);
+    if (ret != ESP_OK) {
+        esp_timer_delete(sup_timer);
+        sup_timer = NULL;
+    }
+    return ret;
+}
+
+int supervisor_register(const char *name, uint32_t deadline_us, bool critical) {
+    int task = -1;
+
+    portENTER_CRITICAL(&sup_lock);
+    if (sup_count < SUPERVISOR_MAX_TASKS) {
+        task = sup_count;
+        memset(&sup_tasks[task], 0, sizeof(sup_tasks[task]));
+        sup_tasks[task].stats.name = name;
+        sup_tasks[task].stats.deadline_us = deadline_us;
+        sup_tasks[task].stats.critical = critical;
+        sup_count++;
+    }
+    portEXIT_CRITICAL(&sup_lock);
+
+    if (task < 0) {
+        ESP_LOGE(TAG, "No room to supervise %s", name);
+    }
+    return task;
+}
+
+void supervisor_checkin(int task, int64_t now_us) {
+    if (task < 0 || task >= sup_count) return;
+    sup_task_t *t = &sup_tasks[task];
+
+    portENTER_CRITICAL(&sup_lock);
+    if (t->last_us != 0) {
+        int64_t gap = now_us - t->last_us;
+        if (gap > (int64_t)t->stats.gap_max_us) {
+            t->stats.gap_max_us = (uint32_t)gap;
+        }
+        if (gap > (int64_t)t->stats.deadline_us) {
+            uint32_t late = (uint32_t)(gap - t->stats.deadline_us);
+            if (late > t->stats.late_max_us) {
+                t->stats.late_max_us = late;
+            }
+            // Overshot between two checks of the timer
+            if (!t->stats.late) {
+                t->stats.misses++;
+            }
+        }
+    }
+    t->stats.late = false;
+    t->stats.checkins++;
+    t->last_us = now_us;
+    portEXIT_CRITICAL(&sup_lock);
+}
+
+int supervisor_count(void) {
+    return sup_count;
+}
+
+bool supervisor_get_stats(int task, supervisor_stats_t *stats) {
+    if (stats == NULL || task < 0 || task >= sup_count) return false;
+
+    portENTER_CRITICAL(&sup_lock);
+    *stats = sup_tasks[task].stats;
+    portEXIT_CRITICAL(&sup_lock);
+    return true;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file supervisor.h
+ * @brief Deadline supervisor for the periodic tasks
+ *
+ * Each periodic task registers with the longest time it may take between
+ * two check-ins. A timer checks every task each CONFIG_SUPERVISOR_CHECK_MS:
+ * - a task that has not checked in within its deadline counts one miss
+ *   (per episode, not per check) until it checks in again
+ * - each check-in records how far the gap overshot the deadline
+ * - when the timer finds a critical task past its deadline, the trip
+ *   callback runs at once, from the timer task
+ *
+ * A task is supervised from its first check-in, so slow start-up work
+ * before the loop does not count.
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SUPERVISOR_MAX_TASKS    8
+
+typedef struct {
+    const char *name;
+    uint32_t deadline_us;
+    bool critical;
+    bool late;                  // Missed and not yet checked in again
+    uint32_t checkins;
+    uint32_t misses;            // Deadlines missed
+    uint32_t late_max_us;       // Worst overshoot of the deadline
+    uint32_t gap_max_us;        // Worst time between two check-ins
+} supervisor_stats_t;
+
+/**
+ * @brief Called when a critical task misses its deadline
+ * @param task Task index from supervisor_register()
+ * @param ctx  User context given to supervisor_start()
+ */
+typedef void (*supervisor_trip_t)(int task, void *ctx);
+
+/**
+ * @brief Start the check timer
+ * @param check_period_us Check period
+ * @param on_trip         Called from the timer task on a critical miss
+ * @param ctx             Passed to on_trip
+ * @return ESP_OK, or the timer error
+ */
+esp_err_t supervisor_start(uint32_t check_period_us, supervisor_trip_t on_trip, void *ctx);
+
+/**
+ * @brief Register a task
+ * @param name        Name for the stats (not copied)
+ * @param deadline_us Longest allowed time between check-ins
+ * @param critical    A miss calls the trip callback
+ * @return Task index, or -1 if the table is full
+ */
+int supervisor_register(const char *name, uint32_t deadline_us, bool critical);
+
+/**
+ * @brief Report that a task is alive, once per iteration
+ * @param task   Task index
+ * @param now_us esp_timer_get_time()
+ */
+void supervisor_checkin(int task, int64_t now_us);
+
+/**
+ * @brief Number of registered tasks
+ */
+int supervisor_count(void);
+
+/**
+ * @brief Get the counters of a task
+ * @param task  Task index
+ * @param stats Output
+ * @return false if task is not registered
+ */
+bool supervisor_get_stats(int task, supervisor_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SUPERVISOR_H
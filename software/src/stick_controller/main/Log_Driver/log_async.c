@@ -0,0 +1,427 @@
+/**
+ * @file log_async.c
+ * @brief Deferred ESP_LOG formatting
+ */
+
+#include "log_async.h"
+
+#if CONFIG_LOG_ASYNC_ENABLE && !CONFIG_IDF_TARGET_LINUX
+
+#include "esp_log.h"
+#include "esp_memory_utils.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_SLOTS       CONFIG_LOG_ASYNC_RING_SLOTS
+#define LOG_SPEC_MAX    16      // Longest conversion spec handled, e.g. "%-08.3lf"
+
+_Static_assert((LOG_SLOTS & (LOG_SLOTS - 1)) == 0, "CONFIG_LOG_ASYNC_RING_SLOTS must be a power of two");
+
+// One log call. seq implements the bounded MPSC ring: a slot is free for
+// position pos when seq == pos, and holds the record of pos when seq == pos + 1.
+typedef struct {
+    atomic_uint seq;
+    const char *fmt;            // Format in flash, or NULL if data[] holds finished text
+    uint16_t len;               // Bytes used in data[]
+    uint8_t data[LOG_ASYNC_RECORD_SIZE - sizeof(atomic_uint) - sizeof(const char *) - sizeof(uint16_t)];
+} log_record_t;
+
+// Storage class of one conversion's argument
+typedef enum {
+    LOG_ARG_NONE = 0,           // "%%"
+    LOG_ARG_INT,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,
+    LOG_ARG_UNSUPPORTED,        // %n, long double: formatted on the spot
+} log_arg_t;
+
+typedef struct {
+    const char *start;          // The '%'
+    const char *end;            // One past the conversion character
+    bool star_width;
+    bool star_prec;
+    log_arg_t arg;
+} log_spec_t;
+
+// Inline string marker in data[]: pointer to flash, or copied bytes
+#define LOG_STR_PTR     0
+#define LOG_STR_COPY    1
+
+static log_record_t ring[LOG_SLOTS];
+static atomic_uint ring_head;   // Next position to claim (producers)
+static unsigned ring_tail;      // Next position to drain (drain task only)
+static atomic_uint dropped;
+static vprintf_like_t console_vprintf = NULL;
+static TaskHandle_t drain_task = NULL;
+
+// =============================================================================
+// Format scanning (shared by producer and drain task)
+// =============================================================================
+
+// Find the next conversion in p. Returns false at the end of the format.
+static bool log_next_spec(const char *p, log_spec_t *spec) {
+    p = strchr(p, '%');
+    if (p == NULL) {
+        return false;
+    }
+    memset(spec, 0, sizeof(*spec));
+    spec->start = p++;
+
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') p++;
+    if (*p == '*') {
+        spec->star_width = true;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->star_prec = true;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') p++;
+        }
+    }
+
+    int longs = 0;
+    bool size = false;
+    bool ldouble = false;
+    while (*p == 'h' || *p == 'l' || *p == 'z' || *p == 't' || *p == 'j' || *p == 'L') {
+        if (*p == 'l') longs++;
+        if (*p == 'j') longs = 2;
+        if (*p == 'z' || *p == 't') size = true;
+        if (*p == 'L') ldouble = true;
+        p++;
+    }
+
+    switch (*p) {
+        case '%':
+            spec->arg = LOG_ARG_NONE;
+            break;
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            spec->arg = size ? LOG_ARG_SIZE : longs >= 2 ? LOG_ARG_LLONG : longs ? LOG_ARG_LONG : LOG_ARG_INT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            spec->arg = ldouble ? LOG_ARG_UNSUPPORTED : LOG_ARG_DOUBLE;
+            break;
+        case 'p':
+            spec->arg = LOG_ARG_PTR;
+            break;
+        case 's':
+            spec->arg = longs ? LOG_ARG_UNSUPPORTED : LOG_ARG_STR;
+            break;
+        case '\0':
+            // Stray '%' at the end: print it as is
+            spec->end = p;
+            spec->arg = LOG_ARG_NONE;
+            return true;
+        default:
+            spec->arg = LOG_ARG_UNSUPPORTED;
+            break;
+    }
+    spec->end = p + 1;
+    return true;
+}
+
+// =============================================================================
+// Producer
+// =============================================================================
+
+static bool log_put(uint8_t *data, uint16_t *len, const void *value, size_t size) {
+    if (*len + size > sizeof(((log_record_t *)0)->data)) {
+        return false;
+    }
+    memcpy(data + *len, value, size);
+    *len += size;
+    return true;
+}
+
+// Store the raw arguments of fmt. Returns false if they cannot be deferred.
+static bool log_pack(const char *fmt, va_list args, uint8_t *data, uint16_t *len) {
+    log_spec_t spec;
+    const char *p = fmt;
+
+    *len = 0;
+    while (log_next_spec(p, &spec)) {
+        p = spec.end;
+        if (spec.star_width) {
+            int w = va_arg(args, int);
+            if (!log_put(data, len, &w, sizeof(w))) return false;
+        }
+        if (spec.star_prec) {
+            int prec = va_arg(args, int);
+            if (!log_put(data, len, &prec, sizeof(prec))) return false;
+        }
+
+        bool ok = true;
+        switch (spec.arg) {
+            case LOG_ARG_NONE:
+                break;
+            case LOG_ARG_INT: {
+                int v = va_arg(args, int);
+                ok = log_put(data, len, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_LONG: {
+                long v = va_arg(args, long);
+                ok = log_put(data, len, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_LLONG: {
+                long long v = va_arg(args, long long);
+                ok = log_put(data, len, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_SIZE: {
+                size_t v = va_arg(args, size_t);
+                ok = log_put(data, len, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_DOUBLE: {
+                double v = va_arg(args, double);
+                ok = log_put(data, len, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_PTR: {
+                void *v = va_arg(args, void *);
+                ok = log_put(data, len, &v, sizeof(v));
+                break;
+            }
+            case LOG_ARG_STR: {
+                const char *s = va_arg(args, const char *);
+                uint8_t marker;
+                if (s == NULL || esp_ptr_in_drom(s)) {
+                    // Tags and literals stay in flash: keep the pointer
+                    marker = LOG_STR_PTR;
+                    ok = log_put(data, len, &marker, 1) && log_put(data, len, &s, sizeof(s));
+                } else {
+                    // RAM strings may be gone by drain time: copy with the terminator
+                    marker = LOG_STR_COPY;
+                    ok = log_put(data, len, &marker, 1) && log_put(data, len, s, strlen(s) + 1);
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int log_async_vprintf(const char *fmt, va_list args) {
+    unsigned pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    log_record_t *rec;
+
+    // Claim a slot (lock-free: a failed CAS only means another task got there first)
+    while (1) {
+        rec = &ring[pos & (LOG_SLOTS - 1)];
+        unsigned seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+        int diff = (int)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring_head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+        }
+    }
+
+    bool deferred = false;
+    if (esp_ptr_in_drom(fmt)) {
+        va_list copy;
+        va_copy(copy, args);
+        deferred = log_pack(fmt, copy, rec->data, &rec->len);
+        va_end(copy);
+    }
+    if (deferred) {
+        rec->fmt = fmt;
+    } else {
+        int n = vsnprintf((char *)rec->data, sizeof(rec->data), fmt, args);
+        rec->fmt = NULL;
+        rec->len = (n < 0) ? 0 : (n >= (int)sizeof(rec->data) ? sizeof(rec->data) - 1 : (uint16_t)n);
+    }
+
+    atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+// =============================================================================
+// Drain task
+// =============================================================================
+
+static void log_console(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    console_vprintf(fmt, args);
+    va_end(args);
+}
+
+#define LOG_TAKE(type, var) \
+    type var; \
+    memcpy(&var, rec->data + off, sizeof(var)); \
+    off += sizeof(var)
+
+#define LOG_EMIT(value) \
+    (spec.star_width && spec.star_prec ? snprintf(out, room, sub, width, prec, value) : \
+     spec.star_width ? snprintf(out, room, sub, width, value) : \
+     spec.star_prec  ? snprintf(out, room, sub, prec, value) : \
+                       snprintf(out, room, sub, value))
+
+// Format a deferred record into line
+static void log_render(const log_record_t *rec, char *line, size_t size) {
+    log_spec_t spec;
+    const char *p = rec->fmt;
+    size_t used = 0;
+    uint16_t off = 0;
+    char sub[LOG_SPEC_MAX + 1];
+
+    while (used < size - 1) {
+        bool more = log_next_spec(p, &spec);
+        const char *lit_end = more ? spec.start : p + strlen(p);
+
+        // Literal text up to the conversion
+        size_t lit = (size_t)(lit_end - p);
+        if (lit > size - 1 - used) lit = size - 1 - used;
+        memcpy(line + used, p, lit);
+        used += lit;
+        if (!more) {
+            break;
+        }
+        p = spec.end;
+
+        int width = 0;
+        int prec = 0;
+        if (spec.star_width) { LOG_TAKE(int, w); width = w; }
+        if (spec.star_prec)  { LOG_TAKE(int, pr); prec = pr; }
+
+        size_t sub_len = (size_t)(spec.end - spec.start);
+        if (sub_len > LOG_SPEC_MAX) sub_len = LOG_SPEC_MAX;
+        memcpy(sub, spec.start, sub_len);
+        sub[sub_len] = '\0';
+
+        char *out = line + used;
+        size_t room = size - used;
+        int n = 0;
+        switch (spec.arg) {
+            case LOG_ARG_NONE:
+                n = snprintf(out, room, "%%");
+                break;
+            case LOG_ARG_INT:    { LOG_TAKE(int, v);       n = LOG_EMIT(v); break; }
+            case LOG_ARG_LONG:   { LOG_TAKE(long, v);      n = LOG_EMIT(v); break; }
+            case LOG_ARG_LLONG:  { LOG_TAKE(long long, v); n = LOG_EMIT(v); break; }
+            case LOG_ARG_SIZE:   { LOG_TAKE(size_t, v);    n = LOG_EMIT(v); break; }
+            case LOG_ARG_DOUBLE: { LOG_TAKE(double, v);    n = LOG_EMIT(v); break; }
+            case LOG_ARG_PTR:    { LOG_TAKE(void *, v);    n = LOG_EMIT(v); break; }
+            case LOG_ARG_STR: {
+                uint8_t marker = rec->data[off++];
+                const char *s;
+                if (marker == LOG_STR_PTR) {
+                    memcpy(&s, rec->data + off, sizeof(s));
+                    off += sizeof(s);
+                } else {
+                    s = (const char *)rec->data + off;
+                    off += strlen(s) + 1;
+                }
+                n = LOG_EMIT(s ? s : "(null)");
+                break;
+            }
+            default:
+                break;
+        }
+        if (n > 0) {
+            used += ((size_t)n < room) ? (size_t)n : room - 1;
+        }
+    }
+    // Keep the line break of a truncated line
+    if (used == size - 1 && line[used - 1] != '\n') {
+        line[used - 1] = '\n';
+    }
+    line[used] = '\0';
+}
+
+static void log_drain_task(void *arg) {
+    (void)arg;
+    char line[LOG_ASYNC_LINE_MAX];
+    uint32_t reported_drops = 0;
+
+    while (1) {
+        while (1) {
+            log_record_t *rec = &ring[ring_tail & (LOG_SLOTS - 1)];
+            if (atomic_load_explicit(&rec->seq, memory_order_acquire) != ring_tail + 1) {
+                break;
+            }
+
+            if (rec->fmt != NULL) {
+                log_render(rec, line, sizeof(line));
+            } else {
+                memcpy(line, rec->data, rec->len);
+                line[rec->len] = '\0';
+            }
+            // Free the slot before the slow console write
+            atomic_store_explicit(&rec->seq, ring_tail + LOG_SLOTS, memory_order_release);
+            ring_tail++;
+
+            log_console("%s", line);
+        }
+
+        uint32_t drops = atomic_load_explicit(&dropped, memory_order_relaxed);
+        if (drops != reported_drops) {
+            log_console("W (%lu) log: %lu records dropped, ring full\n",
+                        (unsigned long)esp_log_timestamp(), (unsigned long)(drops - reported_drops));
+            reported_drops = drops;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_LOG_ASYNC_DRAIN_MS));
+    }
+}
+
+esp_err_t log_async_start(void) {
+    if (drain_task != NULL) return ESP_ERR_INVALID_STATE;
+
+    for (unsigned i = 0; i < LOG_SLOTS; i++) {
+        atomic_init(&ring[i].seq, i);
+    }
+    atomic_init(&ring_head, 0);
+    atomic_init(&dropped, 0);
+    ring_tail = 0;
+
+    if (xTaskCreatePinnedToCore(log_drain_task, "log_drain", LOG_ASYNC_TASK_STACK, NULL,
+                                LOG_ASYNC_TASK_PRIO, &drain_task, 0) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    console_vprintf = esp_log_set_vprintf(log_async_vprintf);
+    return ESP_OK;
+}
+
+uint32_t log_async_get_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+#else // Synchronous logging
+
+esp_err_t log_async_start(void) {
+    return ESP_OK;
+}
+
+uint32_t log_async_get_dropped(void) {
+    return 0;
+}
+
+#endif // CONFIG_LOG_ASYNC_ENABLE && !CONFIG_IDF_TARGET_LINUX
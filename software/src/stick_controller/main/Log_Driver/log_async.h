@@ -0,0 +1,52 @@
+/**
+ * @file log_async.h
+ * @brief Deferred ESP_LOG formatting
+ *
+ * Installed as the esp_log vprintf hook. A log call does not format
+ * anything: it stores the format string pointer and the raw arguments in
+ * a fixed-slot lock-free ring and returns. A low-priority task drains the
+ * ring every CONFIG_LOG_ASYNC_DRAIN_MS, formats each record and writes it
+ * to the console (USB-Serial-JTAG, see sdkconfig).
+ *
+ * Strings in flash (tags, literals) are kept as pointers; other %s
+ * arguments are copied into the record. Records whose arguments do not fit,
+ * or whose format is not in flash, are formatted on the spot instead.
+ * When the ring is full the record is dropped and counted.
+ */
+
+#ifndef LOG_ASYNC_H
+#define LOG_ASYNC_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOG_ASYNC_RECORD_SIZE   128     // Bytes per ring slot
+#define LOG_ASYNC_LINE_MAX      256     // Longest formatted line
+#define LOG_ASYNC_TASK_PRIO     1
+#define LOG_ASYNC_TASK_STACK    3072
+
+/**
+ * @brief Install the vprintf hook and start the drain task
+ *
+ * Call first thing in app_main(). Does nothing (logging stays synchronous)
+ * when CONFIG_LOG_ASYNC_ENABLE is off.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t log_async_start(void);
+
+/**
+ * @brief Records dropped because the ring was full
+ */
+uint32_t log_async_get_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG_ASYNC_H
@@ -0,0 +1,202 @@
+/**
+ * @file vesc_can.c
+ * @brief Passive VESC telemetry from CAN status broadcasts
+ */
+
+#include "vesc_can.h"
+#include "vesc_codec.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "vesc_can";
+
+#define STATUS_KINDS    VESC_CODEC_CAN_STATUS_KINDS
+
+// Fields each status frame carries, by kind (see status_kind())
+static const uint32_t status_fields[STATUS_KINDS] = {
+    VESC_VALUE_RPM | VESC_VALUE_MOTOR_CURRENT | VESC_VALUE_DUTY_CYCLE,
+    VESC_VALUE_AMP_HOURS | VESC_VALUE_AMP_HOURS_CHARGED,
+    VESC_VALUE_WATT_HOURS | VESC_VALUE_WATT_HOURS_CHARGED,
+    VESC_VALUE_TEMP_MOSFET | VESC_VALUE_TEMP_MOTOR | VESC_VALUE_INPUT_CURRENT | VESC_VALUE_PID_POS,
+    VESC_VALUE_TACHOMETER | VESC_VALUE_INPUT_VOLTAGE,
+    0,                          // STATUS_6: ADC/PPM inputs, not kept in vesc_data_t
+};
+
+// Telemetry of one controller
+typedef struct {
+    bool used;
+    uint8_t controller_id;
+    vesc_data_t data;
+    int64_t status_us[STATUS_KINDS];    // Last reception of each status kind (0 = never)
+} vesc_can_node_t;
+
+static const can_backend_t *can_backend = NULL;
+static TaskHandle_t can_task = NULL;
+static vesc_can_node_t nodes[VESC_CAN_MAX_NODES];
+static portMUX_TYPE nodes_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t frame_count = 0;
+
+static int status_kind(uint8_t packet_id) {
+    switch (packet_id) {
+        case VESC_CAN_PACKET_STATUS:   return 0;
+        case VESC_CAN_PACKET_STATUS_2: return 1;
+        case VESC_CAN_PACKET_STATUS_3: return 2;
+        case VESC_CAN_PACKET_STATUS_4: return 3;
+        case VESC_CAN_PACKET_STATUS_5: return 4;
+        case VESC_CAN_PACKET_STATUS_6: return 5;
+        default:                       return -1;
+    }
+}
+
+uint32_t vesc_can_decode_status(const can_frame_t *frame, uint8_t *controller_id, vesc_data_t *data) {
+    // Extended ID: [packet ID << 8][controller ID]
+    if (!frame->extended || frame->dlc < 8) {
+        return 0;
+    }
+    int kind = status_kind((uint8_t)(frame->id >> 8));
+    if (kind < 0) {
+        return 0;
+    }
+
+    *controller_id = (uint8_t)(frame->id & 0xFF);
+    data->controller_id = *controller_id;
+
+    if (!vesc_codec_decode(&vesc_msg_can_status[kind], frame->data, frame->dlc, data, NULL)) {
+        return 0;
+    }
+    return status_fields[kind] | VESC_VALUE_CONTROLLER_ID;
+}
+
+static void copy_fields(vesc_data_t *dst, const vesc_data_t *src, uint32_t mask) {
+    if (mask & VESC_VALUE_RPM)                  dst->rpm = src->rpm;
+    if (mask & VESC_VALUE_MOTOR_CURRENT)        dst->avg_motor_current = src->avg_motor_current;
+    if (mask & VESC_VALUE_DUTY_CYCLE)           dst->duty_cycle = src->duty_cycle;
+    if (mask & VESC_VALUE_AMP_HOURS)            dst->amp_hours = src->amp_hours;
+    if (mask & VESC_VALUE_AMP_HOURS_CHARGED)    dst->amp_hours_charged = src->amp_hours_charged;
+    if (mask & VESC_VALUE_WATT_HOURS)           dst->watt_hours = src->watt_hours;
+    if (mask & VESC_VALUE_WATT_HOURS_CHARGED)   dst->watt_hours_charged = src->watt_hours_charged;
+    if (mask & VESC_VALUE_TEMP_MOSFET)          dst->temp_mosfet = src->temp_mosfet;
+    if (mask & VESC_VALUE_TEMP_MOTOR)           dst->temp_motor = src->temp_motor;
+    if (mask & VESC_VALUE_INPUT_CURRENT)        dst->avg_input_current = src->avg_input_current;
+    if (mask & VESC_VALUE_PID_POS)              dst->pid_pos = src->pid_pos;
+    if (mask & VESC_VALUE_TACHOMETER)           dst->tachometer = src->tachometer;
+    if (mask & VESC_VALUE_INPUT_VOLTAGE)        dst->input_voltage = src->input_voltage;
+    if (mask & VESC_VALUE_CONTROLLER_ID)        dst->controller_id = src->controller_id;
+}
+
+// Find the node for a controller, claiming a free one on first sight. Call with nodes_lock held.
+static vesc_can_node_t *node_get(uint8_t controller_id, bool create) {
+    vesc_can_node_t *free_node = NULL;
+
+    for (int i = 0; i < VESC_CAN_MAX_NODES; i++) {
+        if (nodes[i].used && nodes[i].controller_id == controller_id) {
+            return &nodes[i];
+        }
+        if (!nodes[i].used && free_node == NULL) {
+            free_node = &nodes[i];
+        }
+    }
+    if (create && free_node != NULL) {
+        memset(free_node, 0, sizeof(*free_node));
+        free_node->used = true;
+        free_node->controller_id = controller_id;
+        return free_node;
+    }
+    return NULL;
+}
+
+static void vesc_can_task(void *arg) {
+    (void)arg;
+    can_frame_t frame;
+    vesc_data_t decoded;
+    uint8_t controller_id;
+
+    while (1) {
+        if (can_backend->receive(&frame, VESC_CAN_RX_TIMEOUT_MS) != ESP_OK) {
+            continue;
+        }
+
+        uint32_t fields = vesc_can_decode_status(&frame, &controller_id, &decoded);
+        if (fields == 0) {
+            continue;
+        }
+        int kind = status_kind((uint8_t)(frame.id >> 8));
+        int64_t now = esp_timer_get_time();
+
+        portENTER_CRITICAL(&nodes_lock);
+        vesc_can_node_t *node = node_get(controller_id, true);
+        if (node != NULL) {
+            copy_fields(&node->data, &decoded, fields);
+            node->status_us[kind] = now;
+        }
+        frame_count++;
+        portEXIT_CRITICAL(&nodes_lock);
+    }
+}
+
+esp_err_t vesc_can_init(const can_backend_t *backend, const can_bus_config_t *config) {
+    if (backend == NULL) return ESP_ERR_INVALID_ARG;
+    if (can_task != NULL) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t ret = backend->start(config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    can_backend = backend;
+    memset(nodes, 0, sizeof(nodes));
+
+    if (xTaskCreatePinnedToCore(vesc_can_task, "vesc_can", VESC_CAN_TASK_STACK, NULL,
+                                VESC_CAN_TASK_PRIO, &can_task, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create VESC CAN task");
+        backend->stop();
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Listening for VESC status on %s", backend->name);
+    return ESP_OK;
+}
+
+void vesc_can_deinit(void) {
+    if (can_task == NULL) return;
+
+    vTaskDelete(can_task);
+    can_task = NULL;
+    can_backend->stop();
+}
+
+uint32_t vesc_can_get_values(uint8_t controller_id, vesc_data_t *data, uint32_t max_age_ms,
+                             int64_t *motor_us) {
+    if (motor_us != NULL) *motor_us = 0;
+    if (data == NULL) return 0;
+
+    int64_t oldest = esp_timer_get_time() - (int64_t)max_age_ms * 1000;
+    uint32_t fresh = 0;
+
+    portENTER_CRITICAL(&nodes_lock);
+    vesc_can_node_t *node = node_get(controller_id, false);
+    if (node != NULL) {
+        for (int kind = 0; kind < STATUS_KINDS; kind++) {
+            if (node->status_us[kind] != 0 && node->status_us[kind] >= oldest) {
+                fresh |= status_fields[kind];
+            }
+        }
+        if (fresh) {
+            fresh |= VESC_VALUE_CONTROLLER_ID;
+            copy_fields(data, &node->data, fresh);
+        }
+        // Status 1 carries eRPM and motor current
+        if (motor_us != NULL && (fresh & status_fields[0])) {
+            *motor_us = node->status_us[0];
+        }
+    }
+    portEXIT_CRITICAL(&nodes_lock);
+
+    return fresh;
+}
+
+uint32_t vesc_can_get_frame_count(void) {
+    return frame_count;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file vesc_can.h
+ * @brief Passive VESC telemetry from CAN status broadcasts
+ *
+ * With send_can_status enabled in the app config, every VESC broadcasts
+ * CAN_PACKET_STATUS_1..6 at send_can_status_rate_hz. This module listens to
+ * them and keeps a vesc_data_t per controller ID, so telemetry arrives
+ * without any request traffic on the UART.
+ *
+ * The status frames carry no fault code; that still has to come from
+ * COMM_GET_VALUES_SELECTIVE (VESC_VALUE_FAULT).
+ */
+
+#ifndef VESC_CAN_H
+#define VESC_CAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "can_bus.h"
+#include "vesc_uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_CAN_MAX_NODES      VESC_MAX_CONTROLLERS
+#define VESC_CAN_RX_TIMEOUT_MS  100
+#define VESC_CAN_TASK_PRIO      6
+#define VESC_CAN_TASK_STACK     3072
+
+// CAN packet IDs of the status broadcasts (upper bits of the extended ID)
+typedef enum {
+    VESC_CAN_PACKET_STATUS   = 9,
+    VESC_CAN_PACKET_STATUS_2 = 14,
+    VESC_CAN_PACKET_STATUS_3 = 15,
+    VESC_CAN_PACKET_STATUS_4 = 16,
+    VESC_CAN_PACKET_STATUS_5 = 27,
+    VESC_CAN_PACKET_STATUS_6 = 58,
+} vesc_can_packet_id_t;
+
+/**
+ * @brief Decode one status frame
+ *
+ * Pure function, no state: usable on any frame source.
+ *
+ * @param frame         Received frame
+ * @param controller_id Output: sending controller
+ * @param data          Output: fields carried by the frame are written
+ * @return VESC_VALUE_* mask of the fields written, 0 if not a status frame
+ */
+uint32_t vesc_can_decode_status(const can_frame_t *frame, uint8_t *controller_id, vesc_data_t *data);
+
+/**
+ * @brief Open the bus and start the receiver task
+ * @param backend Bus backend, normally CAN_BUS_DEFAULT_BACKEND
+ * @param config  Bus settings
+ * @return ESP_OK on success
+ */
+esp_err_t vesc_can_init(const can_backend_t *backend, const can_bus_config_t *config);
+
+/**
+ * @brief Stop the receiver task and close the bus
+ */
+void vesc_can_deinit(void);
+
+/**
+ * @brief Copy the fresh CAN telemetry of one controller
+ *
+ * Only fields from status frames received within max_age_ms are copied;
+ * the rest of data is left untouched.
+ *
+ * @param controller_id VESC controller ID
+ * @param data          Structure to update
+ * @param max_age_ms    Oldest status that still counts as fresh
+ * @param motor_us      Output: reception time (esp_timer_get_time()) of the
+ *                      status carrying eRPM and motor current if it was
+ *                      copied, else 0. May be NULL.
+ * @return VESC_VALUE_* mask of the fields copied (0 = nothing fresh)
+ */
+uint32_t vesc_can_get_values(uint8_t controller_id, vesc_data_t *data, uint32_t max_age_ms,
+                             int64_t *motor_us);
+
+/**
+ * @brief Number of status frames decoded since init
+ */
+uint32_t vesc_can_get_frame_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_CAN_H
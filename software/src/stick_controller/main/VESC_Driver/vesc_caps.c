@@ -0,0 +1,142 @@
+/**
+ * @file vesc_caps.c
+ * @brief Firmware version handshake and VESC capabilities
+ */
+
+#include "vesc_caps.h"
+#include "vesc_uart.h"
+#include "vesc_io.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static const char *TAG = "vesc_caps";
+
+#define CAPS_ATTEMPTS   3       // Tries for the version request
+
+static portMUX_TYPE caps_lock = portMUX_INITIALIZER_UNLOCKED;
+static vesc_caps_t caps = {
+    .flags = VESC_CAPS_DEFAULT,
+    .values_msg = &vesc_msg_values,
+};
+static bool caps_valid = false;
+
+// [COMM_FW_VERSION][major][minor][hw name\0][uuid x12]...
+static int decode_fw_version(const uint8_t *message, uint16_t len, void *ctx) {
+    vesc_caps_t *out = (vesc_caps_t *)ctx;
+    vesc_fw_version_t fw;
+
+    if (!vesc_codec_decode(&vesc_msg_fw_version, message, len, &fw, NULL)) {
+        return 0;
+    }
+    out->fw_major = fw.major;
+    out->fw_minor = fw.minor;
+    out->identity_hash = esp_rom_crc32_le(0, message, len);
+
+    // Firmware 2.x stops after the version
+    size_t name_len = len > 3 ? strnlen((const char *)&message[3], len - 3) : 0;
+    if (name_len >= VESC_CAPS_HW_NAME_LEN) {
+        name_len = VESC_CAPS_HW_NAME_LEN - 1;
+    }
+    memcpy(out->hw_name, &message[3], name_len);
+    out->hw_name[name_len] = '\0';
+    return 1;
+}
+
+static bool caps_read_version(vesc_caps_t *out) {
+    uint8_t payload[1] = { COMM_FW_VERSION };
+
+    for (int i = 0; i < CAPS_ATTEMPTS; i++) {
+        vesc_io_future_t future;
+        if (vesc_io_request_future(&future, payload, sizeof(payload), COMM_FW_VERSION,
+                                   decode_fw_version, out) == ESP_OK &&
+            vesc_io_future_wait(&future) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int decode_probe(const uint8_t *message, uint16_t len, void *ctx) {
+    return vesc_codec_decode(&vesc_msg_values_selective, message, len, ctx, NULL);
+}
+
+// Unknown commands are ignored by the VESC, so no answer means no support.
+// Sent directly: vesc_get_values_selective() falls back to COMM_GET_VALUES.
+static bool caps_probe_selective(void) {
+    uint8_t payload[5];
+    vesc_codec_mask_t request = { .mask = VESC_VALUE_FAULT };
+    vesc_data_t scratch;
+    vesc_io_future_t future;
+
+    int32_t len = vesc_codec_encode(&vesc_msg_get_values_selective, &request, 0, payload, sizeof(payload));
+    return vesc_io_request_future(&future, payload, len, COMM_GET_VALUES_SELECTIVE,
+                                  decode_probe, &scratch) == ESP_OK &&
+           vesc_io_future_wait(&future) != 0;
+}
+
+esp_err_t vesc_caps_handshake(void) {
+    vesc_caps_t found;
+
+    memset(&found, 0, sizeof(found));
+    if (!caps_read_version(&found)) {
+        ESP_LOGW(TAG, "No firmware version, keeping %s capabilities", caps_valid ? "previous" : "default");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t fw = VESC_FW(found.fw_major, found.fw_minor);
+    if (fw < VESC_FW_VALUES_FW3) {
+        found.values_msg = &vesc_msg_values_fw2;
+    } else if (fw < VESC_FW_VALUES_FULL) {
+        found.values_msg = &vesc_msg_values_fw3;
+    } else {
+        found.values_msg = &vesc_msg_values;
+        found.flags |= VESC_CAP_CONTROLLER_ID;
+    }
+    if (fw >= VESC_FW_CONFIG)        found.flags |= VESC_CAP_CONFIG;
+    if (fw >= VESC_FW_VALUES_SETUP)  found.flags |= VESC_CAP_VALUES_SETUP;
+    if (fw >= VESC_FW_CURRENT_REL)   found.flags |= VESC_CAP_CURRENT_REL;
+    if (fw >= VESC_FW_BMS)           found.flags |= VESC_CAP_BMS;
+    if (fw >= VESC_FW_MCCONF_TEMP)   found.flags |= VESC_CAP_MCCONF_TEMP;
+
+    if (fw >= VESC_FW_VALUES_FW3 && caps_probe_selective()) {
+        found.flags |= VESC_CAP_VALUES_SELECTIVE;
+    }
+
+    portENTER_CRITICAL(&caps_lock);
+    caps = found;
+    caps_valid = true;
+    portEXIT_CRITICAL(&caps_lock);
+
+    ESP_LOGI(TAG, "VESC FW %u.%02u%s%s: %s, selective %s, relative current %s",
+             found.fw_major, found.fw_minor, found.hw_name[0] ? " on " : "", found.hw_name,
+             found.values_msg->name,
+             (found.flags & VESC_CAP_VALUES_SELECTIVE) ? "yes" : "no",
+             (found.flags & VESC_CAP_CURRENT_REL) ? "yes" : "no");
+    return ESP_OK;
+}
+
+bool vesc_caps_get(vesc_caps_t *out) {
+    if (out == NULL) return false;
+
+    portENTER_CRITICAL(&caps_lock);
+    *out = caps;
+    bool valid = caps_valid;
+    portEXIT_CRITICAL(&caps_lock);
+    return valid;
+}
+
+bool vesc_caps_has(uint32_t flags) {
+    portENTER_CRITICAL(&caps_lock);
+    bool has = (caps.flags & flags) == flags;
+    portEXIT_CRITICAL(&caps_lock);
+    return has;
+}
+
+const vesc_codec_msg_t *vesc_caps_values_msg(void) {
+    portENTER_CRITICAL(&caps_lock);
+    const vesc_codec_msg_t *msg = caps.values_msg;
+    portEXIT_CRITICAL(&caps_lock);
+    return msg;
+}
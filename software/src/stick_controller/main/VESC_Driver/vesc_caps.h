@@ -0,0 +1,102 @@
+/**
+ * @file vesc_caps.h
+ * @brief Firmware version handshake and VESC capabilities
+ *
+ * At link-up the UART VESC is asked for its firmware version once. The
+ * version picks the COMM_GET_VALUES layout and the commands the driver may
+ * use; COMM_GET_VALUES_SELECTIVE is also confirmed with a probe request,
+ * since builds between releases do not always match the release notes.
+ * The result is cached and used by the rest of the driver without asking
+ * the VESC again:
+ * - vesc_uart polls with COMM_GET_VALUES in the matching layout when
+ *   selective values are not available, and pipelines forwarded CAN polls
+ *   only when replies carry the controller ID
+ * - vesc_health probes with the cheapest request the VESC answers
+ * - vesc_config reads limits only from firmware with config signatures,
+ *   and reuses the cached COMM_FW_VERSION reply as its identity
+ * - vesc_envelope pushes temporary limits only to firmware that acks them
+ *
+ * Until the first handshake the driver assumes firmware 3.40 or newer.
+ */
+
+#ifndef VESC_CAPS_H
+#define VESC_CAPS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "vesc_codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_FW(major, minor)   (((major) << 8) | (minor))
+
+// First firmware release with each feature
+#define VESC_FW_VALUES_FW3      VESC_FW(3, 0)   // Single FET temperature, motor temperature, d/q currents
+#define VESC_FW_VALUES_FULL     VESC_FW(3, 40)  // pid_pos and controller_id in COMM_GET_VALUES
+#define VESC_FW_CONFIG          VESC_FW(3, 40)  // MCCONF/APPCONF start with their signature
+#define VESC_FW_VALUES_SETUP    VESC_FW(3, 40)  // COMM_GET_VALUES_SETUP(_SELECTIVE)
+#define VESC_FW_MCCONF_TEMP     VESC_FW(3, 40)  // COMM_SET_MCCONF_TEMP with ack
+#define VESC_FW_CURRENT_REL     VESC_FW(3, 50)  // COMM_SET_CURRENT_REL
+#define VESC_FW_BMS             VESC_FW(5, 0)   // COMM_BMS_GET_VALUES
+
+// Capability flags
+#define VESC_CAP_VALUES_SELECTIVE   (1UL << 0)  // COMM_GET_VALUES_SELECTIVE (probed)
+#define VESC_CAP_CONTROLLER_ID      (1UL << 1)  // Values replies can carry the controller ID
+#define VESC_CAP_CONFIG             (1UL << 2)  // Config limits can be decoded (vesc_config)
+#define VESC_CAP_VALUES_SETUP       (1UL << 3)  // vesc_get_values_setup()
+#define VESC_CAP_CURRENT_REL        (1UL << 4)  // VESC_CMD_CURRENT_REL / COMM_SET_CURRENT_REL
+#define VESC_CAP_BMS                (1UL << 5)  // vesc_bms_get_values()
+#define VESC_CAP_MCCONF_TEMP        (1UL << 6)  // Temporary limits (vesc_envelope)
+
+// Assumed before the first handshake: what the driver always relied on
+#define VESC_CAPS_DEFAULT   (VESC_CAP_VALUES_SELECTIVE | VESC_CAP_CONTROLLER_ID | VESC_CAP_CONFIG)
+
+#define VESC_CAPS_HW_NAME_LEN   16
+
+typedef struct {
+    uint8_t fw_major;
+    uint8_t fw_minor;
+    char hw_name[VESC_CAPS_HW_NAME_LEN];    // Empty on firmware that does not send it
+    uint32_t identity_hash;                 // CRC32 of the COMM_FW_VERSION reply
+    uint32_t flags;                         // VESC_CAP_*
+    const vesc_codec_msg_t *values_msg;     // COMM_GET_VALUES layout
+} vesc_caps_t;
+
+/**
+ * @brief Read the firmware version of the UART VESC and derive its capabilities
+ *
+ * Blocks for up to a few request timeouts. Call after vesc_link_start(),
+ * and again after a reconnect (the VESC may have been reflashed).
+ *
+ * @return ESP_OK, or ESP_ERR_TIMEOUT if the VESC did not answer (the
+ *         previous capabilities are kept)
+ */
+esp_err_t vesc_caps_handshake(void);
+
+/**
+ * @brief Get the cached handshake result
+ * @param caps Output
+ * @return false if no handshake has succeeded yet (caps holds the defaults)
+ */
+bool vesc_caps_get(vesc_caps_t *caps);
+
+/**
+ * @brief Check capabilities
+ * @param flags VESC_CAP_* bits
+ * @return true if all of them are available
+ */
+bool vesc_caps_has(uint32_t flags);
+
+/**
+ * @brief COMM_GET_VALUES layout of the connected firmware
+ */
+const vesc_codec_msg_t *vesc_caps_values_msg(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_CAPS_H
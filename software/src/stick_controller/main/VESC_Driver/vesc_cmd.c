@@ -0,0 +1,329 @@
+/**
+ * @file vesc_cmd.c
+ * @brief Motor setpoint scheduler
+ */
+
+#include "vesc_cmd.h"
+#include "vesc_io.h"
+#include "vesc_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdatomic.h>
+#include <string.h>
+
+static const char *TAG = "vesc_cmd";
+
+_Static_assert(VESC_MAX_CONTROLLERS <= VESC_IO_MAX_BATCH &&
+               VESC_MAX_CONTROLLERS * VESC_MOTOR_COMMAND_MAX_LEN <= VESC_IO_MAX_PAYLOAD,
+               "A command to every controller must fit one I/O batch");
+
+static int cmd_ids[VESC_MAX_CONTROLLERS];
+static int cmd_count = 0;
+static uint64_t cmd_period_us = 0;
+static esp_timer_handle_t cmd_timer = NULL;     // Refresh, periodic
+static esp_timer_handle_t cmd_kick = NULL;      // New setpoint, one-shot
+
+// Wanted setpoint, written by vesc_cmd_set() only. seq is odd while it is
+// being filled in; the sender takes it when seq has moved on.
+static struct {
+    atomic_uint seq;
+    vesc_cmd_kind_t kind;
+    float value;
+    uint32_t estop_release;     // E-stop hold to end, set by vesc_cmd_release_estop() and kept
+} cmd_wanted;
+
+// Active setpoint, already encoded per controller. Only touched by the
+// two timer callbacks, which the esp_timer task runs one at a time.
+static vesc_cmd_kind_t cmd_kind = VESC_CMD_NONE;
+static uint8_t cmd_payloads[VESC_MAX_CONTROLLERS][VESC_MOTOR_COMMAND_MAX_LEN];
+static uint16_t cmd_lens[VESC_MAX_CONTROLLERS];
+static unsigned cmd_seen = 0;                   // cmd_wanted.seq last taken
+static uint32_t cmd_release_wanted = 0;         // cmd_wanted.estop_release last taken
+static uint32_t cmd_release_sent = 0;           // ... and last queued
+
+// 0 A to every controller, encoded at start and never changed after
+static uint8_t cmd_halt_payloads[VESC_MAX_CONTROLLERS][VESC_MOTOR_COMMAND_MAX_LEN];
+static uint16_t cmd_halt_lens[VESC_MAX_CONTROLLERS];
+
+// 0 while armed. Halted: odd, past every cmd_wanted.seq handed over before
+// the halt, so only a later 0 A setpoint re-arms.
+static atomic_uint cmd_halt;
+
+static portMUX_TYPE cmd_lock = portMUX_INITIALIZER_UNLOCKED;
+static vesc_cmd_stats_t cmd_stats;              // Guarded by cmd_lock
+static atomic_uint cmd_set_coalesced;           // Counted by vesc_cmd_set(), which takes no lock
+static atomic_uint cmd_halts;                   // Counted by vesc_cmd_halt(), likewise
+
+#define CMD_COUNT(field)    do { portENTER_CRITICAL_SAFE(&cmd_lock); cmd_stats.field++; \
+                                 portEXIT_CRITICAL_SAFE(&cmd_lock); } while (0)
+
+static vesc_comm_packet_id_t cmd_packet_id(vesc_cmd_kind_t kind) {
+    switch (kind) {
+        case VESC_CMD_BRAKE:        return COMM_SET_CURRENT_BRAKE;
+        case VESC_CMD_DUTY:         return COMM_SET_DUTY;
+        case VESC_CMD_RPM:          return COMM_SET_RPM;
+        case VESC_CMD_CURRENT_REL:  return COMM_SET_CURRENT_REL;
+        case VESC_CMD_CURRENT:
+        default:                    return COMM_SET_CURRENT;
+    }
+}
+
+// Send the active setpoint to every controller, or 0 A while halted
+static bool cmd_send(void) {
+    vesc_io_frame_t frames[VESC_MAX_CONTROLLERS];
+    bool halted = atomic_load(&cmd_halt) != 0;
+
+    for (int i = 0; i < cmd_count; i++) {
+        frames[i].payload = halted ? cmd_halt_payloads[i] : cmd_payloads[i];
+        frames[i].len = halted ? cmd_halt_lens[i] : cmd_lens[i];
+    }
+    if (vesc_io_send_batch(frames, cmd_count, VESC_IO_PRIO_URGENT) != ESP_OK) {
+        CMD_COUNT(dropped);
+        return false;
+    }
+    return true;
+}
+
+// Copy out the wanted setpoint if vesc_cmd_set() has written a new one.
+// Never waits for the writer: a setpoint caught half-written is taken by
+// the kick that follows it.
+static bool cmd_take_wanted(vesc_cmd_kind_t *kind, float *value, unsigned *seq) {
+    unsigned before = atomic_load_explicit(&cmd_wanted.seq, memory_order_acquire);
+    if (before == cmd_seen || (before & 1)) {
+        return false;
+    }
+
+    *kind = cmd_wanted.kind;
+    *value = cmd_wanted.value;
+    uint32_t release = cmd_wanted.estop_release;
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&cmd_wanted.seq, memory_order_relaxed) != before) {
+        return false;
+    }
+    cmd_seen = before;
+    cmd_release_wanted = release;
+    *seq = before;
+    return true;
+}
+
+// Make the wanted setpoint the active one. Returns false if nothing changed.
+static bool cmd_apply_wanted(void) {
+    uint8_t payloads[VESC_MAX_CONTROLLERS][VESC_MOTOR_COMMAND_MAX_LEN];
+    uint16_t lens[VESC_MAX_CONTROLLERS];
+    vesc_cmd_kind_t kind;
+    float value;
+    unsigned seq;
+
+    if (!cmd_take_wanted(&kind, &value, &seq)) {
+        return false;
+    }
+    if (kind == VESC_CMD_CURRENT_REL && !vesc_caps_has(VESC_CAP_CURRENT_REL)) {
+        // Older firmware ignores the frame: keep the active setpoint instead
+        CMD_COUNT(unsupported);
+        ESP_LOGW(TAG, "Relative current not supported by this firmware");
+        return false;
+    }
+    unsigned halt = atomic_load(&cmd_halt);
+    if (halt != 0) {
+        // Only 0 A handed over after the halt re-arms
+        if (kind != VESC_CMD_CURRENT || value != 0.0f || (int)(seq - halt) < 0) {
+            CMD_COUNT(held);
+            return false;
+        }
+        // Let setpoints through the I/O engine first: if a new halt lands in
+        // between, the failed exchange below puts the substitution back
+        vesc_io_halt(false);
+        if (!atomic_compare_exchange_strong(&cmd_halt, &halt, 0)) {
+            vesc_io_halt(true);
+            CMD_COUNT(held);
+            return false;
+        }
+        ESP_LOGI(TAG, "Setpoints re-armed");
+    }
+
+    memset(payloads, 0, sizeof(payloads));
+    // Compare on the wire encoding: setpoints that round to the same frame are the same
+    for (int i = 0; i < cmd_count; i++) {
+        lens[i] = vesc_build_motor_command(payloads[i], cmd_ids[i], cmd_packet_id(kind), value);
+    }
+    if (kind == cmd_kind && memcmp(lens, cmd_lens, cmd_count * sizeof(lens[0])) == 0 &&
+        memcmp(payloads, cmd_payloads, sizeof(payloads[0]) * cmd_count) == 0) {
+        CMD_COUNT(coalesced);
+        return false;
+    }
+
+    cmd_kind = kind;
+    memcpy(cmd_payloads, payloads, sizeof(payloads[0]) * cmd_count);
+    memcpy(cmd_lens, lens, sizeof(lens[0]) * cmd_count);
+    return true;
+}
+
+// End the e-stop hold with 0 A once a setpoint from after the e-stop has
+// been taken. Queued before any send of the setpoint itself, so nothing
+// from before it can follow the burst.
+static void cmd_send_release(void) {
+    if (cmd_release_wanted == cmd_release_sent) {
+        return;
+    }
+
+    vesc_io_frame_t frames[VESC_MAX_CONTROLLERS];
+    for (int i = 0; i < cmd_count; i++) {
+        frames[i].payload = cmd_halt_payloads[i];
+        frames[i].len = cmd_halt_lens[i];
+    }
+    if (vesc_io_estop_release(cmd_release_wanted, frames, cmd_count) != ESP_OK) {
+        CMD_COUNT(dropped);             // Retried on the next refresh
+        return;
+    }
+    cmd_release_sent = cmd_release_wanted;
+}
+
+static void cmd_on_kick(void *arg) {
+    (void)arg;
+
+    bool changed = cmd_apply_wanted();
+    cmd_send_release();
+    if (changed && cmd_send()) {
+        CMD_COUNT(changes);
+        // The next refresh is a full period after this send
+        esp_timer_restart(cmd_timer, cmd_period_us);
+    }
+}
+
+static void cmd_refresh(void *arg) {
+    (void)arg;
+
+    // Also picks up a setpoint whose kick found it half-written
+    bool changed = cmd_apply_wanted();
+    cmd_send_release();
+    if ((cmd_kind != VESC_CMD_NONE || atomic_load(&cmd_halt) != 0) && cmd_send()) {
+        if (changed) {
+            CMD_COUNT(changes);
+        } else {
+            CMD_COUNT(refreshes);
+        }
+    }
+}
+
+esp_err_t vesc_cmd_start(const int *can_ids, int count, uint32_t period_ms) {
+    if (can_ids == NULL || count <= 0 || count > VESC_MAX_CONTROLLERS || period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (cmd_timer != NULL) return ESP_ERR_INVALID_STATE;
+
+    memcpy(cmd_ids, can_ids, count * sizeof(int));
+    cmd_count = count;
+    cmd_period_us = (uint64_t)period_ms * 1000;
+    cmd_kind = VESC_CMD_NONE;
+    memset(&cmd_stats, 0, sizeof(cmd_stats));
+
+    vesc_io_frame_t halt_frames[VESC_MAX_CONTROLLERS];
+    memset(cmd_halt_payloads, 0, sizeof(cmd_halt_payloads));
+    for (int i = 0; i < count; i++) {
+        cmd_halt_lens[i] = vesc_build_motor_command(cmd_halt_payloads[i], can_ids[i], COMM_SET_CURRENT, 0.0f);
+        halt_frames[i].payload = cmd_halt_payloads[i];
+        halt_frames[i].len = cmd_halt_lens[i];
+    }
+    esp_err_t ret = vesc_io_halt_prepare(halt_frames, count);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Halt batch: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    const esp_timer_create_args_t kick_args = {
+        .callback = cmd_on_kick,
+        .name = "vesc_cmd_kick",
+    };
+    const esp_timer_create_args_t timer_args = {
+        .callback = cmd_refresh,
+        .name = "vesc_cmd",
+    };
+    ret = esp_timer_create(&kick_args, &cmd_kick);
+    if (ret == ESP_OK) {
+        ret = esp_timer_create(&timer_args, &cmd_timer);
+        if (ret != ESP_OK) {
+            esp_timer_delete(cmd_kick);
+            cmd_kick = NULL;
+        }
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Timer create failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ret = esp_timer_start_periodic(cmd_timer, cmd_period_us);
+    if (ret != ESP_OK) {
+        esp_timer_delete(cmd_timer);
+        esp_timer_delete(cmd_kick);
+        cmd_timer = NULL;
+        cmd_kick = NULL;
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Setpoint refresh every %lu ms to %d controller(s)", (unsigned long)period_ms, count);
+    return ESP_OK;
+}
+
+void vesc_cmd_set(vesc_cmd_kind_t kind, float value) {
+    if (cmd_kick == NULL || kind == VESC_CMD_NONE) return;
+
+    // Same as the last call: nothing to hand over. While halted every 0 A
+    // call is handed over, since only a call after the halt re-arms.
+    if (kind == cmd_wanted.kind && value == cmd_wanted.value && atomic_load(&cmd_halt) == 0) {
+        atomic_fetch_add_explicit(&cmd_set_coalesced, 1, memory_order_relaxed);
+        return;
+    }
+
+    atomic_fetch_add_explicit(&cmd_wanted.seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    cmd_wanted.kind = kind;
+    cmd_wanted.value = value;
+    atomic_fetch_add_explicit(&cmd_wanted.seq, 1, memory_order_release);
+
+    // Already armed: that run takes this setpoint as well
+    esp_timer_start_once(cmd_kick, 0);
+}
+
+void vesc_cmd_release_estop(uint32_t hold) {
+    if (cmd_kick == NULL || hold == 0) return;
+
+    // Handed over like any setpoint, never coalesced: the tag stays in the
+    // slot, so setpoints set after it cannot lose the release
+    atomic_fetch_add_explicit(&cmd_wanted.seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    cmd_wanted.kind = VESC_CMD_CURRENT;
+    cmd_wanted.value = 0.0f;
+    cmd_wanted.estop_release = hold;
+    atomic_fetch_add_explicit(&cmd_wanted.seq, 1, memory_order_release);
+
+    esp_timer_start_once(cmd_kick, 0);
+}
+
+void vesc_cmd_halt(void) {
+    if (cmd_timer == NULL) return;
+
+    // A setpoint being written right now counts as handed over before the
+    // halt: the marker is past the seq it will end on
+    unsigned seq = atomic_load(&cmd_wanted.seq);
+    if (atomic_exchange(&cmd_halt, (seq + 1) | 1U) == 0) {
+        atomic_fetch_add_explicit(&cmd_halts, 1, memory_order_relaxed);
+    }
+    // The engine writes the pre-encoded 0 A batch next and puts it in place
+    // of any setpoint still queued; the refresh repeats it from here on
+    vesc_io_halt(true);
+}
+
+bool vesc_cmd_halted(void) {
+    return atomic_load(&cmd_halt) != 0;
+}
+
+void vesc_cmd_get_stats(vesc_cmd_stats_t *stats) {
+    if (stats == NULL) return;
+
+    portENTER_CRITICAL(&cmd_lock);
+    *stats = cmd_stats;
+    portEXIT_CRITICAL(&cmd_lock);
+    stats->coalesced += atomic_load_explicit(&cmd_set_coalesced, memory_order_relaxed);
+    stats->halts = atomic_load_explicit(&cmd_halts, memory_order_relaxed);
+}
@@ -0,0 +1,113 @@
+/**
+ * @file vesc_cmd.h
+ * @brief Motor setpoint scheduler
+ *
+ * Holds the latest setpoint (current, brake current, duty or RPM) for the
+ * controllers driven together and is the only source of periodic motor
+ * traffic:
+ * - A new setpoint goes out at once, as one urgent batch to every controller.
+ *   vesc_cmd_set() only hands it over: the batch is encoded and queued on
+ *   the esp_timer task, so the control loop never waits on the sender.
+ * - The same setpoint is re-sent every CONFIG_VESC_CMD_PERIOD_MS after the
+ *   last send. The refresh doubles as the VESC keepalive, so no
+ *   COMM_ALIVE frames are needed.
+ * - Setting the setpoint that is already active sends nothing.
+ * - vesc_cmd_halt() forces 0 A at once and holds it: other setpoints are
+ *   ignored until 0 A current is set again.
+ */
+
+#ifndef VESC_CMD_H
+#define VESC_CMD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "vesc_uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    VESC_CMD_NONE = 0,          // Nothing commanded yet: no frames are sent
+    VESC_CMD_CURRENT,           // Amps
+    VESC_CMD_BRAKE,             // Brake amps
+    VESC_CMD_DUTY,              // Duty cycle (0.0 - 1.0)
+    VESC_CMD_RPM,               // eRPM
+    VESC_CMD_CURRENT_REL,       // Share of the VESC current limits (-1.0 - 1.0), needs VESC_CAP_CURRENT_REL
+} vesc_cmd_kind_t;
+
+// Frame counts since start (one batch = one frame per controller)
+typedef struct {
+    uint32_t changes;           // Batches sent for a new setpoint
+    uint32_t refreshes;         // Periodic re-sends of the active setpoint
+    uint32_t coalesced;         // vesc_cmd_set() calls that matched the active setpoint
+    uint32_t unsupported;       // VESC_CMD_CURRENT_REL setpoints the firmware cannot take
+    uint32_t dropped;           // Batches the I/O engine had no room for
+    uint32_t halts;             // vesc_cmd_halt() calls that stopped the motors
+    uint32_t held;              // vesc_cmd_set() calls ignored while halted
+} vesc_cmd_stats_t;
+
+/**
+ * @brief Start the scheduler
+ * @param can_ids   Controllers driven together (VESC_CAN_LOCAL for the UART VESC)
+ * @param count     Number of controllers (<= VESC_MAX_CONTROLLERS)
+ * @param period_ms Refresh period, well below the VESC app timeout_msec
+ * @return ESP_OK on success
+ */
+esp_err_t vesc_cmd_start(const int *can_ids, int count, uint32_t period_ms);
+
+/**
+ * @brief Change the setpoint of every controller
+ *
+ * Never blocks: the setpoint is left in a lock-free slot and the sender is
+ * kicked. A different setpoint is sent at once; the active one is not sent
+ * again until its next refresh. Call from one task (the control loop).
+ * VESC_CMD_CURRENT_REL is ignored unless vesc_caps_has(VESC_CAP_CURRENT_REL).
+ *
+ * @param kind  Setpoint kind
+ * @param value Setpoint value
+ */
+void vesc_cmd_set(vesc_cmd_kind_t kind, float value);
+
+/**
+ * @brief Set 0 A and end an e-stop hold with it
+ *
+ * The I/O engine drops motor commands after an e-stop burst. This hands
+ * over 0 A like vesc_cmd_set(), and the sender queues the 0 A batch that
+ * lifts the hold (vesc_io_estop_release()) once it has taken this setpoint,
+ * ahead of anything it sends after. A setpoint the sender had taken before
+ * is still dropped. Call from the task that calls vesc_cmd_set().
+ *
+ * @param hold Tag of the held e-stop, from vesc_io_estop_held()
+ */
+void vesc_cmd_release_estop(uint32_t hold);
+
+/**
+ * @brief Command 0 A to every controller at once and hold it
+ *
+ * For the supervisor. Lock-free and never blocks; callable from any task or
+ * esp_timer callback, not from an interrupt. The I/O engine writes the 0 A
+ * batch encoded at start ahead of queued motor commands and sends it in
+ * place of any that follow, and the refresh repeats it. vesc_cmd_set() is
+ * ignored until it is called with VESC_CMD_CURRENT and 0 A after the halt,
+ * which re-arms it.
+ */
+void vesc_cmd_halt(void);
+
+/**
+ * @brief Whether vesc_cmd_halt() is in force
+ */
+bool vesc_cmd_halted(void);
+
+/**
+ * @brief Read the frame counters
+ * @param stats Output
+ */
+void vesc_cmd_get_stats(vesc_cmd_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_CMD_H
@@ -0,0 +1,459 @@
+/**
+ * @file vesc_codec.c
+ * @brief Table-driven encoder/decoder for VESC payloads
+ */
+
+#include "vesc_codec.h"
+#include "vesc_codec_fields.h"
+#include "vesc_uart.h"
+#include "vesc_config.h"
+#include <stddef.h>
+#include <math.h>
+
+// Wire bytes per element, by vesc_wire_t
+static const uint8_t wire_size[VESC_WIRE_TYPES] = { 1, 2, 4, 4, 4 };
+
+// Shift that sign-extends a raw wire value, by vesc_wire_t (0 = no extension)
+static const uint8_t wire_sign_shift[VESC_WIRE_TYPES] = { 0, 16, 0, 0, 0 };
+
+// Struct member bytes per element, by vesc_dst_t
+#define DST_SIZE_NONE   1
+#define DST_SIZE_FLOAT  sizeof(float)
+#define DST_SIZE_INT32  sizeof(int32_t)
+#define DST_SIZE_UINT32 sizeof(uint32_t)
+#define DST_SIZE_UINT8  sizeof(uint8_t)
+#define DST_SIZE_ENUM   sizeof(int)
+#define DST_SIZE_COUNT  sizeof(uint8_t)
+#define DST_SIZE_FIXED  sizeof(int32_t)
+
+static const uint8_t dst_size[] = {
+    DST_SIZE_NONE, DST_SIZE_FLOAT, DST_SIZE_INT32, DST_SIZE_UINT32,
+    DST_SIZE_UINT8, DST_SIZE_ENUM, DST_SIZE_COUNT, DST_SIZE_FIXED,
+};
+
+// dst suffixes of the field lists: the member type and, for scaled
+// integers, the member scale
+#define DST_KIND_FLOAT  VESC_DST_FLOAT
+#define DST_KIND_INT32  VESC_DST_INT32
+#define DST_KIND_UINT32 VESC_DST_UINT32
+#define DST_KIND_UINT8  VESC_DST_UINT8
+#define DST_KIND_ENUM   VESC_DST_ENUM
+#define DST_KIND_COUNT  VESC_DST_COUNT
+#define DST_KIND_FX1    VESC_DST_FIXED
+#define DST_KIND_FX2    VESC_DST_FIXED
+#define DST_KIND_FX3    VESC_DST_FIXED
+#define DST_KIND_FX4    VESC_DST_FIXED
+#define DST_KIND_FX6    VESC_DST_FIXED
+
+#define DST_SIZE_FX1    DST_SIZE_FIXED
+#define DST_SIZE_FX2    DST_SIZE_FIXED
+#define DST_SIZE_FX3    DST_SIZE_FIXED
+#define DST_SIZE_FX4    DST_SIZE_FIXED
+#define DST_SIZE_FX6    DST_SIZE_FIXED
+
+#define DST_SCALE_FLOAT     1
+#define DST_SCALE_INT32     1
+#define DST_SCALE_UINT32    1
+#define DST_SCALE_UINT8     1
+#define DST_SCALE_ENUM      1
+#define DST_SCALE_COUNT     1
+#define DST_SCALE_FX1       VESC_FX1_SCALE
+#define DST_SCALE_FX2       VESC_FX2_SCALE
+#define DST_SCALE_FX3       VESC_FX3_SCALE
+#define DST_SCALE_FX4       VESC_FX4_SCALE
+#define DST_SCALE_FX6       VESC_FX6_SCALE
+
+// Table generation. CODEC_TYPE is the struct the current list decodes into.
+
+#define MEMBER_SIZE(type, member)   sizeof(((type *)0)->member)
+
+#define CODEC_FIELD(name, wire, count, scale, dst, member) \
+    { VESC_WIRE_##wire, DST_KIND_##dst, count, MEMBER_SIZE(CODEC_TYPE, member) / DST_SIZE_##dst, \
+      offsetof(CODEC_TYPE, member), (uint16_t)(DST_SCALE_##dst / (scale)), scale },
+
+#define CODEC_SKIP(name, wire, count) \
+    { VESC_WIRE_##wire, VESC_DST_NONE, count, 0, 0, 1, 1.0f },
+
+// Each member must hold a whole number of elements of its field type, and
+// a scaled integer must have at least the digits of the wire value
+#define CODEC_CHECK(name, wire, count, scale, dst, member) \
+    _Static_assert(MEMBER_SIZE(CODEC_TYPE, member) % DST_SIZE_##dst == 0 && \
+                   MEMBER_SIZE(CODEC_TYPE, member) / DST_SIZE_##dst <= UINT8_MAX, \
+                   #member " does not match field type " #dst); \
+    _Static_assert(DST_KIND_##dst != VESC_DST_FIXED || (int32_t)(scale) <= DST_SCALE_##dst, \
+                   #member " has more digits on the wire than " #dst " keeps");
+
+#define CODEC_NO_CHECK(name, wire, count)
+
+#define CODEC_TABLE(table, LIST) \
+    LIST(CODEC_CHECK, CODEC_NO_CHECK) \
+    static const vesc_codec_field_t table[] = { LIST(CODEC_FIELD, CODEC_SKIP) }
+
+#define FIELD_COUNT(table)  ((uint8_t)(sizeof(table) / sizeof(table[0])))
+
+#define CODEC_TYPE vesc_fw_version_t
+CODEC_TABLE(fw_version_fields, VESC_FW_VERSION_FIELDS);
+#undef CODEC_TYPE
+
+#define CODEC_TYPE vesc_data_t
+CODEC_TABLE(values_fields, VESC_VALUES_FIELDS);
+CODEC_TABLE(values_fw2_fields, VESC_VALUES_FW2_FIELDS);
+CODEC_TABLE(can_status_1_fields, VESC_CAN_STATUS_1_FIELDS);
+CODEC_TABLE(can_status_2_fields, VESC_CAN_STATUS_2_FIELDS);
+CODEC_TABLE(can_status_3_fields, VESC_CAN_STATUS_3_FIELDS);
+CODEC_TABLE(can_status_4_fields, VESC_CAN_STATUS_4_FIELDS);
+CODEC_TABLE(can_status_5_fields, VESC_CAN_STATUS_5_FIELDS);
+CODEC_TABLE(can_status_6_fields, VESC_CAN_STATUS_6_FIELDS);
+#undef CODEC_TYPE
+
+#define CODEC_TYPE vesc_setup_data_t
+CODEC_TABLE(values_setup_fields, VESC_VALUES_SETUP_FIELDS);
+#undef CODEC_TYPE
+
+#define CODEC_TYPE vesc_bms_data_t
+CODEC_TABLE(bms_values_fields, VESC_BMS_VALUES_FIELDS);
+#undef CODEC_TYPE
+
+#define CODEC_TYPE vesc_limits_t
+CODEC_TABLE(mcconf_limits_fields, VESC_MCCONF_LIMITS_FIELDS);
+CODEC_TABLE(appconf_limits_fields, VESC_APPCONF_LIMITS_FIELDS);
+#undef CODEC_TYPE
+
+#define CODEC_TYPE vesc_codec_setpoint_t
+CODEC_TABLE(set_duty_fields, VESC_SET_DUTY_FIELDS);
+CODEC_TABLE(set_current_fields, VESC_SET_CURRENT_FIELDS);
+CODEC_TABLE(set_current_rel_fields, VESC_SET_CURRENT_REL_FIELDS);
+CODEC_TABLE(set_rpm_fields, VESC_SET_RPM_FIELDS);
+#undef CODEC_TYPE
+
+#define CODEC_TYPE vesc_mcconf_temp_t
+CODEC_TABLE(set_mcconf_temp_fields, VESC_SET_MCCONF_TEMP_FIELDS);
+#undef CODEC_TYPE
+
+#define CODEC_TYPE vesc_codec_mask_t
+CODEC_TABLE(mask_request_fields, VESC_MASK_REQUEST_FIELDS);
+#undef CODEC_TYPE
+
+// The public mask bits are the field indices of the lists
+#define VALUES_INDEX(name, ...)     VALUES_IDX_##name,
+#define SETUP_INDEX(name, ...)      SETUP_IDX_##name,
+enum { VESC_VALUES_FIELDS(VALUES_INDEX, VALUES_INDEX) VALUES_IDX_COUNT };
+enum { VESC_VALUES_SETUP_FIELDS(SETUP_INDEX, SETUP_INDEX) SETUP_IDX_COUNT };
+
+#define VALUES_BIT_CHECK(name, ...) \
+    _Static_assert(VESC_VALUE_##name == 1UL << VALUES_IDX_##name, "VESC_VALUE_" #name " is not its field index");
+#define SETUP_BIT_CHECK(name, ...) \
+    _Static_assert(VESC_SETUP_##name == 1UL << SETUP_IDX_##name, "VESC_SETUP_" #name " is not its field index");
+VESC_VALUES_FIELDS(VALUES_BIT_CHECK, VALUES_BIT_CHECK)
+VESC_VALUES_SETUP_FIELDS(SETUP_BIT_CHECK, SETUP_BIT_CHECK)
+
+// A plain COMM_GET_VALUES reply carries the fields up to the controller ID
+// (up to the fault code before firmware 3.40)
+#define VALUES_PLAIN_COUNT  (VALUES_IDX_CONTROLLER_ID + 1)
+#define VALUES_FW3_COUNT    (VALUES_IDX_FAULT + 1)
+_Static_assert(VESC_VALUES_ALL == (1UL << VALUES_PLAIN_COUNT) - 1, "VESC_VALUES_ALL does not match the table");
+_Static_assert(VALUES_IDX_COUNT <= VESC_CODEC_MAX_FIELDS && SETUP_IDX_COUNT <= VESC_CODEC_MAX_FIELDS,
+               "Masked messages are limited to 32 fields");
+
+// Messages
+
+const vesc_codec_msg_t vesc_msg_fw_version = {
+    "FW_VERSION", COMM_FW_VERSION, 0, FIELD_COUNT(fw_version_fields), fw_version_fields,
+};
+const vesc_codec_msg_t vesc_msg_values = {
+    "GET_VALUES", COMM_GET_VALUES, 0, VALUES_PLAIN_COUNT, values_fields,
+};
+const vesc_codec_msg_t vesc_msg_values_fw3 = {
+    "GET_VALUES_FW3", COMM_GET_VALUES, 0, VALUES_FW3_COUNT, values_fields,
+};
+const vesc_codec_msg_t vesc_msg_values_fw2 = {
+    "GET_VALUES_FW2", COMM_GET_VALUES, 0, FIELD_COUNT(values_fw2_fields), values_fw2_fields,
+};
+const vesc_codec_msg_t vesc_msg_values_selective = {
+    "GET_VALUES_SELECTIVE", COMM_GET_VALUES_SELECTIVE, VESC_CODEC_MASKED,
+    FIELD_COUNT(values_fields), values_fields,
+};
+const vesc_codec_msg_t vesc_msg_values_setup = {
+    "GET_VALUES_SETUP", COMM_GET_VALUES_SETUP, 0, FIELD_COUNT(values_setup_fields), values_setup_fields,
+};
+const vesc_codec_msg_t vesc_msg_values_setup_selective = {
+    "GET_VALUES_SETUP_SELECTIVE", COMM_GET_VALUES_SETUP_SELECTIVE, VESC_CODEC_MASKED,
+    FIELD_COUNT(values_setup_fields), values_setup_fields,
+};
+const vesc_codec_msg_t vesc_msg_bms_values = {
+    "BMS_GET_VALUES", COMM_BMS_GET_VALUES, 0, FIELD_COUNT(bms_values_fields), bms_values_fields,
+};
+const vesc_codec_msg_t vesc_msg_mcconf_limits = {
+    "GET_MCCONF", COMM_GET_MCCONF, 0, FIELD_COUNT(mcconf_limits_fields), mcconf_limits_fields,
+};
+const vesc_codec_msg_t vesc_msg_appconf_limits = {
+    "GET_APPCONF", COMM_GET_APPCONF, 0, FIELD_COUNT(appconf_limits_fields), appconf_limits_fields,
+};
+
+const vesc_codec_msg_t vesc_msg_can_status[VESC_CODEC_CAN_STATUS_KINDS] = {
+    { "CAN_STATUS", VESC_CODEC_NO_ID, 0, FIELD_COUNT(can_status_1_fields), can_status_1_fields },
+    { "CAN_STATUS_2", VESC_CODEC_NO_ID, 0, FIELD_COUNT(can_status_2_fields), can_status_2_fields },
+    { "CAN_STATUS_3", VESC_CODEC_NO_ID, 0, FIELD_COUNT(can_status_3_fields), can_status_3_fields },
+    { "CAN_STATUS_4", VESC_CODEC_NO_ID, 0, FIELD_COUNT(can_status_4_fields), can_status_4_fields },
+    { "CAN_STATUS_5", VESC_CODEC_NO_ID, 0, FIELD_COUNT(can_status_5_fields), can_status_5_fields },
+    { "CAN_STATUS_6", VESC_CODEC_NO_ID, 0, FIELD_COUNT(can_status_6_fields), can_status_6_fields },
+};
+
+const vesc_codec_msg_t vesc_msg_set_duty = {
+    "SET_DUTY", COMM_SET_DUTY, 0, FIELD_COUNT(set_duty_fields), set_duty_fields,
+};
+const vesc_codec_msg_t vesc_msg_set_current = {
+    "SET_CURRENT", COMM_SET_CURRENT, 0, FIELD_COUNT(set_current_fields), set_current_fields,
+};
+const vesc_codec_msg_t vesc_msg_set_current_brake = {
+    "SET_CURRENT_BRAKE", COMM_SET_CURRENT_BRAKE, 0, FIELD_COUNT(set_current_fields), set_current_fields,
+};
+const vesc_codec_msg_t vesc_msg_set_current_rel = {
+    "SET_CURRENT_REL", COMM_SET_CURRENT_REL, 0, FIELD_COUNT(set_current_rel_fields), set_current_rel_fields,
+};
+const vesc_codec_msg_t vesc_msg_set_rpm = {
+    "SET_RPM", COMM_SET_RPM, 0, FIELD_COUNT(set_rpm_fields), set_rpm_fields,
+};
+const vesc_codec_msg_t vesc_msg_set_mcconf_temp = {
+    "SET_MCCONF_TEMP", COMM_SET_MCCONF_TEMP, 0, FIELD_COUNT(set_mcconf_temp_fields), set_mcconf_temp_fields,
+};
+const vesc_codec_msg_t vesc_msg_get_values_selective = {
+    "GET_VALUES_SELECTIVE", COMM_GET_VALUES_SELECTIVE, 0,
+    FIELD_COUNT(mask_request_fields), mask_request_fields,
+};
+const vesc_codec_msg_t vesc_msg_get_values_setup_selective = {
+    "GET_VALUES_SETUP_SELECTIVE", COMM_GET_VALUES_SETUP_SELECTIVE, 0,
+    FIELD_COUNT(mask_request_fields), mask_request_fields,
+};
+
+// Wire access
+
+static uint32_t wire_read(const uint8_t *buffer, uint8_t size) {
+    uint32_t res = 0;
+    for (uint8_t i = 0; i < size; i++) {
+        res = (res << 8) | buffer[i];
+    }
+    return res;
+}
+
+static void wire_write(uint8_t *buffer, uint8_t size, uint32_t value) {
+    for (uint8_t i = 0; i < size; i++) {
+        buffer[i] = (uint8_t)(value >> (8 * (size - 1 - i)));
+    }
+}
+
+// Inverse of the firmware's buffer_append_float32_auto()
+static float float32_auto_decode(uint32_t res) {
+    int e = (res >> 23) & 0xFF;
+    uint32_t sig_i = res & 0x7FFFFF;
+    bool neg = (res & (1UL << 31)) != 0;
+
+    float sig = 0.0f;
+    if (e != 0 || sig_i != 0) {
+        sig = (float)sig_i / (8388608.0f * 2.0f) + 0.5f;
+        e -= 126;
+    }
+    return ldexpf(neg ? -sig : sig, e);
+}
+
+// Same encoding as the firmware's buffer_append_float32_auto()
+static uint32_t float32_auto_encode(float number) {
+    if (fabsf(number) < 1.5e-38f) {
+        number = 0.0f;
+    }
+
+    int e = 0;
+    float sig = frexpf(number, &e);
+    float sig_abs = fabsf(sig);
+    uint32_t sig_i = 0;
+
+    if (sig_abs >= 0.5f) {
+        sig_i = (uint32_t)((sig_abs - 0.5f) * 2.0f * 8388608.0f);
+        e += 126;
+    }
+
+    uint32_t res = (((uint32_t)e & 0xFF) << 23) | (sig_i & 0x7FFFFF);
+    if (sig < 0) {
+        res |= 1UL << 31;
+    }
+    return res;
+}
+
+static void field_store(const vesc_codec_field_t *field, uint8_t *out, uint32_t raw) {
+    uint8_t shift = wire_sign_shift[field->wire];
+    int32_t value = (int32_t)(raw << shift) >> shift;
+
+    switch (field->dst) {
+        case VESC_DST_FLOAT:
+            if (field->wire == VESC_WIRE_F32_AUTO) {
+                *(float *)out = float32_auto_decode(raw);
+            } else if (field->wire == VESC_WIRE_U32) {
+                *(float *)out = (float)raw / field->scale;
+            } else {
+                *(float *)out = (float)value / field->scale;
+            }
+            break;
+        case VESC_DST_FIXED:  *(int32_t *)out = value * field->fx_mul; break;
+        case VESC_DST_INT32:  *(int32_t *)out = value;        break;
+        case VESC_DST_UINT32: *(uint32_t *)out = raw;         break;
+        case VESC_DST_ENUM:   *(int *)out = value;            break;
+        case VESC_DST_UINT8:
+        case VESC_DST_COUNT:  *out = (uint8_t)raw;            break;
+        default:                                              break;
+    }
+}
+
+static uint32_t field_load(const vesc_codec_field_t *field, const uint8_t *in) {
+    switch (field->dst) {
+        case VESC_DST_FLOAT:
+            if (field->wire == VESC_WIRE_F32_AUTO) {
+                return float32_auto_encode(*(const float *)in);
+            }
+            return (uint32_t)(int32_t)(*(const float *)in * field->scale);
+        case VESC_DST_FIXED:  return (uint32_t)(*(const int32_t *)in / field->fx_mul);
+        case VESC_DST_INT32:  return (uint32_t)*(const int32_t *)in;
+        case VESC_DST_UINT32: return *(const uint32_t *)in;
+        case VESC_DST_ENUM:   return (uint32_t)*(const int *)in;
+        case VESC_DST_UINT8:
+        case VESC_DST_COUNT:  return *in;
+        default:              return 0;
+    }
+}
+
+static uint32_t msg_all_fields(const vesc_codec_msg_t *msg) {
+    return msg->field_count >= 32 ? UINT32_MAX : (1UL << msg->field_count) - 1;
+}
+
+// Check the header and return the index of the first field and the fields
+// present, or -1. Masked messages take the mask from the payload.
+static int32_t msg_begin(const vesc_codec_msg_t *msg, const uint8_t *payload, uint16_t len, uint32_t *mask) {
+    int32_t index = 0;
+
+    if (msg->id != VESC_CODEC_NO_ID) {
+        if (len < 1 || payload[0] != (uint8_t)msg->id) {
+            return -1;
+        }
+        index = 1;
+    }
+    *mask = msg_all_fields(msg);
+    if (msg->flags & VESC_CODEC_MASKED) {
+        if (len - index < 4) {
+            return -1;
+        }
+        *mask &= wire_read(&payload[index], 4);
+        index += 4;
+    }
+    return index;
+}
+
+// Walk the fields present, storing them into dst if not NULL. Returns the
+// payload offset of field stop (or of the end if stop < 0), or -1 if the
+// payload is too short.
+static int32_t msg_walk(const vesc_codec_msg_t *msg, const uint8_t *payload, uint16_t len,
+                        uint8_t *dst, int stop, uint32_t *decoded) {
+    uint32_t mask;
+    int32_t index = msg_begin(msg, payload, len, &mask);
+    uint8_t counted = 0;
+
+    if (index < 0) {
+        return -1;
+    }
+    if (stop >= 0 && (stop >= msg->field_count || !(mask & (1UL << stop)))) {
+        return -1;
+    }
+
+    for (int i = 0; i < msg->field_count; i++) {
+        if (!(mask & (1UL << i))) {
+            continue;
+        }
+        const vesc_codec_field_t *field = &msg->fields[i];
+        uint8_t size = wire_size[field->wire];
+        uint32_t repeat = field->count != VESC_CODEC_COUNTED ? field->count : counted;
+        int32_t bytes = (int32_t)(size * repeat);
+
+        if (bytes > len - index) {
+            return -1;
+        }
+        if (i == stop) {
+            return index;
+        }
+
+        if (field->dst == VESC_DST_COUNT) {
+            counted = payload[index];
+        }
+        if (dst != NULL) {
+            uint8_t *out = dst + field->offset;
+            uint32_t keep = repeat < field->max ? repeat : field->max;
+            for (uint32_t r = 0; r < keep; r++) {
+                field_store(field, out + r * dst_size[field->dst], wire_read(&payload[index + r * size], size));
+            }
+        }
+        index += bytes;
+    }
+
+    if (decoded) {
+        *decoded = mask;
+    }
+    return index;
+}
+
+bool vesc_codec_decode(const vesc_codec_msg_t *msg, const uint8_t *payload, uint16_t len,
+                       void *dst, uint32_t *mask) {
+    if (msg == NULL || payload == NULL || dst == NULL) {
+        return false;
+    }
+    return msg_walk(msg, payload, len, (uint8_t *)dst, -1, mask) >= 0;
+}
+
+int32_t vesc_codec_field_offset(const vesc_codec_msg_t *msg, const uint8_t *payload, uint16_t len,
+                                int field) {
+    if (msg == NULL || payload == NULL || field < 0) {
+        return -1;
+    }
+    return msg_walk(msg, payload, len, NULL, field, NULL);
+}
+
+int32_t vesc_codec_encode(const vesc_codec_msg_t *msg, const void *src, uint32_t mask,
+                          uint8_t *payload, uint16_t size) {
+    const uint8_t *in = (const uint8_t *)src;
+    uint32_t fields = msg_all_fields(msg);
+    int32_t index = 0;
+    uint8_t counted = 0;
+
+    if (msg->id != VESC_CODEC_NO_ID) {
+        if (size < 1) {
+            return -1;
+        }
+        payload[index++] = (uint8_t)msg->id;
+    }
+    if (msg->flags & VESC_CODEC_MASKED) {
+        fields &= mask;
+        if (size - index < 4) {
+            return -1;
+        }
+        wire_write(&payload[index], 4, fields);
+        index += 4;
+    }
+
+    for (int i = 0; i < msg->field_count; i++) {
+        if (!(fields & (1UL << i))) {
+            continue;
+        }
+        const vesc_codec_field_t *field = &msg->fields[i];
+        uint8_t wsize = wire_size[field->wire];
+        uint32_t repeat = field->count != VESC_CODEC_COUNTED ? field->count : counted;
+
+        if ((int32_t)(wsize * repeat) > size - index) {
+            return -1;
+        }
+        for (uint32_t r = 0; r < repeat; r++) {
+            uint32_t raw = r < field->max ? field_load(field, in + field->offset + r * dst_size[field->dst]) : 0;
+            wire_write(&payload[index], wsize, raw);
+            index += wsize;
+        }
+        if (field->dst == VESC_DST_COUNT) {
+            counted = in[field->offset];
+        }
+    }
+    return index;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file vesc_codec.h
+ * @brief Table-driven encoder/decoder for VESC payloads
+ *
+ * Every message the driver reads or writes is described once, as a list of
+ * fields in wire order (see vesc_codec_fields.h). Each field has a wire
+ * type, a repeat count, a scale and the struct member it maps to.
+ * Telemetry members are scaled integers (vesc_fixed.h), so decoding them
+ * is a byte swap and at most an integer multiply. One
+ * generic loop encodes and decodes every message from those tables:
+ * - The packet ID is checked before anything is read.
+ * - Every field is bounds-checked against the payload length before it is
+ *   read, including counted arrays.
+ * - Struct members are checked against their field types at compile time.
+ *
+ * A new command is a table entry and a struct, not more index arithmetic.
+ */
+
+#ifndef VESC_CODEC_H
+#define VESC_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_CODEC_NO_ID        (-1)    // Message has no packet ID byte (CAN status frames)
+#define VESC_CODEC_MASKED       0x01    // uint32 field mask follows the packet ID
+#define VESC_CODEC_COUNTED      0       // Field count: repeat by the last VESC_DST_COUNT value
+#define VESC_CODEC_MAX_FIELDS   32      // One mask bit per field
+
+// Field encodings on the wire (all big endian)
+typedef enum {
+    VESC_WIRE_U8 = 0,           // 1 byte
+    VESC_WIRE_I16,              // 2 bytes, buffer_append_float16() when scaled
+    VESC_WIRE_I32,              // 4 bytes, buffer_append_float32() when scaled
+    VESC_WIRE_U32,              // 4 bytes
+    VESC_WIRE_F32_AUTO,         // 4 bytes, buffer_append_float32_auto()
+    VESC_WIRE_TYPES,
+} vesc_wire_t;
+
+// Struct member types a field decodes into
+typedef enum {
+    VESC_DST_NONE = 0,          // Not kept: only its size matters
+    VESC_DST_FLOAT,             // float = wire / scale
+    VESC_DST_INT32,             // int32_t
+    VESC_DST_UINT32,            // uint32_t
+    VESC_DST_UINT8,             // uint8_t
+    VESC_DST_ENUM,              // int-sized enum
+    VESC_DST_COUNT,             // uint8_t, also the length of the next counted fields
+    VESC_DST_FIXED,             // vesc_fxN_t = wire * fx_mul (vesc_fixed.h)
+} vesc_dst_t;
+
+// One field, generated from the tables in vesc_codec_fields.h
+typedef struct {
+    uint8_t wire;               // vesc_wire_t
+    uint8_t dst;                // vesc_dst_t
+    uint8_t count;              // Repeats on the wire, or VESC_CODEC_COUNTED
+    uint8_t max;                // Elements the member holds (1 for scalars, 0 if not kept)
+    uint16_t offset;            // Member offset in the message struct
+    uint16_t fx_mul;            // VESC_DST_FIXED only: member scale / wire scale
+    float scale;                // VESC_DST_FLOAT only
+} vesc_codec_field_t;
+
+// One message layout
+typedef struct {
+    const char *name;
+    int16_t id;                 // Packet ID (first payload byte), or VESC_CODEC_NO_ID
+    uint8_t flags;              // VESC_CODEC_MASKED
+    uint8_t field_count;
+    const vesc_codec_field_t *fields;
+} vesc_codec_msg_t;
+
+// Single setpoint of the motor commands
+typedef struct {
+    float value;
+} vesc_codec_setpoint_t;
+
+// COMM_GET_VALUES_SELECTIVE / COMM_GET_VALUES_SETUP_SELECTIVE request
+typedef struct {
+    uint32_t mask;
+} vesc_codec_mask_t;
+
+// Replies
+extern const vesc_codec_msg_t vesc_msg_fw_version;          // vesc_fw_version_t
+extern const vesc_codec_msg_t vesc_msg_values;              // vesc_data_t
+extern const vesc_codec_msg_t vesc_msg_values_fw3;          // vesc_data_t, FW 3.00 - 3.39
+extern const vesc_codec_msg_t vesc_msg_values_fw2;          // vesc_data_t, FW 2.x
+extern const vesc_codec_msg_t vesc_msg_values_selective;    // vesc_data_t
+extern const vesc_codec_msg_t vesc_msg_values_setup;        // vesc_setup_data_t
+extern const vesc_codec_msg_t vesc_msg_values_setup_selective; // vesc_setup_data_t
+extern const vesc_codec_msg_t vesc_msg_bms_values;          // vesc_bms_data_t
+extern const vesc_codec_msg_t vesc_msg_mcconf_limits;       // vesc_limits_t (leading fields)
+extern const vesc_codec_msg_t vesc_msg_appconf_limits;      // vesc_limits_t (leading fields)
+
+// CAN status broadcasts, by kind (STATUS, STATUS_2 ... STATUS_6)
+#define VESC_CODEC_CAN_STATUS_KINDS 6
+extern const vesc_codec_msg_t vesc_msg_can_status[VESC_CODEC_CAN_STATUS_KINDS]; // vesc_data_t
+
+// Requests
+extern const vesc_codec_msg_t vesc_msg_set_duty;            // vesc_codec_setpoint_t
+extern const vesc_codec_msg_t vesc_msg_set_current;         // vesc_codec_setpoint_t
+extern const vesc_codec_msg_t vesc_msg_set_current_brake;   // vesc_codec_setpoint_t
+extern const vesc_codec_msg_t vesc_msg_set_current_rel;     // vesc_codec_setpoint_t
+extern const vesc_codec_msg_t vesc_msg_set_rpm;             // vesc_codec_setpoint_t
+extern const vesc_codec_msg_t vesc_msg_set_mcconf_temp;     // vesc_mcconf_temp_t
+extern const vesc_codec_msg_t vesc_msg_get_values_selective; // vesc_codec_mask_t
+extern const vesc_codec_msg_t vesc_msg_get_values_setup_selective; // vesc_codec_mask_t
+
+/**
+ * @brief Decode a payload into the message struct
+ *
+ * Fields absent from the payload (not in the mask of a masked message) are
+ * left untouched in dst. Bytes after the last field are ignored, so newer
+ * firmware may append fields.
+ *
+ * @param msg     Message layout
+ * @param payload Payload, starting with the packet ID unless VESC_CODEC_NO_ID
+ * @param len     Payload length
+ * @param dst     Message struct to update
+ * @param mask    Output: fields decoded, bit i = field i (may be NULL)
+ * @return true if the packet ID matched and every field was inside the payload
+ */
+bool vesc_codec_decode(const vesc_codec_msg_t *msg, const uint8_t *payload, uint16_t len,
+                       void *dst, uint32_t *mask);
+
+/**
+ * @brief Encode a message struct
+ * @param msg     Message layout
+ * @param src     Message struct
+ * @param mask    Fields to encode for a masked message (ignored otherwise)
+ * @param payload Output buffer
+ * @param size    Output buffer size
+ * @return Payload length, or -1 if it does not fit
+ */
+int32_t vesc_codec_encode(const vesc_codec_msg_t *msg, const void *src, uint32_t mask,
+                          uint8_t *payload, uint16_t size);
+
+/**
+ * @brief Find a field in a payload without decoding it
+ * @param msg     Message layout
+ * @param payload Payload
+ * @param len     Payload length
+ * @param field   Field index (mask bit)
+ * @return Offset of the field in the payload, or -1 if absent or truncated
+ */
+int32_t vesc_codec_field_offset(const vesc_codec_msg_t *msg, const uint8_t *payload, uint16_t len,
+                                int field);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_CODEC_H
@@ -0,0 +1,192 @@
+/**
+ * @file vesc_codec_fields.h
+ * @brief VESC message layouts, as X-macro field lists
+ *
+ * Each list gives the fields of one message in wire order:
+ *   FIELD(name, wire, count, scale, dst, member)  decoded into member
+ *   SKIP(name, wire, count)                       on the wire, not kept
+ * wire is a VESC_WIRE_* suffix, dst a VESC_DST_* suffix or FXn for a
+ * vesc_fxN_t member, count the number of repeats (VESC_CODEC_COUNTED for a
+ * length sent just before).
+ * For masked messages the field index is the mask bit.
+ *
+ * Scales are those of the VESC firmware (commands.c, bms.c, comm_can.c).
+ * The lists are expanded into descriptor tables in vesc_codec.c.
+ */
+
+#ifndef VESC_CODEC_FIELDS_H
+#define VESC_CODEC_FIELDS_H
+
+// [COMM_FW_VERSION][major][minor][hw name\0]... -> vesc_fw_version_t
+#define VESC_FW_VERSION_FIELDS(FIELD, SKIP) \
+    FIELD(MAJOR,                U8,  1, 1.0f,       UINT8, major) \
+    FIELD(MINOR,                U8,  1, 1.0f,       UINT8, minor)
+
+// COMM_GET_VALUES(_SELECTIVE) -> vesc_data_t. Names match VESC_VALUE_*.
+#define VESC_VALUES_FIELDS(FIELD, SKIP) \
+    FIELD(TEMP_MOSFET,          I16, 1, 10.0f,      FX1,   temp_mosfet) \
+    FIELD(TEMP_MOTOR,           I16, 1, 10.0f,      FX1,   temp_motor) \
+    FIELD(MOTOR_CURRENT,        I32, 1, 100.0f,     FX2,   avg_motor_current) \
+    FIELD(INPUT_CURRENT,        I32, 1, 100.0f,     FX2,   avg_input_current) \
+    SKIP (AVG_ID,               I32, 1) \
+    SKIP (AVG_IQ,               I32, 1) \
+    FIELD(DUTY_CYCLE,           I16, 1, 1000.0f,    FX3,   duty_cycle) \
+    FIELD(RPM,                  I32, 1, 1.0f,       INT32, rpm) \
+    FIELD(INPUT_VOLTAGE,        I16, 1, 10.0f,      FX1,   input_voltage) \
+    FIELD(AMP_HOURS,            I32, 1, 10000.0f,   FX4,   amp_hours) \
+    FIELD(AMP_HOURS_CHARGED,    I32, 1, 10000.0f,   FX4,   amp_hours_charged) \
+    FIELD(WATT_HOURS,           I32, 1, 10000.0f,   FX4,   watt_hours) \
+    FIELD(WATT_HOURS_CHARGED,   I32, 1, 10000.0f,   FX4,   watt_hours_charged) \
+    FIELD(TACHOMETER,           I32, 1, 1.0f,       INT32, tachometer) \
+    FIELD(TACHOMETER_ABS,       I32, 1, 1.0f,       INT32, tachometer_abs) \
+    FIELD(FAULT,                U8,  1, 1.0f,       ENUM,  fault) \
+    FIELD(PID_POS,              I32, 1, 1000000.0f, FX6,   pid_pos) \
+    FIELD(CONTROLLER_ID,        U8,  1, 1.0f,       UINT8, controller_id) \
+    SKIP (TEMP_FETS,            I16, 3) \
+    SKIP (VD,                   I32, 1) \
+    SKIP (VQ,                   I32, 1)
+
+// COMM_GET_VALUES of firmware 2.x -> vesc_data_t: six FET temperatures and
+// the PCB temperature up front, no motor temperature, no d/q currents
+#define VESC_VALUES_FW2_FIELDS(FIELD, SKIP) \
+    FIELD(TEMP_MOS1,            I16, 1, 10.0f,      FX1,   temp_mosfet) \
+    SKIP (TEMP_MOS2_6,          I16, 5) \
+    SKIP (TEMP_PCB,             I16, 1) \
+    FIELD(MOTOR_CURRENT,        I32, 1, 100.0f,     FX2,   avg_motor_current) \
+    FIELD(INPUT_CURRENT,        I32, 1, 100.0f,     FX2,   avg_input_current) \
+    FIELD(DUTY_CYCLE,           I16, 1, 1000.0f,    FX3,   duty_cycle) \
+    FIELD(RPM,                  I32, 1, 1.0f,       INT32, rpm) \
+    FIELD(INPUT_VOLTAGE,        I16, 1, 10.0f,      FX1,   input_voltage) \
+    FIELD(AMP_HOURS,            I32, 1, 10000.0f,   FX4,   amp_hours) \
+    FIELD(AMP_HOURS_CHARGED,    I32, 1, 10000.0f,   FX4,   amp_hours_charged) \
+    FIELD(WATT_HOURS,           I32, 1, 10000.0f,   FX4,   watt_hours) \
+    FIELD(WATT_HOURS_CHARGED,   I32, 1, 10000.0f,   FX4,   watt_hours_charged) \
+    FIELD(TACHOMETER,           I32, 1, 1.0f,       INT32, tachometer) \
+    FIELD(TACHOMETER_ABS,       I32, 1, 1.0f,       INT32, tachometer_abs) \
+    FIELD(FAULT,                U8,  1, 1.0f,       ENUM,  fault)
+
+// COMM_GET_VALUES_SETUP(_SELECTIVE) -> vesc_setup_data_t. Names match VESC_SETUP_*.
+#define VESC_VALUES_SETUP_FIELDS(FIELD, SKIP) \
+    FIELD(TEMP_MOSFET,          I16, 1, 10.0f,      FLOAT, temp_mosfet) \
+    FIELD(TEMP_MOTOR,           I16, 1, 10.0f,      FLOAT, temp_motor) \
+    FIELD(MOTOR_CURRENT,        I32, 1, 100.0f,     FLOAT, motor_current) \
+    FIELD(INPUT_CURRENT,        I32, 1, 100.0f,     FLOAT, input_current) \
+    FIELD(DUTY_CYCLE,           I16, 1, 1000.0f,    FLOAT, duty_cycle) \
+    FIELD(RPM,                  I32, 1, 1.0f,       FLOAT, rpm) \
+    FIELD(SPEED,                I32, 1, 1000.0f,    FLOAT, speed) \
+    FIELD(INPUT_VOLTAGE,        I16, 1, 10.0f,      FLOAT, input_voltage) \
+    FIELD(BATTERY_LEVEL,        I16, 1, 1000.0f,    FLOAT, battery_level) \
+    FIELD(AMP_HOURS,            I32, 1, 10000.0f,   FLOAT, amp_hours) \
+    FIELD(AMP_HOURS_CHARGED,    I32, 1, 10000.0f,   FLOAT, amp_hours_charged) \
+    FIELD(WATT_HOURS,           I32, 1, 10000.0f,   FLOAT, watt_hours) \
+    FIELD(WATT_HOURS_CHARGED,   I32, 1, 10000.0f,   FLOAT, watt_hours_charged) \
+    FIELD(DISTANCE,             I32, 1, 1000.0f,    FLOAT, distance) \
+    FIELD(DISTANCE_ABS,         I32, 1, 1000.0f,    FLOAT, distance_abs) \
+    FIELD(PID_POS,              I32, 1, 1000000.0f, FLOAT, pid_pos) \
+    FIELD(FAULT,                U8,  1, 1.0f,       ENUM,  fault) \
+    FIELD(CONTROLLER_ID,        U8,  1, 1.0f,       UINT8, controller_id) \
+    FIELD(NUM_VESCS,            U8,  1, 1.0f,       UINT8, num_vescs) \
+    FIELD(BATTERY_WH,           I32, 1, 1000.0f,    FLOAT, battery_wh) \
+    FIELD(ODOMETER,             U32, 1, 1.0f,       UINT32, odometer) \
+    FIELD(UPTIME,               U32, 1, 1.0f,       UINT32, uptime_ms)
+
+// COMM_BMS_GET_VALUES -> vesc_bms_data_t. Later fields (charge totals,
+// pressure) vary between firmware releases and are not decoded.
+#define VESC_BMS_VALUES_FIELDS(FIELD, SKIP) \
+    FIELD(V_TOT,                I32, 1, 1000000.0f, FLOAT, v_tot) \
+    FIELD(V_CHARGE,             I32, 1, 1000000.0f, FLOAT, v_charge) \
+    FIELD(I_IN,                 I32, 1, 1000000.0f, FLOAT, i_in) \
+    FIELD(I_IN_IC,              I32, 1, 1000000.0f, FLOAT, i_in_ic) \
+    FIELD(AH_CNT,               I32, 1, 1000.0f,    FLOAT, ah_cnt) \
+    FIELD(WH_CNT,               I32, 1, 1000.0f,    FLOAT, wh_cnt) \
+    FIELD(CELL_NUM,             U8,  1, 1.0f,       COUNT, cell_num) \
+    FIELD(V_CELL,               I16, VESC_CODEC_COUNTED, 1000.0f, FLOAT, v_cell) \
+    FIELD(BAL_STATE,            U8,  VESC_CODEC_COUNTED, 1.0f,    UINT8, bal_state) \
+    FIELD(TEMP_NUM,             U8,  1, 1.0f,       COUNT, temp_num) \
+    FIELD(TEMPS,                I16, VESC_CODEC_COUNTED, 100.0f,  FLOAT, temps) \
+    FIELD(TEMP_IC,              I16, 1, 100.0f,     FLOAT, temp_ic) \
+    FIELD(TEMP_HUM,             I16, 1, 100.0f,     FLOAT, temp_hum) \
+    FIELD(HUMIDITY,             I16, 1, 100.0f,     FLOAT, humidity) \
+    FIELD(TEMP_MAX_CELL,        I16, 1, 100.0f,     FLOAT, temp_max_cell) \
+    FIELD(SOC,                  I16, 1, 1000.0f,    FLOAT, soc) \
+    FIELD(SOH,                  I16, 1, 1000.0f,    FLOAT, soh) \
+    FIELD(CAN_ID,               U8,  1, 1.0f,       UINT8, can_id)
+
+// [COMM_GET_MCCONF][signature][pwm/comm/motor/sensor mode][l_current_max]... -> vesc_limits_t
+#define VESC_MCCONF_LIMITS_FIELDS(FIELD, SKIP) \
+    FIELD(SIGNATURE,            U32, 1, 1.0f,       UINT32, mcconf_signature) \
+    SKIP (MODES,                U8,  4) \
+    FIELD(CURRENT_MAX,          F32_AUTO, 1, 1.0f,  FLOAT, current_max) \
+    FIELD(CURRENT_MIN,          F32_AUTO, 1, 1.0f,  FLOAT, current_min) \
+    FIELD(IN_CURRENT_MAX,       F32_AUTO, 1, 1.0f,  FLOAT, in_current_max) \
+    FIELD(IN_CURRENT_MIN,       F32_AUTO, 1, 1.0f,  FLOAT, in_current_min)
+
+// [COMM_GET_APPCONF][signature][controller_id][timeout_msec]... -> vesc_limits_t
+#define VESC_APPCONF_LIMITS_FIELDS(FIELD, SKIP) \
+    FIELD(SIGNATURE,            U32, 1, 1.0f,       UINT32, appconf_signature) \
+    FIELD(CONTROLLER_ID,        U8,  1, 1.0f,       UINT8, controller_id) \
+    FIELD(TIMEOUT,              U32, 1, 1.0f,       UINT32, timeout_ms)
+
+// CAN status broadcasts (no packet ID byte: it is in the extended CAN ID) -> vesc_data_t
+#define VESC_CAN_STATUS_1_FIELDS(FIELD, SKIP) \
+    FIELD(RPM,                  I32, 1, 1.0f,       INT32, rpm) \
+    FIELD(MOTOR_CURRENT,        I16, 1, 10.0f,      FX2,   avg_motor_current) \
+    FIELD(DUTY_CYCLE,           I16, 1, 1000.0f,    FX3,   duty_cycle)
+
+#define VESC_CAN_STATUS_2_FIELDS(FIELD, SKIP) \
+    FIELD(AMP_HOURS,            I32, 1, 10000.0f,   FX4,   amp_hours) \
+    FIELD(AMP_HOURS_CHARGED,    I32, 1, 10000.0f,   FX4,   amp_hours_charged)
+
+#define VESC_CAN_STATUS_3_FIELDS(FIELD, SKIP) \
+    FIELD(WATT_HOURS,           I32, 1, 10000.0f,   FX4,   watt_hours) \
+    FIELD(WATT_HOURS_CHARGED,   I32, 1, 10000.0f,   FX4,   watt_hours_charged)
+
+#define VESC_CAN_STATUS_4_FIELDS(FIELD, SKIP) \
+    FIELD(TEMP_MOSFET,          I16, 1, 10.0f,      FX1,   temp_mosfet) \
+    FIELD(TEMP_MOTOR,           I16, 1, 10.0f,      FX1,   temp_motor) \
+    FIELD(INPUT_CURRENT,        I16, 1, 10.0f,      FX2,   avg_input_current) \
+    FIELD(PID_POS,              I16, 1, 50.0f,      FX6,   pid_pos)
+
+#define VESC_CAN_STATUS_5_FIELDS(FIELD, SKIP) \
+    FIELD(TACHOMETER,           I32, 1, 1.0f,       INT32, tachometer) \
+    FIELD(INPUT_VOLTAGE,        I16, 1, 10.0f,      FX1,   input_voltage)
+
+#define VESC_CAN_STATUS_6_FIELDS(FIELD, SKIP) \
+    SKIP (ADC_PPM,              I16, 4)
+
+// Motor commands -> vesc_codec_setpoint_t
+#define VESC_SET_DUTY_FIELDS(FIELD, SKIP) \
+    FIELD(VALUE,                I32, 1, 100000.0f,  FLOAT, value)
+
+#define VESC_SET_CURRENT_FIELDS(FIELD, SKIP) \
+    FIELD(VALUE,                I32, 1, 1000.0f,    FLOAT, value)
+
+#define VESC_SET_CURRENT_REL_FIELDS(FIELD, SKIP) \
+    FIELD(VALUE,                I32, 1, 100000.0f,  FLOAT, value)
+
+#define VESC_SET_RPM_FIELDS(FIELD, SKIP) \
+    FIELD(VALUE,                I32, 1, 1.0f,       FLOAT, value)
+
+// Temporary motor limits -> vesc_mcconf_temp_t. Firmware before 5.x stops
+// reading after the power limits.
+#define VESC_SET_MCCONF_TEMP_FIELDS(FIELD, SKIP) \
+    FIELD(STORE,                U8,  1, 1.0f,       UINT8, store) \
+    FIELD(FORWARD_CAN,          U8,  1, 1.0f,       UINT8, forward_can) \
+    FIELD(ACK,                  U8,  1, 1.0f,       UINT8, ack) \
+    FIELD(DIVIDE,               U8,  1, 1.0f,       UINT8, divide_by_controllers) \
+    FIELD(CURRENT_MIN_SCALE,    F32_AUTO, 1, 1.0f,  FLOAT, current_min_scale) \
+    FIELD(CURRENT_MAX_SCALE,    F32_AUTO, 1, 1.0f,  FLOAT, current_max_scale) \
+    FIELD(ERPM_MIN,             F32_AUTO, 1, 1.0f,  FLOAT, erpm_min) \
+    FIELD(ERPM_MAX,             F32_AUTO, 1, 1.0f,  FLOAT, erpm_max) \
+    FIELD(DUTY_MIN,             F32_AUTO, 1, 1.0f,  FLOAT, duty_min) \
+    FIELD(DUTY_MAX,             F32_AUTO, 1, 1.0f,  FLOAT, duty_max) \
+    FIELD(WATT_MIN,             F32_AUTO, 1, 1.0f,  FLOAT, watt_min) \
+    FIELD(WATT_MAX,             F32_AUTO, 1, 1.0f,  FLOAT, watt_max) \
+    FIELD(IN_CURRENT_MIN,       F32_AUTO, 1, 1.0f,  FLOAT, in_current_min) \
+    FIELD(IN_CURRENT_MAX,       F32_AUTO, 1, 1.0f,  FLOAT, in_current_max)
+
+// Selective telemetry requests -> vesc_codec_mask_t
+#define VESC_MASK_REQUEST_FIELDS(FIELD, SKIP) \
+    FIELD(MASK,                 U32, 1, 1.0f,       UINT32, mask)
+
+#endif // VESC_CODEC_FIELDS_H
@@ -0,0 +1,187 @@
+/**
+ * @file vesc_config.c
+ * @brief VESC motor/app configuration limits, cached in NVS
+ */
+
+#include "vesc_config.h"
+#include "vesc_uart.h"
+#include "vesc_io.h"
+#include "vesc_codec.h"
+#include "vesc_caps.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include <string.h>
+
+static const char *TAG = "vesc_config";
+
+#define CACHE_KEY       "limits"
+#define CACHE_VERSION   1
+
+// NVS record
+typedef struct {
+    uint32_t version;
+    uint32_t identity_hash;
+    uint32_t config_hash;
+    vesc_limits_t limits;
+} vesc_config_cache_t;
+
+// Decoder state for one MCCONF + APPCONF read
+typedef struct {
+    vesc_limits_t limits;
+    uint32_t hash;
+} config_read_t;
+
+// [COMM_FW_VERSION][major][minor][hw name\0][uuid x12]...: hash the whole reply
+static int decode_identity(const uint8_t *message, uint16_t len, void *ctx) {
+    *(uint32_t *)ctx = esp_rom_crc32_le(0, message, len);
+    return 1;
+}
+
+// Leading MCCONF fields, see vesc_codec_fields.h
+static int decode_mcconf(const uint8_t *message, uint16_t len, void *ctx) {
+    config_read_t *read = (config_read_t *)ctx;
+
+    if (!vesc_codec_decode(&vesc_msg_mcconf_limits, message, len, &read->limits, NULL)) {
+        return 0;
+    }
+    read->hash = esp_rom_crc32_le(read->hash, message, len);
+    return 1;
+}
+
+// Leading APPCONF fields, see vesc_codec_fields.h
+static int decode_appconf(const uint8_t *message, uint16_t len, void *ctx) {
+    config_read_t *read = (config_read_t *)ctx;
+
+    if (!vesc_codec_decode(&vesc_msg_appconf_limits, message, len, &read->limits, NULL)) {
+        return 0;
+    }
+    read->hash = esp_rom_crc32_le(read->hash, message, len);
+    return 1;
+}
+
+static bool config_request(uint8_t comm, vesc_io_reply_view_t decode, void *ctx) {
+    uint8_t payload[1] = { comm };
+
+    for (int i = 0; i < VESC_CONFIG_ATTEMPTS; i++) {
+        vesc_io_future_t future;
+        if (vesc_io_request_future_long(&future, payload, sizeof(payload), comm, VESC_CONFIG_REPLY_MAX,
+                                        decode, ctx) == ESP_OK &&
+            vesc_io_future_wait(&future) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool config_read_full(config_read_t *read) {
+    memset(read, 0, sizeof(*read));
+    return config_request(COMM_GET_MCCONF, decode_mcconf, read) &&
+           config_request(COMM_GET_APPCONF, decode_appconf, read);
+}
+
+static bool cache_load(vesc_config_cache_t *cache) {
+    nvs_handle_t nvs;
+    if (nvs_open(VESC_CONFIG_NVS_NS, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    size_t size = sizeof(*cache);
+    esp_err_t ret = nvs_get_blob(nvs, CACHE_KEY, cache, &size);
+    nvs_close(nvs);
+    return ret == ESP_OK && size == sizeof(*cache) && cache->version == CACHE_VERSION;
+}
+
+static void cache_store(const vesc_config_cache_t *cache) {
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(VESC_CONFIG_NVS_NS, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(nvs, CACHE_KEY, cache, sizeof(*cache));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Config cache not saved: %s", esp_err_to_name(ret));
+    }
+}
+
+static void config_log(const char *what, const vesc_limits_t *limits) {
+    ESP_LOGI(TAG, "%s: motor %.1f/%.1f A, battery %.1f/%.1f A, id %u, timeout %lu ms",
+             what, limits->current_max, limits->current_min,
+             limits->in_current_max, limits->in_current_min,
+             limits->controller_id, (unsigned long)limits->timeout_ms);
+}
+
+esp_err_t vesc_config_load(vesc_limits_t *limits, vesc_config_source_t *source) {
+    vesc_config_cache_t cache;
+    uint32_t identity;
+
+    vesc_caps_t caps;
+
+    if (limits == NULL) return ESP_ERR_INVALID_ARG;
+    if (source) *source = VESC_CONFIG_NONE;
+    if (!vesc_caps_has(VESC_CAP_CONFIG)) return ESP_ERR_NOT_SUPPORTED;
+
+    // The handshake already read COMM_FW_VERSION
+    if (vesc_caps_get(&caps)) {
+        identity = caps.identity_hash;
+    } else if (!config_request(COMM_FW_VERSION, decode_identity, &identity)) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    if (cache_load(&cache) && cache.identity_hash == identity) {
+        *limits = cache.limits;
+        if (source) *source = VESC_CONFIG_CACHED;
+        config_log("Cached limits", limits);
+        return ESP_OK;
+    }
+
+    config_read_t read;
+    if (!config_read_full(&read)) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    cache.version = CACHE_VERSION;
+    cache.identity_hash = identity;
+    cache.config_hash = read.hash;
+    cache.limits = read.limits;
+    cache_store(&cache);
+
+    *limits = read.limits;
+    if (source) *source = VESC_CONFIG_FETCHED;
+    config_log("Read limits", limits);
+    return ESP_OK;
+}
+
+esp_err_t vesc_config_refresh(vesc_limits_t *limits, bool *changed) {
+    vesc_config_cache_t cache;
+    uint32_t identity;
+    config_read_t read;
+
+    if (limits == NULL || changed == NULL) return ESP_ERR_INVALID_ARG;
+    *changed = false;
+    if (!vesc_caps_has(VESC_CAP_CONFIG)) return ESP_ERR_NOT_SUPPORTED;
+
+    if (!config_request(COMM_FW_VERSION, decode_identity, &identity) || !config_read_full(&read)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    *limits = read.limits;
+
+    bool cached = cache_load(&cache);
+    if (cached && cache.identity_hash == identity && cache.config_hash == read.hash) {
+        return ESP_OK;
+    }
+
+    *changed = !cached || memcmp(&cache.limits, &read.limits, sizeof(read.limits)) != 0;
+    cache.version = CACHE_VERSION;
+    cache.identity_hash = identity;
+    cache.config_hash = read.hash;
+    cache.limits = read.limits;
+    cache_store(&cache);
+
+    if (*changed) {
+        config_log("Limits changed", limits);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file vesc_config.h
+ * @brief VESC motor/app configuration limits, cached in NVS
+ *
+ * The limits the controller needs (motor and battery current limits,
+ * controller ID, app timeout) are decoded from COMM_GET_MCCONF and
+ * COMM_GET_APPCONF. Only the leading fields are decoded; their layout is
+ * the same across firmware releases, and the config signature is kept
+ * with them.
+ *
+ * The decoded subset is cached in NVS with two hashes:
+ * - the identity hash: CRC32 of the COMM_FW_VERSION reply, which carries
+ *   the firmware version, hardware name and MCU UUID
+ * - the config hash: CRC32 of the full MCCONF and APPCONF replies
+ *
+ * The VESC has no command that returns a config hash, so at boot only the
+ * short COMM_FW_VERSION reply is read. If its hash matches the cache, the
+ * cached limits are used. vesc_config_refresh() then re-reads the full
+ * configuration in the background and compares config hashes, to catch
+ * changes made in VESC Tool. When vesc_caps_handshake() has run, its
+ * cached COMM_FW_VERSION reply is used and no request is needed at all.
+ *
+ * Firmware older than VESC_FW_CONFIG has a different config layout and is
+ * not read (ESP_ERR_NOT_SUPPORTED).
+ */
+
+#ifndef VESC_CONFIG_H
+#define VESC_CONFIG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "vesc_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_CONFIG_ATTEMPTS    3       // Tries per configuration read
+#define VESC_CONFIG_REPLY_MAX   VESC_FRAME_MAX_PAYLOAD  // MCCONF/APPCONF run to 400-700 bytes by firmware
+#define VESC_CONFIG_NVS_NS      "vesc_cfg"
+
+// Decoded configuration subset
+typedef struct {
+    uint32_t mcconf_signature;
+    uint32_t appconf_signature;
+    float current_max;          // l_current_max (A)
+    float current_min;          // l_current_min (A, negative = braking)
+    float in_current_max;       // l_in_current_max (A)
+    float in_current_min;       // l_in_current_min (A, negative = regen)
+    uint8_t controller_id;      // App controller_id
+    uint32_t timeout_ms;        // App timeout_msec
+} vesc_limits_t;
+
+typedef enum {
+    VESC_CONFIG_NONE = 0,       // Nothing read, limits unknown
+    VESC_CONFIG_CACHED,         // From NVS, identity hash matched
+    VESC_CONFIG_FETCHED,        // Read from the VESC
+} vesc_config_source_t;
+
+/**
+ * @brief Get the limits of the UART VESC, from the cache when possible
+ *
+ * Blocks for up to a few request timeouts. Call after vesc_link_start().
+ *
+ * @param limits Output
+ * @param source Output: where the limits came from (may be NULL)
+ * @return ESP_OK, ESP_ERR_TIMEOUT if the VESC did not answer, or
+ *         ESP_ERR_NOT_SUPPORTED for firmware without VESC_CAP_CONFIG
+ */
+esp_err_t vesc_config_load(vesc_limits_t *limits, vesc_config_source_t *source);
+
+/**
+ * @brief Re-read the full configuration and update the cache if it changed
+ * @param limits  Output: current limits
+ * @param changed Output: true if they differ from the cached ones
+ * @return ESP_OK, ESP_ERR_TIMEOUT if the VESC did not answer, or
+ *         ESP_ERR_NOT_SUPPORTED for firmware without VESC_CAP_CONFIG
+ */
+esp_err_t vesc_config_refresh(vesc_limits_t *limits, bool *changed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_CONFIG_H
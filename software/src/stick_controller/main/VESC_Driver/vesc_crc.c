@@ -0,0 +1,202 @@
+/**
+ * @file vesc_crc.c
+ * @brief CRC16-CCITT (XModem) kernels for the VESC protocol
+ */
+
+#include "vesc_crc.h"
+#include <stddef.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_rom_crc.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+
+static const char *TAG = "vesc_crc";
+#endif
+
+// Byte-wise lookup table, also slice 0 of the slicing-by-4 tables
+static const uint16_t crc16_tab[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+    0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+    0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+    0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+    0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+    0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+    0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+    0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+    0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+    0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+    0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+    0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+    0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+    0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+    0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+    0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+    0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+    0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+    0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+    0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+    0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+    0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
+
+// crc16_slice[k][b]: CRC of byte b followed by k + 1 zero bytes
+static uint16_t crc16_slice[3][256];
+static bool slice_ready = false;
+
+static vesc_crc_kernel_t active_kernel = VESC_CRC_KERNEL_BYTEWISE;
+static vesc_crc_bench_t bench[VESC_CRC_KERNEL_COUNT];
+
+static uint16_t crc16_bytewise(uint16_t crc, const uint8_t *buf, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        crc = crc16_tab[((crc >> 8) ^ buf[i]) & 0xFF] ^ (uint16_t)(crc << 8);
+    }
+    return crc;
+}
+
+static void crc16_build_slices(void) {
+    for (int b = 0; b < 256; b++) {
+        uint16_t crc = crc16_tab[b];
+        for (int k = 0; k < 3; k++) {
+            crc = crc16_tab[crc >> 8] ^ (uint16_t)(crc << 8);
+            crc16_slice[k][b] = crc;
+        }
+    }
+    slice_ready = true;
+}
+
+// The 16-bit CRC folds into the first two bytes of each block; the last two
+// bytes only contribute through their own tables
+static uint16_t crc16_slice4(uint16_t crc, const uint8_t *buf, uint32_t len) {
+    while (len >= 4) {
+        uint16_t x = crc ^ (uint16_t)((buf[0] << 8) | buf[1]);
+        crc = crc16_slice[2][x >> 8] ^ crc16_slice[1][x & 0xFF] ^
+              crc16_slice[0][buf[2]] ^ crc16_tab[buf[3]];
+        buf += 4;
+        len -= 4;
+    }
+    return crc16_bytewise(crc, buf, len);
+}
+
+#ifdef ESP_PLATFORM
+// The ROM routine inverts the CRC on entry and exit; undo both for XModem
+static uint16_t crc16_rom(uint16_t crc, const uint8_t *buf, uint32_t len) {
+    return (uint16_t)~esp_rom_crc16_be((uint16_t)~crc, buf, len);
+}
+#endif
+
+uint16_t vesc_crc16_kernel(vesc_crc_kernel_t kernel, uint16_t crc, const uint8_t *buf, uint32_t len) {
+    switch (kernel) {
+        case VESC_CRC_KERNEL_BYTEWISE:
+            return crc16_bytewise(crc, buf, len);
+        case VESC_CRC_KERNEL_SLICE4:
+            return slice_ready ? crc16_slice4(crc, buf, len) : crc16_bytewise(crc, buf, len);
+#ifdef ESP_PLATFORM
+        case VESC_CRC_KERNEL_ROM:
+            return crc16_rom(crc, buf, len);
+#endif
+        default:
+            return crc;
+    }
+}
+
+uint16_t vesc_crc16_update(uint16_t crc, const uint8_t *buf, uint32_t len) {
+    return vesc_crc16_kernel(active_kernel, crc, buf, len);
+}
+
+uint16_t vesc_crc16(const uint8_t *buf, uint32_t len) {
+    return vesc_crc16_update(0, buf, len);
+}
+
+// Check vector, plus a split run so incremental use is covered too
+static bool crc_kernel_check(vesc_crc_kernel_t kernel, const uint8_t *ref, uint32_t ref_len, uint16_t ref_crc) {
+    static const uint8_t check[] = "123456789";
+
+    if (vesc_crc16_kernel(kernel, 0, check, 9) != VESC_CRC_CHECK_VALUE) {
+        return false;
+    }
+    uint16_t crc = vesc_crc16_kernel(kernel, 0, ref, 7);
+    crc = vesc_crc16_kernel(kernel, crc, ref + 7, ref_len - 7);
+    return crc == ref_crc;
+}
+
+#ifdef ESP_PLATFORM
+static uint32_t crc_kernel_bench(vesc_crc_kernel_t kernel, const uint8_t *buf, uint32_t len) {
+    uint32_t best = UINT32_MAX;
+    volatile uint16_t sink = 0;
+
+    for (int r = 0; r < VESC_CRC_BENCH_ROUNDS; r++) {
+        uint32_t start = esp_cpu_get_cycle_count();
+        sink ^= vesc_crc16_kernel(kernel, 0, buf, len);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    (void)sink;
+    return (uint32_t)(((uint64_t)best * 100) / len);
+}
+#endif
+
+vesc_crc_kernel_t vesc_crc_init(void) {
+    static bool done = false;
+    uint8_t buf[VESC_CRC_BENCH_LEN];
+
+    if (done) {
+        return active_kernel;
+    }
+    crc16_build_slices();
+
+    // Frame-like data, with an odd tail so the slicing kernel's remainder runs too
+    for (int i = 0; i < VESC_CRC_BENCH_LEN; i++) {
+        buf[i] = (uint8_t)(i * 167 + 13);
+    }
+    uint32_t ref_len = VESC_CRC_BENCH_LEN - 3;
+    uint16_t ref_crc = crc16_bytewise(0, buf, ref_len);
+
+    vesc_crc_kernel_t best = VESC_CRC_KERNEL_BYTEWISE;
+    for (int k = 0; k < VESC_CRC_KERNEL_COUNT; k++) {
+        bench[k].valid = crc_kernel_check((vesc_crc_kernel_t)k, buf, ref_len, ref_crc);
+        bench[k].cycles_x100_per_byte = 0;
+#ifdef ESP_PLATFORM
+        if (bench[k].valid) {
+            bench[k].cycles_x100_per_byte = crc_kernel_bench((vesc_crc_kernel_t)k, buf, VESC_CRC_BENCH_LEN);
+            if (bench[k].cycles_x100_per_byte < bench[best].cycles_x100_per_byte) {
+                best = (vesc_crc_kernel_t)k;
+            }
+        }
+        ESP_LOGI(TAG, "Kernel %d: %s, %lu.%02lu cycles/byte", k, bench[k].valid ? "ok" : "FAILED",
+                 (unsigned long)(bench[k].cycles_x100_per_byte / 100),
+                 (unsigned long)(bench[k].cycles_x100_per_byte % 100));
+#else
+        // No cycle counter off-target: prefer slicing when it checks out
+        if (bench[k].valid && k == VESC_CRC_KERNEL_SLICE4) {
+            best = VESC_CRC_KERNEL_SLICE4;
+        }
+#endif
+    }
+
+    active_kernel = best;
+    done = true;
+    return active_kernel;
+}
+
+vesc_crc_kernel_t vesc_crc_get_kernel(void) {
+    return active_kernel;
+}
+
+void vesc_crc_get_bench(vesc_crc_kernel_t kernel, vesc_crc_bench_t *result) {
+    if (kernel < VESC_CRC_KERNEL_COUNT) {
+        *result = bench[kernel];
+    }
+}
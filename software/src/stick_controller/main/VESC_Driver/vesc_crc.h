@@ -0,0 +1,100 @@
+/**
+ * @file vesc_crc.h
+ * @brief CRC16-CCITT (XModem) kernels for the VESC protocol
+ *
+ * Three interchangeable kernels compute the same CRC (poly 0x1021, init 0,
+ * no reflection, no final XOR):
+ * - byte-wise table lookup (the reference, always available)
+ * - slicing-by-4, four table lookups per 4 input bytes
+ * - the ESP32 ROM crc16_be routine
+ *
+ * vesc_crc_init() checks each kernel against the standard check vector,
+ * times them on a frame-sized buffer and routes vesc_crc16_update() to the
+ * fastest correct one. Until then the byte-wise kernel is used.
+ */
+
+#ifndef VESC_CRC_H
+#define VESC_CRC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_CRC_CHECK_VALUE    0x31C3  // CRC of "123456789"
+#define VESC_CRC_BENCH_LEN      256     // Bytes per benchmark pass
+#define VESC_CRC_BENCH_ROUNDS   16      // Passes per kernel (best one is kept)
+
+// Available kernels
+typedef enum {
+    VESC_CRC_KERNEL_BYTEWISE = 0,
+    VESC_CRC_KERNEL_SLICE4,
+    VESC_CRC_KERNEL_ROM,
+    VESC_CRC_KERNEL_COUNT,
+} vesc_crc_kernel_t;
+
+// Benchmark result for one kernel
+typedef struct {
+    bool valid;                     // Passed the check vector
+    uint32_t cycles_x100_per_byte;  // CPU cycles per byte x100 (0 if not measured)
+} vesc_crc_bench_t;
+
+/**
+ * @brief Continue a CRC over more data
+ *
+ * Lets a CRC be built up as bytes arrive: start from 0 and feed each chunk
+ * with the previous result.
+ *
+ * @param crc CRC so far (0 for a new frame)
+ * @param buf Data
+ * @param len Data length
+ * @return Updated CRC
+ */
+uint16_t vesc_crc16_update(uint16_t crc, const uint8_t *buf, uint32_t len);
+
+/**
+ * @brief CRC16 of a complete buffer
+ * @param buf Data
+ * @param len Data length
+ * @return CRC value
+ */
+uint16_t vesc_crc16(const uint8_t *buf, uint32_t len);
+
+/**
+ * @brief Run one specific kernel
+ * @param kernel Kernel to use
+ * @param crc    CRC so far
+ * @param buf    Data
+ * @param len    Data length
+ * @return Updated CRC, or crc unchanged if the kernel is not available
+ */
+uint16_t vesc_crc16_kernel(vesc_crc_kernel_t kernel, uint16_t crc, const uint8_t *buf, uint32_t len);
+
+/**
+ * @brief Build the slicing tables, verify and benchmark the kernels, pick the fastest
+ *
+ * Safe to call more than once; only the first call does the work.
+ *
+ * @return Kernel selected for vesc_crc16_update()
+ */
+vesc_crc_kernel_t vesc_crc_init(void);
+
+/**
+ * @brief Kernel currently used by vesc_crc16_update()
+ */
+vesc_crc_kernel_t vesc_crc_get_kernel(void);
+
+/**
+ * @brief Benchmark results from vesc_crc_init()
+ * @param kernel Kernel to query
+ * @param result Output
+ */
+void vesc_crc_get_bench(vesc_crc_kernel_t kernel, vesc_crc_bench_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_CRC_H
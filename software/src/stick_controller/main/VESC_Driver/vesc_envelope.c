@@ -0,0 +1,256 @@
+/**
+ * @file vesc_envelope.c
+ * @brief Speed-level limits enforced by the VESC (COMM_SET_MCCONF_TEMP)
+ */
+
+#include "vesc_envelope.h"
+#include "vesc_uart.h"
+#include "vesc_codec.h"
+#include "vesc_caps.h"
+#include "vesc_io.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdatomic.h>
+#include <string.h>
+
+static const char *TAG = "vesc_envelope";
+
+#define ENVELOPE_RETRY_US       (100 * 1000)    // Pause before a push that was not acked is sent again
+#define ENVELOPE_DUTY_MIN       0.005f          // VESC Tool default l_min_duty
+
+// Envelope handed over by vesc_envelope_set(), its only writer. seq is odd
+// while it is being filled in; the pusher takes it when seq has moved on.
+static struct {
+    atomic_uint seq;
+    vesc_envelope_t envelope;
+} env_slot;
+
+// Pushes run on the esp_timer task only (env_timer), one at a time, so
+// they reach the wire in generation order and the last ack is the envelope
+// in force. env_lock guards the rest against the I/O engine callback and
+// vesc_task.
+static portMUX_TYPE env_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t env_timer = NULL;
+static atomic_bool env_restart = false; // New limits or a reconnect: push with fresh attempts
+static atomic_int env_state = VESC_ENVELOPE_IDLE;
+static unsigned env_seen = 0;           // env_slot.seq last taken, pusher only
+static bool env_forward_can = false;
+static bool env_have_limits = false;
+static bool env_have_envelope = false;
+static vesc_limits_t env_limits;
+static vesc_envelope_t env_wanted;
+static uint32_t env_generation = 0;     // Bumped by every change; acks of older pushes are ignored
+static int env_attempts = 0;
+static bool env_retry_due = false;      // Last push not acked, attempts left
+static vesc_envelope_stats_t env_stats;
+
+static float clampf(float value, float lo, float hi) {
+    return value < lo ? lo : (value > hi ? hi : value);
+}
+
+// Call with env_lock held
+static void envelope_build(vesc_mcconf_temp_t *temp) {
+    memset(temp, 0, sizeof(*temp));
+    temp->forward_can = env_forward_can;
+    temp->ack = 1;
+    temp->current_min_scale = 1.0f;     // Braking stays at the VESC config
+    temp->current_max_scale = clampf(env_wanted.current_max / env_limits.current_max, 0.0f, 1.0f);
+    temp->erpm_min = -env_wanted.erpm_max;
+    temp->erpm_max = env_wanted.erpm_max;
+    temp->duty_min = ENVELOPE_DUTY_MIN;
+    temp->duty_max = clampf(env_wanted.duty_max, ENVELOPE_DUTY_MIN, 0.95f);
+    temp->watt_min = -env_wanted.watt_max;
+    temp->watt_max = env_wanted.watt_max;
+    temp->in_current_min = env_limits.in_current_min;
+    temp->in_current_max = env_limits.in_current_max;
+}
+
+// Run the pusher now; a retry waiting on the timer is brought forward
+static void envelope_kick(void) {
+    esp_timer_stop(env_timer);
+    esp_timer_start_once(env_timer, 0);
+}
+
+static void envelope_done(esp_err_t status, const uint8_t *payload, uint16_t len, void *ctx) {
+    (void)payload;
+    (void)len;
+    uint32_t generation = (uint32_t)(uintptr_t)ctx;
+    bool retry = false;
+
+    portENTER_CRITICAL(&env_lock);
+    if (generation == env_generation) {
+        if (status == ESP_OK) {
+            env_stats.acks++;
+            atomic_store(&env_state, VESC_ENVELOPE_ACTIVE);
+        } else {
+            env_stats.timeouts++;
+            retry = env_attempts < VESC_ENVELOPE_ATTEMPTS;
+            env_retry_due = retry;
+            if (!retry) {
+                atomic_store(&env_state, VESC_ENVELOPE_FAILED);
+            }
+        }
+    }
+    portEXIT_CRITICAL(&env_lock);
+
+    // Not from here: this runs in the I/O engine task, which must not build pushes
+    if (retry) {
+        esp_timer_start_once(env_timer, ENVELOPE_RETRY_US);
+    }
+}
+
+// Copy out the envelope if vesc_envelope_set() has handed over a new one.
+// Never waits for the writer: one caught half-written is taken by the kick
+// that follows it.
+static bool envelope_take_wanted(void) {
+    vesc_envelope_t envelope;
+    unsigned before = atomic_load_explicit(&env_slot.seq, memory_order_acquire);
+    if (before == env_seen || (before & 1)) {
+        return false;
+    }
+
+    envelope = env_slot.envelope;
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&env_slot.seq, memory_order_relaxed) != before) {
+        return false;
+    }
+    env_seen = before;
+
+    portENTER_CRITICAL(&env_lock);
+    env_wanted = envelope;
+    env_have_envelope = true;
+    portEXIT_CRITICAL(&env_lock);
+    return true;
+}
+
+// Send the wanted envelope. restart starts a new generation with fresh attempts.
+static void envelope_push(bool restart) {
+    vesc_mcconf_temp_t temp;
+    uint8_t payload[VESC_IO_MAX_PAYLOAD];
+    vesc_caps_t caps;
+
+    // Nothing is sent before the handshake has confirmed the firmware
+    if (!vesc_caps_get(&caps)) return;
+    if (!(caps.flags & VESC_CAP_MCCONF_TEMP)) {
+        if (atomic_exchange(&env_state, VESC_ENVELOPE_UNSUPPORTED) != VESC_ENVELOPE_UNSUPPORTED) {
+            ESP_LOGW(TAG, "Firmware has no COMM_SET_MCCONF_TEMP, speed levels enforced by setpoint only");
+        }
+        return;
+    }
+
+    portENTER_CRITICAL(&env_lock);
+    if (!env_have_limits || !env_have_envelope) {
+        atomic_store(&env_state, VESC_ENVELOPE_IDLE);
+        portEXIT_CRITICAL(&env_lock);
+        return;
+    }
+    if (restart) {
+        env_generation++;
+        env_attempts = 0;
+    }
+    env_attempts++;
+    env_retry_due = false;
+    env_stats.pushes++;
+    atomic_store(&env_state, VESC_ENVELOPE_PENDING);
+    uint32_t generation = env_generation;
+    envelope_build(&temp);
+    portEXIT_CRITICAL(&env_lock);
+
+    int32_t len = vesc_codec_encode(&vesc_msg_set_mcconf_temp, &temp, 0, payload, sizeof(payload));
+    esp_err_t ret = (len > 0) ? vesc_io_request(payload, (uint16_t)len, COMM_SET_MCCONF_TEMP,
+                                                envelope_done, (void *)(uintptr_t)generation)
+                              : ESP_ERR_INVALID_SIZE;
+    if (ret != ESP_OK) {
+        // Queue full: counts as an unanswered send
+        envelope_done(ret, NULL, 0, (void *)(uintptr_t)generation);
+    }
+}
+
+// The pusher: a new envelope or new limits start over, an unacked push is retried
+static void envelope_run(void *arg) {
+    (void)arg;
+    bool restart = atomic_exchange(&env_restart, false);
+    if (envelope_take_wanted()) {
+        restart = true;
+    }
+
+    portENTER_CRITICAL(&env_lock);
+    bool retry = env_retry_due;
+    portEXIT_CRITICAL(&env_lock);
+
+    if (restart || retry) {
+        envelope_push(restart);
+    }
+}
+
+void vesc_envelope_init(bool forward_can) {
+    if (env_timer != NULL) return;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = envelope_run,
+        .name = "vesc_envelope",
+    };
+    if (esp_timer_create(&timer_args, &env_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Push timer create failed");
+        env_timer = NULL;
+        return;
+    }
+
+    portENTER_CRITICAL(&env_lock);
+    env_forward_can = forward_can;
+    memset(&env_stats, 0, sizeof(env_stats));
+    portEXIT_CRITICAL(&env_lock);
+}
+
+void vesc_envelope_set_limits(const vesc_limits_t *limits) {
+    if (limits == NULL || env_timer == NULL) return;
+    if (!(limits->current_max > 0.0f)) {
+        ESP_LOGW(TAG, "VESC reports no usable l_current_max, envelope not pushed");
+        return;
+    }
+
+    portENTER_CRITICAL(&env_lock);
+    env_limits = *limits;
+    env_have_limits = true;
+    portEXIT_CRITICAL(&env_lock);
+
+    atomic_store(&env_restart, true);
+    envelope_kick();
+}
+
+void vesc_envelope_set(const vesc_envelope_t *envelope) {
+    if (envelope == NULL || env_timer == NULL) return;
+
+    // Already handed over and pushed (or on its way): nothing to do
+    int state = atomic_load(&env_state);
+    if (atomic_load_explicit(&env_slot.seq, memory_order_relaxed) != 0 &&
+        memcmp(&env_slot.envelope, envelope, sizeof(*envelope)) == 0 &&
+        (state == VESC_ENVELOPE_PENDING || state == VESC_ENVELOPE_ACTIVE)) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&env_slot.seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    env_slot.envelope = *envelope;
+    atomic_fetch_add_explicit(&env_slot.seq, 1, memory_order_release);
+
+    envelope_kick();
+}
+
+void vesc_envelope_invalidate(void) {
+    if (env_timer == NULL) return;
+
+    atomic_store(&env_restart, true);
+    envelope_kick();
+}
+
+void vesc_envelope_get_stats(vesc_envelope_stats_t *stats) {
+    if (stats == NULL) return;
+
+    portENTER_CRITICAL(&env_lock);
+    *stats = env_stats;
+    portEXIT_CRITICAL(&env_lock);
+    stats->state = (vesc_envelope_state_t)atomic_load(&env_state);
+}
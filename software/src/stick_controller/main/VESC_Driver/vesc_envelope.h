@@ -0,0 +1,95 @@
+/**
+ * @file vesc_envelope.h
+ * @brief Speed-level limits enforced by the VESC (COMM_SET_MCCONF_TEMP)
+ *
+ * The setpoint scheduler only tells the VESC what to do; the envelope tells
+ * it what it may do. Each envelope is pushed as temporary motor limits, so
+ * the VESC current loop clamps the motor to it no matter which setpoint
+ * arrives or how late.
+ *
+ * The envelope current is sent as a share of the VESC's l_current_max, so
+ * the configured limits (vesc_config) must be known first. The eRPM, duty
+ * and power ceilings are absolute and replace the VESC Tool values while
+ * the envelope is active. The limits are not stored: a rebooted VESC is
+ * back on its own config, so the envelope is pushed again after a
+ * reconnect (vesc_envelope_invalidate()).
+ *
+ * Nothing here blocks. Pushes are built and queued on the esp_timer task;
+ * the calls below only hand over what to push and kick it. Pushes are
+ * acked by the VESC and retried up to VESC_ENVELOPE_ATTEMPTS times;
+ * firmware without VESC_CAP_MCCONF_TEMP is never sent one.
+ */
+
+#ifndef VESC_ENVELOPE_H
+#define VESC_ENVELOPE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "vesc_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_ENVELOPE_ATTEMPTS  3       // Sends per push before waiting for the next change or reconnect
+
+typedef struct {
+    float current_max;          // Motor current ceiling (A), clamped to l_current_max
+    float erpm_max;             // |eRPM| ceiling
+    float duty_max;             // Duty cycle ceiling (0.0 - 0.95)
+    float watt_max;             // |Motor power| ceiling (W)
+} vesc_envelope_t;
+
+typedef enum {
+    VESC_ENVELOPE_IDLE = 0,     // Nothing to push yet (no envelope or no limits)
+    VESC_ENVELOPE_UNSUPPORTED,  // Firmware without VESC_CAP_MCCONF_TEMP
+    VESC_ENVELOPE_PENDING,      // Sent, waiting for the ack
+    VESC_ENVELOPE_ACTIVE,       // Acked by the VESC
+    VESC_ENVELOPE_FAILED,       // Not acked after VESC_ENVELOPE_ATTEMPTS sends
+} vesc_envelope_state_t;
+
+typedef struct {
+    vesc_envelope_state_t state;
+    uint32_t pushes;            // Frames sent
+    uint32_t acks;
+    uint32_t timeouts;
+} vesc_envelope_stats_t;
+
+/**
+ * @brief Set how the envelope is pushed
+ * @param forward_can Also apply it to every VESC on the CAN bus of the UART VESC
+ */
+void vesc_envelope_init(bool forward_can);
+
+/**
+ * @brief Set the configured limits of the VESC and push the envelope again
+ * @param limits From vesc_config_load() / vesc_config_refresh()
+ */
+void vesc_envelope_set_limits(const vesc_limits_t *limits);
+
+/**
+ * @brief Change the envelope. Sent at once unless it is already active.
+ *
+ * Lock-free, for the control loop. Call from one task.
+ *
+ * @param envelope New envelope
+ */
+void vesc_envelope_set(const vesc_envelope_t *envelope);
+
+/**
+ * @brief Push the envelope again, e.g. after the VESC may have rebooted
+ */
+void vesc_envelope_invalidate(void);
+
+/**
+ * @brief Get the push state and counters
+ * @param stats Output
+ */
+void vesc_envelope_get_stats(vesc_envelope_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_ENVELOPE_H
@@ -0,0 +1,33 @@
+/**
+ * @file vesc_fixed.c
+ * @brief Scaled-integer telemetry values
+ */
+
+#include "vesc_fixed.h"
+#include <stdio.h>
+#include <stdbool.h>
+
+int vesc_fx_format(char *buf, size_t size, int32_t raw, int32_t scale, int decimals) {
+    uint32_t step = (uint32_t)scale;       // Scaled units per shown digit
+    uint32_t unit = 1;                      // 10^shown
+    int shown = 0;
+
+    while (shown < decimals && step >= 10) {
+        step /= 10;
+        unit *= 10;
+        shown++;
+    }
+
+    bool neg = raw < 0;
+    uint32_t mag = neg ? (uint32_t)0 - (uint32_t)raw : (uint32_t)raw;
+    mag = mag / step + (mag % step >= (step + 1) / 2 ? 1 : 0);
+
+    unsigned long whole = (unsigned long)(mag / unit);
+    unsigned long frac = (unsigned long)(mag % unit);
+    const char *sign = (neg && mag != 0) ? "-" : "";
+
+    if (shown == 0) {
+        return snprintf(buf, size, "%s%lu", sign, whole);
+    }
+    return snprintf(buf, size, "%s%lu.%0*lu", sign, whole, shown, frac);
+}
@@ -0,0 +1,59 @@
+/**
+ * @file vesc_fixed.h
+ * @brief Scaled-integer telemetry values
+ *
+ * The VESC sends telemetry as integers times a power of ten. They are kept
+ * that way from the wire to the display: a vesc_fxN_t holds the value
+ * times 10^N, so the scale is part of the type name and decoding is only a
+ * byte swap (and a multiply when a CAN frame carries fewer digits).
+ * Convert to real units only where they are needed, with VESC_FX_TO_FLOAT()
+ * or vesc_fx_format().
+ *
+ * VESC_FX_TO_FLOAT() gives the same float, bit for bit, as the firmware's
+ * division of the wire integer by its scale: always for a field kept at its
+ * wire scale, and for a multiplied-up CAN field while the scaled integer is
+ * exact as a float (the PID position of CAN status 3 within +-360 degrees).
+ * test/test_fixed.c checks both.
+ */
+
+#ifndef VESC_FIXED_H
+#define VESC_FIXED_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int32_t vesc_fx1_t;     // x 10
+typedef int32_t vesc_fx2_t;     // x 100
+typedef int32_t vesc_fx3_t;     // x 1000
+typedef int32_t vesc_fx4_t;     // x 10000
+typedef int32_t vesc_fx6_t;     // x 1000000
+
+#define VESC_FX1_SCALE  10
+#define VESC_FX2_SCALE  100
+#define VESC_FX3_SCALE  1000
+#define VESC_FX4_SCALE  10000
+#define VESC_FX6_SCALE  1000000
+
+// Real value of a scaled integer, e.g. VESC_FX_TO_FLOAT(data.input_voltage, VESC_FX1_SCALE)
+#define VESC_FX_TO_FLOAT(raw, scale)    ((float)(raw) / (float)(scale))
+
+/**
+ * @brief Format a scaled integer as a decimal number, without float printf
+ * @param buf      Output buffer
+ * @param size     Output buffer size
+ * @param raw      Scaled value
+ * @param scale    Its VESC_FXn_SCALE
+ * @param decimals Digits after the point (0 - n); the rest is rounded half away from zero
+ * @return Characters written, as snprintf()
+ */
+int vesc_fx_format(char *buf, size_t size, int32_t raw, int32_t scale, int decimals);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_FIXED_H
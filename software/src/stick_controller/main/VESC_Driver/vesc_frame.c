@@ -0,0 +1,238 @@
+/**
+ * @file vesc_frame.c
+ * @brief Incremental VESC packet framing and parsing
+ */
+
+#include "vesc_frame.h"
+#include <string.h>
+
+void vesc_frame_parser_init(vesc_frame_parser_t *parser, vesc_frame_cb_t on_frame, void *ctx) {
+    memset(parser, 0, sizeof(*parser));
+    parser->on_frame = on_frame;
+    parser->ctx = ctx;
+    parser->state = VESC_FRAME_WAIT_START;
+}
+
+void vesc_frame_parser_reset(vesc_frame_parser_t *parser) {
+    parser->state = VESC_FRAME_WAIT_START;
+    parser->len = 0;
+    parser->count = 0;
+    parser->len_bytes = 0;
+    parser->raw_len = 0;
+}
+
+void vesc_frame_parser_set_long_max(vesc_frame_parser_t *parser, uint32_t long_max) {
+    parser->long_max = long_max < VESC_FRAME_MAX_PAYLOAD ? long_max : VESC_FRAME_MAX_PAYLOAD;
+}
+
+// Shortest and longest payload a frame with this start byte may carry. The
+// sender always uses the shortest length encoding, so e.g. a 16-bit length
+// under 256 is noise.
+static uint32_t frame_len_min(uint8_t start) {
+    return start == 2 ? 1 : 1UL << (8 * (start - 2));
+}
+
+static uint32_t frame_len_max(const vesc_frame_parser_t *parser, uint8_t start) {
+    return start == 2 ? 0xFF : parser->long_max;
+}
+
+uint8_t vesc_frame_header(uint8_t *header, uint32_t len) {
+    if (len <= 0xFF) {
+        header[0] = 2;
+        header[1] = (uint8_t)len;
+        return 2;
+    } else if (len <= 0xFFFF) {
+        header[0] = 3;
+        header[1] = (uint8_t)(len >> 8);
+        header[2] = (uint8_t)(len & 0xFF);
+        return 3;
+    }
+    header[0] = 4;
+    header[1] = (uint8_t)(len >> 16);
+    header[2] = (uint8_t)(len >> 8);
+    header[3] = (uint8_t)(len & 0xFF);
+    return 4;
+}
+
+void vesc_frame_trailer(uint8_t *trailer, uint16_t crc) {
+    trailer[0] = (uint8_t)(crc >> 8);
+    trailer[1] = (uint8_t)(crc & 0xFF);
+    trailer[2] = 3;
+}
+
+static void frame_complete(vesc_frame_parser_t *parser) {
+    parser->frames_ok++;
+    if (parser->on_frame) {
+        parser->on_frame(parser->raw + parser->payload_off, parser->len, parser->ctx);
+    }
+}
+
+// The current candidate is bad. Its start byte is dropped and everything
+// after it is parsed again, so a frame starting inside it is not lost.
+static void frame_fail(vesc_frame_parser_t *parser) {
+    parser->bytes_discarded++;
+    parser->resyncs++;
+    parser->failed = true;
+    parser->fail_len = parser->raw_len;
+
+    if (!parser->draining && parser->raw_len > 1) {
+        memcpy(parser->replay, parser->raw + 1, parser->raw_len - 1);
+        parser->replay_len = parser->raw_len - 1;
+        parser->replay_pos = 0;
+    }
+    // While draining, the candidate is replay[] itself; the drain loop rewinds
+
+    vesc_frame_parser_reset(parser);
+}
+
+// Length fully received: check it fits
+static void frame_length_done(vesc_frame_parser_t *parser) {
+    parser->count = 0;
+    parser->crc_calc = 0;
+    parser->payload_off = parser->raw_len;
+    if (parser->len < frame_len_min(parser->raw[0]) || parser->len > frame_len_max(parser, parser->raw[0])) {
+        parser->framing_errors++;
+        frame_fail(parser);
+    } else {
+        parser->state = VESC_FRAME_PAYLOAD;
+    }
+}
+
+size_t vesc_frame_parser_rx_window(vesc_frame_parser_t *parser, uint8_t **dst) {
+    if (parser->state != VESC_FRAME_PAYLOAD) {
+        return 0;
+    }
+    *dst = parser->raw + parser->payload_off + parser->count;
+    return parser->len - parser->count;
+}
+
+void vesc_frame_parser_rx_commit(vesc_frame_parser_t *parser, size_t len) {
+    if (parser->state != VESC_FRAME_PAYLOAD) {
+        return;
+    }
+    parser->crc_calc = vesc_crc16_update(parser->crc_calc, parser->raw + parser->payload_off + parser->count, len);
+    parser->count += len;
+    parser->raw_len += len;
+    if (parser->count >= parser->len) {
+        parser->state = VESC_FRAME_CRC_HI;
+    }
+}
+
+// Parse bytes until they run out or a candidate fails. Returns bytes used.
+static size_t parser_consume(vesc_frame_parser_t *parser, const uint8_t *data, size_t len) {
+    size_t i = 0;
+
+    while (i < len && !parser->failed) {
+        switch (parser->state) {
+            case VESC_FRAME_WAIT_START:
+                // 2: 8-bit length, 3: 16-bit length, 4: 24-bit length (only while expected)
+                if (data[i] >= 2 && data[i] <= 4 &&
+                    frame_len_max(parser, data[i]) >= frame_len_min(data[i])) {
+                    parser->len_bytes = data[i] - 1;
+                    parser->len = 0;
+                    parser->raw[0] = data[i];
+                    parser->raw_len = 1;
+                    parser->state = VESC_FRAME_LEN;
+                } else {
+                    parser->bytes_discarded++;
+                }
+                i++;
+                break;
+
+            case VESC_FRAME_LEN:
+                parser->raw[parser->raw_len++] = data[i];
+                parser->len = (parser->len << 8) | data[i++];
+                if (--parser->len_bytes == 0) {
+                    frame_length_done(parser);
+                }
+                break;
+
+            case VESC_FRAME_PAYLOAD: {
+                // Copy as much of the payload as this chunk holds in one go
+                size_t chunk = len - i;
+                size_t remaining = parser->len - parser->count;
+                if (chunk > remaining) {
+                    chunk = remaining;
+                }
+                memcpy(parser->raw + parser->payload_off + parser->count, data + i, chunk);
+                i += chunk;
+                vesc_frame_parser_rx_commit(parser, chunk);
+                break;
+            }
+
+            case VESC_FRAME_CRC_HI:
+                parser->raw[parser->raw_len++] = data[i];
+                parser->crc_rx = (uint16_t)data[i++] << 8;
+                parser->state = VESC_FRAME_CRC_LO;
+                break;
+
+            case VESC_FRAME_CRC_LO:
+                parser->raw[parser->raw_len++] = data[i];
+                parser->crc_rx |= data[i++];
+                parser->state = VESC_FRAME_END;
+                break;
+
+            case VESC_FRAME_END:
+                parser->raw[parser->raw_len++] = data[i];
+                if (data[i++] != 3) {
+                    parser->framing_errors++;
+                    frame_fail(parser);
+                } else if (parser->crc_calc != parser->crc_rx) {
+                    parser->crc_errors++;
+                    frame_fail(parser);
+                } else {
+                    frame_complete(parser);
+                    vesc_frame_parser_reset(parser);
+                }
+                break;
+
+            default:
+                vesc_frame_parser_reset(parser);
+                break;
+        }
+    }
+    return i;
+}
+
+// Rescan the bytes of failed candidates until none are left
+static void parser_drain(vesc_frame_parser_t *parser) {
+    parser->draining = true;
+    while (parser->replay_pos < parser->replay_len) {
+        uint16_t pos = parser->replay_pos;
+        size_t used = parser_consume(parser, parser->replay + pos, parser->replay_len - pos);
+
+        if (parser->failed) {
+            // The failed candidate sits in replay[] just before the stop point:
+            // resume one byte after its start
+            parser->failed = false;
+            parser->replay_pos = (uint16_t)(pos + used - parser->fail_len + 1);
+        } else {
+            parser->replay_pos = (uint16_t)(pos + used);
+        }
+    }
+    parser->replay_pos = 0;
+    parser->replay_len = 0;
+    parser->draining = false;
+}
+
+void vesc_frame_parser_feed(vesc_frame_parser_t *parser, const uint8_t *data, size_t len) {
+    size_t i = 0;
+
+    while (i < len) {
+        i += parser_consume(parser, data + i, len - i);
+        if (parser->failed) {
+            parser->failed = false;
+            parser_drain(parser);
+        }
+    }
+}
+
+void vesc_frame_parser_flush(vesc_frame_parser_t *parser) {
+    // Each pass drops at least the start byte, so this ends
+    while (vesc_frame_parser_busy(parser)) {
+        parser->flushes++;
+        frame_fail(parser);
+        parser->failed = false;
+        parser_drain(parser);
+    }
+}
@@ -0,0 +1,192 @@
+/**
+ * @file vesc_frame.h
+ * @brief Incremental VESC packet framing and parsing
+ *
+ * VESC packets on the wire look like:
+ *   [2][len8][payload...][crc_hi][crc_lo][3]         payload up to 255 bytes
+ *   [3][len16][payload...][crc_hi][crc_lo][3]        payload up to 65535 bytes
+ *   [4][len24][payload...][crc_hi][crc_lo][3]        longer payloads
+ *
+ * The parser is a resumable state machine: it can be fed any number of
+ * bytes at a time (as they come out of the UART driver) and calls the
+ * frame callback once for every complete, CRC-checked payload. The CRC is
+ * accumulated as payload bytes arrive, so checking it at the end byte is
+ * a single compare.
+ *
+ * When a candidate frame turns out bad (impossible length, CRC mismatch or
+ * wrong end byte) its start byte may have been noise, so the parser
+ * rescans the candidate's bytes from the one after that start byte. A
+ * real frame hidden inside the bad candidate is found right away instead
+ * of being thrown away with it.
+ *
+ * Replies longer than 255 bytes are rare (configuration reads), and a
+ * stray 3 or 4 byte taken as the start of one would swallow hundreds of
+ * following bytes. So 16- and 24-bit lengths are only accepted while the
+ * owner has said a long reply may come (vesc_frame_parser_set_long_max()),
+ * and only within the size given; lengths must also be in their shortest
+ * encoding. A candidate still open when the line goes idle is stale and is
+ * rescanned the same way (vesc_frame_parser_flush()).
+ *
+ * Has no ESP-IDF dependencies so it can be reused on any byte stream.
+ */
+
+#ifndef VESC_FRAME_H
+#define VESC_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "vesc_crc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_FRAME_MAX_PAYLOAD  1024    // Fits COMM_GET_MCCONF / COMM_GET_APPCONF replies
+#define VESC_FRAME_MAX_HEADER   4
+#define VESC_FRAME_TRAILER      3
+#define VESC_FRAME_MAX_RAW      (VESC_FRAME_MAX_HEADER + VESC_FRAME_MAX_PAYLOAD + VESC_FRAME_TRAILER)
+
+/**
+ * @brief Called for every complete frame with a valid CRC
+ * @param payload Payload bytes. This is a view into the parser's frame
+ *                buffer, valid only for the duration of the call.
+ * @param len     Payload length
+ * @param ctx     User context given to vesc_frame_parser_init()
+ */
+typedef void (*vesc_frame_cb_t)(const uint8_t *payload, uint16_t len, void *ctx);
+
+// Parser states
+typedef enum {
+    VESC_FRAME_WAIT_START = 0,
+    VESC_FRAME_LEN,
+    VESC_FRAME_PAYLOAD,
+    VESC_FRAME_CRC_HI,
+    VESC_FRAME_CRC_LO,
+    VESC_FRAME_END,
+} vesc_frame_state_t;
+
+// Parser instance
+typedef struct {
+    vesc_frame_state_t state;
+    uint8_t len_bytes;          // Length bytes still to read
+    uint32_t len;               // Expected payload length
+    uint32_t count;             // Payload bytes received so far
+    uint16_t crc_rx;            // CRC received from the wire
+    uint16_t crc_calc;          // CRC of the payload bytes received so far
+    uint16_t raw_len;           // Bytes of the current candidate in raw[]
+    uint16_t payload_off;       // Offset of the payload in raw[]
+    uint32_t frames_ok;         // Frames delivered
+    uint32_t crc_errors;        // Frames dropped due to CRC mismatch
+    uint32_t framing_errors;    // Bad end byte or unsupported length
+    uint32_t bytes_discarded;   // Bytes that could not start a valid frame
+    uint32_t resyncs;           // Bad candidates rescanned
+    uint32_t flushes;           // Candidates still open when the line went idle
+    uint32_t long_max;          // Largest payload accepted with a 16/24-bit length; 0: none
+    vesc_frame_cb_t on_frame;
+    void *ctx;
+    bool draining;              // Currently parsing replay[]
+    bool failed;                // Set by a candidate failure, cleared by the caller
+    uint16_t fail_len;          // Length of the candidate that failed
+    uint16_t replay_pos;        // Next byte of replay[] to parse
+    uint16_t replay_len;
+    uint8_t raw[VESC_FRAME_MAX_RAW];        // Current candidate: start, length, payload, trailer
+    uint8_t replay[VESC_FRAME_MAX_RAW];     // Bytes of a failed candidate awaiting rescan
+} vesc_frame_parser_t;
+
+/**
+ * @brief Initialize a parser
+ * @param parser   Parser instance
+ * @param on_frame Callback for complete frames
+ * @param ctx      User context passed to the callback
+ */
+void vesc_frame_parser_init(vesc_frame_parser_t *parser, vesc_frame_cb_t on_frame, void *ctx);
+
+/**
+ * @brief Drop any partially received frame and wait for a new start byte
+ * @param parser Parser instance
+ */
+void vesc_frame_parser_reset(vesc_frame_parser_t *parser);
+
+/**
+ * @brief Set the largest payload a 16- or 24-bit length may announce
+ *
+ * Start bytes 3 and 4 are treated as noise while this is 0 (the default).
+ * A candidate already past its length keeps going.
+ *
+ * @param parser   Parser instance
+ * @param long_max Largest expected long payload, 0 while none is expected
+ */
+void vesc_frame_parser_set_long_max(vesc_frame_parser_t *parser, uint32_t long_max);
+
+/**
+ * @brief Give up on the open candidate, if any, and rescan its bytes
+ *
+ * Call when the line has gone idle: a real frame arrives in one piece, so
+ * a candidate still open by then started on a noise byte. Frames found in
+ * its bytes are delivered; the remainder is dropped.
+ *
+ * @param parser Parser instance
+ */
+void vesc_frame_parser_flush(vesc_frame_parser_t *parser);
+
+/**
+ * @brief Whether a candidate frame is open
+ * @param parser Parser instance
+ * @return true between a start byte and the end of its frame
+ */
+static inline bool vesc_frame_parser_busy(const vesc_frame_parser_t *parser) {
+    return parser->state != VESC_FRAME_WAIT_START;
+}
+
+/**
+ * @brief Build the frame header for a payload of the given length
+ * @param header Output, at least VESC_FRAME_MAX_HEADER bytes
+ * @param len    Payload length
+ * @return Header length in bytes
+ */
+uint8_t vesc_frame_header(uint8_t *header, uint32_t len);
+
+/**
+ * @brief Build the frame trailer (CRC and end byte)
+ * @param trailer Output, VESC_FRAME_TRAILER bytes
+ * @param crc     CRC of the payload
+ */
+void vesc_frame_trailer(uint8_t *trailer, uint16_t crc);
+
+/**
+ * @brief Get where the next payload bytes should be written
+ *
+ * Lets the caller read payload bytes from the UART straight into the frame
+ * buffer instead of through an intermediate chunk. Follow with
+ * vesc_frame_parser_rx_commit().
+ *
+ * @param parser Parser instance
+ * @param dst    Output: write position in the frame buffer
+ * @return Payload bytes still expected, or 0 if not inside a payload
+ */
+size_t vesc_frame_parser_rx_window(vesc_frame_parser_t *parser, uint8_t **dst);
+
+/**
+ * @brief Account for bytes written into the window from rx_window()
+ * @param parser Parser instance
+ * @param len    Bytes written (at most the window size)
+ */
+void vesc_frame_parser_rx_commit(vesc_frame_parser_t *parser, size_t len);
+
+/**
+ * @brief Feed received bytes into the parser
+ *
+ * May deliver zero, one or several frames through the callback.
+ *
+ * @param parser Parser instance
+ * @param data   Received bytes
+ * @param len    Number of bytes
+ */
+void vesc_frame_parser_feed(vesc_frame_parser_t *parser, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_FRAME_H
@@ -0,0 +1,263 @@
+/**
+ * @file vesc_health.c
+ * @brief VESC link health: error counters, reply latency and reconnect detection
+ */
+
+#include "vesc_health.h"
+#include "vesc_uart.h"
+#include "vesc_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static const char *TAG = "vesc_health";
+
+// Probe: COMM_GET_VALUES_SELECTIVE for the fault code only, the shortest reply there is.
+// Firmware without it gets COMM_FW_VERSION, which every release answers.
+static const uint8_t probe_payload[] = {
+    COMM_GET_VALUES_SELECTIVE,
+    (uint8_t)(VESC_VALUE_FAULT >> 24), (uint8_t)(VESC_VALUE_FAULT >> 16),
+    (uint8_t)(VESC_VALUE_FAULT >> 8), (uint8_t)VESC_VALUE_FAULT,
+};
+static const uint8_t probe_fw_version[] = { COMM_FW_VERSION };
+
+static portMUX_TYPE health_lock = portMUX_INITIALIZER_UNLOCKED;
+static vesc_health_state_t state = VESC_HEALTH_DISCONNECTED;
+static uint32_t consecutive_timeouts = 0;
+static uint32_t reconnects = 0;
+static uint32_t probes = 0;
+static bool probe_outstanding = false;
+static uint32_t latency_hist[VESC_HEALTH_LATENCY_BUCKETS];
+static uint32_t latency_samples = 0;   // In the histogram (aged)
+static uint32_t latency_replies = 0;   // Since start
+static uint32_t latency_max = 0;
+static vesc_health_cb_t state_cb = NULL;
+static void *state_ctx = NULL;
+
+static void health_on_reply(uint32_t latency_us, void *ctx);
+static void health_on_timeout(void *ctx);
+
+static const vesc_io_monitor_t health_monitor = {
+    .on_reply = health_on_reply,
+    .on_timeout = health_on_timeout,
+    .ctx = NULL,
+};
+
+// =============================================================================
+// Latency histogram
+// =============================================================================
+
+// 0..3 us get a bucket each; above that, 4 buckets per power of two
+static int latency_bucket(uint32_t us) {
+    if (us < 4) {
+        return (int)us;
+    }
+    int msb = 31 - __builtin_clz(us);
+    int bucket = 4 + (msb - 2) * 4 + (int)((us >> (msb - 2)) & 3);
+    return bucket < VESC_HEALTH_LATENCY_BUCKETS ? bucket : VESC_HEALTH_LATENCY_BUCKETS - 1;
+}
+
+// Largest value that falls into a bucket
+static uint32_t latency_bucket_top(int bucket) {
+    if (bucket < 4) {
+        return (uint32_t)bucket;
+    }
+    int msb = (bucket - 4) / 4 + 2;
+    uint32_t step = (uint32_t)(bucket - 4) % 4;
+    return ((4 + step + 1) << (msb - 2)) - 1;
+}
+
+// Call with health_lock held
+static uint32_t latency_percentile(uint32_t pct) {
+    if (latency_samples == 0) {
+        return 0;
+    }
+    uint32_t rank = (latency_samples * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < VESC_HEALTH_LATENCY_BUCKETS; i++) {
+        seen += latency_hist[i];
+        if (seen >= rank) {
+            uint32_t top = latency_bucket_top(i);
+            return top < latency_max ? top : latency_max;
+        }
+    }
+    return latency_max;
+}
+
+// =============================================================================
+// State machine
+// =============================================================================
+
+static void health_probe_send(void);
+
+// Call with health_lock held. Returns true if the state changed.
+static bool health_set_state(vesc_health_state_t next) {
+    if (next == state) {
+        return false;
+    }
+    if (state == VESC_HEALTH_DISCONNECTED && next == VESC_HEALTH_CONNECTED) {
+        reconnects++;
+    }
+    state = next;
+    return true;
+}
+
+static void health_notify(vesc_health_state_t next) {
+    ESP_LOGI(TAG, "VESC link %s", vesc_health_state_to_string(next));
+    if (state_cb) {
+        state_cb(next, state_ctx);
+    }
+}
+
+static void health_on_frame(const uint8_t *payload, uint16_t len, void *ctx) {
+    (void)payload;
+    (void)len;
+    (void)ctx;
+
+    portENTER_CRITICAL(&health_lock);
+    consecutive_timeouts = 0;
+    bool changed = health_set_state(VESC_HEALTH_CONNECTED);
+    portEXIT_CRITICAL(&health_lock);
+
+    if (changed) {
+        health_notify(VESC_HEALTH_CONNECTED);
+    }
+}
+
+static void health_on_reply(uint32_t latency_us, void *ctx) {
+    (void)ctx;
+
+    portENTER_CRITICAL(&health_lock);
+    if (latency_samples >= VESC_HEALTH_LATENCY_HALVE_AT) {
+        // Age old samples so the percentiles follow the current link
+        latency_samples = 0;
+        for (int i = 0; i < VESC_HEALTH_LATENCY_BUCKETS; i++) {
+            latency_hist[i] /= 2;
+            latency_samples += latency_hist[i];
+        }
+    }
+    latency_hist[latency_bucket(latency_us)]++;
+    latency_samples++;
+    latency_replies++;
+    if (latency_us > latency_max) {
+        latency_max = latency_us;
+    }
+    portEXIT_CRITICAL(&health_lock);
+}
+
+static void health_on_timeout(void *ctx) {
+    (void)ctx;
+
+    portENTER_CRITICAL(&health_lock);
+    consecutive_timeouts++;
+    vesc_health_state_t next = consecutive_timeouts >= VESC_HEALTH_DISCONNECT_TIMEOUTS ?
+                               VESC_HEALTH_DISCONNECTED : VESC_HEALTH_DEGRADED;
+    // Only the disconnect threshold can move a link down from DEGRADED
+    bool changed = (state != VESC_HEALTH_DISCONNECTED) && health_set_state(next);
+    bool probe = (state == VESC_HEALTH_DISCONNECTED) && !probe_outstanding;
+    portEXIT_CRITICAL(&health_lock);
+
+    if (changed) {
+        health_notify(next);
+    }
+    if (probe) {
+        health_probe_send();
+    }
+}
+
+static void health_probe_done(esp_err_t status, const uint8_t *payload, uint16_t len, void *ctx) {
+    (void)payload;
+    (void)len;
+    (void)ctx;
+
+    // The probe's own timeout has already gone through health_on_timeout();
+    // keep one probe on the wire until the VESC answers
+    portENTER_CRITICAL(&health_lock);
+    probe_outstanding = false;
+    bool again = (status != ESP_OK) && (state == VESC_HEALTH_DISCONNECTED);
+    portEXIT_CRITICAL(&health_lock);
+
+    if (again) {
+        health_probe_send();
+    }
+}
+
+static void health_probe_send(void) {
+    portENTER_CRITICAL(&health_lock);
+    if (probe_outstanding) {
+        portEXIT_CRITICAL(&health_lock);
+        return;
+    }
+    probe_outstanding = true;
+    probes++;
+    portEXIT_CRITICAL(&health_lock);
+
+    bool selective = vesc_caps_has(VESC_CAP_VALUES_SELECTIVE);
+    const uint8_t *payload = selective ? probe_payload : probe_fw_version;
+    uint16_t len = selective ? sizeof(probe_payload) : sizeof(probe_fw_version);
+
+    if (vesc_io_request(payload, len, payload[0], health_probe_done, NULL) != ESP_OK) {
+        // Queue full: the traffic ahead of us will time out or answer and retry the probe
+        portENTER_CRITICAL(&health_lock);
+        probe_outstanding = false;
+        portEXIT_CRITICAL(&health_lock);
+    }
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+esp_err_t vesc_health_start(vesc_health_cb_t cb, void *ctx) {
+    portENTER_CRITICAL(&health_lock);
+    state = VESC_HEALTH_DISCONNECTED;
+    consecutive_timeouts = 0;
+    memset(latency_hist, 0, sizeof(latency_hist));
+    latency_samples = 0;
+    latency_replies = 0;
+    latency_max = 0;
+    state_cb = cb;
+    state_ctx = ctx;
+    portEXIT_CRITICAL(&health_lock);
+
+    esp_err_t ret = vesc_io_subscribe(health_on_frame, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "No subscriber slot for the health monitor");
+        return ret;
+    }
+    vesc_io_set_monitor(&health_monitor);
+
+    health_probe_send();
+    return ESP_OK;
+}
+
+void vesc_health_get(vesc_health_stats_t *stats) {
+    if (stats == NULL) return;
+
+    vesc_io_get_counters(&stats->counters);
+
+    portENTER_CRITICAL(&health_lock);
+    stats->state = state;
+    stats->latency_p50_us = latency_percentile(50);
+    stats->latency_p90_us = latency_percentile(90);
+    stats->latency_p99_us = latency_percentile(99);
+    stats->latency_max_us = latency_max;
+    stats->replies = latency_replies;
+    stats->consecutive_timeouts = consecutive_timeouts;
+    stats->reconnects = reconnects;
+    stats->probes = probes;
+    portEXIT_CRITICAL(&health_lock);
+}
+
+vesc_health_state_t vesc_health_get_state(void) {
+    return state;
+}
+
+const char *vesc_health_state_to_string(vesc_health_state_t s) {
+    switch (s) {
+        case VESC_HEALTH_DISCONNECTED: return "DISCONNECTED";
+        case VESC_HEALTH_DEGRADED:     return "DEGRADED";
+        case VESC_HEALTH_CONNECTED:    return "CONNECTED";
+        default:                       return "?";
+    }
+}
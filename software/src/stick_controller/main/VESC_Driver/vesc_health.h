@@ -0,0 +1,96 @@
+/**
+ * @file vesc_health.h
+ * @brief VESC link health: error counters, reply latency and reconnect detection
+ *
+ * Watches the I/O engine and keeps:
+ * - the link counters (timeouts, CRC and framing errors, bytes discarded
+ *   while resynchronising)
+ * - a histogram of request round-trip times, read back as percentiles
+ * - the link state: CONNECTED while frames arrive, DEGRADED after a
+ *   timeout, DISCONNECTED after VESC_HEALTH_DISCONNECT_TIMEOUTS timeouts
+ *   in a row with no frame in between
+ *
+ * While DISCONNECTED a small probe request is kept outstanding back to
+ * back, so a VESC that comes back is seen on its first reply instead of on
+ * the next telemetry poll. Any valid frame moves the link to CONNECTED.
+ */
+
+#ifndef VESC_HEALTH_H
+#define VESC_HEALTH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "vesc_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_HEALTH_DISCONNECT_TIMEOUTS 3       // Timeouts in a row that mean the VESC is gone
+#define VESC_HEALTH_LATENCY_BUCKETS     80      // Log2 buckets with 4 steps each, up to ~1 s
+#define VESC_HEALTH_LATENCY_HALVE_AT    4096    // Samples before the histogram is aged by halving
+
+typedef enum {
+    VESC_HEALTH_DISCONNECTED = 0,
+    VESC_HEALTH_DEGRADED,
+    VESC_HEALTH_CONNECTED,
+} vesc_health_state_t;
+
+// Snapshot returned by vesc_health_get()
+typedef struct {
+    vesc_health_state_t state;
+    vesc_io_counters_t counters;
+    uint32_t latency_p50_us;        // Round-trip percentiles (0 until a reply was seen)
+    uint32_t latency_p90_us;
+    uint32_t latency_p99_us;
+    uint32_t latency_max_us;
+    uint32_t replies;               // Replies measured since start
+    uint32_t consecutive_timeouts;
+    uint32_t reconnects;            // DISCONNECTED -> CONNECTED transitions
+    uint32_t probes;                // Probe requests sent while disconnected
+} vesc_health_stats_t;
+
+/**
+ * @brief Link state change callback
+ *
+ * Runs in the I/O engine task and must not block.
+ *
+ * @param state New state
+ * @param ctx   User context given to vesc_health_start()
+ */
+typedef void (*vesc_health_cb_t)(vesc_health_state_t state, void *ctx);
+
+/**
+ * @brief Start watching the link
+ *
+ * Call after vesc_uart_init(). The link starts as DISCONNECTED with
+ * probing running until the VESC answers.
+ *
+ * @param cb  State change callback (may be NULL)
+ * @param ctx User context for the callback
+ * @return ESP_OK, or an error from the I/O engine
+ */
+esp_err_t vesc_health_start(vesc_health_cb_t cb, void *ctx);
+
+/**
+ * @brief Read the link health
+ * @param stats Output
+ */
+void vesc_health_get(vesc_health_stats_t *stats);
+
+/**
+ * @brief Current link state
+ */
+vesc_health_state_t vesc_health_get_state(void);
+
+/**
+ * @brief State name for logs
+ */
+const char *vesc_health_state_to_string(vesc_health_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_HEALTH_H
@@ -0,0 +1,871 @@
+/**
+ * @file vesc_io.c
+ * @brief VESC I/O engine - single owner of the VESC UART
+ */
+
+#include "vesc_io.h"
+#include "vesc_uart.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+
+static const char *TAG = "vesc_io";
+
+// How long the reply of a timed-out request may still turn up
+#define VESC_IO_LATE_REPLY_MS   VESC_UART_TIMEOUT_MS
+
+typedef enum {
+    VESC_IO_ITEM_FRAME = 0,
+    VESC_IO_ITEM_BATCH,         // Frames back to back, payloads packed in payload[]
+    VESC_IO_ITEM_SET_BAUD,      // Barrier: waits for in-flight requests to finish
+} vesc_io_item_kind_t;
+
+// Frame (or control action) queued for the engine
+typedef struct {
+    vesc_io_item_kind_t kind;
+    uint32_t baud;
+    uint16_t len;
+    bool expects_reply;
+    uint8_t reply_id;
+    uint32_t reply_max;
+    vesc_io_reply_match_t match;
+    uint32_t tag;
+    vesc_io_reply_cb_t cb;
+    void *ctx;
+    const uint8_t *ext_payload;                 // Caller-owned payload, or NULL to use payload[]
+    uint32_t estop_release;                     // E-stop hold this batch ends (0 = none)
+    uint8_t batch_count;
+    uint8_t batch_lens[VESC_IO_MAX_BATCH];
+    uint8_t payload[VESC_IO_MAX_PAYLOAD];
+} vesc_io_item_t;
+
+// Request written to the wire and waiting for its reply
+typedef struct {
+    bool active;
+    uint8_t reply_id;
+    uint32_t reply_max;
+    vesc_io_reply_match_t match;
+    uint32_t tag;
+    int64_t sent_us;
+    bool maybe_answered;        // A reply with its ID went to a timed-out request meanwhile
+    vesc_io_reply_cb_t cb;
+    void *ctx;
+} vesc_io_inflight_t;
+
+// Reply still owed to a request that timed out: the next frame with its ID
+// is that late reply, not the answer to a newer request
+typedef struct {
+    bool active;
+    uint8_t reply_id;
+    int64_t until_us;
+} vesc_io_late_t;
+
+typedef struct {
+    vesc_frame_cb_t cb;
+    void *ctx;
+} vesc_subscriber_t;
+
+static QueueHandle_t uart_event_queue = NULL;
+static QueueHandle_t urgent_queue = NULL;
+static QueueHandle_t normal_queue = NULL;
+static SemaphoreHandle_t work_sem = NULL;      // Given once per queued item
+static QueueSetHandle_t wake_set = NULL;
+static TaskHandle_t io_task = NULL;
+
+// Owned by the engine task
+static vesc_frame_parser_t rx_parser;
+static vesc_io_inflight_t inflight[VESC_IO_MAX_INFLIGHT];
+static int inflight_count = 0;
+static vesc_io_late_t late[VESC_IO_MAX_INFLIGHT];
+static uint32_t late_replies = 0;
+static int64_t rx_last_us = 0;                  // Last data event
+static vesc_io_item_t pending_normal;           // Dequeued but not yet written
+static bool pending_normal_valid = false;
+static uint32_t timeouts = 0;
+static uint32_t current_baud = VESC_UART_BAUD;
+static const vesc_io_monitor_t *volatile link_monitor = NULL;
+
+// E-stop burst, encoded once by vesc_io_estop_prepare()
+static uint8_t estop_burst[VESC_IO_ESTOP_MAX_BYTES];
+static uint16_t estop_burst_len = 0;
+static atomic_bool estop_request;               // Set by the trigger interrupt
+static atomic_uint estop_hold;                  // Held e-stop (0 = none): motor commands dropped
+static uint32_t estop_count = 0;                // E-stops triggered, guarded by estop_lock
+static int64_t estop_trigger_us = 0;
+static vesc_io_estop_stats_t estop_stats;
+static portMUX_TYPE estop_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Motor halt batch, encoded once by vesc_io_halt_prepare()
+static vesc_io_item_t halt_item;
+static atomic_bool halt_ready;
+static atomic_bool halt_active;                 // Motor commands replaced by halt_item
+static atomic_bool halt_request;                // Write halt_item at once
+
+static vesc_subscriber_t subscribers[VESC_IO_MAX_SUBSCRIBERS];
+static portMUX_TYPE subscribers_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// =============================================================================
+// Transmit
+// =============================================================================
+
+// Header, payload and trailer go into the TX ring as separate spans, so the
+// payload is never copied into an intermediate frame buffer
+static void io_write_frame(const uint8_t *payload, uint16_t len_pay) {
+    uint8_t header[VESC_FRAME_MAX_HEADER];
+    uint8_t trailer[VESC_FRAME_TRAILER];
+    uint8_t header_len = vesc_frame_header(header, len_pay);
+
+    vesc_frame_trailer(trailer, vesc_crc16(payload, len_pay));
+
+    // Each write copies into the TX ring and returns; only blocks if the ring is full
+    uart_write_bytes(VESC_UART_NUM, header, header_len);
+    uart_write_bytes(VESC_UART_NUM, payload, len_pay);
+    uart_write_bytes(VESC_UART_NUM, trailer, sizeof(trailer));
+}
+
+static void io_estop_dropped(uint32_t count) {
+    portENTER_CRITICAL(&estop_lock);
+    estop_stats.dropped += count;
+    portEXIT_CRITICAL(&estop_lock);
+}
+
+// Write the e-stop burst if one was triggered. Checked before every write,
+// so at most the frame being written when the trigger came goes ahead of
+// it. Returns true if the burst was written now.
+static bool io_poll_estop(void) {
+    if (!atomic_exchange(&estop_request, false)) {
+        return false;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    size_t ring_free = VESC_IO_TX_BUF_SIZE;
+    uart_get_tx_buffer_free_size(VESC_UART_NUM, &ring_free);
+    uart_write_bytes(VESC_UART_NUM, estop_burst, estop_burst_len);
+    int64_t written_us = esp_timer_get_time();
+
+    // Motor commands queued before the trigger are stale
+    vesc_io_item_t stale;
+    uint32_t dropped = 0;
+    while (xQueueReceive(urgent_queue, &stale, 0) == pdTRUE) {
+        dropped++;
+    }
+
+    // The burst leaves after the ring bytes found ahead of it and a full FIFO, 10 bits per byte
+    uint32_t ahead = VESC_IO_TX_BUF_SIZE - (uint32_t)ring_free;
+    uint64_t drain_us = (uint64_t)(ahead + VESC_IO_TX_FIFO_BYTES + estop_burst_len) * 10 * 1000000 /
+                        current_baud;
+
+    portENTER_CRITICAL(&estop_lock);
+    int64_t trigger_us = estop_trigger_us;
+    uint32_t pickup = start_us > trigger_us ? (uint32_t)(start_us - trigger_us) : 0;
+    uint32_t wire = (uint32_t)(written_us - start_us + drain_us) + pickup;
+    estop_stats.injected++;
+    estop_stats.dropped += dropped;
+    estop_stats.last_pickup_us = pickup;
+    estop_stats.last_wire_us = wire;
+    if (ahead > estop_stats.ahead_max_bytes) estop_stats.ahead_max_bytes = ahead;
+    if (pickup > estop_stats.pickup_max_us) estop_stats.pickup_max_us = pickup;
+    if (wire > estop_stats.wire_max_us) estop_stats.wire_max_us = wire;
+    portEXIT_CRITICAL(&estop_lock);
+    return true;
+}
+
+static void io_write_item(const vesc_io_item_t *item);
+
+// Write the halt batch if vesc_io_halt() asked for it since the last check
+static void io_poll_halt(void) {
+    if (atomic_exchange(&halt_request, false) && !atomic_load(&estop_hold)) {
+        io_write_item(&halt_item);
+    }
+}
+
+static void io_write_item(const vesc_io_item_t *item) {
+    if (item->kind == VESC_IO_ITEM_BATCH) {
+        const uint8_t *payload = item->payload;
+        for (int i = 0; i < item->batch_count; i++) {
+            io_write_frame(payload, item->batch_lens[i]);
+            payload += item->batch_lens[i];
+        }
+        return;
+    }
+    io_write_frame(item->ext_payload ? item->ext_payload : item->payload, item->len);
+}
+
+// =============================================================================
+// Receive
+// =============================================================================
+
+// Long frames are accepted only while a request in flight may get one
+static void io_update_long_max(void) {
+    uint32_t long_max = 0;
+    for (int i = 0; i < VESC_IO_MAX_INFLIGHT; i++) {
+        if (inflight[i].active && inflight[i].reply_max > VESC_IO_REPLY_SHORT &&
+            inflight[i].reply_max > long_max) {
+            long_max = inflight[i].reply_max;
+        }
+    }
+    vesc_frame_parser_set_long_max(&rx_parser, long_max);
+}
+
+// Take the frame as the late reply to a timed-out request, if one is owed
+static bool io_take_late_reply(uint8_t reply_id, int64_t now) {
+    for (int i = 0; i < VESC_IO_MAX_INFLIGHT; i++) {
+        if (late[i].active && now >= late[i].until_us) {
+            late[i].active = false;
+        }
+    }
+    for (int i = 0; i < VESC_IO_MAX_INFLIGHT; i++) {
+        if (late[i].active && late[i].reply_id == reply_id) {
+            late[i].active = false;
+            late_replies++;
+            // The VESC answers in order, but if the late reply never came this
+            // was the answer to a request in flight: that one owes nothing
+            for (int j = 0; j < VESC_IO_MAX_INFLIGHT; j++) {
+                if (inflight[j].active && inflight[j].reply_id == reply_id) {
+                    inflight[j].maybe_answered = true;
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static void io_dispatch_frame(const uint8_t *payload, uint16_t len, void *ctx) {
+    (void)ctx;
+
+    // Complete the oldest in-flight request waiting for this packet ID,
+    // unless the frame is what a timed-out request was waiting for
+    int found = -1;
+    bool stale = io_take_late_reply(payload[0], esp_timer_get_time());
+    for (int i = 0; i < VESC_IO_MAX_INFLIGHT && !stale; i++) {
+        if (inflight[i].active && inflight[i].reply_id == payload[0] &&
+            (inflight[i].match == NULL || inflight[i].match(payload, len, inflight[i].tag)) &&
+            (found < 0 || inflight[i].sent_us < inflight[found].sent_us)) {
+            found = i;
+        }
+    }
+    if (found >= 0) {
+        vesc_io_inflight_t done = inflight[found];
+        inflight[found].active = false;
+        inflight_count--;
+        io_update_long_max();
+        const vesc_io_monitor_t *mon = link_monitor;
+        if (mon && mon->on_reply) {
+            mon->on_reply((uint32_t)(esp_timer_get_time() - done.sent_us), mon->ctx);
+        }
+        if (done.cb) {
+            done.cb(ESP_OK, payload, len, done.ctx);
+        }
+    }
+
+    vesc_subscriber_t local[VESC_IO_MAX_SUBSCRIBERS];
+    portENTER_CRITICAL(&subscribers_lock);
+    memcpy(local, subscribers, sizeof(local));
+    portEXIT_CRITICAL(&subscribers_lock);
+
+    for (int i = 0; i < VESC_IO_MAX_SUBSCRIBERS; i++) {
+        if (local[i].cb) {
+            local[i].cb(payload, len, local[i].ctx);
+        }
+    }
+}
+
+static void io_handle_uart_event(const uart_event_t *event) {
+    uint8_t chunk[VESC_IO_RX_CHUNK];
+
+    switch (event->type) {
+        case UART_DATA: {
+            rx_last_us = esp_timer_get_time();
+            // Drain everything that is buffered, not just this event's share
+            size_t buffered = 0;
+            uart_get_buffered_data_len(VESC_UART_NUM, &buffered);
+            while (buffered > 0) {
+                uint8_t *dst;
+                size_t window = vesc_frame_parser_rx_window(&rx_parser, &dst);
+                int len;
+
+                if (window > 0) {
+                    // Payload bytes go straight from the driver into the frame buffer
+                    len = uart_read_bytes(VESC_UART_NUM, dst, buffered < window ? buffered : window, 0);
+                    if (len > 0) {
+                        vesc_frame_parser_rx_commit(&rx_parser, len);
+                    }
+                } else {
+                    len = uart_read_bytes(VESC_UART_NUM, chunk,
+                                          buffered < sizeof(chunk) ? buffered : sizeof(chunk), 0);
+                    if (len > 0) {
+                        vesc_frame_parser_feed(&rx_parser, chunk, len);
+                    }
+                }
+                if (len <= 0) {
+                    break;
+                }
+                buffered -= len;
+            }
+            break;
+        }
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            ESP_LOGW(TAG, "UART RX overflow, flushing");
+            uart_flush_input(VESC_UART_NUM);
+            vesc_frame_parser_reset(&rx_parser);
+            break;
+        case UART_FRAME_ERR:
+        case UART_PARITY_ERR:
+            vesc_frame_parser_reset(&rx_parser);
+            break;
+        default:
+            break;
+    }
+}
+
+// While a frame streams in the UART raises a data event at least every
+// RX_FULL_THRESH bytes, and on every idle gap. A frame still open after
+// twice that without one is not coming: its start byte was noise.
+static int64_t io_rx_stale_us(void) {
+    return (int64_t)VESC_IO_RX_STALE_BYTES * 10 * 1000000 / current_baud;
+}
+
+static void io_flush_stale_rx(int64_t now) {
+    if (vesc_frame_parser_busy(&rx_parser) && now - rx_last_us >= io_rx_stale_us()) {
+        vesc_frame_parser_flush(&rx_parser);
+    }
+}
+
+// =============================================================================
+// Engine
+// =============================================================================
+
+// Remember that a reply to a timed-out request may still arrive
+static void io_expect_late_reply(uint8_t reply_id, int64_t now) {
+    int slot = 0;
+    for (int i = 0; i < VESC_IO_MAX_INFLIGHT; i++) {
+        if (!late[i].active) {
+            slot = i;
+            break;
+        }
+        if (late[i].until_us < late[slot].until_us) {
+            slot = i;           // All taken: replace the one closest to expiring
+        }
+    }
+    late[slot].active = true;
+    late[slot].reply_id = reply_id;
+    late[slot].until_us = now + VESC_IO_LATE_REPLY_MS * 1000LL;
+}
+
+static void io_expire_inflight(int64_t now) {
+    for (int i = 0; i < VESC_IO_MAX_INFLIGHT; i++) {
+        if (inflight[i].active && (now - inflight[i].sent_us) >= VESC_UART_TIMEOUT_MS * 1000LL) {
+            vesc_io_inflight_t done = inflight[i];
+            inflight[i].active = false;
+            inflight_count--;
+            timeouts++;
+            if (!done.maybe_answered) {
+                io_expect_late_reply(done.reply_id, now);
+            }
+            io_update_long_max();
+            ESP_LOGD(TAG, "Request 0x%02X timed out", done.reply_id);
+            const vesc_io_monitor_t *mon = link_monitor;
+            if (mon && mon->on_timeout) {
+                mon->on_timeout(mon->ctx);
+            }
+            if (done.cb) {
+                done.cb(ESP_ERR_TIMEOUT, NULL, 0, done.ctx);
+            }
+        }
+    }
+}
+
+static TickType_t io_next_wait(int64_t now) {
+    int64_t earliest = INT64_MAX;
+    for (int i = 0; i < VESC_IO_MAX_INFLIGHT; i++) {
+        if (inflight[i].active && inflight[i].sent_us < earliest) {
+            earliest = inflight[i].sent_us;
+        }
+    }
+    int64_t deadline = (earliest == INT64_MAX) ? INT64_MAX : earliest + VESC_UART_TIMEOUT_MS * 1000LL;
+    if (vesc_frame_parser_busy(&rx_parser) && rx_last_us + io_rx_stale_us() < deadline) {
+        deadline = rx_last_us + io_rx_stale_us();
+    }
+    if (deadline == INT64_MAX) {
+        return portMAX_DELAY;
+    }
+
+    int64_t remaining_us = deadline - now;
+    TickType_t ticks = pdMS_TO_TICKS((remaining_us + 999) / 1000);
+    return ticks > 0 ? ticks : 1;
+}
+
+static void io_apply_baud(uint32_t baud) {
+    // Let queued bytes leave at the old rate, then start clean at the new one
+    uart_wait_tx_done(VESC_UART_NUM, pdMS_TO_TICKS(VESC_UART_TIMEOUT_MS));
+    uart_set_baudrate(VESC_UART_NUM, baud);
+    uart_flush_input(VESC_UART_NUM);
+    vesc_frame_parser_reset(&rx_parser);
+    memset(late, 0, sizeof(late));              // Late replies went with the input
+    current_baud = baud;
+    ESP_LOGI(TAG, "VESC UART baud set to %lu", (unsigned long)baud);
+}
+
+static void io_issue_normal(const vesc_io_item_t *item) {
+    if (item->kind == VESC_IO_ITEM_SET_BAUD) {
+        io_apply_baud(item->baud);
+        return;
+    }
+
+    if (item->expects_reply) {
+        for (int i = 0; i < VESC_IO_MAX_INFLIGHT; i++) {
+            if (!inflight[i].active) {
+                inflight[i].active = true;
+                inflight[i].reply_id = item->reply_id;
+                inflight[i].reply_max = item->reply_max;
+                inflight[i].match = item->match;
+                inflight[i].tag = item->tag;
+                inflight[i].sent_us = esp_timer_get_time();
+                inflight[i].maybe_answered = false;
+                inflight[i].cb = item->cb;
+                inflight[i].ctx = item->ctx;
+                inflight_count++;
+                io_update_long_max();
+                break;
+            }
+        }
+    }
+    io_poll_estop();
+    io_write_item(item);
+}
+
+static void vesc_io_task(void *arg) {
+    (void)arg;
+    vesc_io_item_t item;
+    uart_event_t event;
+
+    while (1) {
+        QueueSetMemberHandle_t member = xQueueSelectFromSet(wake_set, io_next_wait(esp_timer_get_time()));
+
+        if (member == work_sem) {
+            xSemaphoreTake(work_sem, 0);
+        } else if (member == uart_event_queue) {
+            if (xQueueReceive(uart_event_queue, &event, 0) == pdTRUE) {
+                io_handle_uart_event(&event);
+            }
+        }
+
+        // E-stop first, ahead of everything queued, then a halt
+        io_poll_estop();
+        io_poll_halt();
+
+        // Urgent commands always go out before anything else queued
+        while (xQueueReceive(urgent_queue, &item, 0) == pdTRUE) {
+            // Taken before an e-stop burst, or held back after one. Only the
+            // release batch of the e-stop being held ends the hold: what was
+            // queued before it is dropped, it goes out first.
+            unsigned held = atomic_load(&estop_hold);
+            if (io_poll_estop() ||
+                (held != 0 && (item.estop_release != held ||
+                               !atomic_compare_exchange_strong(&estop_hold, &held, 0)))) {
+                io_estop_dropped(1);
+                continue;
+            }
+            // Halted: whatever setpoint was queued, the motors get 0 A
+            io_write_item(atomic_load(&halt_active) ? &halt_item : &item);
+        }
+
+        io_flush_stale_rx(esp_timer_get_time());
+        io_expire_inflight(esp_timer_get_time());
+
+        // Normal traffic in order, limited by the number of free in-flight slots
+        while (1) {
+            if (!pending_normal_valid) {
+                if (xQueueReceive(normal_queue, &pending_normal, 0) != pdTRUE) {
+                    break;
+                }
+                pending_normal_valid = true;
+            }
+            if (pending_normal.expects_reply && inflight_count >= VESC_IO_MAX_INFLIGHT) {
+                break;
+            }
+            if (pending_normal.kind == VESC_IO_ITEM_SET_BAUD && inflight_count > 0) {
+                break;
+            }
+            io_issue_normal(&pending_normal);
+            pending_normal_valid = false;
+        }
+    }
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+esp_err_t vesc_io_init(void) {
+    uart_config_t uart_config = {
+        .baud_rate = VESC_UART_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity    = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    esp_err_t ret;
+
+    // Pick the CRC kernel before the first frame is built or checked
+    vesc_crc_init();
+
+    ret = uart_param_config(VESC_UART_NUM, &uart_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "UART param config failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = uart_set_pin(VESC_UART_NUM, VESC_UART_TX_PIN, VESC_UART_RX_PIN,
+                       UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "UART set pin failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = uart_driver_install(VESC_UART_NUM, VESC_IO_RX_BUF_SIZE, VESC_IO_TX_BUF_SIZE,
+                              VESC_IO_EVENT_QUEUE_LEN, &uart_event_queue, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "UART driver install failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Raise data events early: on a short idle gap or a partly filled FIFO
+    uart_set_rx_timeout(VESC_UART_NUM, VESC_IO_RX_TOUT_SYMBOLS);
+    uart_set_rx_full_threshold(VESC_UART_NUM, VESC_IO_RX_FULL_THRESH);
+
+    urgent_queue = xQueueCreate(VESC_IO_URGENT_QUEUE_LEN, sizeof(vesc_io_item_t));
+    normal_queue = xQueueCreate(VESC_IO_NORMAL_QUEUE_LEN, sizeof(vesc_io_item_t));
+    work_sem = xSemaphoreCreateCounting(VESC_IO_URGENT_QUEUE_LEN + VESC_IO_NORMAL_QUEUE_LEN, 0);
+    wake_set = xQueueCreateSet(VESC_IO_URGENT_QUEUE_LEN + VESC_IO_NORMAL_QUEUE_LEN +
+                               VESC_IO_EVENT_QUEUE_LEN);
+    if (urgent_queue == NULL || normal_queue == NULL || work_sem == NULL || wake_set == NULL) {
+        ESP_LOGE(TAG, "Failed to create engine queues");
+        return ESP_ERR_NO_MEM;
+    }
+    xQueueAddToSet(work_sem, wake_set);
+    xQueueAddToSet(uart_event_queue, wake_set);
+
+    vesc_frame_parser_init(&rx_parser, io_dispatch_frame, NULL);
+
+    if (xTaskCreatePinnedToCore(vesc_io_task, "vesc_io", VESC_IO_TASK_STACK, NULL,
+                                VESC_IO_TASK_PRIO, &io_task, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create VESC I/O task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "VESC UART initialized on TX:%d RX:%d @ %d baud",
+             VESC_UART_TX_PIN, VESC_UART_RX_PIN, VESC_UART_BAUD);
+    return ESP_OK;
+}
+
+void vesc_io_deinit(void) {
+    if (io_task == NULL) return;
+
+    vTaskDelete(io_task);
+    io_task = NULL;
+    uart_driver_delete(VESC_UART_NUM);
+}
+
+static esp_err_t io_enqueue(const vesc_io_item_t *item, vesc_io_prio_t prio) {
+    QueueHandle_t queue = (prio == VESC_IO_PRIO_URGENT) ? urgent_queue : normal_queue;
+    if (queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xQueueSend(queue, item, 0) != pdTRUE) {
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(work_sem);
+    return ESP_OK;
+}
+
+esp_err_t vesc_io_send(const uint8_t *payload, uint16_t len, vesc_io_prio_t prio) {
+    if (payload == NULL || len == 0 || len > VESC_IO_MAX_PAYLOAD) return ESP_ERR_INVALID_SIZE;
+
+    vesc_io_item_t item = {
+        .kind = VESC_IO_ITEM_FRAME,
+        .len = len,
+        .expects_reply = false,
+    };
+    memcpy(item.payload, payload, len);
+    return io_enqueue(&item, prio);
+}
+
+// Pack frames into one batch item
+static esp_err_t io_build_batch(vesc_io_item_t *item, const vesc_io_frame_t *frames, int count) {
+    if (frames == NULL || count <= 0 || count > VESC_IO_MAX_BATCH) return ESP_ERR_INVALID_SIZE;
+
+    memset(item, 0, offsetof(vesc_io_item_t, payload));
+    item->kind = VESC_IO_ITEM_BATCH;
+    item->batch_count = (uint8_t)count;
+    for (int i = 0; i < count; i++) {
+        if (frames[i].payload == NULL || frames[i].len == 0 ||
+            item->len + frames[i].len > VESC_IO_MAX_PAYLOAD) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(&item->payload[item->len], frames[i].payload, frames[i].len);
+        item->batch_lens[i] = (uint8_t)frames[i].len;
+        item->len += frames[i].len;
+    }
+    return ESP_OK;
+}
+
+esp_err_t vesc_io_send_batch(const vesc_io_frame_t *frames, int count, vesc_io_prio_t prio) {
+    vesc_io_item_t item;
+    esp_err_t ret = io_build_batch(&item, frames, count);
+    if (ret != ESP_OK) return ret;
+
+    // One item, one send: nothing can land between the frames
+    return io_enqueue(&item, prio);
+}
+
+static esp_err_t io_request(const uint8_t *payload, uint16_t len, uint8_t reply_id, uint32_t reply_max,
+                            vesc_io_reply_match_t match, uint32_t tag, vesc_io_reply_cb_t cb, void *ctx) {
+    if (payload == NULL || len == 0) return ESP_ERR_INVALID_SIZE;
+
+    vesc_io_item_t item = {
+        .kind = VESC_IO_ITEM_FRAME,
+        .len = len,
+        .expects_reply = true,
+        .reply_id = reply_id,
+        .reply_max = reply_max,
+        .match = match,
+        .tag = tag,
+        .cb = cb,
+        .ctx = ctx,
+    };
+    if (len <= VESC_IO_MAX_PAYLOAD) {
+        memcpy(item.payload, payload, len);
+    } else {
+        item.ext_payload = payload;
+    }
+    return io_enqueue(&item, VESC_IO_PRIO_NORMAL);
+}
+
+esp_err_t vesc_io_request(const uint8_t *payload, uint16_t len, uint8_t reply_id,
+                          vesc_io_reply_cb_t cb, void *ctx) {
+    return vesc_io_request_matched(payload, len, reply_id, NULL, 0, cb, ctx);
+}
+
+esp_err_t vesc_io_request_matched(const uint8_t *payload, uint16_t len, uint8_t reply_id,
+                                  vesc_io_reply_match_t match, uint32_t tag,
+                                  vesc_io_reply_cb_t cb, void *ctx) {
+    return io_request(payload, len, reply_id, VESC_IO_REPLY_SHORT, match, tag, cb, ctx);
+}
+
+esp_err_t vesc_io_set_baudrate(uint32_t baud) {
+    if (baud == 0) return ESP_ERR_INVALID_ARG;
+
+    vesc_io_item_t item = {
+        .kind = VESC_IO_ITEM_SET_BAUD,
+        .baud = baud,
+    };
+    return io_enqueue(&item, VESC_IO_PRIO_NORMAL);
+}
+
+uint32_t vesc_io_get_baudrate(void) {
+    return current_baud;
+}
+
+void vesc_io_get_counters(vesc_io_counters_t *counters) {
+    if (counters == NULL) return;
+
+    counters->frames_ok = rx_parser.frames_ok;
+    counters->crc_errors = rx_parser.crc_errors;
+    counters->framing_errors = rx_parser.framing_errors;
+    counters->timeouts = timeouts;
+    counters->late_replies = late_replies;
+    counters->bytes_discarded = rx_parser.bytes_discarded;
+    counters->resyncs = rx_parser.resyncs;
+    counters->flushes = rx_parser.flushes;
+}
+
+void vesc_io_set_monitor(const vesc_io_monitor_t *monitor) {
+    link_monitor = monitor;
+}
+
+static void io_future_complete(esp_err_t status, const uint8_t *payload, uint16_t len, void *ctx) {
+    vesc_io_future_t *future = (vesc_io_future_t *)ctx;
+
+    future->status = status;
+    future->result = 0;
+    if (status == ESP_OK && future->on_reply) {
+        // Decode straight from the RX frame buffer
+        future->result = future->on_reply(payload, len, future->reply_ctx);
+    }
+    xSemaphoreGive(future->done);
+}
+
+esp_err_t vesc_io_request_future(vesc_io_future_t *future, const uint8_t *payload, uint16_t len,
+                                 uint8_t reply_id, vesc_io_reply_view_t on_reply, void *ctx) {
+    return vesc_io_request_future_matched(future, payload, len, reply_id, NULL, 0, on_reply, ctx);
+}
+
+static void io_future_begin(vesc_io_future_t *future, vesc_io_reply_view_t on_reply, void *ctx) {
+    future->done = xSemaphoreCreateBinaryStatic(&future->done_buf);
+    future->status = ESP_ERR_TIMEOUT;
+    future->on_reply = on_reply;
+    future->reply_ctx = ctx;
+    future->result = 0;
+}
+
+static esp_err_t io_future_queued(vesc_io_future_t *future, esp_err_t ret) {
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(future->done);
+        future->done = NULL;
+    }
+    return ret;
+}
+
+esp_err_t vesc_io_request_future_matched(vesc_io_future_t *future, const uint8_t *payload, uint16_t len,
+                                         uint8_t reply_id, vesc_io_reply_match_t match, uint32_t tag,
+                                         vesc_io_reply_view_t on_reply, void *ctx) {
+    if (future == NULL) return ESP_ERR_INVALID_ARG;
+
+    io_future_begin(future, on_reply, ctx);
+    return io_future_queued(future, io_request(payload, len, reply_id, VESC_IO_REPLY_SHORT, match, tag,
+                                               io_future_complete, future));
+}
+
+esp_err_t vesc_io_request_future_long(vesc_io_future_t *future, const uint8_t *payload, uint16_t len,
+                                      uint8_t reply_id, uint32_t reply_max,
+                                      vesc_io_reply_view_t on_reply, void *ctx) {
+    if (future == NULL) return ESP_ERR_INVALID_ARG;
+    if (reply_max > VESC_FRAME_MAX_PAYLOAD) return ESP_ERR_INVALID_SIZE;
+
+    io_future_begin(future, on_reply, ctx);
+    return io_future_queued(future, io_request(payload, len, reply_id, reply_max, NULL, 0,
+                                               io_future_complete, future));
+}
+
+int vesc_io_future_wait(vesc_io_future_t *future) {
+    if (future == NULL || future->done == NULL) return 0;
+
+    xSemaphoreTake(future->done, portMAX_DELAY);
+    vSemaphoreDelete(future->done);
+    future->done = NULL;
+
+    return (future->status == ESP_OK) ? future->result : 0;
+}
+
+esp_err_t vesc_io_estop_prepare(const vesc_io_frame_t *frames, int count) {
+    if (frames == NULL || count <= 0) return ESP_ERR_INVALID_SIZE;
+
+    uint16_t len = 0;
+    for (int i = 0; i < count; i++) {
+        if (frames[i].payload == NULL || frames[i].len == 0 ||
+            len + VESC_FRAME_MAX_HEADER + frames[i].len + VESC_FRAME_TRAILER > VESC_IO_ESTOP_MAX_BYTES) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        len += vesc_frame_header(&estop_burst[len], frames[i].len);
+        memcpy(&estop_burst[len], frames[i].payload, frames[i].len);
+        len += frames[i].len;
+        vesc_frame_trailer(&estop_burst[len], vesc_crc16(frames[i].payload, frames[i].len));
+        len += VESC_FRAME_TRAILER;
+    }
+
+    portENTER_CRITICAL(&estop_lock);
+    estop_burst_len = len;
+    estop_stats.burst_bytes = len;
+    portEXIT_CRITICAL(&estop_lock);
+    return ESP_OK;
+}
+
+bool IRAM_ATTR vesc_io_estop_from_isr(int64_t trigger_us) {
+    BaseType_t woken = pdFALSE;
+
+    if (estop_burst_len == 0 || work_sem == NULL) return false;
+
+    portENTER_CRITICAL_ISR(&estop_lock);
+    estop_trigger_us = trigger_us;
+    if (++estop_count == 0) estop_count = 1;
+    uint32_t hold = estop_count;
+    portEXIT_CRITICAL_ISR(&estop_lock);
+    atomic_store(&estop_hold, hold);
+    atomic_store(&estop_request, true);
+    // A full count means the engine is awake already
+    xSemaphoreGiveFromISR(work_sem, &woken);
+    return woken == pdTRUE;
+}
+
+esp_err_t vesc_io_halt_prepare(const vesc_io_frame_t *frames, int count) {
+    if (atomic_load(&halt_ready)) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t ret = io_build_batch(&halt_item, frames, count);
+    if (ret == ESP_OK) {
+        atomic_store(&halt_ready, true);
+    }
+    return ret;
+}
+
+void vesc_io_halt(bool halted) {
+    if (!atomic_load(&halt_ready) || work_sem == NULL) return;
+
+    atomic_store(&halt_active, halted);
+    if (halted) {
+        atomic_store(&halt_request, true);
+        xSemaphoreGive(work_sem);
+    }
+}
+
+uint32_t vesc_io_estop_held(void) {
+    return atomic_load(&estop_hold);
+}
+
+esp_err_t vesc_io_estop_release(uint32_t hold, const vesc_io_frame_t *frames, int count) {
+    if (hold == 0) return ESP_ERR_INVALID_ARG;
+
+    vesc_io_item_t item;
+    esp_err_t ret = io_build_batch(&item, frames, count);
+    if (ret != ESP_OK) return ret;
+
+    item.estop_release = hold;
+    return io_enqueue(&item, VESC_IO_PRIO_URGENT);
+}
+
+void vesc_io_get_estop_stats(vesc_io_estop_stats_t *stats) {
+    if (stats == NULL) return;
+
+    portENTER_CRITICAL(&estop_lock);
+    *stats = estop_stats;
+    portEXIT_CRITICAL(&estop_lock);
+}
+
+esp_err_t vesc_io_subscribe(vesc_frame_cb_t cb, void *ctx) {
+    if (cb == NULL) return ESP_ERR_INVALID_ARG;
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&subscribers_lock);
+    for (int i = 0; i < VESC_IO_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].cb == NULL) {
+            subscribers[i].cb = cb;
+            subscribers[i].ctx = ctx;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&subscribers_lock);
+    return ret;
+}
+
+void vesc_io_unsubscribe(vesc_frame_cb_t cb, void *ctx) {
+    portENTER_CRITICAL(&subscribers_lock);
+    for (int i = 0; i < VESC_IO_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].cb == cb && subscribers[i].ctx == ctx) {
+            subscribers[i].cb = NULL;
+            subscribers[i].ctx = NULL;
+        }
+    }
+    portEXIT_CRITICAL(&subscribers_lock);
+}
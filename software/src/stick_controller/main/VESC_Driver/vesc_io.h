@@ -0,0 +1,408 @@
+/**
+ * @file vesc_io.h
+ * @brief VESC I/O engine - single owner of the VESC UART
+ *
+ * One task owns the UART for both directions. Other tasks never touch the
+ * UART directly; they hand frames to the engine:
+ * - Urgent commands (set current, brake, stop) are written ahead of
+ *   anything else the engine has queued.
+ * - Normal traffic (telemetry requests, configuration) is written in order,
+ *   with up to VESC_IO_MAX_INFLIGHT request/response pairs outstanding.
+ *
+ * An e-stop burst (pre-built 0 A frames) can be triggered from an
+ * interrupt. The engine writes it before any queued frame, drops the motor
+ * commands queued before it and holds new ones back until released.
+ *
+ * Replies are matched to requests by packet ID, optionally narrowed by a
+ * match function (e.g. on the controller ID when several VESCs answer with
+ * the same packet ID), and returned through a callback or a future. Every
+ * received frame is also passed to the registered subscribers.
+ */
+
+#ifndef VESC_IO_H
+#define VESC_IO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "vesc_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_IO_MAX_PAYLOAD         64      // Largest payload a queued frame can carry
+#define VESC_IO_MAX_INFLIGHT        4       // Outstanding request/response pairs
+#define VESC_IO_MAX_BATCH           8       // Frames per vesc_io_send_batch() group
+#define VESC_IO_URGENT_QUEUE_LEN    8
+#define VESC_IO_NORMAL_QUEUE_LEN    16
+#define VESC_IO_TX_BUF_SIZE         1024    // UART TX ring, keeps writes non-blocking
+#define VESC_IO_RX_BUF_SIZE         1024
+#define VESC_IO_EVENT_QUEUE_LEN     16
+#define VESC_IO_RX_CHUNK            16      // Header/trailer bytes read per call (payloads go direct)
+#define VESC_IO_RX_TOUT_SYMBOLS     2       // Idle byte-times before a data event
+#define VESC_IO_RX_FULL_THRESH      64      // FIFO level that raises a data event
+#define VESC_IO_RX_STALE_BYTES      (2 * (VESC_IO_RX_FULL_THRESH + VESC_IO_RX_TOUT_SYMBOLS))
+                                            // Byte-times without a data event before an open frame is dropped
+#define VESC_IO_REPLY_SHORT         0xFF    // Reply size limit of ordinary requests
+#define VESC_IO_TASK_PRIO           10
+#define VESC_IO_TASK_STACK          4096
+#define VESC_IO_MAX_SUBSCRIBERS     4
+#define VESC_IO_ESTOP_MAX_BYTES     128     // Pre-built e-stop burst
+#define VESC_IO_TX_FIFO_BYTES       128     // UART hardware TX FIFO, ahead of the ring
+
+// Queue selection for outgoing frames
+typedef enum {
+    VESC_IO_PRIO_URGENT = 0,    // Motor commands: always written first
+    VESC_IO_PRIO_NORMAL,        // Telemetry and housekeeping
+} vesc_io_prio_t;
+
+// Running link counters since boot
+typedef struct {
+    uint32_t frames_ok;         // Valid frames received
+    uint32_t crc_errors;        // Frames dropped on CRC mismatch
+    uint32_t framing_errors;    // Frames with a bad length or end byte
+    uint32_t timeouts;          // Requests that got no reply
+    uint32_t late_replies;      // Replies to timed-out requests, discarded
+    uint32_t bytes_discarded;   // Bytes skipped while looking for a frame start
+    uint32_t resyncs;           // Bad frames rescanned from the byte after their start
+    uint32_t flushes;           // Unfinished frames dropped when the line went idle
+} vesc_io_counters_t;
+
+// E-stop injection timing. Times run from the trigger time given to
+// vesc_io_estop_from_isr().
+typedef struct {
+    uint32_t injected;          // Bursts written
+    uint32_t dropped;           // Motor commands (single frames or batches) discarded behind an e-stop
+    uint32_t burst_bytes;       // Size of the pre-built burst
+    uint32_t ahead_max_bytes;   // Most bytes found in the TX ring at injection
+    uint32_t pickup_max_us;     // Trigger to the engine starting the write
+    uint32_t wire_max_us;       // Trigger to the last bit on the wire (upper bound)
+    uint32_t last_pickup_us;
+    uint32_t last_wire_us;
+} vesc_io_estop_stats_t;
+
+// Link events for a health monitor. Called in the I/O engine task; must not block.
+typedef struct {
+    void (*on_reply)(uint32_t latency_us, void *ctx);  // A request got its reply
+    void (*on_timeout)(void *ctx);                      // A request timed out
+    void *ctx;
+} vesc_io_monitor_t;
+
+/**
+ * @brief Request completion callback
+ *
+ * Runs in the I/O engine task and must not block.
+ *
+ * @param status  ESP_OK, or ESP_ERR_TIMEOUT if no reply arrived in time
+ * @param payload Reply payload (NULL on timeout), valid only during the call
+ * @param len     Reply length
+ * @param ctx     User context given with the request
+ */
+typedef void (*vesc_io_reply_cb_t)(esp_err_t status, const uint8_t *payload, uint16_t len, void *ctx);
+
+/**
+ * @brief Decodes a reply in place for a future
+ *
+ * Runs in the I/O engine task with a view into the RX frame buffer, so the
+ * reply is never copied out. Must not block.
+ *
+ * @param payload Reply payload, valid only during the call
+ * @param len     Reply length
+ * @param ctx     User context given with the request
+ * @return Value returned by vesc_io_future_wait() (0 = failure)
+ */
+typedef int (*vesc_io_reply_view_t)(const uint8_t *payload, uint16_t len, void *ctx);
+
+/**
+ * @brief Decides whether a reply with the right packet ID belongs to a request
+ *
+ * Runs in the I/O engine task. Must not block.
+ *
+ * @param payload Reply payload
+ * @param len     Reply length
+ * @param tag     Tag given with the request
+ * @return true if the reply completes the request
+ */
+typedef bool (*vesc_io_reply_match_t)(const uint8_t *payload, uint16_t len, uint32_t tag);
+
+// One frame of a batch for vesc_io_send_batch()
+typedef struct {
+    const uint8_t *payload;
+    uint16_t len;
+} vesc_io_frame_t;
+
+// Future for waiting on a request from a task. Lives on the caller's stack.
+typedef struct {
+    StaticSemaphore_t done_buf;
+    SemaphoreHandle_t done;
+    esp_err_t status;
+    vesc_io_reply_view_t on_reply;
+    void *reply_ctx;
+    int result;
+} vesc_io_future_t;
+
+/**
+ * @brief Install the UART driver and start the I/O engine task
+ * @return ESP_OK on success
+ */
+esp_err_t vesc_io_init(void);
+
+/**
+ * @brief Stop the I/O engine task and remove the UART driver
+ */
+void vesc_io_deinit(void);
+
+/**
+ * @brief Queue a frame that expects no reply. Never blocks.
+ * @param payload Payload bytes (copied)
+ * @param len     Payload length (<= VESC_IO_MAX_PAYLOAD)
+ * @param prio    Queue to use
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE, or ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t vesc_io_send(const uint8_t *payload, uint16_t len, vesc_io_prio_t prio);
+
+/**
+ * @brief Queue several frames that must leave back to back. Never blocks.
+ *
+ * The frames travel as one queue item, so the batch is queued whole or not
+ * at all whichever core the caller and the engine run on, and the engine
+ * writes them in one go.
+ *
+ * @param frames Frames (payloads copied, together <= VESC_IO_MAX_PAYLOAD)
+ * @param count  Number of frames (<= VESC_IO_MAX_BATCH)
+ * @param prio   Queue to use
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE, or ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t vesc_io_send_batch(const vesc_io_frame_t *frames, int count, vesc_io_prio_t prio);
+
+/**
+ * @brief Queue a request and get the reply through a callback. Never blocks.
+ *
+ * Payloads up to VESC_IO_MAX_PAYLOAD are copied. Longer payloads are
+ * written straight from the caller's buffer, which must then stay valid
+ * until the callback has run.
+ *
+ * @param payload  Payload bytes
+ * @param len      Payload length
+ * @param reply_id Packet ID of the expected reply
+ * @param cb       Completion callback (called exactly once)
+ * @param ctx      User context for the callback
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE, or ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t vesc_io_request(const uint8_t *payload, uint16_t len, uint8_t reply_id,
+                          vesc_io_reply_cb_t cb, void *ctx);
+
+/**
+ * @brief Like vesc_io_request(), but only replies accepted by match complete it
+ * @param payload  Payload bytes
+ * @param len      Payload length
+ * @param reply_id Packet ID of the expected reply
+ * @param match    Match function (NULL accepts any reply with reply_id)
+ * @param tag      Value passed to match
+ * @param cb       Completion callback (called exactly once)
+ * @param ctx      User context for the callback
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE, or ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t vesc_io_request_matched(const uint8_t *payload, uint16_t len, uint8_t reply_id,
+                                  vesc_io_reply_match_t match, uint32_t tag,
+                                  vesc_io_reply_cb_t cb, void *ctx);
+
+/**
+ * @brief Queue a request whose reply is decoded into a future
+ *
+ * The payload buffer must stay valid until vesc_io_future_wait() returns.
+ *
+ * @param future   Future to complete (initialized by this call)
+ * @param payload  Payload bytes
+ * @param len      Payload length
+ * @param reply_id Packet ID of the expected reply
+ * @param on_reply Decoder run on the reply in place (may be NULL)
+ * @param ctx      User context for the decoder
+ * @return ESP_OK if queued
+ */
+esp_err_t vesc_io_request_future(vesc_io_future_t *future, const uint8_t *payload, uint16_t len,
+                                 uint8_t reply_id, vesc_io_reply_view_t on_reply, void *ctx);
+
+/**
+ * @brief Future variant of vesc_io_request_matched()
+ * @param future   Future to complete (initialized by this call)
+ * @param payload  Payload bytes
+ * @param len      Payload length
+ * @param reply_id Packet ID of the expected reply
+ * @param match    Match function (NULL accepts any reply with reply_id)
+ * @param tag      Value passed to match
+ * @param on_reply Decoder run on the reply in place (may be NULL)
+ * @param ctx      User context for the decoder
+ * @return ESP_OK if queued
+ */
+esp_err_t vesc_io_request_future_matched(vesc_io_future_t *future, const uint8_t *payload, uint16_t len,
+                                         uint8_t reply_id, vesc_io_reply_match_t match, uint32_t tag,
+                                         vesc_io_reply_view_t on_reply, void *ctx);
+
+/**
+ * @brief vesc_io_request_future() for a reply that may exceed 255 bytes
+ *
+ * Frames with 16- or 24-bit lengths are only accepted while a request like
+ * this is in flight, and only up to the largest reply_max among them, so
+ * noise cannot open a long frame the rest of the time.
+ *
+ * @param future    Future to complete (initialized by this call)
+ * @param payload   Payload bytes
+ * @param len       Payload length
+ * @param reply_id  Packet ID of the expected reply
+ * @param reply_max Largest reply payload expected (<= VESC_FRAME_MAX_PAYLOAD)
+ * @param on_reply  Decoder run on the reply in place (may be NULL)
+ * @param ctx       User context for the decoder
+ * @return ESP_OK if queued
+ */
+esp_err_t vesc_io_request_future_long(vesc_io_future_t *future, const uint8_t *payload, uint16_t len,
+                                      uint8_t reply_id, uint32_t reply_max,
+                                      vesc_io_reply_view_t on_reply, void *ctx);
+
+/**
+ * @brief Block until a future completes
+ *
+ * The engine always completes a queued request (with a timeout status at
+ * worst), so this returns within VESC_UART_TIMEOUT_MS of the request
+ * reaching the wire.
+ *
+ * @param future Future from vesc_io_request_future()
+ * @return Decoder result, or 0 on timeout/error
+ */
+int vesc_io_future_wait(vesc_io_future_t *future);
+
+/**
+ * @brief Change the UART baud rate, in order with queued normal traffic
+ *
+ * The change is applied once all earlier requests have completed or timed
+ * out, after any queued bytes have left at the old rate.
+ *
+ * @param baud New baud rate
+ * @return ESP_OK if queued
+ */
+esp_err_t vesc_io_set_baudrate(uint32_t baud);
+
+/**
+ * @brief Baud rate the UART is currently running at
+ */
+uint32_t vesc_io_get_baudrate(void);
+
+/**
+ * @brief Read the link counters
+ * @param counters Output
+ */
+void vesc_io_get_counters(vesc_io_counters_t *counters);
+
+/**
+ * @brief Install the link event monitor (one at a time)
+ * @param monitor Monitor (must stay valid), or NULL to remove it
+ */
+void vesc_io_set_monitor(const vesc_io_monitor_t *monitor);
+
+/**
+ * @brief Pre-encode the e-stop burst
+ *
+ * Call once the I/O engine is running and before the first trigger.
+ *
+ * @param frames Payloads of the burst, encoded into frames here
+ * @param count  Number of frames
+ * @return ESP_OK, or ESP_ERR_INVALID_SIZE if the burst exceeds VESC_IO_ESTOP_MAX_BYTES
+ */
+esp_err_t vesc_io_estop_prepare(const vesc_io_frame_t *frames, int count);
+
+/**
+ * @brief Write the e-stop burst ahead of everything queued. ISR-safe.
+ *
+ * Motor commands (urgent queue) already queued are dropped, and new ones
+ * are dropped until the release batch of this e-stop goes out (see
+ * vesc_io_estop_release()). Normal traffic continues.
+ *
+ * The time to the wire is bounded by what the UART already holds: the TX
+ * ring bytes seen at injection plus a full hardware FIFO, at the current
+ * baud rate.
+ *
+ * @param trigger_us Time the e-stop was due, esp_timer_get_time(); the stats run from it
+ * @return true if a higher priority task was woken (yield from the ISR)
+ */
+bool vesc_io_estop_from_isr(int64_t trigger_us);
+
+/**
+ * @brief The e-stop whose hold is in force
+ * @return Non-zero tag of the held e-stop, 0 if motor commands go through
+ */
+uint32_t vesc_io_estop_held(void);
+
+/**
+ * @brief Queue the motor command batch that ends an e-stop hold
+ *
+ * The hold ends as the batch is taken from the urgent queue: commands
+ * queued before it are still dropped, it is the first on the wire after
+ * the burst. If another e-stop has fired since hold was read, the batch is
+ * dropped and that e-stop's hold stays. Send 0 A, from the setpoint source
+ * once its own setpoint is 0 A. Never blocks.
+ *
+ * @param hold   Tag from vesc_io_estop_held()
+ * @param frames Payloads of the batch
+ * @param count  Number of frames (<= VESC_IO_MAX_BATCH)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for hold 0, ESP_ERR_INVALID_SIZE, or
+ *         ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t vesc_io_estop_release(uint32_t hold, const vesc_io_frame_t *frames, int count);
+
+/**
+ * @brief Pre-encode the motor halt batch
+ *
+ * Call once the I/O engine is running.
+ *
+ * @param frames Payloads of the batch, normally 0 A to every controller
+ * @param count  Number of frames (<= VESC_IO_MAX_BATCH)
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE if it does not fit one batch, or
+ *         ESP_ERR_INVALID_STATE if already prepared
+ */
+esp_err_t vesc_io_halt_prepare(const vesc_io_frame_t *frames, int count);
+
+/**
+ * @brief Set or clear the motor halt. Lock-free; not for interrupts.
+ *
+ * Setting it writes the halt batch ahead of the queued motor commands,
+ * and every motor command taken from the urgent queue afterwards is
+ * replaced by the halt batch, until cleared. An e-stop hold still drops
+ * them instead.
+ *
+ * @param halted true to halt, false to let motor commands through again
+ */
+void vesc_io_halt(bool halted);
+
+/**
+ * @brief Read the e-stop timing
+ * @param stats Output
+ */
+void vesc_io_get_estop_stats(vesc_io_estop_stats_t *stats);
+
+/**
+ * @brief Register a callback for every valid frame received from the VESC
+ *
+ * Callbacks run in the I/O engine task; the payload is only valid during
+ * the call and callbacks must not block.
+ *
+ * @param cb  Frame callback
+ * @param ctx User context passed to the callback
+ * @return ESP_OK, or ESP_ERR_NO_MEM if all subscriber slots are used
+ */
+esp_err_t vesc_io_subscribe(vesc_frame_cb_t cb, void *ctx);
+
+/**
+ * @brief Remove a callback registered with vesc_io_subscribe()
+ * @param cb  Frame callback
+ * @param ctx User context it was registered with
+ */
+void vesc_io_unsubscribe(vesc_frame_cb_t cb, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_IO_H
@@ -0,0 +1,116 @@
+/**
+ * @file vesc_link.c
+ * @brief VESC UART link-speed manager
+ */
+
+#include "vesc_link.h"
+#include "vesc_uart.h"
+#include "vesc_io.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "vesc_link";
+
+// Standard rates, fastest first
+static const uint32_t standard_rates[] = {
+    921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600,
+};
+
+#define MAX_LINK_RATES  (sizeof(standard_rates) / sizeof(standard_rates[0]) + 1)
+
+static uint32_t link_rates[MAX_LINK_RATES];    // Candidates, fastest first, fallback last
+static int link_rate_count = 0;
+static int rate_index = 0;
+static bool established = false;
+static vesc_io_counters_t window_start;
+static int64_t last_probe_us = 0;
+
+static void link_build_rates(void) {
+    link_rate_count = 0;
+    for (size_t i = 0; i < sizeof(standard_rates) / sizeof(standard_rates[0]); i++) {
+        if (standard_rates[i] <= CONFIG_VESC_UART_BAUD_MAX &&
+            standard_rates[i] > CONFIG_VESC_UART_BAUD_FALLBACK) {
+            link_rates[link_rate_count++] = standard_rates[i];
+        }
+    }
+    link_rates[link_rate_count++] = CONFIG_VESC_UART_BAUD_FALLBACK;
+}
+
+static bool link_probe_rate(uint32_t baud) {
+    vesc_fw_version_t fw;
+
+    vesc_io_set_baudrate(baud);
+    for (int i = 0; i < CONFIG_VESC_LINK_PROBE_ATTEMPTS; i++) {
+        if (vesc_get_fw_version(&fw)) {
+            ESP_LOGI(TAG, "VESC FW %d.%02d answered at %lu baud",
+                     fw.major, fw.minor, (unsigned long)baud);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Probe every candidate once, starting at index first and wrapping to the top
+static bool link_probe_from(int first) {
+    last_probe_us = esp_timer_get_time();
+
+    for (int n = 0; n < link_rate_count; n++) {
+        int i = (first + n) % link_rate_count;
+        if (link_probe_rate(link_rates[i])) {
+            rate_index = i;
+            established = true;
+            vesc_io_get_counters(&window_start);
+            return true;
+        }
+    }
+
+    ESP_LOGW(TAG, "No baud rate answered, staying at %lu", (unsigned long)CONFIG_VESC_UART_BAUD_FALLBACK);
+    rate_index = link_rate_count - 1;
+    vesc_io_set_baudrate(link_rates[rate_index]);
+    established = false;
+    vesc_io_get_counters(&window_start);
+    return false;
+}
+
+esp_err_t vesc_link_start(void) {
+    link_build_rates();
+    return link_probe_from(0) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void vesc_link_update(void) {
+    if (link_rate_count == 0) return;
+
+    if (!established) {
+        if ((esp_timer_get_time() - last_probe_us) >= VESC_LINK_REPROBE_INTERVAL_MS * 1000LL) {
+            link_probe_from(0);
+        }
+        return;
+    }
+
+    vesc_io_counters_t now;
+    vesc_io_get_counters(&now);
+
+    uint32_t ok = now.frames_ok - window_start.frames_ok;
+    uint32_t bad = (now.crc_errors - window_start.crc_errors) +
+                   (now.timeouts - window_start.timeouts);
+    if (ok + bad < CONFIG_VESC_LINK_ERROR_WINDOW) {
+        return;
+    }
+    window_start = now;
+
+    // Only a link that still answers is degraded; total silence is a missing VESC
+    if (ok > 0 && bad * 100 > (ok + bad) * CONFIG_VESC_LINK_ERROR_PCT_MAX &&
+        rate_index < link_rate_count - 1) {
+        ESP_LOGW(TAG, "Link error rate %lu%% at %lu baud, stepping down",
+                 (unsigned long)(bad * 100 / (ok + bad)), (unsigned long)link_rates[rate_index]);
+        link_probe_from(rate_index + 1);
+    }
+}
+
+uint32_t vesc_link_get_baud(void) {
+    return vesc_io_get_baudrate();
+}
+
+bool vesc_link_is_established(void) {
+    return established;
+}
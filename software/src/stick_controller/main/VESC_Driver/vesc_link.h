@@ -0,0 +1,65 @@
+/**
+ * @file vesc_link.h
+ * @brief VESC UART link-speed manager
+ *
+ * At start-up the standard rates from CONFIG_VESC_UART_BAUD_MAX down to
+ * CONFIG_VESC_UART_BAUD_FALLBACK are probed with COMM_FW_VERSION, fastest
+ * first, and the link stays at the first rate the VESC answers on.
+ *
+ * While running, the share of failed transactions (CRC errors and
+ * timeouts) is measured over a window. If it goes above
+ * CONFIG_VESC_LINK_ERROR_PCT_MAX while the VESC is still answering, the
+ * manager steps down to the next slower rate that answers.
+ *
+ * The VESC only listens on its configured app_uart_baudrate, so stepping
+ * down only finds a new rate if the VESC answers there; otherwise the
+ * probe falls back to the rates above, which re-synchronises with the
+ * VESC at whatever rate it is actually using.
+ */
+
+#ifndef VESC_LINK_H
+#define VESC_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_LINK_REPROBE_INTERVAL_MS   5000    // Retry period while no rate answers
+
+/**
+ * @brief Probe the candidate baud rates and settle on the fastest that works
+ *
+ * Blocks for up to CONFIG_VESC_LINK_PROBE_ATTEMPTS request timeouts per
+ * candidate rate. Call from a task after vesc_uart_init().
+ *
+ * @return ESP_OK if a rate answered, ESP_ERR_NOT_FOUND if none did (the
+ *         link is left at the fallback rate)
+ */
+esp_err_t vesc_link_start(void);
+
+/**
+ * @brief Evaluate the error rate and step down / re-probe when needed
+ *
+ * Call periodically from the task that polls the VESC.
+ */
+void vesc_link_update(void);
+
+/**
+ * @brief Baud rate the link is currently running at
+ */
+uint32_t vesc_link_get_baud(void);
+
+/**
+ * @brief true once a probe has found a working rate
+ */
+bool vesc_link_is_established(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_LINK_H
@@ -0,0 +1,120 @@
+/**
+ * @file vesc_poll.c
+ * @brief Adaptive telemetry poll scheduler
+ */
+
+#include "vesc_poll.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void vesc_poll_init(vesc_poll_t *sched, uint32_t full_mask, int64_t now_us) {
+    memset(sched, 0, sizeof(*sched));
+    sched->full_mask = full_mask;
+    sched->mode = VESC_POLL_DISCONNECTED;
+    sched->interval_ms = VESC_POLL_IDLE_MS;
+    sched->window_start_us = now_us;
+    sched->stats.mode = sched->mode;
+    sched->stats.interval_ms = sched->interval_ms;
+}
+
+uint32_t vesc_poll_next_mask(vesc_poll_t *sched) {
+    if (sched->mode != VESC_POLL_ACTIVE) {
+        return sched->full_mask;
+    }
+
+    // Fast fields every time, everything else (temps, Ah, fault) every Nth poll
+    uint32_t fast = sched->full_mask & VESC_POLL_FAST_FIELDS;
+    if (fast == 0 || (sched->active_count % VESC_POLL_FULL_EVERY) == 0) {
+        return sched->full_mask;
+    }
+    return fast;
+}
+
+static void poll_measure(vesc_poll_t *sched, bool answered, int64_t now_us) {
+    sched->stats.polls++;
+    sched->window_polls++;
+    if (answered) {
+        sched->window_answered++;
+    }
+
+    int64_t elapsed_us = now_us - sched->window_start_us;
+    if (elapsed_us >= VESC_POLL_RATE_WINDOW_MS * 1000LL) {
+        sched->stats.rate_mhz = (uint32_t)((uint64_t)sched->window_polls * 1000000000ULL / elapsed_us);
+        sched->stats.answer_pct = sched->window_answered * 100 / sched->window_polls;
+        sched->window_start_us = now_us;
+        sched->window_polls = 0;
+        sched->window_answered = 0;
+    }
+}
+
+uint32_t vesc_poll_update(vesc_poll_t *sched, bool answered, const vesc_data_t *data,
+                          float commanded_current, int64_t now_us) {
+    poll_measure(sched, answered, now_us);
+
+    if (!answered || data == NULL) {
+        // Back off while nobody answers: idle rate first, then doubling
+        if (sched->mode == VESC_POLL_DISCONNECTED) {
+            sched->interval_ms *= 2;
+            if (sched->interval_ms > VESC_POLL_DISCONNECTED_MAX_MS) {
+                sched->interval_ms = VESC_POLL_DISCONNECTED_MAX_MS;
+            }
+        } else {
+            sched->interval_ms = VESC_POLL_IDLE_MS;
+        }
+        sched->mode = VESC_POLL_DISCONNECTED;
+        sched->have_prev = false;
+    } else {
+        bool trigger = fabsf(commanded_current) > VESC_POLL_CURRENT_ON_A;
+
+        if (sched->have_prev && now_us > sched->prev_us) {
+            // Slew limits compared as |delta| * 1 s > limit * dt, in the scaled units of the wire
+            int64_t dt_us = now_us - sched->prev_us;
+            int64_t dcurrent = llabs((int64_t)data->avg_motor_current - sched->prev_current);
+            int64_t drpm = llabs((int64_t)data->rpm - sched->prev_rpm);
+            if (dcurrent * 1000000 > (int64_t)VESC_POLL_DIDT_A_PER_S * VESC_FX2_SCALE * dt_us ||
+                drpm * 1000000 > (int64_t)VESC_POLL_DRPM_PER_S * dt_us) {
+                trigger = true;
+            }
+        }
+        sched->prev_current = data->avg_motor_current;
+        sched->prev_rpm = data->rpm;
+        sched->prev_us = now_us;
+        sched->have_prev = true;
+
+        if (trigger) {
+            sched->active_until_us = now_us + VESC_POLL_ACTIVE_HOLD_MS * 1000LL;
+        }
+
+        if (now_us < sched->active_until_us) {
+            if (sched->mode != VESC_POLL_ACTIVE) {
+                sched->active_count = 0;
+            }
+            sched->mode = VESC_POLL_ACTIVE;
+            sched->interval_ms = VESC_POLL_ACTIVE_MS;
+            sched->active_count++;
+        } else {
+            sched->mode = VESC_POLL_IDLE;
+            sched->interval_ms = VESC_POLL_IDLE_MS;
+        }
+    }
+
+    sched->stats.mode = sched->mode;
+    sched->stats.interval_ms = sched->interval_ms;
+    return sched->interval_ms;
+}
+
+void vesc_poll_get_stats(const vesc_poll_t *sched, vesc_poll_stats_t *stats) {
+    if (stats != NULL) {
+        *stats = sched->stats;
+    }
+}
+
+const char *vesc_poll_mode_to_string(vesc_poll_mode_t mode) {
+    switch (mode) {
+        case VESC_POLL_DISCONNECTED: return "DISCONNECTED";
+        case VESC_POLL_IDLE:         return "IDLE";
+        case VESC_POLL_ACTIVE:       return "ACTIVE";
+        default:                     return "?";
+    }
+}
@@ -0,0 +1,118 @@
+/**
+ * @file vesc_poll.h
+ * @brief Adaptive telemetry poll scheduler
+ *
+ * Chooses how often and which fields to poll from the motor state:
+ * - ACTIVE: a current is commanded, or motor current / RPM is changing
+ *   fast. Polls every VESC_POLL_ACTIVE_MS with the fast-changing fields,
+ *   and the full field set every VESC_POLL_FULL_EVERY polls.
+ * - IDLE: nothing happening. Polls the full field set every
+ *   VESC_POLL_IDLE_MS (short enough to keep the VESC timeout fed).
+ * - DISCONNECTED: no answer. Backs off from VESC_POLL_IDLE_MS up to
+ *   VESC_POLL_DISCONNECTED_MAX_MS.
+ *
+ * The achieved poll rate is measured and can be read back with
+ * vesc_poll_get_stats().
+ */
+
+#ifndef VESC_POLL_H
+#define VESC_POLL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vesc_uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VESC_POLL_ACTIVE_MS             25      // 40 Hz
+#define VESC_POLL_IDLE_MS               500     // 2 Hz
+#define VESC_POLL_DISCONNECTED_MAX_MS   2000
+#define VESC_POLL_FULL_EVERY            10      // Full field set every Nth active poll
+#define VESC_POLL_ACTIVE_HOLD_MS        1000    // Stay active this long after the last trigger
+#define VESC_POLL_CURRENT_ON_A          0.1f    // Commanded current that counts as running
+#define VESC_POLL_DIDT_A_PER_S          20      // Motor current slew that counts as changing
+#define VESC_POLL_DRPM_PER_S            2000    // eRPM slew that counts as changing
+#define VESC_POLL_RATE_WINDOW_MS        1000    // Window for the achieved-rate measurement
+
+// Fields polled on every active poll
+#define VESC_POLL_FAST_FIELDS   (VESC_VALUE_MOTOR_CURRENT | VESC_VALUE_INPUT_CURRENT | \
+                                 VESC_VALUE_DUTY_CYCLE | VESC_VALUE_RPM | VESC_VALUE_INPUT_VOLTAGE)
+
+typedef enum {
+    VESC_POLL_DISCONNECTED = 0,
+    VESC_POLL_IDLE,
+    VESC_POLL_ACTIVE,
+} vesc_poll_mode_t;
+
+// Published scheduler state
+typedef struct {
+    vesc_poll_mode_t mode;
+    uint32_t interval_ms;       // Current target poll interval
+    uint32_t rate_mhz;          // Achieved poll rate over the last window (milli-Hz)
+    uint32_t answer_pct;        // Share of polls answered over the last window
+    uint32_t polls;             // Polls since init
+} vesc_poll_stats_t;
+
+// Scheduler instance
+typedef struct {
+    vesc_poll_mode_t mode;
+    uint32_t full_mask;         // Every field the application wants
+    uint32_t interval_ms;
+    uint32_t active_count;      // Active polls since the last full poll
+    int64_t active_until_us;
+    bool have_prev;
+    vesc_fx2_t prev_current;
+    int32_t prev_rpm;
+    int64_t prev_us;
+    int64_t window_start_us;
+    uint32_t window_polls;
+    uint32_t window_answered;
+    vesc_poll_stats_t stats;
+} vesc_poll_t;
+
+/**
+ * @brief Initialize a scheduler
+ * @param sched     Scheduler instance
+ * @param full_mask Fields the application wants (VESC_VALUE_* bits)
+ * @param now_us    Current time (esp_timer_get_time())
+ */
+void vesc_poll_init(vesc_poll_t *sched, uint32_t full_mask, int64_t now_us);
+
+/**
+ * @brief Fields to request on the next poll
+ * @param sched Scheduler instance
+ * @return VESC_VALUE_* mask
+ */
+uint32_t vesc_poll_next_mask(vesc_poll_t *sched);
+
+/**
+ * @brief Feed the result of a poll and get the time until the next one
+ * @param sched             Scheduler instance
+ * @param answered          The VESC answered the poll
+ * @param data              Telemetry after the poll
+ * @param commanded_current Current the rider is commanding (A)
+ * @param now_us            Current time (esp_timer_get_time())
+ * @return Milliseconds until the next poll
+ */
+uint32_t vesc_poll_update(vesc_poll_t *sched, bool answered, const vesc_data_t *data,
+                          float commanded_current, int64_t now_us);
+
+/**
+ * @brief Read the published scheduler state
+ * @param sched Scheduler instance
+ * @param stats Output
+ */
+void vesc_poll_get_stats(const vesc_poll_t *sched, vesc_poll_stats_t *stats);
+
+/**
+ * @brief Mode name for logs
+ */
+const char *vesc_poll_mode_to_string(vesc_poll_mode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_POLL_H
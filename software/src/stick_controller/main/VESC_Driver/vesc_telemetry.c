@@ -0,0 +1,71 @@
+/**
+ * @file vesc_telemetry.c
+ * @brief Consistent telemetry snapshots shared between tasks
+ */
+
+#include "vesc_telemetry.h"
+#include <stdatomic.h>
+#include <string.h>
+
+typedef struct {
+    atomic_uint seq;            // Odd while the writer is filling snap
+    vesc_telemetry_t snap;
+} telemetry_buf_t;
+
+static telemetry_buf_t tel_buf[2];
+static atomic_uint tel_latest;          // Buffer readers copy from
+static uint32_t tel_published = 0;      // Writer only
+
+void vesc_telemetry_publish(const vesc_data_t *data, int count, uint32_t answered, bool connected,
+                            int64_t sample_us) {
+    if (count < 0) count = 0;
+    if (count > VESC_MAX_CONTROLLERS) count = VESC_MAX_CONTROLLERS;
+
+    unsigned idx = atomic_load_explicit(&tel_latest, memory_order_relaxed) ^ 1;
+    telemetry_buf_t *buf = &tel_buf[idx];
+
+    atomic_fetch_add_explicit(&buf->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    buf->snap.seq = ++tel_published;
+    buf->snap.sample_us = sample_us;
+    buf->snap.connected = connected;
+    buf->snap.count = count;
+    buf->snap.answered = answered;
+    if (data != NULL && count > 0) {
+        memcpy(buf->snap.data, data, count * sizeof(data[0]));
+    }
+
+    atomic_fetch_add_explicit(&buf->seq, 1, memory_order_release);
+    atomic_store_explicit(&tel_latest, idx, memory_order_release);
+}
+
+bool vesc_telemetry_read(vesc_telemetry_t *out) {
+    if (out == NULL) return false;
+
+    while (1) {
+        unsigned idx = atomic_load_explicit(&tel_latest, memory_order_acquire);
+        const telemetry_buf_t *buf = &tel_buf[idx];
+        unsigned before = atomic_load_explicit(&buf->seq, memory_order_acquire);
+        if (before & 1) {
+            continue;           // Overtaken: the writer is already refilling it
+        }
+
+        memcpy(out, &buf->snap, sizeof(*out));
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&buf->seq, memory_order_relaxed) == before) {
+            break;
+        }
+    }
+    return out->seq != 0;
+}
+
+int64_t vesc_telemetry_age_us(const vesc_telemetry_t *snap, int64_t now_us) {
+    if (snap == NULL || snap->seq == 0) return INT64_MAX;
+    return now_us - snap->sample_us;
+}
+
+bool vesc_telemetry_is_fresh(const vesc_telemetry_t *snap, int64_t now_us, int64_t max_age_us) {
+    return snap != NULL && snap->connected && vesc_telemetry_age_us(snap, now_us) <= max_age_us;
+}
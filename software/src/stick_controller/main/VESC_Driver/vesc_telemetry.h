@@ -0,0 +1,79 @@
+/**
+ * @file vesc_telemetry.h
+ * @brief Consistent telemetry snapshots shared between tasks
+ *
+ * vesc_task fills its own vesc_data_t array field by field while it polls.
+ * When a round is done it publishes the array, the answered mask and the
+ * link state as one snapshot. Readers get a copy of the latest complete
+ * snapshot without a mutex and without ever waiting for the writer.
+ *
+ * Two buffers, each with a sequence counter (odd while being written). The
+ * writer fills the buffer readers are not pointed at, then flips the
+ * pointer. A reader copies the buffer the pointer names and retries only if
+ * its counter moved during the copy, i.e. if two snapshots were published
+ * in that time. There is a single writer.
+ *
+ * Every snapshot carries a number and the time its round finished.
+ * Consumers check the age with vesc_telemetry_is_fresh() and treat an old
+ * snapshot like a link loss: it means vesc_task itself has stalled.
+ */
+
+#ifndef VESC_TELEMETRY_H
+#define VESC_TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vesc_uart.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t seq;                               // Snapshot number, 1 for the first publish
+    int64_t sample_us;                          // End of the poll round (esp_timer_get_time())
+    bool connected;                             // UART VESC answered (directly or by CAN status)
+    int count;                                  // Valid entries in data[]
+    uint32_t answered;                          // Bit i: data[i] is from this round
+    vesc_data_t data[VESC_MAX_CONTROLLERS];
+} vesc_telemetry_t;
+
+/**
+ * @brief Publish a poll round (single writer)
+ * @param data      Telemetry per controller
+ * @param count     Entries in data (<= VESC_MAX_CONTROLLERS)
+ * @param answered  Bit i: data[i] answered this round
+ * @param connected Link state to publish
+ * @param sample_us Time of the round
+ */
+void vesc_telemetry_publish(const vesc_data_t *data, int count, uint32_t answered, bool connected,
+                            int64_t sample_us);
+
+/**
+ * @brief Copy the latest snapshot
+ * @param out Output
+ * @return false (and out zeroed) before the first publish
+ */
+bool vesc_telemetry_read(vesc_telemetry_t *out);
+
+/**
+ * @brief Age of a snapshot
+ * @param snap   Snapshot from vesc_telemetry_read()
+ * @param now_us esp_timer_get_time()
+ * @return Microseconds since the snapshot was taken, or INT64_MAX if it never was
+ */
+int64_t vesc_telemetry_age_us(const vesc_telemetry_t *snap, int64_t now_us);
+
+/**
+ * @brief Whether a snapshot is connected and recent enough to show or act on
+ * @param snap       Snapshot from vesc_telemetry_read()
+ * @param now_us     esp_timer_get_time()
+ * @param max_age_us Oldest accepted snapshot
+ */
+bool vesc_telemetry_is_fresh(const vesc_telemetry_t *snap, int64_t now_us, int64_t max_age_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // VESC_TELEMETRY_H
@@ -6,335 +6,356 @@
  */
 
 #include "vesc_uart.h"
-#include "driver/uart.h"
+#include "vesc_io.h"
+#include "vesc_codec.h"
+#include "vesc_caps.h"
 #include "esp_log.h"
 #include "esp_err.h"
-#include "esp_timer.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include <stdatomic.h>
 #include <string.h>
-#include <math.h>
 
 static const char *TAG = "vesc_uart";
 
-// VESC Communication Commands
-typedef enum {
-    COMM_FW_VERSION = 0,
-    COMM_JUMP_TO_BOOTLOADER,
-    COMM_ERASE_NEW_APP,
-    COMM_WRITE_NEW_APP_DATA,
-    COMM_GET_VALUES = 4,
-    COMM_SET_DUTY = 5,
-    COMM_SET_CURRENT = 6,
-    COMM_SET_CURRENT_BRAKE = 7,
-    COMM_SET_RPM = 8,
-    COMM_SET_POS = 9,
-    COMM_SET_HANDBRAKE = 10,
-    COMM_ALIVE = 30,
-    COMM_FORWARD_CAN = 34,
-} vesc_comm_packet_id_t;
-
-// CRC16 lookup table
-static const uint16_t crc16_tab[] = {
-    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
-    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
-    0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
-    0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
-    0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
-    0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
-    0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
-    0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
-    0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
-    0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
-    0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
-    0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
-    0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
-    0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
-    0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
-    0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
-    0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
-    0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
-    0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
-    0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
-    0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
-    0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
-    0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
-    0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
-    0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
-    0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
-    0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
-    0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
-    0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
-    0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
-    0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
-    0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
-};
-
-// Buffer helper functions
-static void buffer_append_int32(uint8_t *buffer, int32_t number, int32_t *index) {
-    buffer[(*index)++] = (uint8_t)(number >> 24);
-    buffer[(*index)++] = (uint8_t)(number >> 16);
-    buffer[(*index)++] = (uint8_t)(number >> 8);
-    buffer[(*index)++] = (uint8_t)(number);
-}
-
-static int16_t buffer_get_int16(const uint8_t *buffer, int32_t *index) {
-    int16_t res = ((uint16_t)buffer[*index]) << 8 | ((uint16_t)buffer[*index + 1]);
-    *index += 2;
-    return res;
-}
-
-static int32_t buffer_get_int32(const uint8_t *buffer, int32_t *index) {
-    int32_t res = ((uint32_t)buffer[*index]) << 24 |
-                  ((uint32_t)buffer[*index + 1]) << 16 |
-                  ((uint32_t)buffer[*index + 2]) << 8 |
-                  ((uint32_t)buffer[*index + 3]);
-    *index += 4;
-    return res;
-}
-
-static float buffer_get_float16(const uint8_t *buffer, float scale, int32_t *index) {
-    return (float)buffer_get_int16(buffer, index) / scale;
-}
-
-static float buffer_get_float32(const uint8_t *buffer, float scale, int32_t *index) {
-    return (float)buffer_get_int32(buffer, index) / scale;
-}
-
-static uint16_t crc16(const uint8_t *buf, uint16_t len) {
-    uint16_t cksum = 0;
-    for (uint16_t i = 0; i < len; i++) {
-        cksum = crc16_tab[(((cksum >> 8) ^ buf[i]) & 0xFF)] ^ (cksum << 8);
+// Controller ID of the UART VESC, learnt from its values replies; -1 while unknown
+static atomic_int local_controller_id = -1;
+
+// Start a payload, prefixed with COMM_FORWARD_CAN for controllers on CAN.
+// Returns the index where the command byte goes.
+static int32_t vesc_payload_begin(uint8_t *payload, int can_id) {
+    int32_t index = 0;
+    if (can_id != VESC_CAN_LOCAL) {
+        payload[index++] = COMM_FORWARD_CAN;
+        payload[index++] = (uint8_t)can_id;
     }
-    return cksum;
+    return index;
 }
 
-// Send payload with framing
-static int vesc_pack_send_payload(const uint8_t *payload, int len_pay) {
-    uint16_t crc_payload = crc16(payload, len_pay);
-    uint8_t message[VESC_UART_BUF_SIZE];
-    int count = 0;
-
-    if (len_pay <= 256) {
-        message[count++] = 2;
-        message[count++] = (uint8_t)len_pay;
-    } else {
-        message[count++] = 3;
-        message[count++] = (uint8_t)(len_pay >> 8);
-        message[count++] = (uint8_t)(len_pay & 0xFF);
+// Queue a command frame on the I/O engine (never blocks)
+static void vesc_send_command(const uint8_t *payload, uint16_t len, vesc_io_prio_t prio) {
+    esp_err_t ret = vesc_io_send(payload, len, prio);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Command 0x%02X dropped: %s", payload[0], esp_err_to_name(ret));
     }
+}
 
-    memcpy(message + count, payload, len_pay);
-    count += len_pay;
-
-    message[count++] = (uint8_t)(crc_payload >> 8);
-    message[count++] = (uint8_t)(crc_payload & 0xFF);
-    message[count++] = 3;
-
-    return uart_write_bytes(VESC_UART_NUM, message, count);
-}
-
-// Receive and unpack UART message
-static int vesc_receive_uart_message(uint8_t *payload_received) {
-    uint8_t message[VESC_UART_BUF_SIZE];
-    uint16_t counter = 0;
-    uint16_t end_message = 256;
-    uint16_t len_payload = 0;
-    bool message_read = false;
-
-    int64_t start_time = esp_timer_get_time();
-    int64_t timeout_us = VESC_UART_TIMEOUT_MS * 1000;
-
-    while ((esp_timer_get_time() - start_time) < timeout_us && !message_read) {
-        int len = uart_read_bytes(VESC_UART_NUM, message + counter, 1, pdMS_TO_TICKS(10));
-        if (len > 0) {
-            counter++;
-
-            if (counter == 2) {
-                switch (message[0]) {
-                    case 2:
-                        end_message = message[1] + 5;
-                        len_payload = message[1];
-                        break;
-                    case 3:
-                        ESP_LOGW(TAG, "Message > 256 bytes not supported");
-                        break;
-                    default:
-                        ESP_LOGW(TAG, "Invalid start byte: %d", message[0]);
-                        break;
-                }
-            }
-
-            if (counter >= sizeof(message)) {
-                break;
-            }
-
-            if (counter == end_message && message[end_message - 1] == 3) {
-                message_read = true;
-                break;
-            }
-        }
+// Send a request and wait for the reply with the given packet ID. The
+// reply is decoded in place by decode (in the I/O task), never copied out.
+static bool vesc_request(const uint8_t *payload, uint16_t len, uint8_t reply_id,
+                         vesc_io_reply_view_t decode, void *ctx) {
+    vesc_io_future_t future;
+    if (vesc_io_request_future(&future, payload, len, reply_id, decode, ctx) != ESP_OK) {
+        return false;
     }
+    return vesc_io_future_wait(&future) != 0;
+}
 
-    if (!message_read) {
-        ESP_LOGD(TAG, "VESC UART timeout");
-        return 0;
-    }
+// Public API implementation
 
-    // Verify CRC
-    uint16_t crc_message = (message[end_message - 3] << 8) | message[end_message - 2];
-    memcpy(payload_received, &message[2], message[1]);
-    uint16_t crc_payload = crc16(payload_received, message[1]);
+esp_err_t vesc_uart_init(void) {
+    return vesc_io_init();
+}
 
-    if (crc_payload == crc_message) {
-        return len_payload;
+void vesc_uart_deinit(void) {
+    vesc_io_deinit();
+}
+
+// Fields not in the reply are left untouched in data
+static int decode_values(const uint8_t *message, uint16_t len, void *ctx) {
+    // Layout depends on the firmware (newer firmware appends more)
+    return vesc_codec_decode(vesc_caps_values_msg(), message, len, ctx, NULL);
+}
+
+static int decode_values_selective(const uint8_t *message, uint16_t len, void *ctx) {
+    // Reply echoes the mask it actually encoded
+    return vesc_codec_decode(&vesc_msg_values_selective, message, len, ctx, NULL);
+}
+
+// Generic reply target for blocking requests
+typedef struct {
+    const vesc_codec_msg_t *msg;
+    void *data;
+} codec_reply_t;
+
+static int decode_codec(const uint8_t *message, uint16_t len, void *ctx) {
+    codec_reply_t *reply = (codec_reply_t *)ctx;
+    return vesc_codec_decode(reply->msg, message, len, reply->data, NULL);
+}
+
+// Controller ID carried in a values reply, or -1 if the reply has none
+static int vesc_reply_controller_id(const uint8_t *message, uint16_t len) {
+    const vesc_codec_msg_t *msg;
+
+    if (len < 1) {
+        return -1;
+    } else if (message[0] == COMM_GET_VALUES && vesc_caps_has(VESC_CAP_CONTROLLER_ID)) {
+        msg = &vesc_msg_values;
+    } else if (message[0] == COMM_GET_VALUES_SELECTIVE) {
+        msg = &vesc_msg_values_selective;
     } else {
-        ESP_LOGW(TAG, "CRC mismatch: got %04X, expected %04X", crc_payload, crc_message);
-        return 0;
+        return -1;
     }
+
+    int32_t index = vesc_codec_field_offset(msg, message, len, __builtin_ctzl(VESC_VALUE_CONTROLLER_ID));
+    return index < 0 ? -1 : message[index];
 }
 
-// Public API implementation
+// Forwarded replies come back with the same packet ID from every
+// controller, so they are told apart by the controller ID they carry
+static bool match_controller_id(const uint8_t *message, uint16_t len, uint32_t tag) {
+    return vesc_reply_controller_id(message, len) == (int)tag;
+}
 
-esp_err_t vesc_uart_init(void) {
-    uart_config_t uart_config = {
-        .baud_rate = VESC_UART_BAUD,
-        .data_bits = UART_DATA_8_BITS,
-        .parity    = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .source_clk = UART_SCLK_DEFAULT,
-    };
-
-    esp_err_t ret;
-    
-    ret = uart_param_config(VESC_UART_NUM, &uart_config);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "UART param config failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
+// Values replies carry the controller ID (selective requests always ask
+// for it), so forwarded ones can be told apart
+static bool vesc_values_pipelined(void) {
+    return vesc_caps_has(VESC_CAP_VALUES_SELECTIVE) || vesc_caps_has(VESC_CAP_CONTROLLER_ID);
+}
 
-    ret = uart_set_pin(VESC_UART_NUM, VESC_UART_TX_PIN, VESC_UART_RX_PIN, 
-                       UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "UART set pin failed: %s", esp_err_to_name(ret));
-        return ret;
+// Every values request asks for the controller ID. Forwarded replies are
+// matched on the CAN ID; the local reply on the UART VESC's own ID once it
+// is known, and on the packet ID alone until then.
+static esp_err_t vesc_values_request(vesc_io_future_t *future, int can_id,
+                                     vesc_data_t *data, uint32_t mask) {
+    uint8_t payload[7];
+    int32_t index = vesc_payload_begin(payload, can_id);
+    int match_id = (can_id != VESC_CAN_LOCAL) ? can_id : atomic_load(&local_controller_id);
+    vesc_io_reply_match_t match = (match_id >= 0) ? match_controller_id : NULL;
+
+    if (!vesc_caps_has(VESC_CAP_VALUES_SELECTIVE)) {
+        // Older firmware: the full reply, in the layout of its version
+        payload[index++] = COMM_GET_VALUES;
+        if (!vesc_caps_has(VESC_CAP_CONTROLLER_ID)) {
+            match = NULL;
+        }
+        return vesc_io_request_future_matched(future, payload, index, COMM_GET_VALUES,
+                                              match, (uint32_t)match_id, decode_values, data);
     }
 
-    ret = uart_driver_install(VESC_UART_NUM, VESC_UART_BUF_SIZE * 2, 0, 0, NULL, 0);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "UART driver install failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
+    vesc_codec_mask_t request = { .mask = mask | VESC_VALUE_CONTROLLER_ID };
+    index += vesc_codec_encode(&vesc_msg_get_values_selective, &request, 0,
+                               &payload[index], sizeof(payload) - index);
 
-    ESP_LOGI(TAG, "VESC UART initialized on TX:%d RX:%d @ %d baud", 
-             VESC_UART_TX_PIN, VESC_UART_RX_PIN, VESC_UART_BAUD);
-    return ESP_OK;
+    return vesc_io_request_future_matched(future, payload, index, COMM_GET_VALUES_SELECTIVE,
+                                          match, (uint32_t)match_id, decode_values_selective, data);
 }
 
-void vesc_uart_deinit(void) {
-    uart_driver_delete(VESC_UART_NUM);
+// Track the local ID from the outcome of a local values request. An ID that
+// belongs to a CAN controller came from a late forwarded reply: not learnt.
+static void vesc_values_learn_local(bool answered, const vesc_data_t *data,
+                                    const int *can_ids, int count) {
+    if (!answered) {
+        // Possibly a new ID after a reconfiguration: match on the packet ID again
+        atomic_store(&local_controller_id, -1);
+        return;
+    }
+    if (atomic_load(&local_controller_id) >= 0 || !vesc_values_pipelined()) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (can_ids[i] == (int)data->controller_id) {
+            return;
+        }
+    }
+    atomic_store(&local_controller_id, (int)data->controller_id);
+    ESP_LOGI(TAG, "UART VESC has controller ID %u", (unsigned)data->controller_id);
+}
+
+int vesc_get_local_controller_id(void) {
+    return atomic_load(&local_controller_id);
 }
 
 bool vesc_get_values(vesc_data_t *data) {
     if (data == NULL) return false;
 
     uint8_t payload[1] = { COMM_GET_VALUES };
-    vesc_pack_send_payload(payload, 1);
-
-    uint8_t message[VESC_UART_BUF_SIZE];
-    int msg_len = vesc_receive_uart_message(message);
-
-    if (msg_len > 55) {
-        // Parse response - skip packet ID
-        int32_t index = 1;
-        
-        data->temp_mosfet       = buffer_get_float16(message, 10.0f, &index);
-        data->temp_motor        = buffer_get_float16(message, 10.0f, &index);
-        data->avg_motor_current = buffer_get_float32(message, 100.0f, &index);
-        data->avg_input_current = buffer_get_float32(message, 100.0f, &index);
-        index += 4; // Skip avg_id
-        index += 4; // Skip avg_iq
-        data->duty_cycle        = buffer_get_float16(message, 1000.0f, &index);
-        data->rpm               = buffer_get_float32(message, 1.0f, &index);
-        data->input_voltage     = buffer_get_float16(message, 10.0f, &index);
-        data->amp_hours         = buffer_get_float32(message, 10000.0f, &index);
-        data->amp_hours_charged = buffer_get_float32(message, 10000.0f, &index);
-        data->watt_hours        = buffer_get_float32(message, 10000.0f, &index);
-        data->watt_hours_charged= buffer_get_float32(message, 10000.0f, &index);
-        data->tachometer        = buffer_get_int32(message, &index);
-        data->tachometer_abs    = buffer_get_int32(message, &index);
-        data->fault             = (vesc_fault_code_t)message[index++];
-        data->pid_pos           = buffer_get_float32(message, 1000000.0f, &index);
-        data->controller_id     = message[index++];
-
-        return true;
+    return vesc_request(payload, sizeof(payload), COMM_GET_VALUES, decode_values, data);
+}
+
+bool vesc_get_values_selective(vesc_data_t *data, uint32_t mask) {
+    return vesc_get_values_selective_can(VESC_CAN_LOCAL, data, mask);
+}
+
+bool vesc_get_values_selective_can(int can_id, vesc_data_t *data, uint32_t mask) {
+    if (data == NULL || mask == 0) return false;
+
+    vesc_io_future_t future;
+    if (vesc_values_request(&future, can_id, data, mask) != ESP_OK) {
+        return false;
+    }
+    bool answered = vesc_io_future_wait(&future) != 0;
+    if (can_id == VESC_CAN_LOCAL) {
+        vesc_values_learn_local(answered, data, NULL, 0);
     }
+    return answered;
+}
 
-    return false;
+uint32_t vesc_poll_values(const int *can_ids, vesc_data_t *data, int count, uint32_t mask) {
+    uint32_t masks[VESC_MAX_CONTROLLERS];
+
+    if (count <= 0 || count > VESC_MAX_CONTROLLERS || mask == 0) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        masks[i] = mask;
+    }
+    return vesc_poll_values_masked(can_ids, data, count, masks);
+}
+
+uint32_t vesc_poll_values_masked(const int *can_ids, vesc_data_t *data, int count, const uint32_t *masks) {
+    vesc_io_future_t futures[VESC_MAX_CONTROLLERS];
+    bool queued[VESC_MAX_CONTROLLERS];
+    bool alone[VESC_MAX_CONTROLLERS];
+    uint32_t answered = 0;
+
+    if (can_ids == NULL || data == NULL || masks == NULL || count <= 0 || count > VESC_MAX_CONTROLLERS) {
+        return 0;
+    }
+
+    // Queue every request first; the engine keeps VESC_IO_MAX_INFLIGHT on the wire.
+    // Without controller IDs in the replies, one at a time; a local request
+    // that cannot be matched on its own ID yet goes alone, before the rest.
+    bool pipelined = vesc_values_pipelined();
+    bool local_known = atomic_load(&local_controller_id) >= 0;
+    for (int i = 0; i < count; i++) {
+        alone[i] = !pipelined || (!local_known && can_ids[i] == VESC_CAN_LOCAL);
+        queued[i] = false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!alone[i] || masks[i] == 0) continue;
+        queued[i] = vesc_values_request(&futures[i], can_ids[i], &data[i], masks[i]) == ESP_OK;
+        if (queued[i] && vesc_io_future_wait(&futures[i])) {
+            answered |= 1UL << i;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (alone[i] || masks[i] == 0) continue;
+        queued[i] = vesc_values_request(&futures[i], can_ids[i], &data[i], masks[i]) == ESP_OK;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!alone[i] && queued[i] && vesc_io_future_wait(&futures[i])) {
+            answered |= 1UL << i;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (can_ids[i] == VESC_CAN_LOCAL && queued[i]) {
+            vesc_values_learn_local((answered & (1UL << i)) != 0, &data[i], can_ids, count);
+        }
+    }
+    return answered;
 }
 
 bool vesc_get_fw_version(vesc_fw_version_t *fw) {
     if (fw == NULL) return false;
 
     uint8_t payload[1] = { COMM_FW_VERSION };
-    vesc_pack_send_payload(payload, 1);
+    codec_reply_t reply = { &vesc_msg_fw_version, fw };
+    return vesc_request(payload, sizeof(payload), COMM_FW_VERSION, decode_codec, &reply);
+}
+
+bool vesc_get_values_setup(vesc_setup_data_t *data) {
+    if (data == NULL) return false;
+
+    uint8_t payload[1] = { COMM_GET_VALUES_SETUP };
+    codec_reply_t reply = { &vesc_msg_values_setup, data };
+    return vesc_request(payload, sizeof(payload), COMM_GET_VALUES_SETUP, decode_codec, &reply);
+}
+
+bool vesc_get_values_setup_selective(vesc_setup_data_t *data, uint32_t mask) {
+    if (data == NULL || mask == 0) return false;
+
+    uint8_t payload[5];
+    vesc_codec_mask_t request = { .mask = mask };
+    int32_t len = vesc_codec_encode(&vesc_msg_get_values_setup_selective, &request, 0,
+                                    payload, sizeof(payload));
+    codec_reply_t reply = { &vesc_msg_values_setup_selective, data };
+    return vesc_request(payload, len, COMM_GET_VALUES_SETUP_SELECTIVE, decode_codec, &reply);
+}
+
+bool vesc_bms_get_values(vesc_bms_data_t *data) {
+    if (data == NULL) return false;
 
-    uint8_t message[VESC_UART_BUF_SIZE];
-    int msg_len = vesc_receive_uart_message(message);
+    uint8_t payload[1] = { COMM_BMS_GET_VALUES };
+    codec_reply_t reply = { &vesc_msg_bms_values, data };
+    return vesc_request(payload, sizeof(payload), COMM_BMS_GET_VALUES, decode_codec, &reply);
+}
 
-    if (msg_len > 0 && message[0] == COMM_FW_VERSION) {
-        fw->major = message[1];
-        fw->minor = message[2];
-        return true;
+uint16_t vesc_build_motor_command(uint8_t *payload, int can_id, vesc_comm_packet_id_t comm, float value) {
+    int32_t index = vesc_payload_begin(payload, can_id);
+    const vesc_codec_msg_t *msg;
+
+    switch (comm) {
+        case COMM_SET_DUTY:             msg = &vesc_msg_set_duty;          break;
+        case COMM_SET_RPM:              msg = &vesc_msg_set_rpm;           break;
+        case COMM_SET_CURRENT_BRAKE:    msg = &vesc_msg_set_current_brake; break;
+        case COMM_SET_CURRENT_REL:      msg = &vesc_msg_set_current_rel;   break;
+        case COMM_SET_CURRENT:
+        default:                        msg = &vesc_msg_set_current;       break;
     }
 
-    return false;
+    vesc_codec_setpoint_t setpoint = { .value = value };
+    index += vesc_codec_encode(msg, &setpoint, 0, &payload[index], VESC_MOTOR_COMMAND_MAX_LEN - index);
+    return (uint16_t)index;
 }
 
 void vesc_set_current(float current) {
-    uint8_t payload[5];
-    int32_t index = 0;
-    
-    payload[index++] = COMM_SET_CURRENT;
-    buffer_append_int32(payload, (int32_t)(current * 1000.0f), &index);
-    
-    vesc_pack_send_payload(payload, 5);
+    vesc_set_current_can(VESC_CAN_LOCAL, current);
+}
+
+void vesc_set_current_can(int can_id, float current) {
+    uint8_t payload[VESC_MOTOR_COMMAND_MAX_LEN];
+    uint16_t len = vesc_build_motor_command(payload, can_id, COMM_SET_CURRENT, current);
+
+    vesc_send_command(payload, len, VESC_IO_PRIO_URGENT);
+}
+
+void vesc_set_current_all(const int *can_ids, const float *currents, int count) {
+    uint8_t payloads[VESC_MAX_CONTROLLERS][VESC_MOTOR_COMMAND_MAX_LEN];
+    vesc_io_frame_t frames[VESC_MAX_CONTROLLERS];
+
+    if (can_ids == NULL || currents == NULL || count <= 0 || count > VESC_MAX_CONTROLLERS) return;
+
+    for (int i = 0; i < count; i++) {
+        frames[i].payload = payloads[i];
+        frames[i].len = vesc_build_motor_command(payloads[i], can_ids[i], COMM_SET_CURRENT, currents[i]);
+    }
+
+    esp_err_t ret = vesc_io_send_batch(frames, count, VESC_IO_PRIO_URGENT);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Current batch for %d controllers dropped: %s", count, esp_err_to_name(ret));
+    }
 }
 
 void vesc_set_brake_current(float current) {
-    uint8_t payload[5];
-    int32_t index = 0;
-    
-    payload[index++] = COMM_SET_CURRENT_BRAKE;
-    buffer_append_int32(payload, (int32_t)(current * 1000.0f), &index);
-    
-    vesc_pack_send_payload(payload, 5);
+    uint8_t payload[VESC_MOTOR_COMMAND_MAX_LEN];
+    uint16_t len = vesc_build_motor_command(payload, VESC_CAN_LOCAL, COMM_SET_CURRENT_BRAKE, current);
+
+    vesc_send_command(payload, len, VESC_IO_PRIO_URGENT);
 }
 
 void vesc_set_rpm(float rpm) {
-    uint8_t payload[5];
-    int32_t index = 0;
-    
-    payload[index++] = COMM_SET_RPM;
-    buffer_append_int32(payload, (int32_t)rpm, &index);
-    
-    vesc_pack_send_payload(payload, 5);
+    uint8_t payload[VESC_MOTOR_COMMAND_MAX_LEN];
+    uint16_t len = vesc_build_motor_command(payload, VESC_CAN_LOCAL, COMM_SET_RPM, rpm);
+
+    vesc_send_command(payload, len, VESC_IO_PRIO_URGENT);
 }
 
 void vesc_set_duty(float duty) {
-    uint8_t payload[5];
-    int32_t index = 0;
-    
-    payload[index++] = COMM_SET_DUTY;
-    buffer_append_int32(payload, (int32_t)(duty * 100000.0f), &index);
-    
-    vesc_pack_send_payload(payload, 5);
+    uint8_t payload[VESC_MOTOR_COMMAND_MAX_LEN];
+    uint16_t len = vesc_build_motor_command(payload, VESC_CAN_LOCAL, COMM_SET_DUTY, duty);
+
+    vesc_send_command(payload, len, VESC_IO_PRIO_URGENT);
 }
 
 void vesc_send_keepalive(void) {
-    uint8_t payload[1] = { COMM_ALIVE };
-    vesc_pack_send_payload(payload, 1);
+    vesc_send_keepalive_can(VESC_CAN_LOCAL);
+}
+
+void vesc_send_keepalive_can(int can_id) {
+    uint8_t payload[3];
+    int32_t index = vesc_payload_begin(payload, can_id);
+
+    payload[index++] = COMM_ALIVE;
+    vesc_send_command(payload, index, VESC_IO_PRIO_NORMAL);
 }
 
 const char* vesc_fault_to_string(vesc_fault_code_t fault) {
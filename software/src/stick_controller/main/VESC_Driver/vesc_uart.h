@@ -12,6 +12,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "sdkconfig.h"
+#include "vesc_fixed.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,11 +21,43 @@ extern "C" {
 
 // VESC UART configuration
 #define VESC_UART_NUM           UART_NUM_0
-#define VESC_UART_BAUD          115200
+#define VESC_UART_BAUD          CONFIG_VESC_UART_BAUD_FALLBACK  // Start-up rate, see vesc_link.h
 #define VESC_UART_TX_PIN        43  // ESP32-S3 TX pin (connects to VESC RX)
 #define VESC_UART_RX_PIN        44  // ESP32-S3 RX pin (connects to VESC TX)
 #define VESC_UART_TIMEOUT_MS    100
-#define VESC_UART_BUF_SIZE      256
+
+// Multi-VESC: controllers behind the UART VESC are reached with COMM_FORWARD_CAN
+#define VESC_CAN_LOCAL          (-1)    // Address the VESC on the UART itself
+#define VESC_MAX_CONTROLLERS    8       // Controllers per batch (local + CAN)
+#define VESC_MOTOR_COMMAND_MAX_LEN  7   // [34][id] + command + int32 value
+
+// VESC communication commands (first payload byte)
+typedef enum {
+    COMM_FW_VERSION = 0,
+    COMM_JUMP_TO_BOOTLOADER,
+    COMM_ERASE_NEW_APP,
+    COMM_WRITE_NEW_APP_DATA,
+    COMM_GET_VALUES = 4,
+    COMM_SET_DUTY = 5,
+    COMM_SET_CURRENT = 6,
+    COMM_SET_CURRENT_BRAKE = 7,
+    COMM_SET_RPM = 8,
+    COMM_SET_POS = 9,
+    COMM_SET_HANDBRAKE = 10,
+    COMM_SET_MCCONF = 13,
+    COMM_GET_MCCONF = 14,
+    COMM_SET_APPCONF = 16,
+    COMM_GET_APPCONF = 17,
+    COMM_ALIVE = 30,
+    COMM_FORWARD_CAN = 34,
+    COMM_GET_VALUES_SETUP = 47,
+    COMM_SET_MCCONF_TEMP = 48,
+    COMM_SET_MCCONF_TEMP_SETUP = 49,
+    COMM_GET_VALUES_SELECTIVE = 50,
+    COMM_GET_VALUES_SETUP_SELECTIVE = 51,
+    COMM_SET_CURRENT_REL = 84,
+    COMM_BMS_GET_VALUES = 96,
+} vesc_comm_packet_id_t;
 
 // Fault codes from VESC
 typedef enum {
@@ -57,25 +91,147 @@ typedef enum {
     VESC_FAULT_PHASE_FILTER,
 } vesc_fault_code_t;
 
-// VESC telemetry data structure
+// VESC telemetry data structure, in the scaled integers of the wire (vesc_fixed.h)
+typedef struct {
+    vesc_fx2_t avg_motor_current;   // Average motor current (A x 100)
+    vesc_fx2_t avg_input_current;   // Average input current (A x 100)
+    vesc_fx3_t duty_cycle;          // Duty cycle (0 - 1000)
+    int32_t rpm;                    // Motor eRPM
+    vesc_fx1_t input_voltage;       // Input voltage (V x 10)
+    vesc_fx4_t amp_hours;           // Amp hours consumed (x 10000)
+    vesc_fx4_t amp_hours_charged;   // Amp hours charged (x 10000)
+    vesc_fx4_t watt_hours;          // Watt hours consumed (x 10000)
+    vesc_fx4_t watt_hours_charged;  // Watt hours charged (x 10000)
+    int32_t tachometer;             // Tachometer value
+    int32_t tachometer_abs;         // Absolute tachometer value
+    vesc_fx1_t temp_mosfet;         // MOSFET temperature (°C x 10)
+    vesc_fx1_t temp_motor;          // Motor temperature (°C x 10)
+    vesc_fx6_t pid_pos;             // PID position (degrees x 1000000)
+    uint8_t controller_id;          // VESC controller ID
+    vesc_fault_code_t fault;        // Current fault code
+} vesc_data_t;
+
+// Field mask for vesc_get_values_selective(). Bit positions match the
+// COMM_GET_VALUES_SELECTIVE wire format.
+#define VESC_VALUE_TEMP_MOSFET          (1UL << 0)
+#define VESC_VALUE_TEMP_MOTOR           (1UL << 1)
+#define VESC_VALUE_MOTOR_CURRENT        (1UL << 2)
+#define VESC_VALUE_INPUT_CURRENT        (1UL << 3)
+#define VESC_VALUE_AVG_ID               (1UL << 4)  // Not stored in vesc_data_t
+#define VESC_VALUE_AVG_IQ               (1UL << 5)  // Not stored in vesc_data_t
+#define VESC_VALUE_DUTY_CYCLE           (1UL << 6)
+#define VESC_VALUE_RPM                  (1UL << 7)
+#define VESC_VALUE_INPUT_VOLTAGE        (1UL << 8)
+#define VESC_VALUE_AMP_HOURS            (1UL << 9)
+#define VESC_VALUE_AMP_HOURS_CHARGED    (1UL << 10)
+#define VESC_VALUE_WATT_HOURS           (1UL << 11)
+#define VESC_VALUE_WATT_HOURS_CHARGED   (1UL << 12)
+#define VESC_VALUE_TACHOMETER           (1UL << 13)
+#define VESC_VALUE_TACHOMETER_ABS       (1UL << 14)
+#define VESC_VALUE_FAULT                (1UL << 15)
+#define VESC_VALUE_PID_POS              (1UL << 16)
+#define VESC_VALUE_CONTROLLER_ID        (1UL << 17)
+#define VESC_VALUE_TEMP_FETS            (1UL << 18) // Not stored in vesc_data_t
+#define VESC_VALUE_VD                   (1UL << 19) // Not stored in vesc_data_t
+#define VESC_VALUE_VQ                   (1UL << 20) // Not stored in vesc_data_t
+
+// Every field carried by a plain COMM_GET_VALUES reply
+#define VESC_VALUES_ALL                 ((1UL << 18) - 1)
+
+// Totals over the VESC and the controllers on its CAN bus (COMM_GET_VALUES_SETUP)
 typedef struct {
-    float avg_motor_current;    // Average motor current (A)
-    float avg_input_current;    // Average input current (A)
+    float temp_mosfet;          // Highest MOSFET temperature (°C)
+    float temp_motor;           // Highest motor temperature (°C)
+    float motor_current;        // Total motor current (A)
+    float input_current;        // Total input current (A)
     float duty_cycle;           // Duty cycle (0.0 - 1.0)
     float rpm;                  // Motor RPM
+    float speed;                // Speed (m/s, from the wheel setup)
     float input_voltage;        // Input voltage (V)
-    float amp_hours;            // Amp hours consumed
-    float amp_hours_charged;    // Amp hours charged
-    float watt_hours;           // Watt hours consumed
-    float watt_hours_charged;   // Watt hours charged
-    int32_t tachometer;         // Tachometer value
-    int32_t tachometer_abs;     // Absolute tachometer value
-    float temp_mosfet;          // MOSFET temperature (°C)
-    float temp_motor;           // Motor temperature (°C)
+    float battery_level;        // Battery level (0.0 - 1.0)
+    float amp_hours;            // Amp hours consumed, all controllers
+    float amp_hours_charged;    // Amp hours charged, all controllers
+    float watt_hours;           // Watt hours consumed, all controllers
+    float watt_hours_charged;   // Watt hours charged, all controllers
+    float distance;             // Trip distance (m)
+    float distance_abs;         // Absolute trip distance (m)
     float pid_pos;              // PID position
-    uint8_t controller_id;      // VESC controller ID
     vesc_fault_code_t fault;    // Current fault code
-} vesc_data_t;
+    uint8_t controller_id;      // VESC controller ID
+    uint8_t num_vescs;          // Controllers included in the totals
+    float battery_wh;           // Battery energy left (Wh)
+    uint32_t odometer;          // Odometer (m)
+    uint32_t uptime_ms;         // Time since boot (ms)
+} vesc_setup_data_t;
+
+// Field mask for vesc_get_values_setup_selective(). Bit positions match
+// the COMM_GET_VALUES_SETUP_SELECTIVE wire format.
+#define VESC_SETUP_TEMP_MOSFET          (1UL << 0)
+#define VESC_SETUP_TEMP_MOTOR           (1UL << 1)
+#define VESC_SETUP_MOTOR_CURRENT        (1UL << 2)
+#define VESC_SETUP_INPUT_CURRENT        (1UL << 3)
+#define VESC_SETUP_DUTY_CYCLE           (1UL << 4)
+#define VESC_SETUP_RPM                  (1UL << 5)
+#define VESC_SETUP_SPEED                (1UL << 6)
+#define VESC_SETUP_INPUT_VOLTAGE        (1UL << 7)
+#define VESC_SETUP_BATTERY_LEVEL        (1UL << 8)
+#define VESC_SETUP_AMP_HOURS            (1UL << 9)
+#define VESC_SETUP_AMP_HOURS_CHARGED    (1UL << 10)
+#define VESC_SETUP_WATT_HOURS           (1UL << 11)
+#define VESC_SETUP_WATT_HOURS_CHARGED   (1UL << 12)
+#define VESC_SETUP_DISTANCE             (1UL << 13)
+#define VESC_SETUP_DISTANCE_ABS         (1UL << 14)
+#define VESC_SETUP_PID_POS              (1UL << 15)
+#define VESC_SETUP_FAULT                (1UL << 16)
+#define VESC_SETUP_CONTROLLER_ID        (1UL << 17)
+#define VESC_SETUP_NUM_VESCS            (1UL << 18)
+#define VESC_SETUP_BATTERY_WH           (1UL << 19)
+#define VESC_SETUP_ODOMETER             (1UL << 20)
+#define VESC_SETUP_UPTIME               (1UL << 21)
+
+#define VESC_BMS_MAX_CELLS      32      // Cells kept in vesc_bms_data_t
+#define VESC_BMS_MAX_TEMPS      16      // Temperature sensors kept in vesc_bms_data_t
+
+// BMS readings relayed by the VESC (COMM_BMS_GET_VALUES)
+typedef struct {
+    float v_tot;                // Pack voltage (V)
+    float v_charge;             // Charger voltage (V)
+    float i_in;                 // Pack current (A)
+    float i_in_ic;              // Pack current from the BMS IC (A)
+    float ah_cnt;               // Amp hour counter
+    float wh_cnt;               // Watt hour counter
+    uint8_t cell_num;           // Cells reported (only the first VESC_BMS_MAX_CELLS are kept)
+    float v_cell[VESC_BMS_MAX_CELLS];       // Cell voltages (V)
+    uint8_t bal_state[VESC_BMS_MAX_CELLS];  // Cell balancing active
+    uint8_t temp_num;           // Temperature sensors reported
+    float temps[VESC_BMS_MAX_TEMPS];        // Sensor temperatures (°C)
+    float temp_ic;              // BMS IC temperature (°C)
+    float temp_hum;             // Humidity sensor temperature (°C)
+    float humidity;             // Relative humidity (%)
+    float temp_max_cell;        // Hottest cell (°C)
+    float soc;                  // State of charge (0.0 - 1.0)
+    float soh;                  // State of health (0.0 - 1.0)
+    uint8_t can_id;             // BMS CAN ID
+} vesc_bms_data_t;
+
+// Temporary motor limits (COMM_SET_MCCONF_TEMP). Not stored unless store
+// is set, so the VESC config is back in force after a reboot.
+typedef struct {
+    uint8_t store;              // Also write the limits to flash
+    uint8_t forward_can;        // Apply to every VESC on the CAN bus as well
+    uint8_t ack;                // Reply with [COMM_SET_MCCONF_TEMP]
+    uint8_t divide_by_controllers;  // Split the power limits over the CAN controllers
+    float current_min_scale;    // Share of l_current_min (0.0 - 1.0)
+    float current_max_scale;    // Share of l_current_max (0.0 - 1.0)
+    float erpm_min;             // l_min_erpm (negative)
+    float erpm_max;             // l_max_erpm
+    float duty_min;             // l_min_duty
+    float duty_max;             // l_max_duty
+    float watt_min;             // l_watt_min (W, negative = regen)
+    float watt_max;             // l_watt_max (W)
+    float in_current_min;       // l_in_current_min (A), ignored before firmware 5
+    float in_current_max;       // l_in_current_max (A), ignored before firmware 5
+} vesc_mcconf_temp_t;
 
 // Firmware version
 typedef struct {
@@ -101,6 +257,72 @@ void vesc_uart_deinit(void);
  */
 bool vesc_get_values(vesc_data_t *data);
 
+/**
+ * @brief Get only the selected telemetry fields (COMM_GET_VALUES_SELECTIVE)
+ *
+ * Fields not in the mask are left untouched in data. The mask can differ
+ * on every call. On firmware without COMM_GET_VALUES_SELECTIVE (see
+ * vesc_caps.h) COMM_GET_VALUES is sent instead and every field of its
+ * reply is updated.
+ *
+ * @param data Pointer to structure to update
+ * @param mask OR of VESC_VALUE_* bits
+ * @return true if successful, false on timeout/error
+ */
+bool vesc_get_values_selective(vesc_data_t *data, uint32_t mask);
+
+/**
+ * @brief vesc_get_values_selective() for any controller
+ *
+ * CAN controllers are reached through COMM_FORWARD_CAN on the UART VESC.
+ * VESC_VALUE_CONTROLLER_ID is added to every mask so the reply can be
+ * matched to the controller that sent it; the UART VESC's own ID is learnt
+ * from its first reply (see vesc_get_local_controller_id()).
+ *
+ * @param can_id CAN controller ID, or VESC_CAN_LOCAL
+ * @param data   Pointer to structure to update
+ * @param mask   OR of VESC_VALUE_* bits
+ * @return true if successful, false on timeout/error
+ */
+bool vesc_get_values_selective_can(int can_id, vesc_data_t *data, uint32_t mask);
+
+/**
+ * @brief Poll several controllers with their requests pipelined
+ *
+ * All requests are queued at once and answered in parallel, so polling N
+ * controllers costs one round trip (or one timeout) rather than N. Until
+ * the UART VESC's controller ID is known, its request goes on its own
+ * ahead of the others, since its reply could not be told apart from a
+ * forwarded one.
+ *
+ * @param can_ids CAN controller IDs (VESC_CAN_LOCAL for the UART VESC)
+ * @param data    One structure per controller, updated in place
+ * @param count   Number of controllers (<= VESC_MAX_CONTROLLERS)
+ * @param mask    OR of VESC_VALUE_* bits
+ * @return Bit i set if controller i answered
+ */
+uint32_t vesc_poll_values(const int *can_ids, vesc_data_t *data, int count, uint32_t mask);
+
+/**
+ * @brief vesc_poll_values() with a separate field mask per controller
+ * @param can_ids CAN controller IDs (VESC_CAN_LOCAL for the UART VESC)
+ * @param data    One structure per controller, updated in place
+ * @param count   Number of controllers (<= VESC_MAX_CONTROLLERS)
+ * @param masks   Field mask per controller; 0 skips that controller
+ * @return Bit i set if controller i answered
+ */
+uint32_t vesc_poll_values_masked(const int *can_ids, vesc_data_t *data, int count, const uint32_t *masks);
+
+/**
+ * @brief Controller ID of the UART VESC
+ *
+ * Learnt from its values replies; forgotten when one goes unanswered, so a
+ * changed ID is picked up again.
+ *
+ * @return Controller ID, or -1 while unknown
+ */
+int vesc_get_local_controller_id(void);
+
 /**
  * @brief Get VESC firmware version
  * @param fw Pointer to structure to fill with firmware version
@@ -108,12 +330,67 @@ bool vesc_get_values(vesc_data_t *data);
  */
 bool vesc_get_fw_version(vesc_fw_version_t *fw);
 
+/**
+ * @brief Get setup-level totals (COMM_GET_VALUES_SETUP, needs VESC_CAP_VALUES_SETUP)
+ * @param data Pointer to structure to fill
+ * @return true if successful, false on timeout/error
+ */
+bool vesc_get_values_setup(vesc_setup_data_t *data);
+
+/**
+ * @brief Get only the selected setup fields (COMM_GET_VALUES_SETUP_SELECTIVE)
+ * @param data Pointer to structure to update; fields not in the mask are untouched
+ * @param mask OR of VESC_SETUP_* bits
+ * @return true if successful, false on timeout/error
+ */
+bool vesc_get_values_setup_selective(vesc_setup_data_t *data, uint32_t mask);
+
+/**
+ * @brief Get the BMS readings relayed by the VESC (COMM_BMS_GET_VALUES, needs VESC_CAP_BMS)
+ * @param data Pointer to structure to fill
+ * @return true if successful, false on timeout/error (or no BMS)
+ */
+bool vesc_bms_get_values(vesc_bms_data_t *data);
+
 /**
  * @brief Set motor current
+ *
+ * Motor commands are queued as urgent on the I/O engine and never block.
+ *
  * @param current Current in Amps (positive = forward, negative = reverse)
  */
 void vesc_set_current(float current);
 
+/**
+ * @brief vesc_set_current() for any controller
+ * @param can_id  CAN controller ID, or VESC_CAN_LOCAL
+ * @param current Current in Amps
+ */
+void vesc_set_current_can(int can_id, float current);
+
+/**
+ * @brief Set the current of several controllers in one burst
+ *
+ * All frames are queued as one urgent batch and written back to back, so
+ * every motor gets its command in the same control tick.
+ *
+ * @param can_ids  CAN controller IDs (VESC_CAN_LOCAL for the UART VESC)
+ * @param currents Current for each controller in Amps
+ * @param count    Number of controllers (<= VESC_MAX_CONTROLLERS)
+ */
+void vesc_set_current_all(const int *can_ids, const float *currents, int count);
+
+/**
+ * @brief Build the payload of a motor command without sending it
+ * @param payload Output buffer (VESC_MOTOR_COMMAND_MAX_LEN bytes)
+ * @param can_id  CAN controller ID, or VESC_CAN_LOCAL
+ * @param comm    COMM_SET_CURRENT, COMM_SET_CURRENT_BRAKE, COMM_SET_CURRENT_REL,
+ *                COMM_SET_DUTY or COMM_SET_RPM
+ * @param value   Amps, share of the current limit (-1.0 - 1.0), duty cycle (0.0 - 1.0) or eRPM
+ * @return Payload length
+ */
+uint16_t vesc_build_motor_command(uint8_t *payload, int can_id, vesc_comm_packet_id_t comm, float value);
+
 /**
  * @brief Set brake current
  * @param current Brake current in Amps
@@ -137,6 +414,12 @@ void vesc_set_duty(float duty);
  */
 void vesc_send_keepalive(void);
 
+/**
+ * @brief vesc_send_keepalive() for any controller
+ * @param can_id CAN controller ID, or VESC_CAN_LOCAL
+ */
+void vesc_send_keepalive_can(int can_id);
+
 /**
  * @brief Get fault code as string
  * @param fault Fault code
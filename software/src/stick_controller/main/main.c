@@ -11,25 +11,48 @@
  *   GP4 - FAST:   High current
  * 
  * VESC Communication:
- *   UART0 at 115200 baud
+ *   UART0, baud rate probed at boot (see VESC_Driver/vesc_link.h)
  *   TX -> VESC RX (Yellow wire)
  *   RX -> VESC TX (White wire)
+ *   Extra VESCs on its CAN bus via COMM_FORWARD_CAN (CONFIG_VESC_CAN_IDS)
  */
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "nvs_flash.h"
 #include "lvgl.h"
 
 #include "LCD_Driver/ST7789.h"
 #include "LVGL_Driver/LVGL_Driver.h"
 #include "Button_Driver/Button_Driver.h"
 #include "Button_Driver/Speed_Buttons.h"
+#include "Button_Driver/button_input.h"
+#include "Log_Driver/log_async.h"
 #include "VESC_Driver/vesc_uart.h"
+#include "VESC_Driver/vesc_io.h"
+#include "VESC_Driver/vesc_link.h"
+#include "VESC_Driver/vesc_health.h"
+#include "VESC_Driver/vesc_can.h"
+#include "VESC_Driver/vesc_poll.h"
+#include "VESC_Driver/vesc_cmd.h"
+#include "VESC_Driver/vesc_config.h"
+#include "VESC_Driver/vesc_caps.h"
+#include "VESC_Driver/vesc_envelope.h"
+#include "VESC_Driver/vesc_telemetry.h"
+#include "Control/control_loop.h"
+#include "Control/current_ramp.h"
+#include "Control/supervisor.h"
+#include "Control/estop.h"
+#include "Control/prop_guard.h"
+#include "Control/stall_guard.h"
+#include <math.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "stick_controller";
@@ -80,7 +103,44 @@ static void rotate_bg_90_cw(void) {
 #define CURRENT_MEDIUM  30.0f   // Normal cruising (Amps)
 #define CURRENT_FAST    70.0f   // Full power (Amps)
 
-#define VESC_POLL_INTERVAL_MS   200
+// Control loop: core 1 runs nothing else; the tasks below and LVGL stay on core 0
+#define CONTROL_LOOP_CORE       1
+#define CONTROL_LOOP_PRIORITY   (configMAX_PRIORITIES - 3)
+
+// Supervised deadlines of the tasks that are not critical (counted, no action).
+// vesc_task may sit out the whole disconnected back-off.
+#define VESC_TASK_DEADLINE_MS   (VESC_POLL_DISCONNECTED_MAX_MS + 1000)
+#define UI_TASK_DEADLINE_MS     500
+
+// The full VESC config is re-read once the motor has been idle this long after boot
+#define VESC_CONFIG_CHECK_DELAY_MS  5000
+
+// UART poll rate and fields adapt to the motor state, see VESC_Driver/vesc_poll.h
+#if CONFIG_VESC_CAN_STATUS_ENABLE
+#define VESC_CAN_READ_INTERVAL_MS   20  // CAN status broadcasts arrive at 50 Hz
+#endif
+
+// Telemetry older than this is shown as a lost link, even if the last round answered
+#define VESC_TELEMETRY_MAX_AGE_MS   (3 * VESC_POLL_IDLE_MS)
+
+// Prop guard signature and timing (limits in menuconfig). It needs the active poll
+// rate (or CAN status): samples further apart than PROP_GUARD_MAX_DT_MS give no rates.
+#define PROP_GUARD_RPM_RISE         15000   // eRPM/s: runaway
+#define PROP_GUARD_CURRENT_FALL     150     // A/s: load collapsing
+#define PROP_GUARD_CURRENT_MIN      3.0f    // Learn the in-water load only above this current
+#define PROP_GUARD_BASELINE_WEIGHT  0.05f   // Per steady sample
+#define PROP_GUARD_CLEAR_MS         100     // Load back this long before restoring
+#define PROP_GUARD_MAX_DT_MS        (3 * VESC_POLL_ACTIVE_MS)
+
+// Stall detection (sequence and rate limits in menuconfig)
+#define STALL_GUARD_CURRENT_SHARE   0.8f    // Of the commanded current
+#define STALL_GUARD_CURRENT_MIN     5.0f    // A
+#define STALL_GUARD_WINDOW_S        60.0f   // CONFIG_STALL_GUARD_MAX_PER_MIN counts in this
+
+// Telemetry fields shown by ui_update(), fetched with COMM_GET_VALUES_SELECTIVE
+#define VESC_UI_VALUES  (VESC_VALUE_INPUT_VOLTAGE | VESC_VALUE_MOTOR_CURRENT | \
+                         VESC_VALUE_AMP_HOURS | VESC_VALUE_RPM | \
+                         VESC_VALUE_TEMP_MOSFET | VESC_VALUE_FAULT)
 
 // =============================================================================
 // UI Elements
@@ -97,11 +157,25 @@ static lv_obj_t *lbl_fault = NULL;
 static lv_obj_t *lbl_temp = NULL;
 static lv_obj_t *lbl_emergency = NULL;
 
-static speed_level_t commanded_speed = SPEED_LEVEL_OFF;
-static float commanded_current = 0.0f;
-static vesc_data_t vesc_data = {0};
-static bool vesc_connected = false;
-static bool emergency_stop_active = false;
+// Written by the control loop (core 1), read by vesc_task (core 0) and the UI
+static atomic_uint commanded_speed = SPEED_LEVEL_OFF;   // speed_level_t
+static atomic_int commanded_ma = 0;                     // Current setpoint (mA)
+static atomic_bool emergency_stop_active = false;
+#define COMMANDED_CURRENT()     (atomic_load_explicit(&commanded_ma, memory_order_relaxed) / 1000.0f)
+#define COMMANDED_SPEED()       ((speed_level_t)atomic_load_explicit(&commanded_speed, memory_order_relaxed))
+#define EMERGENCY_STOP_ACTIVE() atomic_load_explicit(&emergency_stop_active, memory_order_relaxed)
+// Controllers driven together: CAN VESCs from CONFIG_VESC_CAN_IDS first, the
+// UART VESC last (see vesc_poll_values())
+static int vesc_ids[VESC_MAX_CONTROLLERS];
+static int vesc_count = 0;
+static vesc_data_t vesc_data[VESC_MAX_CONTROLLERS];  // Owned by vesc_task, others read vesc_telemetry
+static vesc_poll_t vesc_poll;                       // Owned by vesc_task
+static TaskHandle_t vesc_task_handle = NULL;
+static uint32_t vesc_values_mask = VESC_UI_VALUES;  // May be changed at runtime
+// Supervisor task indexes
+static int sup_control = -1;
+static int sup_vesc = -1;
+static int sup_ui = -1;
 
 // =============================================================================
 // UI Creation - Portrait layout with rotated background
@@ -218,17 +292,33 @@ static void ui_create(void) {
     lv_obj_align(lbl_fault, LV_ALIGN_BOTTOM_MID, 0, -8);
 }
 
+// "<prefix><value><suffix>" from a scaled integer, without float printf
+static void ui_set_fixed(lv_obj_t *label, const char *prefix, int32_t raw, int32_t scale,
+                         int decimals, const char *suffix) {
+    char num[16];
+    char buf[32];
+
+    vesc_fx_format(num, sizeof(num), raw, scale, decimals);
+    snprintf(buf, sizeof(buf), "%s%s%s", prefix, num, suffix);
+    lv_label_set_text(label, buf);
+}
+
 static void ui_update(void) {
+    static vesc_telemetry_t tel;            // Too big for the main task stack
     char buf[32];
 
+    vesc_telemetry_read(&tel);
+    const vesc_data_t *local = &tel.data[vesc_count - 1];
+
     // Speed level with brackets for visibility
-    const char* speed_str = speed_level_to_string(commanded_speed);
+    speed_level_t speed = COMMANDED_SPEED();
+    const char* speed_str = speed_level_to_string(speed);
     snprintf(buf, sizeof(buf), "[ %s ]", speed_str);
     lv_label_set_text(lbl_speed_level, buf);
 
     // Speed label color
     lv_color_t speed_color;
-    switch (commanded_speed) {
+    switch (speed) {
         case SPEED_LEVEL_OFF:    speed_color = lv_color_hex(0x888888); break;
         case SPEED_LEVEL_SLOW:   speed_color = lv_color_hex(0x44FF44); break;
         case SPEED_LEVEL_MEDIUM: speed_color = lv_color_hex(0xFFD700); break;
@@ -237,33 +327,36 @@ static void ui_update(void) {
     }
     lv_obj_set_style_text_color(lbl_speed_level, speed_color, 0);
 
-    if (emergency_stop_active) {
+    if (EMERGENCY_STOP_ACTIVE()) {
         lv_label_set_text(lbl_emergency, "EMERGENCY STOP");
     } else {
         lv_label_set_text(lbl_emergency, "");
     }
 
-    if (vesc_connected) {
-        snprintf(buf, sizeof(buf), "VOLT: %.1f V", vesc_data.input_voltage);
-        lv_label_set_text(lbl_voltage, buf);
-
-        snprintf(buf, sizeof(buf), "AMPS: %.1f A", vesc_data.avg_motor_current);
-        lv_label_set_text(lbl_current, buf);
-
-        snprintf(buf, sizeof(buf), "Ah: %.2f Ah", vesc_data.amp_hours);
-        lv_label_set_text(lbl_amp_hours, buf);
-
-        snprintf(buf, sizeof(buf), "RPM: %.0f", vesc_data.rpm);
-        lv_label_set_text(lbl_rpm, buf);
-
-        snprintf(buf, sizeof(buf), "TEMP: %.1f C", vesc_data.temp_mosfet);
-        lv_label_set_text(lbl_temp, buf);
+    if (vesc_telemetry_is_fresh(&tel, esp_timer_get_time(), VESC_TELEMETRY_MAX_AGE_MS * 1000LL)) {
+        ui_set_fixed(lbl_voltage, "VOLT: ", local->input_voltage, VESC_FX1_SCALE, 1, " V");
+        ui_set_fixed(lbl_current, "AMPS: ", local->avg_motor_current, VESC_FX2_SCALE, 1, " A");
+        ui_set_fixed(lbl_amp_hours, "Ah: ", local->amp_hours, VESC_FX4_SCALE, 2, " Ah");
+        ui_set_fixed(lbl_rpm, "RPM: ", local->rpm, 1, 0, "");
+        ui_set_fixed(lbl_temp, "TEMP: ", local->temp_mosfet, VESC_FX1_SCALE, 1, " C");
+
+        // First faulted or silent controller, UART VESC included
+        int bad = -1;
+        for (int i = 0; i < vesc_count && bad < 0; i++) {
+            if (!(tel.answered & (1UL << i)) || tel.data[i].fault != VESC_FAULT_NONE) {
+                bad = i;
+            }
+        }
 
-        if (vesc_data.fault == VESC_FAULT_NONE) {
+        if (bad < 0) {
             lv_label_set_text(lbl_fault, "VESC: OK");
             lv_obj_set_style_text_color(lbl_fault, lv_color_hex(0x44FF44), 0);
+        } else if (!(tel.answered & (1UL << bad))) {
+            snprintf(buf, sizeof(buf), "NO CAN %d", vesc_ids[bad]);
+            lv_label_set_text(lbl_fault, buf);
+            lv_obj_set_style_text_color(lbl_fault, lv_color_hex(0xFF8800), 0);
         } else {
-            snprintf(buf, sizeof(buf), "%s", vesc_fault_to_string(vesc_data.fault));
+            snprintf(buf, sizeof(buf), "%s", vesc_fault_to_string(tel.data[bad].fault));
             lv_label_set_text(lbl_fault, buf);
             lv_obj_set_style_text_color(lbl_fault, lv_color_hex(0xFF4444), 0);
         }
@@ -282,190 +375,739 @@ static void ui_update(void) {
 // Motor Control
 // =============================================================================
 
+// Current per speed level, clamped to the VESC limits once they are known
+static const float speed_currents_wanted[] = { 0.0f, CURRENT_SLOW, CURRENT_MEDIUM, CURRENT_FAST };
+static float speed_currents[] = { 0.0f, CURRENT_SLOW, CURRENT_MEDIUM, CURRENT_FAST };
+
+// Ramp limits per speed level; a change uses the faster of the two levels involved
+static const current_ramp_profile_t speed_ramps[] = {
+    [SPEED_LEVEL_OFF]    = { 0.0f, 0.0f, 0.0f },
+    [SPEED_LEVEL_SLOW]   = { CONFIG_CONTROL_RAMP_SLOW_UP, CONFIG_CONTROL_RAMP_SLOW_DOWN,
+                             CONFIG_CONTROL_RAMP_SLOW_JERK },
+    [SPEED_LEVEL_MEDIUM] = { CONFIG_CONTROL_RAMP_MEDIUM_UP, CONFIG_CONTROL_RAMP_MEDIUM_DOWN,
+                             CONFIG_CONTROL_RAMP_MEDIUM_JERK },
+    [SPEED_LEVEL_FAST]   = { CONFIG_CONTROL_RAMP_FAST_UP, CONFIG_CONTROL_RAMP_FAST_DOWN,
+                             CONFIG_CONTROL_RAMP_FAST_JERK },
+};
+
+// Setpoint shaping, only touched by the control loop
+static struct {
+    current_ramp_t ramp;
+    int64_t step_us;                // Previous ramp step
+    int64_t emit_us;                // Last setpoint sent
+    bool envelope_pending;          // Lower envelope waiting for the ramp to get down to it
+    float envelope_after;
+    uint32_t scale_pm;              // Prop guard scale in the last setpoint sent
+    bool clearing;                  // Running the weed clearing pulses
+    int64_t clear_start_us;
+    bool stall_locked;              // 0 A until the speed buttons are released
+} motor = { .scale_pm = 1000 };
+
+// Setpoint scale from the prop guard (per mille), written by vesc_task
+static atomic_uint motor_scale_pm = 1000;
+
+#if CONFIG_PROP_GUARD_ENABLE
+// Prop ventilation detector, only touched by vesc_task
+static const prop_guard_config_t prop_guard_config = {
+    .load_trip = CONFIG_PROP_GUARD_TRIP_PCT / 100.0f,
+    .load_clear = CONFIG_PROP_GUARD_CLEAR_PCT / 100.0f,
+    .rpm_rise = PROP_GUARD_RPM_RISE,
+    .current_fall = PROP_GUARD_CURRENT_FALL,
+    .rpm_min = CONFIG_PROP_GUARD_RPM_MIN,
+    .current_min = PROP_GUARD_CURRENT_MIN,
+    .steady_rpm = VESC_POLL_DRPM_PER_S,
+    .steady_current = VESC_POLL_DIDT_A_PER_S,
+    .baseline_weight = PROP_GUARD_BASELINE_WEIGHT,
+    .cut_scale = CONFIG_PROP_GUARD_CUT_PCT / 100.0f,
+    .restore_rate = (100 - CONFIG_PROP_GUARD_CUT_PCT) * 10.0f / CONFIG_PROP_GUARD_RESTORE_MS,
+    .clear_s = PROP_GUARD_CLEAR_MS / 1000.0f,
+    .max_dt_s = PROP_GUARD_MAX_DT_MS / 1000.0f,
+};
+static prop_guard_t prop_guard;
+#endif
+
+#if CONFIG_STALL_GUARD_ENABLE
+// Weed / stall detector, only touched by vesc_task
+static const stall_guard_config_t stall_guard_config = {
+    .current_share = STALL_GUARD_CURRENT_SHARE,
+    .current_min = STALL_GUARD_CURRENT_MIN,
+    .rpm_max = CONFIG_STALL_GUARD_RPM_MAX,
+    .detect_s = CONFIG_STALL_GUARD_DETECT_MS / 1000.0f,
+    .temp_max = CONFIG_STALL_GUARD_FET_TEMP_MAX,
+    .cooldown_s = CONFIG_STALL_GUARD_COOLDOWN_MS / 1000.0f,
+    .max_clears = CONFIG_STALL_GUARD_MAX_PER_MIN,
+    .window_s = STALL_GUARD_WINDOW_S,
+    .pulse_current = CONFIG_STALL_GUARD_PULSE_A,
+    .pulse_s = CONFIG_STALL_GUARD_PULSE_MS / 1000.0f,
+    .gap_s = CONFIG_STALL_GUARD_GAP_MS / 1000.0f,
+    .pulses = CONFIG_STALL_GUARD_PULSES,
+};
+static stall_guard_t stall_guard;
+// stall_guard_action_t for the control loop, written by vesc_task
+static atomic_uint stall_request = STALL_GUARD_NONE;
+// Mirrors motor.clearing for vesc_task
+static atomic_bool stall_clearing = false;
+#endif
+
 static float get_current_for_speed_level(speed_level_t level) {
     switch (level) {
-        case SPEED_LEVEL_SLOW:   return CURRENT_SLOW;
-        case SPEED_LEVEL_MEDIUM: return CURRENT_MEDIUM;
-        case SPEED_LEVEL_FAST:   return CURRENT_FAST;
+        case SPEED_LEVEL_SLOW:
+        case SPEED_LEVEL_MEDIUM:
+        case SPEED_LEVEL_FAST:   return speed_currents[level];
         default:                 return 0.0f;
     }
 }
 
+static void speed_currents_apply_limits(const vesc_limits_t *limits) {
+    if (!(limits->current_max > 0.0f)) {
+        ESP_LOGW(TAG, "VESC reports no usable l_current_max, keeping speed currents");
+        return;
+    }
+
+    for (int level = SPEED_LEVEL_SLOW; level <= SPEED_LEVEL_FAST; level++) {
+        float current = speed_currents_wanted[level];
+        if (current > limits->current_max) {
+            ESP_LOGW(TAG, "%s current %.1fA clamped to VESC l_current_max %.1fA",
+                     speed_level_to_string((speed_level_t)level), current, limits->current_max);
+            current = limits->current_max;
+        }
+        speed_currents[level] = current;
+    }
+}
+
+// Limits the VESC enforces itself while a level is selected
+static void apply_speed_envelope(float current) {
+#if CONFIG_VESC_ENVELOPE_ENABLE
+    vesc_envelope_t envelope = {
+        .current_max = current,
+        .erpm_max = CONFIG_VESC_ENVELOPE_ERPM_MAX,
+        .duty_max = CONFIG_VESC_ENVELOPE_DUTY_MAX_PCT / 100.0f,
+        .watt_max = CONFIG_VESC_ENVELOPE_WATT_MAX,
+    };
+    vesc_envelope_set(&envelope);
+#else
+    (void)current;
+#endif
+}
+
 static void apply_motor_current(float current) {
-    commanded_current = current;
-    if (current > 0.1f) {
-        vesc_set_current(current);
+    atomic_store_explicit(&commanded_ma, (int)lroundf(current * 1000.0f), memory_order_relaxed);
+    if (current <= 0.1f) {
+        current = 0.0f;
+    }
+
+    // Every motor gets the setpoint in the same burst, refreshed until it changes
+    vesc_cmd_set(VESC_CMD_CURRENT, current);
+}
+
+// Ramp the setpoint from wherever it is to the current of level to
+static void motor_ramp_to(speed_level_t from, speed_level_t to) {
+    float target = get_current_for_speed_level(to);
+
+    current_ramp_set_target(&motor.ramp, target, &speed_ramps[to > from ? to : from]);
+    if (to == SPEED_LEVEL_OFF) {
+        // Released keeps the envelope of the last level: the setpoint is 0 A anyway
+        return;
+    }
+    if (target >= motor.ramp.current) {
+        apply_speed_envelope(target);
+        motor.envelope_pending = false;
     } else {
-        vesc_set_current(0.0f);
+        // Lowering it now would cut the current in one step, under the ramp
+        motor.envelope_pending = true;
+        motor.envelope_after = target;
+    }
+}
+
+// Advance the ramp; the setpoint goes out every CONFIG_CONTROL_RAMP_EMIT_MS, on arrival
+// and at once when the prop guard changes its scale
+static void motor_ramp_step(int64_t now_us) {
+    float dt_s = motor.step_us != 0 ? (float)(now_us - motor.step_us) / 1000000.0f : 0.0f;
+    motor.step_us = now_us;
+    uint32_t scale_pm = atomic_load_explicit(&motor_scale_pm, memory_order_relaxed);
+    bool rescaled = scale_pm != motor.scale_pm;
+    motor.scale_pm = scale_pm;
+    if (current_ramp_done(&motor.ramp) && !rescaled) {
+        return;
+    }
+
+    // A stalled loop resumes where it was rather than jumping
+    if (dt_s > 0.02f) {
+        dt_s = 0.02f;
+    }
+    float setpoint = current_ramp_step(&motor.ramp, dt_s) * (float)scale_pm / 1000.0f;
+    bool done = current_ramp_done(&motor.ramp);
+    if (done || rescaled || now_us - motor.emit_us >= CONFIG_CONTROL_RAMP_EMIT_MS * 1000LL) {
+        motor.emit_us = now_us;
+        apply_motor_current(setpoint);
+    }
+    if (done && motor.envelope_pending) {
+        motor.envelope_pending = false;
+        apply_speed_envelope(motor.envelope_after);
+    }
+}
+
+#if CONFIG_PROP_GUARD_ENABLE
+// Judge a sample of the UART VESC; the control loop applies the scale on its next step
+static void prop_guard_feed(const vesc_data_t *data, int64_t now_us) {
+    prop_guard_state_t before = prop_guard.state;
+    bool driving = COMMANDED_SPEED() != SPEED_LEVEL_OFF && !EMERGENCY_STOP_ACTIVE();
+    float scale = prop_guard_update(&prop_guard, now_us, (float)data->rpm,
+                                    VESC_FX_TO_FLOAT(data->avg_motor_current, VESC_FX2_SCALE), driving);
+
+    atomic_store_explicit(&motor_scale_pm, (uint32_t)(scale * 1000.0f + 0.5f), memory_order_relaxed);
+    if (prop_guard.state != before && prop_guard.state != PROP_GUARD_RESTORING) {
+        ESP_LOGI(TAG, "Prop %s, load %.0f%% of baseline, %ld eRPM (%lu trips)",
+                 prop_guard_state_to_string(prop_guard.state), prop_guard.load * 100.0f,
+                 (long)data->rpm, (unsigned long)prop_guard.trips);
+    }
+}
+#endif
+
+#if CONFIG_STALL_GUARD_ENABLE
+// Judge a sample of the UART VESC; the control loop runs the clearing
+static void stall_guard_feed(const vesc_data_t *data, int64_t now_us) {
+    bool driving = COMMANDED_SPEED() != SPEED_LEVEL_OFF && !EMERGENCY_STOP_ACTIVE() &&
+                   !atomic_load(&stall_clearing);
+    float temp_fet = VESC_FX_TO_FLOAT(data->temp_mosfet, VESC_FX1_SCALE);
+    stall_guard_action_t action = stall_guard_update(&stall_guard, now_us, (float)data->rpm,
+                                                     VESC_FX_TO_FLOAT(data->avg_motor_current, VESC_FX2_SCALE),
+                                                     COMMANDED_CURRENT(), temp_fet, driving);
+    if (action == STALL_GUARD_NONE) {
+        return;
+    }
+
+    atomic_store(&stall_request, action);
+    ESP_LOGW(TAG, "Prop stalled at %ld eRPM, FETs %.1f C: %s (%lu cleared, %lu locked out)",
+             (long)data->rpm, temp_fet, action == STALL_GUARD_CLEAR ? "clearing" : "locking out",
+             (unsigned long)stall_guard.clears, (unsigned long)stall_guard.lockouts);
+}
+
+static void motor_clear_start(int64_t now_us) {
+    motor.clearing = true;
+    motor.clear_start_us = now_us;
+    atomic_store(&stall_clearing, true);
+    current_ramp_reset(&motor.ramp, 0.0f);
+    motor.envelope_pending = false;
+}
+
+// Reverse pulses; returns false once the sequence is over
+static bool motor_clear_step(int64_t now_us) {
+    bool done;
+    float pulse = stall_guard_pulse(&stall_guard_config, (float)(now_us - motor.clear_start_us) / 1000000.0f,
+                                    &done);
+    if (done) {
+        return false;
+    }
+    if (pulse != COMMANDED_CURRENT()) {
+        // Not apply_motor_current(): it would clamp the reverse pulse to 0 A
+        atomic_store_explicit(&commanded_ma, (int)lroundf(pulse * 1000.0f), memory_order_relaxed);
+        vesc_cmd_set(VESC_CMD_CURRENT, pulse);
+    }
+    return true;
+}
+#endif
+
+static void motor_clear_end(void) {
+    if (!motor.clearing) return;
+
+    motor.clearing = false;
+#if CONFIG_STALL_GUARD_ENABLE
+    atomic_store(&stall_clearing, false);
+#endif
+    current_ramp_reset(&motor.ramp, 0.0f);
+    apply_motor_current(0.0f);
+}
+
+// A critical task missed its deadline
+static void supervisor_tripped(int task, void *ctx) {
+    (void)ctx;
+    if (task == sup_control) {
+        vesc_cmd_halt();
+    }
+}
+
+// Control loop events for the log. The step must not block, so it only
+// flags them; boot_button_task writes the lines.
+#define CONTROL_EVENT_SPEED         (1U << 0)   // Level changed to or from off
+#define CONTROL_EVENT_ESTOP         (1U << 1)
+#define CONTROL_EVENT_ESTOP_CLEARED (1U << 2)
+static atomic_uint control_events;
+static atomic_uint control_event_speed;         // speed_level_t of the last CONTROL_EVENT_SPEED
+
+static void control_event(uint32_t event) {
+    atomic_fetch_or_explicit(&control_events, event, memory_order_release);
+}
+
+static void control_events_log(void) {
+    uint32_t events = atomic_exchange_explicit(&control_events, 0, memory_order_acquire);
+
+    if (events & CONTROL_EVENT_ESTOP) {
+        ESP_LOGW(TAG, "EMERGENCY STOP ACTIVATED");
+    }
+    if (events & CONTROL_EVENT_ESTOP_CLEARED) {
+        ESP_LOGI(TAG, "Emergency stop cleared");
+    }
+    if (events & CONTROL_EVENT_SPEED) {
+        speed_level_t level = (speed_level_t)atomic_load_explicit(&control_event_speed, memory_order_relaxed);
+        ESP_LOGI(TAG, "Speed: %s", speed_level_to_string(level));
     }
 }
 
 static void enter_emergency_stop(void) {
-    emergency_stop_active = true;
-    commanded_speed = SPEED_LEVEL_OFF;
+    atomic_store_explicit(&emergency_stop_active, true, memory_order_relaxed);
+    atomic_store_explicit(&commanded_speed, SPEED_LEVEL_OFF, memory_order_relaxed);
+    // No ramp: straight to 0 A
+    current_ramp_reset(&motor.ramp, 0.0f);
+    motor.envelope_pending = false;
+    motor_clear_end();
+    motor.stall_locked = false;
     apply_motor_current(0.0f);
+    // Also in the VESC, so a stale setpoint cannot move the motor
+    apply_speed_envelope(0.0f);
     speed_buttons_set_all_leds(false);
-    ESP_LOGW(TAG, "EMERGENCY STOP ACTIVATED");
+    control_event(CONTROL_EVENT_ESTOP);
 }
 
 static void exit_emergency_stop(speed_level_t *last_speed_level) {
-    emergency_stop_active = false;
-    commanded_speed = SPEED_LEVEL_OFF;
+    atomic_store_explicit(&emergency_stop_active, false, memory_order_relaxed);
+    atomic_store_explicit(&commanded_speed, SPEED_LEVEL_OFF, memory_order_relaxed);
     if (last_speed_level) {
         *last_speed_level = SPEED_LEVEL_OFF;
     }
-    speed_buttons_set_leds(commanded_speed);
-    ESP_LOGI(TAG, "Emergency stop cleared");
+    speed_buttons_set_leds(SPEED_LEVEL_OFF);
+    control_event(CONTROL_EVENT_ESTOP_CLEARED);
 }
 
 // =============================================================================
 // Tasks
 // =============================================================================
 
-static void vesc_task(void *arg) {
-    (void)arg;
-    TickType_t last_wake = xTaskGetTickCount();
-    
-    while (1) {
-        if (vesc_get_values(&vesc_data)) {
-            vesc_connected = true;
+// Build the controller table from CONFIG_VESC_CAN_IDS plus the UART VESC
+static void vesc_controllers_init(void) {
+    const char *p = CONFIG_VESC_CAN_IDS;
+
+    vesc_count = 0;
+    while (*p != '\0' && vesc_count < VESC_MAX_CONTROLLERS - 1) {
+        char *end;
+        long id = strtol(p, &end, 10);
+        if (end == p) {
+            p++;    // Separator
+            continue;
+        }
+        if (id >= 0 && id < 255) {
+            vesc_ids[vesc_count++] = (int)id;
         } else {
-            vesc_connected = false;
+            ESP_LOGW(TAG, "Ignoring CAN ID %ld", id);
         }
+        p = end;
+    }
+    vesc_ids[vesc_count++] = VESC_CAN_LOCAL;
 
-        if (vesc_connected) {
-            vesc_send_keepalive();
-        }
+    ESP_LOGI(TAG, "Driving %d VESC(s), %d on CAN", vesc_count, vesc_count - 1);
+}
+
+#if CONFIG_VESC_CAN_STATUS_ENABLE
+static void vesc_can_start(void) {
+    can_bus_config_t config = {
+        .tx_gpio = CONFIG_VESC_CAN_TX_GPIO,
+        .rx_gpio = CONFIG_VESC_CAN_RX_GPIO,
+        .bitrate = CONFIG_VESC_CAN_BITRATE,
+#if CONFIG_IDF_TARGET_LINUX
+        .ifname = CONFIG_VESC_CAN_SOCKETCAN_IF,
+#endif
+    };
+
+    if (vesc_can_init(CAN_BUS_DEFAULT_BACKEND, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "VESC CAN init failed, polling everything over UART");
+    }
+}
 
-        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(VESC_POLL_INTERVAL_MS));
+// Controller ID entry i broadcasts its status under, or -1 while unknown
+static int vesc_status_id(int i) {
+    if (vesc_ids[i] != VESC_CAN_LOCAL) {
+        return vesc_ids[i];
     }
+    return vesc_get_local_controller_id();
 }
+#endif
 
-// MOMENTARY: Hold button = motor runs, release = motor stops
-static void control_task(void *arg) {
+// Link back up: wake vesc_task out of its disconnected back-off
+static void vesc_health_changed(vesc_health_state_t state, void *ctx) {
+    (void)ctx;
+    if (state == VESC_HEALTH_CONNECTED && vesc_task_handle != NULL) {
+        xTaskNotifyGive(vesc_task_handle);
+    }
+}
+
+static void vesc_task(void *arg) {
     (void)arg;
-    speed_level_t last_speed_level = SPEED_LEVEL_OFF;
-    TickType_t all_pressed_start = 0;
-    bool tracking_all_pressed = false;
-    TickType_t blink_last_toggle = 0;
-    bool blink_state = false;
-    bool prev_slow = false;
-    bool prev_medium = false;
-    bool prev_fast = false;
-
-    typedef enum {
-        EXIT_WAIT_SLOW_PRESS = 0,
-        EXIT_WAIT_SLOW_RELEASE,
-        EXIT_WAIT_MEDIUM_PRESS,
-        EXIT_WAIT_MEDIUM_RELEASE,
-        EXIT_WAIT_FAST_PRESS,
-        EXIT_WAIT_FAST_RELEASE
-    } emergency_exit_state_t;
-
-    emergency_exit_state_t exit_state = EXIT_WAIT_SLOW_PRESS;
+    uint32_t masks[VESC_MAX_CONTROLLERS];
+    uint32_t uart_answered = 0;
+    uint32_t can_fresh = 0;                 // Bit i: controller i has fresh CAN status
+#if CONFIG_PROP_GUARD_ENABLE || CONFIG_STALL_GUARD_ENABLE
+    int64_t guard_fed_us = 0;               // Sample time of the last eRPM/current fed to the guards
+#endif
+    uint32_t poll_interval_ms = 0;          // First poll right away
+    vesc_poll_mode_t last_mode = VESC_POLL_DISCONNECTED;
+
+    vesc_task_handle = xTaskGetCurrentTaskHandle();
+    vesc_link_start();
+    vesc_health_start(vesc_health_changed, NULL);
+    // Telemetry layout and commands follow the firmware version
+    vesc_caps_handshake();
+
+    // Clamp the speed levels to the VESC current limits (from the NVS cache when it matches)
+    vesc_limits_t limits;
+    vesc_config_source_t config_source = VESC_CONFIG_NONE;
+    if (vesc_config_load(&limits, &config_source) == ESP_OK) {
+        speed_currents_apply_limits(&limits);
+        vesc_envelope_set_limits(&limits);
+    }
+    // Cached or missing limits are confirmed with a full read once the motor is idle
+    bool config_check_due = (config_source != VESC_CONFIG_FETCHED) && vesc_caps_has(VESC_CAP_CONFIG);
+    int64_t config_check_after_us = esp_timer_get_time() + VESC_CONFIG_CHECK_DELAY_MS * 1000LL;
+    vesc_poll_init(&vesc_poll, vesc_values_mask, esp_timer_get_time());
+#if CONFIG_PROP_GUARD_ENABLE
+    prop_guard_init(&prop_guard, &prop_guard_config);
+#endif
+#if CONFIG_STALL_GUARD_ENABLE
+    stall_guard_init(&stall_guard, &stall_guard_config);
+#endif
+    TickType_t last_wake = xTaskGetTickCount();
+#if CONFIG_VESC_CAN_STATUS_ENABLE
+    TickType_t last_poll = last_wake;
+#endif
     
     while (1) {
-        bool slow_pressed = false, medium_pressed = false, fast_pressed = false;
-        speed_buttons_get_raw(&slow_pressed, &medium_pressed, &fast_pressed);
-
-        bool all_pressed = slow_pressed && medium_pressed && fast_pressed;
-
-        if (!emergency_stop_active) {
-            if (all_pressed) {
-                if (!tracking_all_pressed) {
-                    tracking_all_pressed = true;
-                    all_pressed_start = xTaskGetTickCount();
-                } else if ((xTaskGetTickCount() - all_pressed_start) >= pdMS_TO_TICKS(2000)) {
-                    enter_emergency_stop();
-                    blink_last_toggle = xTaskGetTickCount();
-                    blink_state = false;
-                    exit_state = EXIT_WAIT_SLOW_PRESS;
+        supervisor_checkin(sup_vesc, esp_timer_get_time());
+        int64_t sample_us = 0;              // When the UART VESC's eRPM/current were measured, 0 = not this pass
+        uint32_t poll_mask = vesc_poll_next_mask(&vesc_poll);
+        for (int i = 0; i < vesc_count; i++) {
+            masks[i] = poll_mask;
+        }
+
+#if CONFIG_VESC_CAN_STATUS_ENABLE
+        // Fields the status broadcasts keep fresh are not polled over UART
+        can_fresh = 0;
+        for (int i = 0; i < vesc_count; i++) {
+            int id = vesc_status_id(i);
+            int64_t motor_us = 0;
+            uint32_t fields = (id >= 0) ? vesc_can_get_values((uint8_t)id, &vesc_data[i],
+                                                              CONFIG_VESC_CAN_STATUS_MAX_AGE_MS, &motor_us) : 0;
+            if (fields) {
+                can_fresh |= 1UL << i;
+            }
+            if (i == vesc_count - 1) {
+                sample_us = motor_us;
+            }
+            masks[i] = poll_mask & ~fields;
+        }
+
+        // The loop runs at the CAN rate; the UART poll only when due
+        bool poll_due = (xTaskGetTickCount() - last_poll) >= pdMS_TO_TICKS(poll_interval_ms);
+        if (poll_due) {
+            last_poll = xTaskGetTickCount();
+        }
+#else
+        bool poll_due = true;               // The task already sleeps for the poll interval
+#endif
+        if (poll_due) {
+            // All controllers polled in one pipelined round
+            uart_answered = vesc_poll_values_masked(vesc_ids, vesc_data, vesc_count, masks);
+            // eRPM and current came over UART unless the CAN status had them
+            if (sample_us == 0 && (uart_answered & (1UL << (vesc_count - 1)))) {
+                sample_us = esp_timer_get_time();
+            }
+
+            // Rate follows the UART VESC: commanded current and how fast it is changing
+            bool local_ok = ((uart_answered | can_fresh) & (1UL << (vesc_count - 1))) != 0;
+            poll_interval_ms = vesc_poll_update(&vesc_poll, local_ok, &vesc_data[vesc_count - 1],
+                                                COMMANDED_CURRENT(), esp_timer_get_time());
+            if (vesc_poll.mode != last_mode) {
+                vesc_poll_stats_t stats;
+                vesc_poll_get_stats(&vesc_poll, &stats);
+                ESP_LOGI(TAG, "Poll %s -> %s, every %lu ms (achieved %lu.%03lu Hz, %lu%% answered)",
+                         vesc_poll_mode_to_string(last_mode), vesc_poll_mode_to_string(stats.mode),
+                         (unsigned long)stats.interval_ms,
+                         (unsigned long)(stats.rate_mhz / 1000), (unsigned long)(stats.rate_mhz % 1000),
+                         (unsigned long)stats.answer_pct);
+                last_mode = vesc_poll.mode;
+            }
+
+            vesc_link_update();
+        }
+
+        if (config_check_due && vesc_poll.mode == VESC_POLL_IDLE &&
+            esp_timer_get_time() >= config_check_after_us) {
+            bool changed = false;
+            esp_err_t ret = vesc_config_refresh(&limits, &changed);
+            if (ret == ESP_OK) {
+                config_check_due = false;
+                if (changed || config_source == VESC_CONFIG_NONE) {
+                    speed_currents_apply_limits(&limits);
+                    vesc_envelope_set_limits(&limits);
                 }
+            } else if (ret == ESP_ERR_NOT_SUPPORTED) {
+                config_check_due = false;
             } else {
-                tracking_all_pressed = false;
+                config_check_after_us = esp_timer_get_time() + VESC_CONFIG_CHECK_DELAY_MS * 1000LL;
             }
+        }
 
-            if (!emergency_stop_active) {
-                speed_level_t new_speed = speed_buttons_get_level();
-                
-                if (new_speed != last_speed_level) {
-                    if (new_speed == SPEED_LEVEL_OFF || last_speed_level == SPEED_LEVEL_OFF) {
-                        ESP_LOGI(TAG, "Speed: %s", speed_level_to_string(new_speed));
-                    }
-                    
-                    commanded_speed = new_speed;
-                    apply_motor_current(get_current_for_speed_level(new_speed));
-                    speed_buttons_set_leds(commanded_speed);
-                    last_speed_level = new_speed;
-                }
+        // The round is complete: readers see all of it or none of it
+        uint32_t answered = uart_answered | can_fresh;
+#if CONFIG_PROP_GUARD_ENABLE || CONFIG_STALL_GUARD_ENABLE
+        // The guards differentiate eRPM and current: each sample once, at its own time.
+        // The loop runs faster than CAN status arrives and the UART is polled.
+        bool new_sample = sample_us != 0 && sample_us != guard_fed_us;
+        if (new_sample) {
+            guard_fed_us = sample_us;
+        }
+#if CONFIG_PROP_GUARD_ENABLE
+        if (new_sample) {
+            prop_guard_feed(&vesc_data[vesc_count - 1], sample_us);
+        }
+#endif
+#if CONFIG_STALL_GUARD_ENABLE
+        if (new_sample) {
+            stall_guard_feed(&vesc_data[vesc_count - 1], sample_us);
+        }
+#endif
+#else
+        (void)sample_us;
+#endif
+        vesc_telemetry_publish(vesc_data, vesc_count, answered, (answered & (1UL << (vesc_count - 1))) != 0,
+                               esp_timer_get_time());
+
+#if CONFIG_VESC_CAN_STATUS_ENABLE
+        uint32_t wait_ms = VESC_CAN_READ_INTERVAL_MS;
+#else
+        uint32_t wait_ms = poll_interval_ms;
+#endif
+        if (vesc_poll.mode == VESC_POLL_DISCONNECTED) {
+            // Sit out the back-off, but poll as soon as the health monitor hears the VESC again
+            if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms)) != 0) {
+                // Possibly another VESC or a reflash: redo the handshake first
+                vesc_caps_handshake();
+                // A rebooted VESC has dropped its temporary limits
+                vesc_envelope_invalidate();
+                poll_interval_ms = 0;
             }
+            last_wake = xTaskGetTickCount();
+        } else {
+            vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(wait_ms));
+        }
+    }
+}
+
+typedef enum {
+    EXIT_WAIT_SLOW_PRESS = 0,
+    EXIT_WAIT_SLOW_RELEASE,
+    EXIT_WAIT_MEDIUM_PRESS,
+    EXIT_WAIT_MEDIUM_RELEASE,
+    EXIT_WAIT_FAST_PRESS,
+    EXIT_WAIT_FAST_RELEASE
+} emergency_exit_state_t;
+
+// Control loop state, only touched by control_step()
+static struct {
+    speed_level_t last_speed_level;
+    bool blink_state;
+    int64_t blink_last_toggle_us;
+    bool prev_slow;
+    bool prev_medium;
+    bool prev_fast;
+    emergency_exit_state_t exit_state;
+} control;
+
+// MOMENTARY: Hold button = motor runs, release = motor stops.
+// Runs every CONFIG_CONTROL_LOOP_PERIOD_US on the control core; must not block.
+static void control_step(int64_t now_us, void *ctx) {
+    (void)ctx;
+    // Without this check-in the supervisor cuts the motors
+    supervisor_checkin(sup_control, now_us);
+
+    // Debounced by button_input, updated from the edge interrupts
+    uint32_t buttons = button_input_pressed_mask();
+    bool slow_pressed = (buttons & BUTTON_INPUT_BIT(BUTTON_INPUT_SLOW)) != 0;
+    bool medium_pressed = (buttons & BUTTON_INPUT_BIT(BUTTON_INPUT_MEDIUM)) != 0;
+    bool fast_pressed = (buttons & BUTTON_INPUT_BIT(BUTTON_INPUT_FAST)) != 0;
+
+    // The chord is timed by the e-stop fast path, which has already cut the motors
+    if (estop_take()) {
+        if (!EMERGENCY_STOP_ACTIVE()) {
+            enter_emergency_stop();
+            control.blink_last_toggle_us = now_us;
+            control.blink_state = false;
+            control.exit_state = EXIT_WAIT_SLOW_PRESS;
         } else {
-            TickType_t now = xTaskGetTickCount();
-            if ((now - blink_last_toggle) >= pdMS_TO_TICKS(500)) {
-                blink_last_toggle = now;
-                blink_state = !blink_state;
-                speed_buttons_set_all_leds(blink_state);
+            apply_motor_current(0.0f);
+        }
+        // The hold ends with the 0 A batch this hands to vesc_cmd, so no
+        // setpoint its sender already had can follow the burst
+        estop_acknowledge();
+    }
+
+    if (!EMERGENCY_STOP_ACTIVE()) {
+        speed_level_t new_speed = speed_buttons_level_from(slow_pressed, medium_pressed, fast_pressed);
+
+        if (vesc_cmd_halted()) {
+            // The supervisor cut the motors: 0 A until every speed button is released
+            current_ramp_reset(&motor.ramp, 0.0f);
+            motor.envelope_pending = false;
+            if (new_speed == SPEED_LEVEL_OFF) {
+                apply_motor_current(0.0f);      // Re-arms vesc_cmd
             }
+            new_speed = SPEED_LEVEL_OFF;
+        }
 
-            if (commanded_current != 0.0f) {
-                apply_motor_current(0.0f);
+#if CONFIG_STALL_GUARD_ENABLE
+        // Weed on the prop: reverse pulses, then ramp back up from 0 A.
+        // A lockout holds 0 A until every speed button is released.
+        stall_guard_action_t stall = (stall_guard_action_t)atomic_exchange(&stall_request, STALL_GUARD_NONE);
+        if (stall == STALL_GUARD_LOCKOUT) {
+            motor_clear_end();
+            motor.stall_locked = true;
+            current_ramp_reset(&motor.ramp, 0.0f);
+            motor.envelope_pending = false;
+            apply_motor_current(0.0f);
+        } else if (stall == STALL_GUARD_CLEAR && new_speed != SPEED_LEVEL_OFF && !motor.stall_locked) {
+            motor_clear_start(now_us);
+        }
+        if (motor.stall_locked) {
+            if (new_speed == SPEED_LEVEL_OFF) {
+                motor.stall_locked = false;
+            } else {
+                new_speed = SPEED_LEVEL_OFF;
+            }
+        }
+        if (motor.clearing && (new_speed == SPEED_LEVEL_OFF || !motor_clear_step(now_us))) {
+            // Over, or released: a level still held ramps up from 0 A
+            motor_clear_end();
+            if (new_speed != SPEED_LEVEL_OFF) {
+                control.last_speed_level = SPEED_LEVEL_OFF;
             }
+        }
+#endif
+
+        // The clearing pulses own the setpoint while they run
+        if (!motor.clearing) {
+            if (new_speed != control.last_speed_level) {
+                if (new_speed == SPEED_LEVEL_OFF || control.last_speed_level == SPEED_LEVEL_OFF) {
+                    atomic_store_explicit(&control_event_speed, new_speed, memory_order_relaxed);
+                    control_event(CONTROL_EVENT_SPEED);
+                }
 
-            switch (exit_state) {
-                case EXIT_WAIT_SLOW_PRESS:
-                    if (!prev_slow && slow_pressed) {
-                        exit_state = EXIT_WAIT_SLOW_RELEASE;
-                    }
-                    break;
-                case EXIT_WAIT_SLOW_RELEASE:
-                    if (prev_slow && !slow_pressed) {
-                        exit_state = EXIT_WAIT_MEDIUM_PRESS;
-                    }
-                    break;
-                case EXIT_WAIT_MEDIUM_PRESS:
-                    if (!prev_medium && medium_pressed) {
-                        exit_state = EXIT_WAIT_MEDIUM_RELEASE;
-                    }
-                    break;
-                case EXIT_WAIT_MEDIUM_RELEASE:
-                    if (prev_medium && !medium_pressed) {
-                        exit_state = EXIT_WAIT_FAST_PRESS;
-                    }
-                    break;
-                case EXIT_WAIT_FAST_PRESS:
-                    if (!prev_fast && fast_pressed) {
-                        exit_state = EXIT_WAIT_FAST_RELEASE;
-                    }
-                    break;
-                case EXIT_WAIT_FAST_RELEASE:
-                    if (prev_fast && !fast_pressed) {
-                        exit_state = EXIT_WAIT_SLOW_PRESS;
-                        blink_state = false;
-                        speed_buttons_set_all_leds(false);
-                        exit_emergency_stop(&last_speed_level);
-                    }
-                    break;
-                default:
-                    exit_state = EXIT_WAIT_SLOW_PRESS;
-                    break;
+                atomic_store_explicit(&commanded_speed, new_speed, memory_order_relaxed);
+                motor_ramp_to(control.last_speed_level, new_speed);
+                speed_buttons_set_leds(new_speed);
+                control.last_speed_level = new_speed;
             }
+            motor_ramp_step(now_us);
+        }
+    } else {
+        if (now_us - control.blink_last_toggle_us >= 500 * 1000LL) {
+            control.blink_last_toggle_us = now_us;
+            control.blink_state = !control.blink_state;
+            speed_buttons_set_all_leds(control.blink_state);
         }
 
-        prev_slow = slow_pressed;
-        prev_medium = medium_pressed;
-        prev_fast = fast_pressed;
-        
-        vTaskDelay(pdMS_TO_TICKS(20));
+        if (COMMANDED_CURRENT() != 0.0f) {
+            apply_motor_current(0.0f);
+        }
+
+        switch (control.exit_state) {
+            case EXIT_WAIT_SLOW_PRESS:
+                if (!control.prev_slow && slow_pressed) {
+                    control.exit_state = EXIT_WAIT_SLOW_RELEASE;
+                }
+                break;
+            case EXIT_WAIT_SLOW_RELEASE:
+                if (control.prev_slow && !slow_pressed) {
+                    control.exit_state = EXIT_WAIT_MEDIUM_PRESS;
+                }
+                break;
+            case EXIT_WAIT_MEDIUM_PRESS:
+                if (!control.prev_medium && medium_pressed) {
+                    control.exit_state = EXIT_WAIT_MEDIUM_RELEASE;
+                }
+                break;
+            case EXIT_WAIT_MEDIUM_RELEASE:
+                if (control.prev_medium && !medium_pressed) {
+                    control.exit_state = EXIT_WAIT_FAST_PRESS;
+                }
+                break;
+            case EXIT_WAIT_FAST_PRESS:
+                if (!control.prev_fast && fast_pressed) {
+                    control.exit_state = EXIT_WAIT_FAST_RELEASE;
+                }
+                break;
+            case EXIT_WAIT_FAST_RELEASE:
+                if (control.prev_fast && !fast_pressed) {
+                    control.exit_state = EXIT_WAIT_SLOW_PRESS;
+                    control.blink_state = false;
+                    speed_buttons_set_all_leds(false);
+                    exit_emergency_stop(&control.last_speed_level);
+                }
+                break;
+            default:
+                control.exit_state = EXIT_WAIT_SLOW_PRESS;
+                break;
+        }
     }
+
+    control.prev_slow = slow_pressed;
+    control.prev_medium = medium_pressed;
+    control.prev_fast = fast_pressed;
 }
 
 static void boot_button_task(void *arg) {
     (void)arg;
     
     while (1) {
+        control_events_log();
         if (BOOT_KEY_State == SINGLE_CLICK) {
             BOOT_KEY_State = NONE_PRESS;
-            ESP_LOGI(TAG, "Boot button (debug)");
+            control_loop_stats_t loop;
+            control_loop_get_stats(&loop);
+            ESP_LOGI(TAG, "Control loop: %lu steps, run avg %lu / max %lu us (budget %lu), "
+                     "latency max %lu us, jitter max %lu us, %lu overruns, %lu missed",
+                     (unsigned long)loop.steps, (unsigned long)loop.run_avg_us,
+                     (unsigned long)loop.run_max_us, (unsigned long)loop.budget_us,
+                     (unsigned long)loop.latency_max_us, (unsigned long)loop.jitter_max_us,
+                     (unsigned long)loop.overruns, (unsigned long)loop.missed);
+            vesc_cmd_stats_t cmd;
+            vesc_cmd_get_stats(&cmd);
+            ESP_LOGI(TAG, "Setpoints: %lu changes, %lu refreshes, %lu coalesced, %lu dropped, "
+                     "%lu halts (%lu held)",
+                     (unsigned long)cmd.changes, (unsigned long)cmd.refreshes, (unsigned long)cmd.coalesced,
+                     (unsigned long)cmd.dropped, (unsigned long)cmd.halts, (unsigned long)cmd.held);
+            button_input_stats_t input;
+            button_input_get_stats(&input);
+            ESP_LOGI(TAG, "Buttons: %lu edges, %lu events (%lu corrected, %lu dropped), latency max %lu us",
+                     (unsigned long)input.edges, (unsigned long)input.events,
+                     (unsigned long)input.corrections, (unsigned long)input.dropped,
+                     (unsigned long)input.latency_max_us);
+            estop_stats_t estop;
+            vesc_io_estop_stats_t burst;
+            estop_get_stats(&estop);
+            vesc_io_get_estop_stats(&burst);
+            ESP_LOGI(TAG, "E-stop: %lu fired (%lu chords, %lu released early), alarm late max %lu us",
+                     (unsigned long)estop.fired, (unsigned long)estop.armed,
+                     (unsigned long)estop.cancelled, (unsigned long)estop.alarm_late_max_us);
+            ESP_LOGI(TAG, "E-stop burst: %lu B, pickup max %lu us, on the wire max %lu us "
+                     "(last %lu us, %lu B ahead max, %lu stale dropped)",
+                     (unsigned long)burst.burst_bytes, (unsigned long)burst.pickup_max_us,
+                     (unsigned long)burst.wire_max_us, (unsigned long)burst.last_wire_us,
+                     (unsigned long)burst.ahead_max_bytes, (unsigned long)burst.dropped);
+            for (int i = 0; i < supervisor_count(); i++) {
+                supervisor_stats_t sup;
+                supervisor_get_stats(i, &sup);
+                ESP_LOGI(TAG, "Deadline %s: %lu us, %lu missed, worst %lu us late (gap max %lu us)",
+                         sup.name, (unsigned long)sup.deadline_us, (unsigned long)sup.misses,
+                         (unsigned long)sup.late_max_us, (unsigned long)sup.gap_max_us);
+            }
         }
         if (BOOT_KEY_State == LONG_PRESS_START) {
             BOOT_KEY_State = NONE_PRESS;
@@ -480,29 +1122,77 @@ static void boot_button_task(void *arg) {
 
 void app_main(void)
 {
+    // Console output is formatted later by a low-priority task, see log_async.h
+    log_async_start();
+
+    // NVS holds the VESC config cache
+    esp_err_t nvs_ret = nvs_flash_init();
+    if (nvs_ret == ESP_ERR_NVS_NO_FREE_PAGES || nvs_ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        nvs_ret = nvs_flash_init();
+    }
+    if (nvs_ret != ESP_OK) {
+        ESP_LOGE(TAG, "NVS init failed: %s", esp_err_to_name(nvs_ret));
+    }
+
     ESP_LOGI(TAG, "=== Death Stick Controller ===");
     ESP_LOGI(TAG, "SLOW=%.1fA, MEDIUM=%.1fA, FAST=%.1fA",
              CURRENT_SLOW, CURRENT_MEDIUM, CURRENT_FAST);
 
     LCD_Init();
     LVGL_Init();
-    button_Init();
     speed_buttons_init();
+    // BOOT and speed buttons: edge interrupts, debounced
+    button_Init();
+    vesc_controllers_init();
     
     esp_err_t ret = vesc_uart_init();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "VESC UART init failed!");
     }
+    // The periodic setpoint is also the VESC keepalive
+    vesc_cmd_start(vesc_ids, vesc_count, CONFIG_VESC_CMD_PERIOD_MS);
+    vesc_cmd_set(VESC_CMD_CURRENT, 0.0f);
+    // Chord to 0 A burst on the wire without the control loop in the path
+    if (estop_start(vesc_ids, vesc_count, CONFIG_ESTOP_HOLD_MS) != ESP_OK) {
+        ESP_LOGE(TAG, "E-stop fast path start failed!");
+    }
+    // Until a button is held the VESC is held to the SLOW envelope, pushed once its limits are known
+    vesc_envelope_init(vesc_count > 1);
+    apply_speed_envelope(get_current_for_speed_level(SPEED_LEVEL_SLOW));
+#if CONFIG_VESC_CAN_STATUS_ENABLE
+    vesc_can_start();
+#endif
 
     ui_create();
 
+    // A stuck control loop must not leave the last setpoint refreshed:
+    // cut to 0 A at once instead of waiting for the VESC timeout
+    sup_control = supervisor_register("control", CONFIG_SUPERVISOR_CONTROL_DEADLINE_MS * 1000, true);
+    sup_vesc = supervisor_register("vesc", VESC_TASK_DEADLINE_MS * 1000, false);
+    sup_ui = supervisor_register("ui", UI_TASK_DEADLINE_MS * 1000, false);
+    if (supervisor_start(CONFIG_SUPERVISOR_CHECK_MS * 1000, supervisor_tripped, NULL) != ESP_OK) {
+        ESP_LOGE(TAG, "Supervisor start failed!");
+    }
+
     xTaskCreatePinnedToCore(vesc_task, "vesc_task", 4096, NULL, 5, NULL, 0);
-    xTaskCreatePinnedToCore(control_task, "control_task", 2048, NULL, 4, NULL, 0);
+    // Buttons to setpoint on the otherwise idle core, at a fixed rate
+    const control_loop_config_t loop_config = {
+        .period_us = CONFIG_CONTROL_LOOP_PERIOD_US,
+        .budget_us = CONFIG_CONTROL_LOOP_BUDGET_US,
+        .core = CONTROL_LOOP_CORE,
+        .priority = CONTROL_LOOP_PRIORITY,
+        .stack_size = 4096,
+    };
+    if (control_loop_start(&loop_config, control_step, NULL) != ESP_OK) {
+        ESP_LOGE(TAG, "Control loop start failed!");
+    }
     xTaskCreatePinnedToCore(boot_button_task, "boot_btn_task", 2048, NULL, 3, NULL, 0);
 
     ESP_LOGI(TAG, "Ready - HOLD buttons for speed control");
 
     while (1) {
+        supervisor_checkin(sup_ui, esp_timer_get_time());
         ui_update();
         lv_timer_handler();
         vTaskDelay(pdMS_TO_TICKS(20));
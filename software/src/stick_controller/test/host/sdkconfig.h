@@ -0,0 +1,12 @@
+/**
+ * @file sdkconfig.h
+ * @brief Host stand-in for the generated ESP-IDF config: the options the
+ *        modules under test read, at their Kconfig defaults
+ */
+
+#ifndef TEST_HOST_SDKCONFIG_H
+#define TEST_HOST_SDKCONFIG_H
+
+#define CONFIG_VESC_UART_BAUD_FALLBACK 115200
+
+#endif // TEST_HOST_SDKCONFIG_H
@@ -0,0 +1,324 @@
+/**
+ * @file test_codec.c
+ * @brief Table-driven codec: golden bytes and round trips per message layout
+ */
+
+#include "vesc_codec.h"
+#include "vesc_uart.h"
+#include "test_util.h"
+#include <string.h>
+
+// Telemetry with every field set, negatives included
+static vesc_data_t sample_values(void) {
+    vesc_data_t d;
+    memset(&d, 0, sizeof(d));
+    d.temp_mosfet = 253;                // 25.3 C
+    d.temp_motor = -15;                 // -1.5 C
+    d.avg_motor_current = 1234;         // 12.34 A
+    d.avg_input_current = -250;         // -2.50 A
+    d.duty_cycle = 950;                 // 0.950
+    d.rpm = -12345;
+    d.input_voltage = 504;              // 50.4 V
+    d.amp_hours = 12345;                // 1.2345 Ah
+    d.amp_hours_charged = 1;
+    d.watt_hours = 98765;
+    d.watt_hours_charged = 0;
+    d.tachometer = 100000;
+    d.tachometer_abs = 200000;
+    d.fault = VESC_FAULT_OVER_TEMP_FET;
+    d.pid_pos = 180000000;              // 180 degrees
+    d.controller_id = 42;
+    return d;
+}
+
+// COMM_GET_VALUES as the firmware sends it for sample_values()
+static const uint8_t values_golden[] = {
+    COMM_GET_VALUES,
+    0x00, 0xFD,                         // temp_mosfet
+    0xFF, 0xF1,                         // temp_motor
+    0x00, 0x00, 0x04, 0xD2,             // avg_motor_current
+    0xFF, 0xFF, 0xFF, 0x06,             // avg_input_current
+    0x00, 0x00, 0x00, 0x00,             // avg_id
+    0x00, 0x00, 0x00, 0x00,             // avg_iq
+    0x03, 0xB6,                         // duty_cycle
+    0xFF, 0xFF, 0xCF, 0xC7,             // rpm
+    0x01, 0xF8,                         // input_voltage
+    0x00, 0x00, 0x30, 0x39,             // amp_hours
+    0x00, 0x00, 0x00, 0x01,             // amp_hours_charged
+    0x00, 0x01, 0x81, 0xCD,             // watt_hours
+    0x00, 0x00, 0x00, 0x00,             // watt_hours_charged
+    0x00, 0x01, 0x86, 0xA0,             // tachometer
+    0x00, 0x03, 0x0D, 0x40,             // tachometer_abs
+    0x05,                               // fault
+    0x0A, 0xBA, 0x95, 0x00,             // pid_pos
+    0x2A,                               // controller_id
+};
+
+static void check_values_equal(const vesc_data_t *a, const vesc_data_t *b) {
+    CHECK_EQ_INT(a->temp_mosfet, b->temp_mosfet);
+    CHECK_EQ_INT(a->temp_motor, b->temp_motor);
+    CHECK_EQ_INT(a->avg_motor_current, b->avg_motor_current);
+    CHECK_EQ_INT(a->avg_input_current, b->avg_input_current);
+    CHECK_EQ_INT(a->duty_cycle, b->duty_cycle);
+    CHECK_EQ_INT(a->rpm, b->rpm);
+    CHECK_EQ_INT(a->input_voltage, b->input_voltage);
+    CHECK_EQ_INT(a->amp_hours, b->amp_hours);
+    CHECK_EQ_INT(a->amp_hours_charged, b->amp_hours_charged);
+    CHECK_EQ_INT(a->watt_hours, b->watt_hours);
+    CHECK_EQ_INT(a->watt_hours_charged, b->watt_hours_charged);
+    CHECK_EQ_INT(a->tachometer, b->tachometer);
+    CHECK_EQ_INT(a->tachometer_abs, b->tachometer_abs);
+    CHECK_EQ_INT(a->fault, b->fault);
+    CHECK_EQ_INT(a->pid_pos, b->pid_pos);
+    CHECK_EQ_INT(a->controller_id, b->controller_id);
+}
+
+static void test_values(void) {
+    vesc_data_t in = sample_values(), out;
+    uint8_t buf[128];
+
+    int32_t len = vesc_codec_encode(&vesc_msg_values, &in, 0, buf, sizeof(buf));
+    CHECK_EQ_INT(len, sizeof(values_golden));
+    CHECK(len == (int32_t)sizeof(values_golden) && memcmp(buf, values_golden, sizeof(values_golden)) == 0);
+
+    memset(&out, 0, sizeof(out));
+    uint32_t mask = 0;
+    CHECK(vesc_codec_decode(&vesc_msg_values, values_golden, sizeof(values_golden), &out, &mask));
+    CHECK_EQ_INT(mask, VESC_VALUES_ALL);
+    check_values_equal(&out, &in);
+
+    // Newer firmware appends fields: ignored
+    uint8_t longer[sizeof(values_golden) + 10];
+    memcpy(longer, values_golden, sizeof(values_golden));
+    memset(longer + sizeof(values_golden), 0x77, 10);
+    memset(&out, 0, sizeof(out));
+    CHECK(vesc_codec_decode(&vesc_msg_values, longer, sizeof(longer), &out, NULL));
+    check_values_equal(&out, &in);
+
+    // One byte short, or the wrong packet ID: rejected
+    CHECK(!vesc_codec_decode(&vesc_msg_values, values_golden, sizeof(values_golden) - 1, &out, NULL));
+    memcpy(longer, values_golden, sizeof(values_golden));
+    longer[0] = COMM_GET_VALUES_SELECTIVE;
+    CHECK(!vesc_codec_decode(&vesc_msg_values, longer, sizeof(values_golden), &out, NULL));
+
+    // Firmware 3.00 - 3.39 stops at the fault code
+    memset(&out, 0, sizeof(out));
+    CHECK(vesc_codec_decode(&vesc_msg_values_fw3, values_golden, sizeof(values_golden) - 5, &out, &mask));
+    CHECK_EQ_INT(out.fault, in.fault);
+    CHECK_EQ_INT(out.pid_pos, 0);
+    CHECK_EQ_INT(vesc_codec_field_offset(&vesc_msg_values, values_golden, sizeof(values_golden),
+                                         __builtin_ctzl(VESC_VALUE_CONTROLLER_ID)),
+                 sizeof(values_golden) - 1);
+}
+
+static void test_values_selective(void) {
+    vesc_data_t in = sample_values(), out;
+    uint8_t buf[128];
+    const uint32_t mask = VESC_VALUE_MOTOR_CURRENT | VESC_VALUE_RPM | VESC_VALUE_CONTROLLER_ID;
+    static const uint8_t golden[] = {
+        COMM_GET_VALUES_SELECTIVE,
+        0x00, 0x02, 0x00, 0x84,         // mask: bits 2, 7, 17
+        0x00, 0x00, 0x04, 0xD2,         // avg_motor_current
+        0xFF, 0xFF, 0xCF, 0xC7,         // rpm
+        0x2A,                           // controller_id
+    };
+
+    int32_t len = vesc_codec_encode(&vesc_msg_values_selective, &in, mask, buf, sizeof(buf));
+    CHECK_EQ_INT(len, sizeof(golden));
+    CHECK(len == (int32_t)sizeof(golden) && memcmp(buf, golden, sizeof(golden)) == 0);
+
+    // Only the fields in the mask are touched
+    memset(&out, 0x5A, sizeof(out));
+    vesc_data_t untouched = out;
+    uint32_t decoded = 0;
+    CHECK(vesc_codec_decode(&vesc_msg_values_selective, golden, sizeof(golden), &out, &decoded));
+    CHECK_EQ_INT(decoded, mask);
+    CHECK_EQ_INT(out.avg_motor_current, in.avg_motor_current);
+    CHECK_EQ_INT(out.rpm, in.rpm);
+    CHECK_EQ_INT(out.controller_id, in.controller_id);
+    CHECK_EQ_INT(out.temp_mosfet, untouched.temp_mosfet);
+    CHECK_EQ_INT(out.input_voltage, untouched.input_voltage);
+    CHECK_EQ_INT(out.fault, untouched.fault);
+
+    CHECK_EQ_INT(vesc_codec_field_offset(&vesc_msg_values_selective, golden, sizeof(golden),
+                                         __builtin_ctzl(VESC_VALUE_CONTROLLER_ID)), 13);
+    CHECK_EQ_INT(vesc_codec_field_offset(&vesc_msg_values_selective, golden, sizeof(golden),
+                                         __builtin_ctzl(VESC_VALUE_FAULT)), -1);
+
+    // Every single-field mask and the full mask round-trip
+    for (int bit = 0; bit < 21; bit++) {
+        uint32_t m = 1UL << bit;
+        len = vesc_codec_encode(&vesc_msg_values_selective, &in, m, buf, sizeof(buf));
+        CHECK(len >= 5);
+        memset(&out, 0, sizeof(out));
+        CHECK(vesc_codec_decode(&vesc_msg_values_selective, buf, (uint16_t)len, &out, &decoded));
+        CHECK_EQ_INT(decoded, m);
+    }
+    len = vesc_codec_encode(&vesc_msg_values_selective, &in, VESC_VALUES_ALL, buf, sizeof(buf));
+    CHECK_EQ_INT(len, sizeof(values_golden) + 4);
+    memset(&out, 0, sizeof(out));
+    CHECK(vesc_codec_decode(&vesc_msg_values_selective, buf, (uint16_t)len, &out, NULL));
+    check_values_equal(&out, &in);
+
+    // Mask bits past the table are dropped on encode and ignored on decode
+    len = vesc_codec_encode(&vesc_msg_values_selective, &in, VESC_VALUE_RPM | (1UL << 31), buf, sizeof(buf));
+    CHECK_EQ_INT(len, 9);
+    CHECK_EQ_INT(buf[1], 0x00);
+    buf[1] = 0x80;
+    CHECK(vesc_codec_decode(&vesc_msg_values_selective, buf, (uint16_t)len, &out, &decoded));
+    CHECK_EQ_INT(decoded, VESC_VALUE_RPM);
+
+    // Truncated inside a field or inside the mask
+    CHECK(!vesc_codec_decode(&vesc_msg_values_selective, golden, sizeof(golden) - 1, &out, NULL));
+    CHECK(!vesc_codec_decode(&vesc_msg_values_selective, golden, 4, &out, NULL));
+
+    // The request side: [50][mask]
+    vesc_codec_mask_t request = { .mask = mask };
+    len = vesc_codec_encode(&vesc_msg_get_values_selective, &request, 0, buf, sizeof(buf));
+    CHECK_EQ_INT(len, 5);
+    CHECK(memcmp(buf, golden, 5) == 0);
+}
+
+static void test_can_status(void) {
+    vesc_data_t out;
+    uint8_t buf[8];
+
+    // STATUS: eRPM, current x10, duty x1000
+    static const uint8_t s1[] = { 0x00, 0x00, 0x75, 0x30, 0xFF, 0x85, 0x01, 0xF4 };
+    memset(&out, 0, sizeof(out));
+    CHECK(vesc_codec_decode(&vesc_msg_can_status[0], s1, sizeof(s1), &out, NULL));
+    CHECK_EQ_INT(out.rpm, 30000);
+    CHECK_EQ_INT(out.avg_motor_current, -1230);     // -12.3 A in x100
+    CHECK_EQ_INT(out.duty_cycle, 500);
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_can_status[0], &out, 0, buf, sizeof(buf)), 8);
+    CHECK(memcmp(buf, s1, sizeof(s1)) == 0);
+
+    // STATUS_2: Ah used and charged, x10000
+    static const uint8_t s2[] = { 0x00, 0x01, 0xE2, 0x40, 0x00, 0x00, 0x00, 0x7B };
+    memset(&out, 0, sizeof(out));
+    CHECK(vesc_codec_decode(&vesc_msg_can_status[1], s2, sizeof(s2), &out, NULL));
+    CHECK_EQ_INT(out.amp_hours, 123456);
+    CHECK_EQ_INT(out.amp_hours_charged, 123);
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_can_status[1], &out, 0, buf, sizeof(buf)), 8);
+    CHECK(memcmp(buf, s2, sizeof(s2)) == 0);
+
+    // STATUS_3: Wh used and charged, x10000
+    static const uint8_t s3[] = { 0x7F, 0xFF, 0xFF, 0xFF, 0x80, 0x00, 0x00, 0x00 };
+    memset(&out, 0, sizeof(out));
+    CHECK(vesc_codec_decode(&vesc_msg_can_status[2], s3, sizeof(s3), &out, NULL));
+    CHECK_EQ_INT(out.watt_hours, INT32_MAX);
+    CHECK_EQ_INT(out.watt_hours_charged, INT32_MIN);
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_can_status[2], &out, 0, buf, sizeof(buf)), 8);
+    CHECK(memcmp(buf, s3, sizeof(s3)) == 0);
+
+    // STATUS_4: temperatures x10, input current x10, PID position x50
+    static const uint8_t s4[] = { 0x01, 0x2C, 0xFF, 0xEC, 0x00, 0x0F, 0x23, 0x28 };
+    memset(&out, 0, sizeof(out));
+    CHECK(vesc_codec_decode(&vesc_msg_can_status[3], s4, sizeof(s4), &out, NULL));
+    CHECK_EQ_INT(out.temp_mosfet, 300);
+    CHECK_EQ_INT(out.temp_motor, -20);
+    CHECK_EQ_INT(out.avg_input_current, 150);       // 1.5 A in x100
+    CHECK_EQ_INT(out.pid_pos, 180000000);           // 9000 / 50 = 180 degrees in x1000000
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_can_status[3], &out, 0, buf, sizeof(buf)), 8);
+    CHECK(memcmp(buf, s4, sizeof(s4)) == 0);
+
+    // STATUS_5: tachometer, input voltage x10 (the last two bytes are not decoded)
+    static const uint8_t s5[] = { 0xFF, 0xFF, 0xFF, 0xFE, 0x01, 0xF8, 0x00, 0x00 };
+    memset(&out, 0, sizeof(out));
+    CHECK(vesc_codec_decode(&vesc_msg_can_status[4], s5, sizeof(s5), &out, NULL));
+    CHECK_EQ_INT(out.tachometer, -2);
+    CHECK_EQ_INT(out.input_voltage, 504);
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_can_status[4], &out, 0, buf, sizeof(buf)), 6);
+    CHECK(memcmp(buf, s5, 6) == 0);
+
+    // STATUS_6: ADC and PPM inputs, nothing kept
+    static const uint8_t s6[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    memset(&out, 0x33, sizeof(out));
+    vesc_data_t before = out;
+    CHECK(vesc_codec_decode(&vesc_msg_can_status[5], s6, sizeof(s6), &out, NULL));
+    CHECK(memcmp(&out, &before, sizeof(out)) == 0);
+    CHECK(!vesc_codec_decode(&vesc_msg_can_status[5], s6, 7, &out, NULL));
+
+    // Short frames fail without touching anything
+    CHECK(!vesc_codec_decode(&vesc_msg_can_status[0], s1, 7, &out, NULL));
+    CHECK(!vesc_codec_decode(&vesc_msg_can_status[3], s4, 0, &out, NULL));
+}
+
+static void test_mcconf_temp(void) {
+    vesc_mcconf_temp_t in = {
+        .store = 0,
+        .forward_can = 1,
+        .ack = 1,
+        .divide_by_controllers = 0,
+        .current_min_scale = 1.0f,
+        .current_max_scale = 0.5f,
+        .erpm_min = -60000.0f,
+        .erpm_max = 60000.0f,
+        .duty_min = 0.005f,
+        .duty_max = 0.95f,
+        .watt_min = -1500.0f,
+        .watt_max = 0.0f,
+        .in_current_min = -20.0f,
+        .in_current_max = 80.0f,
+    };
+    uint8_t buf[64];
+
+    // buffer_append_float32_auto() matches IEEE 754 single precision for normal numbers
+    static const uint8_t golden[] = {
+        COMM_SET_MCCONF_TEMP, 0, 1, 1, 0,
+        0x3F, 0x80, 0x00, 0x00,         // 1.0
+        0x3F, 0x00, 0x00, 0x00,         // 0.5
+        0xC7, 0x6A, 0x60, 0x00,         // -60000
+        0x47, 0x6A, 0x60, 0x00,         // 60000
+        0x3B, 0xA3, 0xD7, 0x0A,         // 0.005
+        0x3F, 0x73, 0x33, 0x33,         // 0.95
+        0xC4, 0xBB, 0x80, 0x00,         // -1500
+        0x00, 0x00, 0x00, 0x00,         // 0
+        0xC1, 0xA0, 0x00, 0x00,         // -20
+        0x42, 0xA0, 0x00, 0x00,         // 80
+    };
+
+    int32_t len = vesc_codec_encode(&vesc_msg_set_mcconf_temp, &in, 0, buf, sizeof(buf));
+    CHECK_EQ_INT(len, sizeof(golden));
+    CHECK(len == (int32_t)sizeof(golden) && memcmp(buf, golden, sizeof(golden)) == 0);
+
+    vesc_mcconf_temp_t out;
+    memset(&out, 0, sizeof(out));
+    CHECK(vesc_codec_decode(&vesc_msg_set_mcconf_temp, golden, sizeof(golden), &out, NULL));
+    CHECK(memcmp(&out, &in, sizeof(in)) == 0);
+}
+
+static void test_encode_overflow(void) {
+    vesc_data_t values = sample_values();
+    vesc_mcconf_temp_t temp;
+    vesc_codec_setpoint_t setpoint = { .value = 12.5f };
+    uint8_t buf[128];
+
+    memset(&temp, 0, sizeof(temp));
+    memset(buf, 0xEE, sizeof(buf));
+
+    // One byte short of the whole message, at every layout
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_set_mcconf_temp, &temp, 0, buf, 44), -1);
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_values, &values, 0, buf, sizeof(values_golden) - 1), -1);
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_values_selective, &values, VESC_VALUE_RPM, buf, 8), -1);
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_values_selective, &values, VESC_VALUE_RPM, buf, 4), -1);
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_can_status[0], &values, 0, buf, 7), -1);
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_set_current, &setpoint, 0, buf, 4), -1);
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_set_current, &setpoint, 0, buf, 0), -1);
+
+    // Exactly enough fits
+    memset(buf, 0xEE, sizeof(buf));
+    CHECK_EQ_INT(vesc_codec_encode(&vesc_msg_set_current, &setpoint, 0, buf, 5), 5);
+    CHECK_EQ_INT(buf[0], COMM_SET_CURRENT);
+    CHECK_EQ_INT(buf[4], 0xD4);                     // 12500 = 0x30D4
+    CHECK_EQ_INT(buf[5], 0xEE);                     // Nothing past the end
+}
+
+int main(void) {
+    test_values();
+    test_values_selective();
+    test_can_status();
+    test_mcconf_temp();
+    test_encode_overflow();
+    TEST_DONE();
+}
@@ -0,0 +1,138 @@
+/**
+ * @file test_crc.c
+ * @brief CRC16 kernels: check value, slicing vs byte-wise, split updates
+ */
+
+#include "vesc_crc.h"
+#include "test_util.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Deterministic buffers, so a failure reproduces
+static uint32_t rng_state = 0x12345678;
+
+static uint8_t rng_byte(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (uint8_t)(rng_state >> 24);
+}
+
+// Bit-at-a-time reference straight from the polynomial
+static uint16_t crc_reference(const uint8_t *buf, uint32_t len) {
+    uint16_t crc = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)(buf[i] << 8);
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void test_check_value(void) {
+    static const uint8_t check[] = "123456789";
+
+    // Before init everything runs byte-wise
+    CHECK_EQ_INT(vesc_crc_get_kernel(), VESC_CRC_KERNEL_BYTEWISE);
+    CHECK_EQ_INT(vesc_crc16(check, 9), VESC_CRC_CHECK_VALUE);
+    CHECK_EQ_INT(crc_reference(check, 9), VESC_CRC_CHECK_VALUE);
+
+    CHECK_EQ_INT(vesc_crc_init(), VESC_CRC_KERNEL_SLICE4);
+    CHECK_EQ_INT(vesc_crc_init(), VESC_CRC_KERNEL_SLICE4);
+    CHECK_EQ_INT(vesc_crc16(check, 9), VESC_CRC_CHECK_VALUE);
+    CHECK_EQ_INT(vesc_crc16_kernel(VESC_CRC_KERNEL_BYTEWISE, 0, check, 9), VESC_CRC_CHECK_VALUE);
+    CHECK_EQ_INT(vesc_crc16_kernel(VESC_CRC_KERNEL_SLICE4, 0, check, 9), VESC_CRC_CHECK_VALUE);
+
+    vesc_crc_bench_t bench;
+    vesc_crc_get_bench(VESC_CRC_KERNEL_BYTEWISE, &bench);
+    CHECK(bench.valid);
+    vesc_crc_get_bench(VESC_CRC_KERNEL_SLICE4, &bench);
+    CHECK(bench.valid);
+    // No ROM routine off-target: the kernel leaves the CRC alone and fails its check
+    vesc_crc_get_bench(VESC_CRC_KERNEL_ROM, &bench);
+    CHECK(!bench.valid);
+
+    // Empty input and an unknown kernel leave the CRC as it was
+    CHECK_EQ_INT(vesc_crc16(check, 0), 0);
+    CHECK_EQ_INT(vesc_crc16_update(0xBEEF, check, 0), 0xBEEF);
+    CHECK_EQ_INT(vesc_crc16_kernel(VESC_CRC_KERNEL_COUNT, 0x1234, check, 9), 0x1234);
+}
+
+static void test_slice_vs_bytewise(void) {
+    uint8_t buf[600];
+
+    for (int round = 0; round < 2000; round++) {
+        uint32_t len = (uint32_t)(rng_byte() | (rng_byte() << 8)) % sizeof(buf);
+        uint32_t offset = rng_byte() & 3;       // Unaligned starts as well
+        uint16_t seed = (uint16_t)(rng_byte() | (rng_byte() << 8));
+        if (offset + len > sizeof(buf)) {
+            len = sizeof(buf) - offset;
+        }
+        for (uint32_t i = 0; i < len; i++) {
+            buf[offset + i] = rng_byte();
+        }
+
+        uint16_t byte = vesc_crc16_kernel(VESC_CRC_KERNEL_BYTEWISE, seed, buf + offset, len);
+        uint16_t slice = vesc_crc16_kernel(VESC_CRC_KERNEL_SLICE4, seed, buf + offset, len);
+        CHECK_EQ_INT(slice, byte);
+        if (seed == 0) {
+            CHECK_EQ_INT(byte, crc_reference(buf + offset, len));
+        }
+        CHECK_EQ_INT(vesc_crc16_kernel(VESC_CRC_KERNEL_BYTEWISE, 0, buf + offset, len),
+                     crc_reference(buf + offset, len));
+    }
+
+    // Every short length, where slicing is all remainder or one block plus remainder
+    for (uint32_t len = 0; len <= 16; len++) {
+        for (uint32_t i = 0; i < len; i++) {
+            buf[i] = rng_byte();
+        }
+        CHECK_EQ_INT(vesc_crc16_kernel(VESC_CRC_KERNEL_SLICE4, 0, buf, len), crc_reference(buf, len));
+    }
+
+    // All-ones and all-zeros exercise the table edges
+    memset(buf, 0xFF, sizeof(buf));
+    CHECK_EQ_INT(vesc_crc16_kernel(VESC_CRC_KERNEL_SLICE4, 0, buf, 512), crc_reference(buf, 512));
+    memset(buf, 0x00, sizeof(buf));
+    CHECK_EQ_INT(vesc_crc16_kernel(VESC_CRC_KERNEL_SLICE4, 0xFFFF, buf, 512),
+                 vesc_crc16_kernel(VESC_CRC_KERNEL_BYTEWISE, 0xFFFF, buf, 512));
+}
+
+static void test_split_updates(void) {
+    uint8_t buf[300];
+
+    for (uint32_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = rng_byte();
+    }
+    uint16_t whole = crc_reference(buf, sizeof(buf));
+
+    // Every single split point, both kernels
+    for (uint32_t split = 0; split <= sizeof(buf); split++) {
+        for (int k = VESC_CRC_KERNEL_BYTEWISE; k <= VESC_CRC_KERNEL_SLICE4; k++) {
+            uint16_t crc = vesc_crc16_kernel((vesc_crc_kernel_t)k, 0, buf, split);
+            crc = vesc_crc16_kernel((vesc_crc_kernel_t)k, crc, buf + split, sizeof(buf) - split);
+            CHECK_EQ_INT(crc, whole);
+        }
+    }
+
+    // Random chunking through the public update, as the frame parser feeds it
+    for (int round = 0; round < 200; round++) {
+        uint16_t crc = 0;
+        uint32_t pos = 0;
+        while (pos < sizeof(buf)) {
+            uint32_t chunk = 1 + rng_byte() % 23;
+            if (chunk > sizeof(buf) - pos) {
+                chunk = sizeof(buf) - pos;
+            }
+            crc = vesc_crc16_update(crc, buf + pos, chunk);
+            pos += chunk;
+        }
+        CHECK_EQ_INT(crc, whole);
+    }
+}
+
+int main(void) {
+    test_check_value();
+    test_slice_vs_bytewise();
+    test_split_updates();
+    TEST_DONE();
+}
@@ -0,0 +1,240 @@
+/**
+ * @file test_fixed.c
+ * @brief Scaled integers: decode and formatting against the firmware's float scaling
+ */
+
+#include "vesc_fixed.h"
+#include "vesc_codec.h"
+#include "vesc_uart.h"
+#include "test_util.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t rng_state = 0x2468ACE1;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static bool same_bits(float a, float b) {
+    uint32_t x, y;
+    memcpy(&x, &a, sizeof(x));
+    memcpy(&y, &b, sizeof(y));
+    return x == y;
+}
+
+#define VALUES_LEN  59      // COMM_GET_VALUES up to the controller ID
+#define STATUS_LEN  8       // CAN status frame
+
+// Wire value through the codec, then to real units, vs the firmware's
+// buffer_get_float16/32(): the wire integer divided by the wire scale.
+// offset is the field's position after the packet ID, if any.
+static int decode_mismatch(const vesc_codec_msg_t *msg, uint16_t len, int offset, int wire_bytes,
+                           float wire_scale, size_t member, int32_t member_scale, int32_t wire) {
+    uint8_t payload[VALUES_LEN] = { 0 };
+    int index = 0;
+
+    if (msg->id != VESC_CODEC_NO_ID) {
+        payload[index++] = (uint8_t)msg->id;
+    }
+    for (int b = 0; b < wire_bytes; b++) {
+        payload[index + offset + b] = (uint8_t)((uint32_t)wire >> (8 * (wire_bytes - 1 - b)));
+    }
+
+    vesc_data_t data;
+    memset(&data, 0, sizeof(data));
+    if (!vesc_codec_decode(msg, payload, len, &data, NULL)) {
+        return 1;
+    }
+    int32_t raw;
+    memcpy(&raw, (const uint8_t *)&data + member, sizeof(raw));
+    return same_bits(VESC_FX_TO_FLOAT(raw, member_scale), (float)wire / wire_scale) ? 0 : 1;
+}
+
+#define VALUES_FIELD(off, bytes, scale, m, fx)  &vesc_msg_values, VALUES_LEN, off, bytes, scale, \
+                                                offsetof(vesc_data_t, m), fx
+#define STATUS_FIELD(k, off, scale, m, fx)      &vesc_msg_can_status[k], STATUS_LEN, off, 2, scale, \
+                                                offsetof(vesc_data_t, m), fx
+
+static void test_decode_bit_exact(void) {
+    // Every 16-bit wire value of the int16 fields of COMM_GET_VALUES (own scale)
+    int bad = 0;
+    for (int32_t w = INT16_MIN; w <= INT16_MAX; w++) {
+        bad += decode_mismatch(VALUES_FIELD(0, 2, 10.0f, temp_mosfet, VESC_FX1_SCALE), w);
+        bad += decode_mismatch(VALUES_FIELD(20, 2, 1000.0f, duty_cycle, VESC_FX3_SCALE), w);
+    }
+    CHECK_EQ_INT(bad, 0);
+
+    // 32-bit fields at their own scale: same division as the firmware, so
+    // exact over the whole range, extremes included
+    static const int32_t edges[] = { 0, 1, -1, 5, -5, 99999, -99999, 1 << 24, -(1 << 24),
+                                     (1 << 24) + 1, INT32_MAX, INT32_MIN, INT32_MIN + 1 };
+    bad = 0;
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        bad += decode_mismatch(VALUES_FIELD(4, 4, 100.0f, avg_motor_current, VESC_FX2_SCALE), edges[i]);
+        bad += decode_mismatch(VALUES_FIELD(28, 4, 10000.0f, amp_hours, VESC_FX4_SCALE), edges[i]);
+        bad += decode_mismatch(VALUES_FIELD(53, 4, 1000000.0f, pid_pos, VESC_FX6_SCALE), edges[i]);
+    }
+    for (int i = 0; i < 200000; i++) {
+        int32_t w = (int32_t)rng_next();
+        bad += decode_mismatch(VALUES_FIELD(4, 4, 100.0f, avg_motor_current, VESC_FX2_SCALE), w);
+        bad += decode_mismatch(VALUES_FIELD(53, 4, 1000000.0f, pid_pos, VESC_FX6_SCALE), w);
+    }
+    CHECK_EQ_INT(bad, 0);
+
+    // CAN status fields carry fewer digits and are multiplied up on decode.
+    // Exact while the scaled value is a float integer: the whole int16 range
+    // for currents and temperatures, and +-360 degrees for the PID position.
+    bad = 0;
+    for (int32_t w = INT16_MIN; w <= INT16_MAX; w++) {
+        bad += decode_mismatch(STATUS_FIELD(0, 4, 10.0f, avg_motor_current, VESC_FX2_SCALE), w);
+        bad += decode_mismatch(STATUS_FIELD(3, 0, 10.0f, temp_mosfet, VESC_FX1_SCALE), w);
+        bad += decode_mismatch(STATUS_FIELD(3, 4, 10.0f, avg_input_current, VESC_FX2_SCALE), w);
+        if (abs(w) <= 360 * 50) {
+            bad += decode_mismatch(STATUS_FIELD(3, 6, 50.0f, pid_pos, VESC_FX6_SCALE), w);
+        }
+    }
+    CHECK_EQ_INT(bad, 0);
+}
+
+// Independent reference: the exact decimal digits of raw / scale, rounded
+// half away from zero in the digit string
+static void format_reference(char *out, int32_t raw, int32_t scale, int decimals) {
+    int n = 0;
+    for (int32_t s = scale; s > 1; s /= 10) n++;
+    if (decimals > n) decimals = n;
+
+    char digits[32];
+    int64_t mag = raw < 0 ? -(int64_t)raw : raw;
+    int len = snprintf(digits, sizeof(digits), "%0*lld", n + 1, (long long)mag);
+
+    // Keep len - n + decimals digits, round on the next one
+    int keep = len - n + decimals;
+    int carry = digits[keep] != '\0' && digits[keep] >= '5';
+    digits[keep] = '\0';
+    for (int i = keep - 1; i >= 0 && carry; i--) {
+        if (digits[i] == '9') {
+            digits[i] = '0';
+        } else {
+            digits[i]++;
+            carry = 0;
+        }
+    }
+
+    char body[40];
+    int whole_len = keep - decimals;
+    if (carry) {
+        body[0] = '1';
+        memcpy(body + 1, digits, keep);
+        whole_len++;
+        keep++;
+    } else {
+        memcpy(body, digits, keep);
+    }
+    body[keep] = '\0';
+
+    // Strip leading zeros of the whole part, keep one
+    int lead = 0;
+    while (lead < whole_len - 1 && body[lead] == '0') lead++;
+
+    bool zero = true;
+    for (int i = 0; i < keep; i++) {
+        if (body[i] != '0') zero = false;
+    }
+    char *p = out;
+    if (raw < 0 && !zero) *p++ = '-';
+    memcpy(p, body + lead, whole_len - lead);
+    p += whole_len - lead;
+    if (decimals > 0) {
+        *p++ = '.';
+        memcpy(p, body + whole_len, decimals);
+        p += decimals;
+    }
+    *p = '\0';
+}
+
+static void check_format(int32_t raw, int32_t scale, int decimals, const char *expect) {
+    char buf[32];
+    int len = vesc_fx_format(buf, sizeof(buf), raw, scale, decimals);
+    if (strcmp(buf, expect) != 0 || len != (int)strlen(expect)) {
+        printf("vesc_fx_format(%ld, %ld, %d) = \"%s\", expected \"%s\"\n",
+               (long)raw, (long)scale, decimals, buf, expect);
+        test_failures++;
+    }
+}
+
+static void test_format_golden(void) {
+    check_format(253, VESC_FX1_SCALE, 1, "25.3");
+    check_format(-15, VESC_FX1_SCALE, 1, "-1.5");
+    check_format(-15, VESC_FX1_SCALE, 0, "-2");         // Half away from zero
+    check_format(15, VESC_FX1_SCALE, 0, "2");
+    check_format(14, VESC_FX1_SCALE, 0, "1");
+    check_format(-4, VESC_FX2_SCALE, 1, "0.0");         // Rounds to zero: no sign
+    check_format(-5, VESC_FX2_SCALE, 1, "-0.1");
+    check_format(0, VESC_FX3_SCALE, 3, "0.000");
+    check_format(950, VESC_FX3_SCALE, 2, "0.95");
+    check_format(995, VESC_FX3_SCALE, 2, "1.00");       // Carry into the whole part
+    check_format(-9995, VESC_FX4_SCALE, 3, "-1.000");
+    check_format(253, VESC_FX1_SCALE, 3, "25.3");       // No more digits than the scale has
+    check_format(INT32_MAX, VESC_FX4_SCALE, 2, "214748.36");
+    check_format(INT32_MIN, VESC_FX6_SCALE, 6, "-2147.483648");
+    check_format(INT32_MIN, VESC_FX6_SCALE, 0, "-2147");
+    check_format(INT32_MIN, VESC_FX1_SCALE, 0, "-214748365");
+    check_format(INT32_MAX, VESC_FX1_SCALE, 1, "214748364.7");
+
+    // Truncated like snprintf: the full length is returned
+    char small[4];
+    CHECK_EQ_INT(vesc_fx_format(small, sizeof(small), -12345, VESC_FX2_SCALE, 2), 7);
+    CHECK(strcmp(small, "-12") == 0);
+}
+
+static void test_format_vs_reference(void) {
+    static const int32_t scales[] = { VESC_FX1_SCALE, VESC_FX2_SCALE, VESC_FX3_SCALE,
+                                      VESC_FX4_SCALE, VESC_FX6_SCALE };
+    char expect[40], buf[40];
+    int bad = 0;
+
+    for (int i = 0; i < 300000; i++) {
+        int32_t raw = (i & 1) ? (int32_t)rng_next() : (int32_t)(rng_next() % 200001) - 100000;
+        int32_t scale = scales[rng_next() % 5];
+        int decimals = (int)(rng_next() % 7);
+
+        format_reference(expect, raw, scale, decimals);
+        vesc_fx_format(buf, sizeof(buf), raw, scale, decimals);
+        if (strcmp(buf, expect) != 0) {
+            if (bad++ < 5) {
+                printf("vesc_fx_format(%ld, %ld, %d) = \"%s\", reference \"%s\"\n",
+                       (long)raw, (long)scale, decimals, buf, expect);
+            }
+        }
+
+        // With every digit of the scale shown, the text is also what printf
+        // makes of the firmware's float. Below 2^23 the float is within half
+        // a last digit of the exact value; above, the float loses it.
+        int n = 0;
+        for (int32_t s = scale; s > 1; s /= 10) n++;
+        if (raw > -(1 << 23) && raw < (1 << 23)) {
+            snprintf(expect, sizeof(expect), "%.*f", n, (double)((float)raw / (float)scale));
+            if (strcmp(expect, "-0.0") == 0 || strcmp(expect, "-0.00") == 0) {
+                continue;
+            }
+            vesc_fx_format(buf, sizeof(buf), raw, scale, n);
+            if (strcmp(buf, expect) != 0 && bad++ < 5) {
+                printf("vesc_fx_format(%ld, %ld, %d) = \"%s\", printf of the float \"%s\"\n",
+                       (long)raw, (long)scale, n, buf, expect);
+            }
+        }
+    }
+    CHECK_EQ_INT(bad, 0);
+}
+
+int main(void) {
+    test_decode_bit_exact();
+    test_format_golden();
+    test_format_vs_reference();
+    TEST_DONE();
+}
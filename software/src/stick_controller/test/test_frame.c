@@ -0,0 +1,171 @@
+/**
+ * @file test_frame.c
+ * @brief Frame parser: delivery, resync, long-length gating, idle flush
+ */
+
+#include "vesc_frame.h"
+#include "test_util.h"
+#include <string.h>
+
+typedef struct {
+    int frames;
+    uint16_t last_len;
+    uint8_t last[VESC_FRAME_MAX_PAYLOAD];
+} sink_t;
+
+static void on_frame(const uint8_t *payload, uint16_t len, void *ctx) {
+    sink_t *sink = (sink_t *)ctx;
+    sink->frames++;
+    sink->last_len = len;
+    memcpy(sink->last, payload, len);
+}
+
+// Encode a frame the way the engine writes it; returns its length
+static size_t frame_build(uint8_t *out, const uint8_t *payload, uint32_t len) {
+    size_t n = vesc_frame_header(out, len);
+    memcpy(out + n, payload, len);
+    n += len;
+    vesc_frame_trailer(out + n, vesc_crc16(payload, len));
+    return n + VESC_FRAME_TRAILER;
+}
+
+static void test_short_frames(void) {
+    vesc_frame_parser_t parser;
+    sink_t sink = { 0 };
+    uint8_t payload[40], wire[2 * (40 + 5) + 3];
+
+    vesc_frame_parser_init(&parser, on_frame, &sink);
+    for (int i = 0; i < 40; i++) payload[i] = (uint8_t)(i * 7);
+
+    // Noise, two frames back to back, fed a byte at a time
+    size_t n = 0;
+    wire[n++] = 0x55;
+    wire[n++] = 0xAA;
+    n += frame_build(wire + n, payload, 40);
+    n += frame_build(wire + n, payload, 5);
+    for (size_t i = 0; i < n; i++) {
+        vesc_frame_parser_feed(&parser, &wire[i], 1);
+    }
+    CHECK_EQ_INT(sink.frames, 2);
+    CHECK_EQ_INT(sink.last_len, 5);
+    CHECK(memcmp(sink.last, payload, 5) == 0);
+    CHECK_EQ_INT(parser.bytes_discarded, 2);
+    CHECK(!vesc_frame_parser_busy(&parser));
+
+    // A stray 2 ahead of a frame: its candidate fails and the frame is found in the rescan
+    sink.frames = 0;
+    n = 0;
+    wire[n++] = 2;
+    n += frame_build(wire + n, payload, 40);
+    vesc_frame_parser_feed(&parser, wire, n);
+    CHECK_EQ_INT(sink.frames, 1);
+    CHECK_EQ_INT(sink.last_len, 40);
+}
+
+static void test_long_gating(void) {
+    vesc_frame_parser_t parser;
+    sink_t sink = { 0 };
+    static uint8_t payload[600], wire[700];
+
+    vesc_frame_parser_init(&parser, on_frame, &sink);
+    for (int i = 0; i < 600; i++) payload[i] = (uint8_t)(i ^ 0x5A);
+
+    // A stray 3 with nothing long expected is noise: the reply behind it arrives at once
+    size_t n = 0;
+    wire[n++] = 3;
+    n += frame_build(wire + n, payload, 20);
+    vesc_frame_parser_feed(&parser, wire, n);
+    CHECK_EQ_INT(sink.frames, 1);
+    CHECK_EQ_INT(sink.last_len, 20);
+    CHECK(!vesc_frame_parser_busy(&parser));
+
+    // Nor is a real long frame accepted then
+    sink.frames = 0;
+    n = frame_build(wire, payload, 600);
+    vesc_frame_parser_feed(&parser, wire, n);
+    CHECK_EQ_INT(sink.frames, 0);
+
+    // While a long reply is expected it is, up to the size given
+    vesc_frame_parser_reset(&parser);
+    vesc_frame_parser_set_long_max(&parser, 600);
+    vesc_frame_parser_feed(&parser, wire, n);
+    CHECK_EQ_INT(sink.frames, 1);
+    CHECK_EQ_INT(sink.last_len, 600);
+    CHECK(memcmp(sink.last, payload, 600) == 0);
+
+    sink.frames = 0;
+    vesc_frame_parser_set_long_max(&parser, 599);
+    vesc_frame_parser_feed(&parser, wire, n);
+    CHECK_EQ_INT(sink.frames, 0);
+    uint32_t framing = parser.framing_errors;
+    CHECK(framing > 0);
+
+    // A 16-bit length under 256 is not how the sender encodes it: noise even when allowed
+    vesc_frame_parser_reset(&parser);
+    vesc_frame_parser_set_long_max(&parser, 600);
+    sink.frames = 0;
+    n = 0;
+    wire[n++] = 3;
+    wire[n++] = 0;
+    n += frame_build(wire + n, payload, 30);
+    vesc_frame_parser_feed(&parser, wire, n);
+    CHECK_EQ_INT(sink.frames, 1);
+    CHECK_EQ_INT(sink.last_len, 30);
+
+    // A 24-bit length can never fit the frame buffer
+    sink.frames = 0;
+    n = 0;
+    wire[n++] = 4;
+    n += frame_build(wire + n, payload, 30);
+    vesc_frame_parser_feed(&parser, wire, n);
+    CHECK_EQ_INT(sink.frames, 1);
+}
+
+static void test_idle_flush(void) {
+    vesc_frame_parser_t parser;
+    sink_t sink = { 0 };
+    uint8_t payload[50], wire[200];
+
+    vesc_frame_parser_init(&parser, on_frame, &sink);
+    vesc_frame_parser_set_long_max(&parser, VESC_FRAME_MAX_PAYLOAD);
+    for (int i = 0; i < 50; i++) payload[i] = (uint8_t)(200 - i);
+
+    // A stray 3 while a long reply is expected announces 0x02xx bytes and
+    // swallows the short reply behind it: only the idle line gives it away
+    size_t n = 0;
+    wire[n++] = 3;
+    n += frame_build(wire + n, payload, 50);
+    vesc_frame_parser_feed(&parser, wire, n);
+    CHECK_EQ_INT(sink.frames, 0);
+    CHECK(vesc_frame_parser_busy(&parser));
+
+    vesc_frame_parser_flush(&parser);
+    CHECK_EQ_INT(sink.frames, 1);
+    CHECK_EQ_INT(sink.last_len, 50);
+    CHECK(memcmp(sink.last, payload, 50) == 0);
+    CHECK(!vesc_frame_parser_busy(&parser));
+    CHECK(parser.flushes >= 1);
+
+    // A truncated frame on its own is dropped, and the next one parses normally
+    sink.frames = 0;
+    n = frame_build(wire, payload, 50);
+    vesc_frame_parser_feed(&parser, wire, n - 4);
+    vesc_frame_parser_flush(&parser);
+    CHECK_EQ_INT(sink.frames, 0);
+    CHECK(!vesc_frame_parser_busy(&parser));
+    vesc_frame_parser_feed(&parser, wire, n);
+    CHECK_EQ_INT(sink.frames, 1);
+
+    // Nothing open: a no-op
+    uint32_t flushes = parser.flushes;
+    vesc_frame_parser_flush(&parser);
+    CHECK_EQ_INT(parser.flushes, flushes);
+}
+
+int main(void) {
+    vesc_crc_init();
+    test_short_frames();
+    test_long_gating();
+    test_idle_flush();
+    TEST_DONE();
+}
@@ -0,0 +1,212 @@
+/**
+ * @file test_prop_guard.c
+ * @brief Prop guard replayed over telemetry traces: trip latency, false
+ *        trips and restore
+ *
+ * The traces in traces/ are VESC telemetry (time, eRPM, motor current) of
+ * rides without the guard, written by traces/make_traces.c. "# window"
+ * lines give the spans where the prop was in air.
+ */
+
+#include "prop_guard.h"
+#include "test_util.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SAMPLES     1024
+#define MAX_WINDOWS     4
+
+// The guard as shipped: Kconfig defaults and the PROP_GUARD_* constants in main.c
+static const prop_guard_config_t shipped = {
+    .load_trip = 0.5f,
+    .load_clear = 0.8f,
+    .rpm_rise = 15000.0f,
+    .current_fall = 150.0f,
+    .rpm_min = 3000.0f,
+    .current_min = 3.0f,
+    .steady_rpm = 2000.0f,
+    .steady_current = 20.0f,
+    .baseline_weight = 0.05f,
+    .cut_scale = 0.3f,
+    .restore_rate = 0.7f,
+    .clear_s = 0.1f,
+    .max_dt_s = 0.075f,
+};
+
+typedef struct {
+    int count;
+    int32_t time_ms[MAX_SAMPLES];
+    float rpm[MAX_SAMPLES];
+    float current[MAX_SAMPLES];
+    bool driving[MAX_SAMPLES];
+    int window_count;
+    int32_t window_ms[MAX_WINDOWS][2];      // In air from [0] until [1]
+} trace_t;
+
+static bool trace_load(trace_t *trace, const char *name) {
+    char path[96];
+    char line[128];
+    snprintf(path, sizeof(path), "traces/%s.csv", name);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        printf("%s: cannot open\n", path);
+        return false;
+    }
+
+    memset(trace, 0, sizeof(*trace));
+    while (fgets(line, sizeof(line), f) != NULL) {
+        int start, end, t, rpm, driving;
+        float current;
+        if (sscanf(line, "# window %d %d", &start, &end) == 2 && trace->window_count < MAX_WINDOWS) {
+            trace->window_ms[trace->window_count][0] = start;
+            trace->window_ms[trace->window_count][1] = end;
+            trace->window_count++;
+        } else if (sscanf(line, "%d,%d,%f,%d", &t, &rpm, &current, &driving) == 4 &&
+                   trace->count < MAX_SAMPLES) {
+            trace->time_ms[trace->count] = t;
+            trace->rpm[trace->count] = (float)rpm;
+            trace->current[trace->count] = current;
+            trace->driving[trace->count] = driving != 0;
+            trace->count++;
+        }
+    }
+    fclose(f);
+    return trace->count > 1;
+}
+
+typedef struct {
+    int trips;
+    int32_t trip_ms[MAX_WINDOWS];
+    int32_t low_ms[MAX_WINDOWS];    // First sample below the trip share before each trip
+    float scale_min;
+    float rise_max;                 // Largest scale increase between samples
+    bool cut_only_on_trip;          // The scale only dropped on a trip, straight to cut_scale
+    int32_t restored_ms;            // Back to LOADED at scale 1 after the last trip, -1 = never
+    float baseline;
+} replay_t;
+
+static replay_t replay(const trace_t *trace) {
+    replay_t r = { 0, { 0 }, { 0 }, 1.0f, 0.0f, true, -1, 0.0f };
+    prop_guard_t guard;
+    prop_guard_init(&guard, &shipped);
+
+    float prev_scale = 1.0f;
+    int32_t low_since_ms = -1;
+    for (int i = 0; i < trace->count; i++) {
+        prop_guard_state_t before = guard.state;
+        float scale = prop_guard_update(&guard, (int64_t)trace->time_ms[i] * 1000,
+                                        trace->rpm[i], trace->current[i], trace->driving[i]);
+        bool tripped = guard.state == PROP_GUARD_VENTILATED && before != PROP_GUARD_VENTILATED;
+
+        if (guard.baseline > 0.0f && guard.load < shipped.load_trip) {
+            if (low_since_ms < 0) low_since_ms = trace->time_ms[i];
+        } else {
+            low_since_ms = -1;
+        }
+        if (tripped) {
+            if (r.trips < MAX_WINDOWS) {
+                r.trip_ms[r.trips] = trace->time_ms[i];
+                r.low_ms[r.trips] = low_since_ms;
+            }
+            r.trips++;
+            r.restored_ms = -1;
+        }
+        if (scale < prev_scale && (!tripped || scale != shipped.cut_scale)) {
+            r.cut_only_on_trip = false;
+        }
+        if (scale - prev_scale > r.rise_max) r.rise_max = scale - prev_scale;
+        if (scale < r.scale_min) r.scale_min = scale;
+        if (r.trips > 0 && r.restored_ms < 0 && guard.state == PROP_GUARD_LOADED && scale == 1.0f) {
+            r.restored_ms = trace->time_ms[i];
+        }
+        prev_scale = scale;
+    }
+    r.baseline = guard.baseline;
+    return r;
+}
+
+// Riding in water: a baseline is learnt and nothing is ever cut
+static void test_steady(const char *name) {
+    trace_t trace;
+    if (!trace_load(&trace, name)) {
+        test_failures++;
+        return;
+    }
+    replay_t r = replay(&trace);
+    printf("%s: baseline %.4f, %d trip(s)\n", name, r.baseline, r.trips);
+    CHECK(r.baseline > 0.0f);
+    CHECK_EQ_INT(r.trips, 0);
+    CHECK(r.scale_min == 1.0f);
+}
+
+// Prop in air: one trip per window, at most a telemetry period after the
+// load first shows it, then a ramp back to full scale once the prop bites
+// again. How soon the load shows it is up to the rotor, not the guard.
+static void test_ventilation(const char *name) {
+    trace_t trace;
+    if (!trace_load(&trace, name)) {
+        test_failures++;
+        return;
+    }
+    int32_t period_ms = trace.time_ms[1] - trace.time_ms[0];
+    replay_t r = replay(&trace);
+
+    CHECK(r.baseline > 0.0f);
+    CHECK_EQ_INT(r.trips, trace.window_count);
+    for (int i = 0; i < trace.window_count && i < r.trips; i++) {
+        int32_t latency_ms = r.trip_ms[i] - r.low_ms[i];
+        printf("%s: trip %d at %ld ms into the window, %ld ms after the load fell (period %ld ms)\n",
+               name, i + 1, (long)(r.trip_ms[i] - trace.window_ms[i][0]), (long)latency_ms, (long)period_ms);
+        CHECK(r.trip_ms[i] > trace.window_ms[i][0]);
+        CHECK(r.trip_ms[i] < trace.window_ms[i][1]);
+        CHECK(r.low_ms[i] >= trace.window_ms[i][0]);
+        CHECK(latency_ms <= period_ms);
+    }
+    CHECK(r.scale_min == shipped.cut_scale);
+    CHECK(r.cut_only_on_trip);
+
+    // Restore: no step larger than the restore rate over one period, done in
+    // about clear_s plus the ramp time after the prop is back in water
+    CHECK(r.rise_max <= shipped.restore_rate * period_ms / 1000.0f * 1.001f);
+    CHECK(r.restored_ms > 0);
+    int32_t back_ms = trace.window_ms[trace.window_count - 1][1];
+    float ramp_s = (1.0f - shipped.cut_scale) / shipped.restore_rate;
+    CHECK(r.restored_ms - back_ms <= (int32_t)((shipped.clear_s + ramp_s) * 1000.0f) + 4 * period_ms);
+    CHECK(r.restored_ms - back_ms >= (int32_t)(ramp_s * 1000.0f));
+}
+
+// Telemetry slower than max_dt_s: no rates, so no runaway is ever seen
+static void test_slow_telemetry(void) {
+    trace_t trace;
+    if (!trace_load(&trace, "vent_40hz")) {
+        test_failures++;
+        return;
+    }
+    // Keep every 20th sample: 2 Hz, the idle rate
+    int kept = 0;
+    for (int i = 0; i < trace.count; i += 20) {
+        trace.time_ms[kept] = trace.time_ms[i];
+        trace.rpm[kept] = trace.rpm[i];
+        trace.current[kept] = trace.current[i];
+        trace.driving[kept] = trace.driving[i];
+        kept++;
+    }
+    trace.count = kept;
+    replay_t r = replay(&trace);
+    CHECK(r.baseline == 0.0f);
+    CHECK_EQ_INT(r.trips, 0);
+}
+
+int main(void) {
+    test_steady("water_40hz");
+    test_steady("water_low_40hz");
+    test_steady("levels_40hz");
+    test_steady("speedup_40hz");
+    test_ventilation("vent_40hz");
+    test_ventilation("vent_50hz");
+    test_ventilation("vent_partial_40hz");
+    test_ventilation("vent_twice_40hz");
+    test_slow_telemetry();
+    TEST_DONE();
+}
@@ -0,0 +1,262 @@
+/**
+ * @file test_ramp.c
+ * @brief Jerk-limited current ramp: limits, overshoot, reversal and settling
+ */
+
+#include "current_ramp.h"
+#include "test_util.h"
+#include <stdbool.h>
+
+#define DT_S        0.001f          // Control loop period
+#define SETTLE_A    0.001f          // RAMP_SETTLE_A in current_ramp.c
+#define MAX_STEPS   100000
+
+// The fast level as shipped (CONFIG_CONTROL_RAMP_FAST_*)
+static const current_ramp_profile_t fast = { 140.0f, 280.0f, 1400.0f };
+
+// Setpoints are floats: near 80 A one rounding is a few percent of a jerk
+// step at 1 kHz, so the jerk checks allow 1%
+#define JERK_TOL    1.01f
+
+typedef struct {
+    int steps;                      // Until done, or MAX_STEPS
+    float rate_max;                 // Largest |setpoint change| / dt
+    float accel_max;                // Largest |change of that rate| / dt, ending at rest
+    float snap_max;                 // Largest jump onto the target from within RAMP_SETTLE_A
+    float beyond;                   // Furthest past the target, in the direction of travel
+    bool monotonic;
+} run_t;
+
+// Step until done, measuring the setpoints the VESC would see
+static run_t run_to_target(current_ramp_t *ramp, float dt_s) {
+    run_t run = { 0, 0.0f, 0.0f, 0.0f, 0.0f, true };
+    float dir = ramp->target > ramp->current ? 1.0f : -1.0f;
+    float prev = ramp->current;
+    float prev_rate = ramp->rate;
+    bool snapped = false;
+
+    while (!current_ramp_done(ramp) && run.steps < MAX_STEPS) {
+        float error = fabsf(ramp->target - ramp->current);
+        float now = current_ramp_step(ramp, dt_s);
+        float rate = (now - prev) / dt_s;
+        run.steps++;
+
+        // The settle snap is below the wire resolution: judged on its size alone
+        snapped = error < SETTLE_A;
+        if (snapped) {
+            if (error > run.snap_max) run.snap_max = error;
+        } else {
+            float accel = fabsf(rate - prev_rate) / dt_s;
+            if (accel > run.accel_max) run.accel_max = accel;
+        }
+        if (fabsf(rate) > run.rate_max) run.rate_max = fabsf(rate);
+        if ((now - ramp->target) * dir > run.beyond) run.beyond = (now - ramp->target) * dir;
+        if ((now - prev) * dir < 0.0f) run.monotonic = false;
+        prev = now;
+        prev_rate = rate;
+    }
+    // Held from here on: the last move has to stop within the jerk limit too
+    if (!snapped && fabsf(prev_rate) / dt_s > run.accel_max) {
+        run.accel_max = fabsf(prev_rate) / dt_s;
+    }
+    return run;
+}
+
+// Duration of the S-curve from rest to rest over distance d
+static float s_curve_s(float d, float rate, float jerk) {
+    if (rate * rate / jerk >= d) {
+        return 2.0f * sqrtf(d / jerk);      // Never reaches the rate cap
+    }
+    return d / rate + rate / jerk;
+}
+
+static void test_limits(void) {
+    current_ramp_t ramp;
+
+    // Up: rate_up and jerk respected, no overshoot, on time
+    current_ramp_reset(&ramp, 0.0f);
+    current_ramp_set_target(&ramp, 80.0f, &fast);
+    run_t up = run_to_target(&ramp, DT_S);
+    CHECK(current_ramp_done(&ramp));
+    CHECK(ramp.current == 80.0f);
+    CHECK(up.rate_max <= fast.rate_up * 1.001f);
+    CHECK(up.rate_max >= fast.rate_up * 0.99f);             // It does reach the cap
+    CHECK(up.accel_max <= fast.jerk * JERK_TOL);
+    CHECK(up.beyond == 0.0f);
+    CHECK(up.monotonic);
+    CHECK_NEAR(up.steps * DT_S, s_curve_s(80.0f, fast.rate_up, fast.jerk), 0.01f);
+
+    // Down: the rate_down cap applies
+    current_ramp_set_target(&ramp, 5.0f, &fast);
+    run_t down = run_to_target(&ramp, DT_S);
+    CHECK(ramp.current == 5.0f);
+    CHECK(down.rate_max <= fast.rate_down * 1.001f);
+    CHECK(down.rate_max >= fast.rate_down * 0.99f);
+    CHECK(down.accel_max <= fast.jerk * JERK_TOL);
+    CHECK(down.beyond == 0.0f);
+    CHECK(down.monotonic);
+
+    // A short move never reaches the rate cap and still eases in and out
+    current_ramp_reset(&ramp, 10.0f);
+    current_ramp_set_target(&ramp, 11.0f, &fast);
+    run_t small = run_to_target(&ramp, DT_S);
+    CHECK(ramp.current == 11.0f);
+    CHECK(small.rate_max < fast.rate_up);
+    CHECK(small.accel_max <= fast.jerk * JERK_TOL);
+    CHECK(small.beyond == 0.0f);
+    CHECK_NEAR(small.steps * DT_S, s_curve_s(1.0f, fast.rate_up, fast.jerk), 0.005f);
+
+    // Rate limit only: straight line at the cap, lands exactly
+    const current_ramp_profile_t linear = { 100.0f, 100.0f, 0.0f };
+    current_ramp_reset(&ramp, 0.0f);
+    current_ramp_set_target(&ramp, 10.0f, &linear);
+    run_t line = run_to_target(&ramp, DT_S);
+    CHECK(ramp.current == 10.0f);
+    CHECK(line.rate_max <= 100.0f * 1.001f);
+    CHECK_NEAR(line.steps, 100, 1);
+    CHECK(line.beyond == 0.0f);
+
+    // Coarse steps (a loop that fell behind) do not overshoot either
+    current_ramp_reset(&ramp, 0.0f);
+    current_ramp_set_target(&ramp, 30.0f, &fast);
+    run_t coarse = run_to_target(&ramp, 0.02f);
+    CHECK(ramp.current == 30.0f);
+    CHECK(coarse.beyond == 0.0f);
+    CHECK(coarse.monotonic);
+}
+
+static void test_reversal(void) {
+    current_ramp_t ramp;
+    current_ramp_reset(&ramp, 0.0f);
+    current_ramp_set_target(&ramp, 60.0f, &fast);
+
+    // Up to full rate, then released
+    for (int i = 0; i < 150; i++) {
+        current_ramp_step(&ramp, DT_S);
+    }
+    CHECK(ramp.rate > fast.rate_up * 0.99f);
+    float turn = ramp.current;
+
+    current_ramp_set_target(&ramp, 0.0f, &fast);
+    float first = current_ramp_step(&ramp, DT_S);
+    CHECK(first <= turn);                                   // Stops moving away at once
+    CHECK(ramp.rate <= 0.0f);
+    CHECK(ramp.rate >= -fast.jerk * DT_S * 1.001f);         // ... and eases into the new direction
+
+    run_t back = run_to_target(&ramp, DT_S);
+    CHECK(ramp.current == 0.0f);
+    CHECK(back.monotonic);
+    CHECK(back.beyond == 0.0f);
+    CHECK(back.rate_max <= fast.rate_down * 1.001f);
+    CHECK(back.accel_max <= fast.jerk * JERK_TOL);
+
+    // Retarget further the same way mid-ramp: carries on without a stop
+    current_ramp_reset(&ramp, 0.0f);
+    current_ramp_set_target(&ramp, 20.0f, &fast);
+    for (int i = 0; i < 80; i++) {
+        current_ramp_step(&ramp, DT_S);
+    }
+    float rate = ramp.rate;
+    current_ramp_set_target(&ramp, 40.0f, &fast);
+    current_ramp_step(&ramp, DT_S);
+    CHECK(ramp.rate >= rate - fast.jerk * DT_S * 1.001f);
+    run_t on = run_to_target(&ramp, DT_S);
+    CHECK(ramp.current == 40.0f);
+    CHECK(on.monotonic);
+    CHECK(on.beyond == 0.0f);
+}
+
+static void test_no_time(void) {
+    current_ramp_t ramp;
+    current_ramp_reset(&ramp, 3.0f);
+    current_ramp_set_target(&ramp, 30.0f, &fast);
+    for (int i = 0; i < 20; i++) {
+        current_ramp_step(&ramp, DT_S);
+    }
+    current_ramp_t before = ramp;
+
+    // dt_s <= 0 moves nothing and keeps the slew rate
+    CHECK(current_ramp_step(&ramp, 0.0f) == before.current);
+    CHECK(current_ramp_step(&ramp, -0.01f) == before.current);
+    CHECK(ramp.current == before.current);
+    CHECK(ramp.rate == before.rate);
+    CHECK(!current_ramp_done(&ramp));
+
+    // Even without limits the step waits for time to pass
+    const current_ramp_profile_t none = { 0.0f, 0.0f, 0.0f };
+    current_ramp_reset(&ramp, 0.0f);
+    current_ramp_set_target(&ramp, 10.0f, &none);
+    CHECK(current_ramp_step(&ramp, 0.0f) == 0.0f);
+}
+
+static void test_no_limit(void) {
+    const current_ramp_profile_t none = { 0.0f, 0.0f, 0.0f };
+    current_ramp_t ramp;
+
+    current_ramp_reset(&ramp, 0.0f);
+    current_ramp_set_target(&ramp, 25.0f, &none);
+    CHECK(current_ramp_step(&ramp, DT_S) == 25.0f);
+    CHECK(current_ramp_done(&ramp));
+
+    current_ramp_set_target(&ramp, -8.0f, &none);
+    CHECK(current_ramp_step(&ramp, DT_S) == -8.0f);
+    CHECK(current_ramp_done(&ramp));
+
+    // Limited one way only: the other way is a plain step
+    const current_ramp_profile_t up_only = { 50.0f, 0.0f, 0.0f };
+    current_ramp_reset(&ramp, 10.0f);
+    current_ramp_set_target(&ramp, 0.0f, &up_only);
+    CHECK(current_ramp_step(&ramp, DT_S) == 0.0f);
+    current_ramp_set_target(&ramp, 10.0f, &up_only);
+    CHECK_NEAR(current_ramp_step(&ramp, DT_S), 50.0f * DT_S, 1e-6f);
+}
+
+static void test_settle(void) {
+    current_ramp_t ramp;
+
+    // Within RAMP_SETTLE_A: lands on the target at once, rate cleared
+    current_ramp_reset(&ramp, 10.0f);
+    current_ramp_set_target(&ramp, 10.0f + SETTLE_A * 0.5f, &fast);
+    CHECK(current_ramp_step(&ramp, DT_S) == ramp.target);
+    CHECK(current_ramp_done(&ramp));
+
+    // Outside it: ramps from rest, by no more than the jerk allows
+    current_ramp_reset(&ramp, 10.0f);
+    current_ramp_set_target(&ramp, 10.0f + SETTLE_A * 10.0f, &fast);
+    float next = current_ramp_step(&ramp, DT_S);
+    CHECK(next > 10.0f && next <= 10.0f + fast.jerk * DT_S * DT_S * 1.001f);
+    CHECK(!current_ramp_done(&ramp));
+    run_to_target(&ramp, DT_S);
+    CHECK(current_ramp_done(&ramp));
+
+    // Every move ends exactly on target with the rate at rest, in bounded time
+    static const float targets[] = { 0.0f, 0.3f, -0.3f, 7.77f, 45.0f, 12.5f, 0.0005f, 0.0f, -20.0f, 0.0f };
+    current_ramp_reset(&ramp, 0.0f);
+    for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+        float from = ramp.current;
+        current_ramp_set_target(&ramp, targets[i], &fast);
+        run_t run = run_to_target(&ramp, DT_S);
+        CHECK(current_ramp_done(&ramp));
+        CHECK(ramp.current == targets[i]);
+        CHECK(ramp.rate == 0.0f);
+        CHECK(run.beyond == 0.0f);
+        CHECK(run.snap_max < SETTLE_A);
+        CHECK(run.accel_max <= fast.jerk * JERK_TOL);
+        float d = fabsf(targets[i] - from);
+        if (d >= SETTLE_A) {
+            float rate = targets[i] > from ? fast.rate_up : fast.rate_down;
+            CHECK(run.steps * DT_S <= s_curve_s(d, rate, fast.jerk) + 0.01f);
+        } else {
+            CHECK(run.steps <= 1);
+        }
+    }
+}
+
+int main(void) {
+    test_limits();
+    test_reversal();
+    test_no_time();
+    test_no_limit();
+    test_settle();
+    TEST_DONE();
+}
@@ -0,0 +1,219 @@
+/**
+ * @file test_stall_guard.c
+ * @brief Stall guard: detection, rate limits, lockouts and the pulse train
+ */
+
+#include "stall_guard.h"
+#include "test_util.h"
+#include <stdbool.h>
+
+#define PERIOD_US   25000           // Active telemetry rate, 40 Hz
+#define COMMANDED   40.0f
+
+// The guard as shipped: Kconfig defaults and the STALL_GUARD_* constants in main.c
+static const stall_guard_config_t shipped = {
+    .current_share = 0.8f,
+    .current_min = 5.0f,
+    .rpm_max = 1000.0f,
+    .detect_s = 0.4f,
+    .temp_max = 80.0f,
+    .cooldown_s = 3.0f,
+    .max_clears = 3,
+    .window_s = 60.0f,
+    .pulse_current = 20.0f,
+    .pulse_s = 0.15f,
+    .gap_s = 0.2f,
+    .pulses = 3,
+};
+
+// Feed stalled samples from *time_us until the guard acts or limit_us has
+// passed. Leaves *time_us at the sample that acted.
+static stall_guard_action_t stall_until(stall_guard_t *guard, int64_t *time_us, int64_t limit_us, float temp) {
+    int64_t end_us = *time_us + limit_us;
+    for (; *time_us <= end_us; *time_us += PERIOD_US) {
+        stall_guard_action_t action = stall_guard_update(guard, *time_us, 50.0f, COMMANDED, COMMANDED,
+                                                         temp, true);
+        if (action != STALL_GUARD_NONE) {
+            return action;
+        }
+    }
+    return STALL_GUARD_NONE;
+}
+
+// Stall from time_us and return the action; the time after it is released
+static stall_guard_action_t stall_at(stall_guard_t *guard, int64_t time_us) {
+    stall_guard_action_t action = stall_until(guard, &time_us, 2000000, 40.0f);
+    // Clearing runs or the rider lets go: not driving
+    stall_guard_update(guard, time_us + PERIOD_US, 0.0f, 0.0f, COMMANDED, 40.0f, false);
+    return action;
+}
+
+static void test_turning(void) {
+    stall_guard_t guard;
+    stall_guard_init(&guard, &shipped);
+
+    // Full current with the prop turning, for longer than any limit
+    for (int64_t t = 0; t < 10000000; t += PERIOD_US) {
+        CHECK(stall_guard_update(&guard, t, 20000.0f, COMMANDED, COMMANDED, 40.0f, true) == STALL_GUARD_NONE);
+        CHECK(stall_guard_update(&guard, t, -20000.0f, COMMANDED, COMMANDED, 40.0f, true) == STALL_GUARD_NONE);
+    }
+    // Slow but not below rpm_max
+    int64_t t = 20000000;
+    for (int i = 0; i < 100; i++, t += PERIOD_US) {
+        CHECK(stall_guard_update(&guard, t, shipped.rpm_max, COMMANDED, COMMANDED, 40.0f, true) ==
+              STALL_GUARD_NONE);
+    }
+    // Stopped, but the current is not at the commanded share (prop out of the water, starting)
+    for (int i = 0; i < 100; i++, t += PERIOD_US) {
+        CHECK(stall_guard_update(&guard, t, 0.0f, COMMANDED * 0.7f, COMMANDED, 40.0f, true) ==
+              STALL_GUARD_NONE);
+    }
+    // Below current_min whatever the share
+    for (int i = 0; i < 100; i++, t += PERIOD_US) {
+        CHECK(stall_guard_update(&guard, t, 0.0f, 4.0f, 4.0f, 40.0f, true) == STALL_GUARD_NONE);
+    }
+    // Not driving
+    for (int i = 0; i < 100; i++, t += PERIOD_US) {
+        CHECK(stall_guard_update(&guard, t, 0.0f, COMMANDED, COMMANDED, 40.0f, false) == STALL_GUARD_NONE);
+    }
+    CHECK_EQ_INT(guard.clears, 0);
+    CHECK_EQ_INT(guard.lockouts, 0);
+}
+
+static void test_detect(void) {
+    stall_guard_t guard;
+    stall_guard_init(&guard, &shipped);
+
+    // Stalled just short of detect_s, then turning for a sample: starts over
+    int64_t t = 1000000;
+    int64_t start_us = t;
+    for (; t < start_us + (int64_t)(shipped.detect_s * 1000000.0f) - PERIOD_US; t += PERIOD_US) {
+        CHECK(stall_guard_update(&guard, t, 0.0f, COMMANDED, COMMANDED, 40.0f, true) == STALL_GUARD_NONE);
+    }
+    CHECK(stall_guard_update(&guard, t, 5000.0f, COMMANDED, COMMANDED, 40.0f, true) == STALL_GUARD_NONE);
+    t += PERIOD_US;
+
+    // Then CLEAR once, detect_s after the stall began
+    start_us = t;
+    CHECK(stall_until(&guard, &t, 2000000, 40.0f) == STALL_GUARD_CLEAR);
+    CHECK(t - start_us >= (int64_t)(shipped.detect_s * 1000000.0f));
+    CHECK(t - start_us <= (int64_t)(shipped.detect_s * 1000000.0f) + PERIOD_US);
+    CHECK_EQ_INT(guard.clears, 1);
+
+    // The confirmation is used up: the next one needs detect_s again
+    t += PERIOD_US;
+    CHECK(stall_guard_update(&guard, t, 0.0f, COMMANDED, COMMANDED, 40.0f, true) == STALL_GUARD_NONE);
+}
+
+static void test_cooldown(void) {
+    stall_guard_t guard;
+    stall_guard_init(&guard, &shipped);
+
+    CHECK(stall_at(&guard, 0) == STALL_GUARD_CLEAR);
+    // Stalled again right after the pulses (about 1.7 s in): inside cooldown_s
+    CHECK(stall_at(&guard, 1300000) == STALL_GUARD_LOCKOUT);
+    CHECK_EQ_INT(guard.lockouts, 1);
+    CHECK_EQ_INT(guard.clears, 1);
+    // Past cooldown_s: clears again
+    CHECK(stall_at(&guard, (int64_t)(shipped.cooldown_s * 1000000.0f)) == STALL_GUARD_CLEAR);
+    CHECK_EQ_INT(guard.clears, 2);
+}
+
+static void test_window(void) {
+    stall_guard_t guard;
+    stall_guard_init(&guard, &shipped);
+
+    // max_clears clearings, each past the cooldown of the one before
+    int64_t t = 0;
+    for (uint32_t i = 0; i < shipped.max_clears; i++, t += 5000000) {
+        CHECK(stall_at(&guard, t) == STALL_GUARD_CLEAR);
+    }
+    CHECK(stall_at(&guard, t) == STALL_GUARD_LOCKOUT);
+    CHECK_EQ_INT(guard.lockouts, 1);
+
+    // Once the first has left window_s, one more is allowed, and only one
+    t = (int64_t)(shipped.window_s * 1000000.0f) + 1000000;
+    CHECK(stall_at(&guard, t) == STALL_GUARD_CLEAR);
+    CHECK(stall_at(&guard, t + 3500000) == STALL_GUARD_LOCKOUT);
+    CHECK_EQ_INT(guard.clears, shipped.max_clears + 1);
+}
+
+static void test_temp(void) {
+    stall_guard_t guard;
+    stall_guard_init(&guard, &shipped);
+
+    int64_t t = 0;
+    CHECK(stall_until(&guard, &t, 2000000, shipped.temp_max) == STALL_GUARD_LOCKOUT);
+    CHECK_EQ_INT(guard.clears, 0);
+    // Locking out does not start the cooldown: a cooler stall clears
+    t += PERIOD_US;
+    CHECK(stall_until(&guard, &t, 2000000, shipped.temp_max - 0.5f) == STALL_GUARD_CLEAR);
+}
+
+static void test_clamp(void) {
+    stall_guard_config_t config = shipped;
+    config.max_clears = STALL_GUARD_MAX_CLEARS + 5;
+    config.cooldown_s = 1.0f;
+    config.window_s = 600.0f;
+    stall_guard_t guard;
+    stall_guard_init(&guard, &config);
+    CHECK_EQ_INT(guard.config.max_clears, STALL_GUARD_MAX_CLEARS);
+
+    // The history ring holds exactly the clamped count
+    int64_t t = 0;
+    for (int i = 0; i < STALL_GUARD_MAX_CLEARS; i++, t += 2000000) {
+        CHECK(stall_at(&guard, t) == STALL_GUARD_CLEAR);
+    }
+    CHECK(stall_at(&guard, t) == STALL_GUARD_LOCKOUT);
+    CHECK_EQ_INT(guard.clears, STALL_GUARD_MAX_CLEARS);
+}
+
+static void test_pulse(void) {
+    const float step_s = 0.001f;
+    float end_s = (shipped.gap_s + shipped.pulse_s) * shipped.pulses + shipped.gap_s;
+    int pulses = 0;
+    float pulse_time_s = 0.0f;
+    float last_pulse_end_s = 0.0f;
+    float prev = 0.0f;
+    bool done = false;
+    float done_at_s = -1.0f;
+
+    CHECK(stall_guard_pulse(&shipped, -0.1f, &done) == 0.0f);
+    CHECK(!done);
+
+    for (int i = 0; i < 2000; i++) {
+        float elapsed_s = i * step_s;
+        float current = stall_guard_pulse(&shipped, elapsed_s, &done);
+        CHECK(current == 0.0f || current == -shipped.pulse_current);
+        if (elapsed_s < shipped.gap_s - step_s * 0.5f) {
+            CHECK(current == 0.0f);             // Starts with a gap
+        }
+        if (current != 0.0f) {
+            if (prev == 0.0f) pulses++;
+            pulse_time_s += step_s;
+            last_pulse_end_s = elapsed_s + step_s;
+        }
+        if (done) {
+            CHECK(current == 0.0f);
+            if (done_at_s < 0.0f) done_at_s = elapsed_s;
+        }
+        prev = current;
+    }
+    CHECK_EQ_INT(pulses, shipped.pulses);
+    CHECK_NEAR(pulse_time_s, shipped.pulse_s * shipped.pulses, 3 * step_s);
+    // The trailing gap, then done
+    CHECK_NEAR(done_at_s, end_s, 1.5f * step_s);
+    CHECK_NEAR(done_at_s - last_pulse_end_s, shipped.gap_s, 2 * step_s);
+    CHECK(stall_guard_pulse(&shipped, end_s + 1.0f, &done) == 0.0f && done);
+}
+
+int main(void) {
+    test_turning();
+    test_detect();
+    test_cooldown();
+    test_window();
+    test_temp();
+    test_clamp();
+    test_pulse();
+    TEST_DONE();
+}
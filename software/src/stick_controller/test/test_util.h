@@ -0,0 +1,50 @@
+/**
+ * @file test_util.h
+ * @brief Minimal check macros for the host tests
+ *
+ * Each test is a plain executable: failed checks are printed and counted,
+ * and TEST_DONE() turns the count into the exit status ctest looks at.
+ */
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdio.h>
+#include <math.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ_INT(a, b) do { \
+        long long va_ = (long long)(a), vb_ = (long long)(b); \
+        if (va_ != vb_) { \
+            printf("%s:%d: %s == %s failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, va_, vb_); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol) do { \
+        double va_ = (double)(a), vb_ = (double)(b); \
+        if (!(fabs(va_ - vb_) <= (double)(tol))) { \
+            printf("%s:%d: %s ~ %s failed: %g vs %g (tol %g)\n", __FILE__, __LINE__, #a, #b, \
+                   va_, vb_, (double)(tol)); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_DONE() do { \
+        if (test_failures) { \
+            printf("%d check(s) failed\n", test_failures); \
+            return 1; \
+        } \
+        printf("ok\n"); \
+        return 0; \
+    } while (0)
+
+#endif // TEST_UTIL_H
@@ -0,0 +1,131 @@
+/**
+ * @file make_traces.c
+ * @brief Writes the prop guard telemetry traces from a motor and prop model
+ *
+ * Not built by the tests: the traces are committed. Rebuild them with
+ *   cc -O2 -o make_traces make_traces.c -lm && ./make_traces
+ * from this directory.
+ *
+ * The model stands in for a ride logged with the guard off: the VESC holds
+ * the current setpoint until the eRPM limit, the prop loads the motor with
+ * k * (kERPM)^2, and the rotor speeds up with the difference. A ventilation
+ * window drops k to a share of its value in water. Samples carry the
+ * telemetry noise and resolution (whole eRPM, centiamps).
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#define STEP_S      0.001f
+#define K_WATER     (70.0f / (30.0f * 30.0f))   // 70 A at 30 kERPM in water
+#define ERPM_MAX    60000.0f
+#define ERPM_PER_AS 10000.0f                    // eRPM/s per amp of excess current
+
+typedef struct {
+    float start_s;
+    float end_s;
+    float share;            // Share of the water load left
+} window_t;
+
+typedef struct {
+    const char *name;
+    const char *about;
+    float period_s;         // Telemetry period
+    float length_s;
+    float (*setpoint)(float t);
+    float (*speedup)(float t);  // Load share from the board speeding up, 1 = none
+    window_t windows[2];
+    int window_count;
+} trace_t;
+
+static float set_70(float t) { (void)t; return 70.0f; }
+static float set_10(float t) { (void)t; return 10.0f; }
+
+// Speed level changes through the fast ramp (280 A/s)
+static float set_levels(float t) {
+    static const float levels[] = { 30.0f, 70.0f, 20.0f, 50.0f };
+    static float now = 0.0f;
+    static float last_t = -1.0f;
+    if (t < last_t) now = 0.0f;
+    last_t = t;
+    float want = levels[(int)(t / 2.0f) % 4];
+    float step = 280.0f * STEP_S;
+    now += fmaxf(-step, fminf(step, want - now));
+    return now;
+}
+
+static float no_speedup(float t) { (void)t; return 1.0f; }
+
+// The board gets faster and the prop unloads by 30% over 5 s
+static float speedup(float t) { return 1.0f - 0.3f * fminf(t / 5.0f, 1.0f); }
+
+static const trace_t traces[] = {
+    { "water_40hz", "steady 70 A in water", 0.025f, 8.0f, set_70, no_speedup, {{ 0.0f, 0.0f, 0.0f }}, 0 },
+    { "water_low_40hz", "steady 10 A in water", 0.025f, 8.0f, set_10, no_speedup, {{ 0.0f, 0.0f, 0.0f }}, 0 },
+    { "levels_40hz", "speed level changes 30/70/20/50 A", 0.025f, 8.0f, set_levels, no_speedup, {{ 0.0f, 0.0f, 0.0f }}, 0 },
+    { "speedup_40hz", "70 A, load easing off 30% as the board speeds up", 0.025f, 8.0f, set_70, speedup, {{ 0.0f, 0.0f, 0.0f }}, 0 },
+    { "vent_40hz", "70 A, prop in air for 1 s", 0.025f, 8.0f, set_70, no_speedup,
+      {{ 3.0f, 4.0f, 0.1f }}, 1 },
+    { "vent_50hz", "70 A, prop in air for 1 s, CAN status rate", 0.020f, 8.0f, set_70, no_speedup,
+      {{ 3.0f, 4.0f, 0.1f }}, 1 },
+    { "vent_partial_40hz", "70 A, partly ventilated for 0.6 s", 0.025f, 8.0f, set_70, no_speedup,
+      {{ 3.0f, 3.6f, 0.35f }}, 1 },
+    { "vent_twice_40hz", "70 A, prop in air twice", 0.025f, 8.0f, set_70, no_speedup,
+      {{ 3.0f, 3.5f, 0.1f }, { 5.0f, 5.4f, 0.1f }}, 2 },
+};
+
+static int write_trace(const trace_t *trace) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s.csv", trace->name);
+    FILE *f = fopen(path, "w");
+    if (f == NULL) return 1;
+
+    fprintf(f, "# %s\n", trace->about);
+    for (int i = 0; i < trace->window_count; i++) {
+        fprintf(f, "# window %d %d\n", (int)lroundf(trace->windows[i].start_s * 1000.0f),
+                (int)lroundf(trace->windows[i].end_s * 1000.0f));
+    }
+    fprintf(f, "time_ms,erpm,current_a,driving\n");
+
+    float rpm = 0.0f;
+    float next_s = 0.0f;
+    uint32_t noise = 12345;
+    int steps = (int)lroundf(trace->length_s / STEP_S);
+    for (int n = 0; n < steps; n++) {
+        float t = n * STEP_S;
+        float share = trace->speedup(t);
+        for (int i = 0; i < trace->window_count; i++) {
+            if (t >= trace->windows[i].start_s && t < trace->windows[i].end_s) {
+                share = trace->windows[i].share;
+            }
+        }
+        float krpm = rpm / 1000.0f;
+        float load = K_WATER * share * krpm * krpm;
+        float current = trace->setpoint(t);
+        if (rpm >= ERPM_MAX) {
+            current = fminf(current, load);
+        }
+        rpm = fminf(fmaxf(rpm + (current - load) * ERPM_PER_AS * STEP_S, 0.0f), ERPM_MAX);
+
+        if (t + STEP_S * 0.5f >= next_s) {
+            next_s += trace->period_s;
+            noise = noise * 1103515245u + 12345u;
+            float current_noise = ((int)((noise >> 16) % 61) - 30) * 0.01f;
+            float rpm_noise = ((int)((noise >> 8) % 41) - 20) * 1.0f;
+            fprintf(f, "%d,%ld,%.2f,1\n", n, lroundf(rpm + rpm_noise), current + current_noise);
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(traces) / sizeof(traces[0]); i++) {
+        if (write_trace(&traces[i]) != 0) {
+            fprintf(stderr, "%s: cannot write\n", traces[i].name);
+            return 1;
+        }
+    }
+    return 0;
+}